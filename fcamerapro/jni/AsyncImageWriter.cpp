@@ -31,6 +31,9 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
 #include "AsyncImageWriter.h"
 #include "FCam/processing/JPEG.h"
 #include "FCam/processing/DNG.h"
@@ -38,6 +41,16 @@
 #include "FCam/FCam.h"
 #include "Common.h"
 #include "HPT.h"
+#include "RadianceMerge.h"
+#include "ToneMapper.h"
+#include "ExposureFusion.h"
+#include "MTBAligner.h"
+#include "BurstMerge.h"
+#include "FlashFusion.h"
+#include "FocusStack.h"
+#include "RawDevelop.h"
+#include "Sharpness.h"
+#include "ThreadPool.h"
 
 #define THUMBNAIL_WIDTH   384 /**< Image thumbnail width in pixels */
 #define THUMBNAIL_HEIGHT  288 /**< Image thumbnail height in pixels */
@@ -50,8 +63,25 @@ static const char sXmlName[] = "img_%04i.xml"; /**< Image stack descriptor file
 static const char sImageName[] = "img_%04i_%02i.%s"; /**< Image file name pattern */
 static const char sThumbnailName[] = "thumb_%04i_%02i.jpg"; /**< Image thumbnail file name pattern */
 static const char sJpegExt[] = "jpg"; /**< JPEG file extension */
+static const char sRawExt[] = "raw"; /**< Raw dump file extension */
+static const char sRadianceName[] = "img_%04i.hdr"; /**< Radiance map file name pattern */
+static const char sToneMappedName[] = "img_%04i_tm.jpg"; /**< Tone mapped radiance map file name pattern */
+static const char sFusedName[] = "img_%04i_fused.jpg"; /**< Exposure fusion file name pattern */
+static const char sMergedName[] = "img_%04i_merged.jpg"; /**< Burst merge file name pattern */
+static const char sFlashFusedName[] = "img_%04i_flash.jpg"; /**< Flash/no-flash fusion file name pattern */
+static const char sStackedName[] = "img_%04i_stacked.jpg"; /**< Focus stack file name pattern */
+static const char sNightName[] = "img_%04i_night.jpg"; /**< Night mode image file name pattern */
+
+#define TONE_MAPPED_QUALITY 95 /**< Tone mapped radiance map JPEG compression quality (0-100) */
+#define FUSED_QUALITY       95 /**< Exposure fusion JPEG compression quality (0-100) */
+#define MERGED_QUALITY      95 /**< Burst merge JPEG compression quality (0-100) */
+#define FLASH_FUSED_QUALITY 95 /**< Flash/no-flash fusion JPEG compression quality (0-100) */
+#define STACKED_QUALITY     95 /**< Focus stack JPEG compression quality (0-100) */
+#define NIGHT_QUALITY       95 /**< Night mode image JPEG compression quality (0-100) */
 
 ImageSet::ImageSet( int id, const char * outputDirPrefix ) :
+    m_luckyFrames( 0 ), m_capturedFrames( 0 ), m_localToneMapping( true ), m_exposureFusion( false ),
+    m_burstMerge( false ), m_flashFusion( false ), m_focusStack( false ), m_alignment( false ), m_nightFrames( 0 ),
     m_outputDirPrefix( outputDirPrefix ), m_fileId( id )
 {
 }
@@ -62,8 +92,349 @@ ImageSet::~ImageSet( void )
 
 void ImageSet::add( const FileFormatDescriptor & ff, const FCam::Frame & frame )
 {
+    int index = m_capturedFrames++;
+    float sharpness = -1.0f;
+
+    if ( m_luckyFrames > 0 )
+    {
+        if ( frame.valid() && frame.image().type() == FCam::YUV420p )
+        {
+            Timer timer;
+            timer.tic();
+            sharpness = GetFrameSharpness( frame.image()( 0, 0 ), frame.image().width(), frame.image().height(),
+                                           m_sharpnessScratch );
+            LOG( "frame %i sharpness: %.1f (%.3f)\n", index, sharpness, timer.toc() );
+        }
+
+        // evict the least sharp kept frame, releasing its image
+        if (( int ) m_ranking.size() >= m_luckyFrames )
+        {
+            if ( sharpness <= m_ranking.front().first )
+            {
+                return;
+            }
+
+            std::pop_heap( m_ranking.begin(), m_ranking.end(), std::greater<std::pair<float, int> >() );
+            int slot = std::find( m_frameIndex.begin(), m_frameIndex.end(), m_ranking.back().second ) - m_frameIndex.begin();
+            m_ranking.pop_back();
+
+            m_frames.erase( m_frames.begin() + slot );
+            m_frameFormat.erase( m_frameFormat.begin() + slot );
+            m_frameSharpness.erase( m_frameSharpness.begin() + slot );
+            m_frameIndex.erase( m_frameIndex.begin() + slot );
+        }
+
+        m_ranking.push_back( std::make_pair( sharpness, index ) );
+        std::push_heap( m_ranking.begin(), m_ranking.end(), std::greater<std::pair<float, int> >() );
+    }
+
     m_frames.push_back( frame );
     m_frameFormat.push_back( ff );
+    m_frameSharpness.push_back( sharpness );
+    m_frameIndex.push_back( index );
+}
+
+void ImageSet::enableLuckyShot( int keep )
+{
+    m_luckyFrames = keep > 1 ? keep : 1;
+}
+
+void ImageSet::enableRadianceMerge( const float * responseCurve, bool localToneMapping )
+{
+    m_responseCurve.assign( responseCurve, responseCurve + 3 * RESPONSE_CURVE_SIZE );
+    m_localToneMapping = localToneMapping;
+}
+
+void ImageSet::enableExposureFusion( void )
+{
+    m_exposureFusion = true;
+}
+
+void ImageSet::enableBurstMerge( void )
+{
+    m_burstMerge = true;
+}
+
+void ImageSet::enableFlashFusion( void )
+{
+    m_flashFusion = true;
+}
+
+void ImageSet::enableFocusStack( void )
+{
+    m_focusStack = true;
+}
+
+void ImageSet::setNightImage( const FCam::Image & image, int frameCount )
+{
+    m_nightImage = image;
+    m_nightFrames = frameCount;
+}
+
+void ImageSet::enableAlignment( void )
+{
+    m_alignment = true;
+}
+
+/**
+ * Gets the color filter layout of a raw frame.
+ * @param frame raw frame
+ * @param pattern receives the layout (RawDevelop::EBayerPattern value)
+ * @return false if the frame has no Bayer data
+ */
+static bool GetBayerPattern( const FCam::Frame & frame, int & pattern )
+{
+    if ( frame.image().type() != FCam::RAW )
+    {
+        return false;
+    }
+
+    switch ( frame.platform().bayerPattern() )
+    {
+        case FCam::RGGB:
+            pattern = RawDevelop::EBayerRGGB;
+            return true;
+        case FCam::BGGR:
+            pattern = RawDevelop::EBayerBGGR;
+            return true;
+        case FCam::GRBG:
+            pattern = RawDevelop::EBayerGRBG;
+            return true;
+        case FCam::GBRG:
+            pattern = RawDevelop::EBayerGBRG;
+            return true;
+        default:
+            return false;
+    }
+}
+
+FCam::Image ImageSet::developRawFrame( const FCam::Frame & frame, const char * fileName, ThreadPool * pool )
+{
+    const FCam::Image & raw = frame.image();
+    const FCam::Platform & platform = frame.platform();
+
+    RawDevelop::Metadata metadata;
+    if ( !GetBayerPattern( frame, metadata.bayerPattern ) )
+    {
+        ERROR( "developRawFrame(): frame has no Bayer data!" );
+        return FCam::Image();
+    }
+
+    // YUV420p output needs an even size
+    metadata.width = raw.width() & ~1;
+    metadata.height = raw.height() & ~1;
+    metadata.blackLevel = platform.minRawValue();
+    metadata.whiteLevel = platform.maxRawValue();
+
+    // 3x4 sensor matrix for the shot's color temperature, the offsets are not used
+    float rawToRGB[12];
+    platform.rawToRGBColorMatrix( frame.whiteBalance(), rawToRGB );
+    float matrix[9];
+    for ( int i = 0; i < 3; i++ )
+    {
+        std::copy( rawToRGB + 4 * i, rawToRGB + 4 * i + 3, matrix + 3 * i );
+    }
+    RawDevelop::SplitColorMatrix( matrix, metadata.wbGains, metadata.colorMatrix );
+
+    const ushort * samples = ( const ushort * ) raw( 0, 0 );
+    int stride = raw.bytesPerRow() / sizeof( ushort );
+    RawDevelop::WriteDump( fileName, samples, stride, metadata );
+
+    FCam::Image developed( metadata.width, metadata.height, FCam::YUV420p );
+    Timer timer;
+    timer.tic();
+    RawDevelop develop;
+    develop.develop( samples, stride, metadata, RawDevelop::EDemosaicGradient, developed( 0, 0 ), pool );
+    LOG( "raw develop time: %.3f\n", timer.toc() );
+
+    return developed;
+}
+
+void ImageSet::alignFrames( ThreadPool * pool )
+{
+    std::vector<const uchar *> frames;
+    std::vector<float> logExposure;
+    int width, height;
+
+    int count = collectStackFrames( frames, logExposure, width, height );
+    if ( count < 2 )
+    {
+        return;
+    }
+
+    // reference is the frame of median exposure, the best exposed one for most of the scene
+    std::vector<float> sorted( logExposure );
+    std::nth_element( sorted.begin(), sorted.begin() + count / 2, sorted.end() );
+    int reference = std::find( logExposure.begin(), logExposure.end(), sorted[count / 2] ) - logExposure.begin();
+
+    std::vector<int> offsets( 2 * count );
+    MTBAligner aligner;
+    aligner.align( &frames[0], count, reference, width, height, &offsets[0], pool );
+
+    for ( int i = 0; i < count; i++ )
+    {
+        LOG( "alignFrames: frame %d offset (%d, %d)\n", i, offsets[2 * i], offsets[2 * i + 1] );
+        // the frame data is no longer needed unaligned, the images have already been written
+        MTBAligner::Translate( const_cast<uchar *>( frames[i] ), width, height, offsets[2 * i], offsets[2 * i + 1] );
+    }
+}
+
+int ImageSet::collectStackFrames( std::vector<const uchar *> & frames, std::vector<float> & logExposure, int & width,
+                                 int & height ) const
+{
+    width = height = 0;
+
+    for ( int i = 0; i < m_frames.size(); i++ )
+    {
+        const FCam::Frame & frame = m_frames[i];
+        if ( !frame.valid() || frame.image().type() != FCam::YUV420p )
+        {
+            continue;
+        }
+
+        if ( frames.empty() )
+        {
+            width = frame.image().width();
+            height = frame.image().height();
+        }
+        else if ( frame.image().width() != width || frame.image().height() != height )
+        {
+            continue;
+        }
+
+        frames.push_back( frame.image()( 0, 0 ) );
+        logExposure.push_back( logf( frame.exposure() * 1e-6f * frame.gain() ) );
+    }
+
+    return frames.size();
+}
+
+bool ImageSet::writeRadianceMap( const char * fileName, const char * toneMappedFileName, ThreadPool * pool )
+{
+    std::vector<const uchar *> frames;
+    std::vector<float> logExposure;
+    int width, height;
+
+    if ( collectStackFrames( frames, logExposure, width, height ) < 2 )
+    {
+        ERROR( "writeRadianceMap: at least two frames of the same size are needed" );
+        return false;
+    }
+
+    std::vector<uchar> rgbe( width * height * 4 );
+    RadianceMerge merge;
+    merge.setResponseCurve( &m_responseCurve[0] );
+
+    if ( !merge.write( fileName, &frames[0], &logExposure[0], frames.size(), width, height, pool, &rgbe[0] ) )
+    {
+        return false;
+    }
+
+    FCam::Image toneMapped( width, height, FCam::YUV420p );
+    ToneMapper toneMapper;
+    toneMapper.map( m_localToneMapping ? ToneMapper::EOperatorLocal : ToneMapper::EOperatorGlobal, &rgbe[0], width, height,
+                    toneMapped( 0, 0 ), pool );
+    FCam::saveJPEG( toneMapped, toneMappedFileName, TONE_MAPPED_QUALITY );
+
+    return true;
+}
+
+bool ImageSet::writeExposureFusion( const char * fileName, ThreadPool * pool )
+{
+    std::vector<const uchar *> frames;
+    std::vector<float> logExposure;
+    int width, height;
+
+    if ( collectStackFrames( frames, logExposure, width, height ) < 2 )
+    {
+        ERROR( "writeExposureFusion: at least two frames of the same size are needed" );
+        return false;
+    }
+
+    FCam::Image fused( width, height, FCam::YUV420p );
+    ExposureFusion fusion;
+    fusion.fuse( &frames[0], frames.size(), width, height, fused( 0, 0 ), pool );
+    FCam::saveJPEG( fused, fileName, FUSED_QUALITY );
+
+    return true;
+}
+
+bool ImageSet::writeBurstMerge( const char * fileName, ThreadPool * pool )
+{
+    std::vector<const uchar *> frames;
+    std::vector<float> logExposure;
+    int width, height;
+
+    if ( collectStackFrames( frames, logExposure, width, height ) < 2 )
+    {
+        ERROR( "writeBurstMerge: at least two frames of the same size are needed" );
+        return false;
+    }
+
+    FCam::Image merged( width, height, FCam::YUV420p );
+    BurstMerge merge;
+    merge.merge( &frames[0], frames.size(), width, height, merged( 0, 0 ), pool );
+    FCam::saveJPEG( merged, fileName, MERGED_QUALITY );
+
+    return true;
+}
+
+bool ImageSet::writeFlashFusion( const char * fileName, ThreadPool * pool )
+{
+    // the last no-flash frame followed by a flash frame of the same size is the
+    // pair taken back to back
+    int ambient = -1, flash = -1;
+    for ( int i = 0; i + 1 < m_frames.size(); i++ )
+    {
+        const FCam::Frame & a = m_frames[i];
+        const FCam::Frame & f = m_frames[i + 1];
+        if ( !a.valid() || !f.valid() || a.image().type() != FCam::YUV420p || f.image().type() != FCam::YUV420p
+             || a.image().width() != f.image().width() || a.image().height() != f.image().height() )
+        {
+            continue;
+        }
+
+        if ( FCam::Flash::Tags( a ).brightness <= 0.0f && FCam::Flash::Tags( f ).brightness > 0.0f )
+        {
+            ambient = i;
+            flash = i + 1;
+        }
+    }
+
+    if ( ambient < 0 )
+    {
+        ERROR( "writeFlashFusion: a no-flash frame followed by a flash frame of the same size is needed" );
+        return false;
+    }
+
+    int width = m_frames[ambient].image().width();
+    int height = m_frames[ambient].image().height();
+    FCam::Image fused( width, height, FCam::YUV420p );
+    FlashFusion fusion;
+    fusion.fuse( m_frames[ambient].image()( 0, 0 ), m_frames[flash].image()( 0, 0 ), width, height, fused( 0, 0 ), pool );
+    FCam::saveJPEG( fused, fileName, FLASH_FUSED_QUALITY );
+
+    return true;
+}
+
+bool ImageSet::writeFocusStack( const char * fileName, ThreadPool * pool )
+{
+    std::vector<const uchar *> frames;
+    std::vector<float> logExposure;
+    int width, height;
+
+    if ( collectStackFrames( frames, logExposure, width, height ) < 2 )
+    {
+        ERROR( "writeFocusStack: at least two frames of the same size are needed" );
+        return false;
+    }
+
+    FCam::Image stacked( width, height, FCam::YUV420p );
+    FocusStack stack;
+    stack.stack( &frames[0], frames.size(), width, height, stacked( 0, 0 ), pool );
+    FCam::saveJPEG( stacked, fileName, STACKED_QUALITY );
+
+    return true;
 }
 
 /**
@@ -152,7 +523,7 @@ static void CreateThumbnail( FCam::Image & dest, const FCam::Image & source )
 }
 
 void ImageSet::dumpToFileSystem(
-    ASYNC_IMAGE_WRITER_CALLBACK onFileSystemChange )
+    ASYNC_IMAGE_WRITER_CALLBACK onFileSystemChange, ThreadPool * pool )
 {
     char fname[128];
     char buf[128];
@@ -179,13 +550,52 @@ void ImageSet::dumpToFileSystem(
     FILE * xml = fopen( buf, "wb" );
 
     fprintf( xml, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" );
-    fprintf( xml, "<imagestack imagecount=\"%i\">\n", icount );
+    fprintf( xml, "<imagestack imagecount=\"%i\"", icount );
+    if ( !m_responseCurve.empty() )
+    {
+        sprintf( fname, sRadianceName, m_fileId );
+        sprintf( buf, sToneMappedName, m_fileId );
+        fprintf( xml, " radiance=\"%s\" tonemapped=\"%s\"", fname, buf );
+    }
+    if ( m_exposureFusion )
+    {
+        sprintf( fname, sFusedName, m_fileId );
+        fprintf( xml, " fused=\"%s\"", fname );
+    }
+    if ( m_burstMerge )
+    {
+        sprintf( fname, sMergedName, m_fileId );
+        fprintf( xml, " merged=\"%s\"", fname );
+    }
+    if ( m_flashFusion )
+    {
+        sprintf( fname, sFlashFusedName, m_fileId );
+        fprintf( xml, " flashfused=\"%s\"", fname );
+    }
+    if ( m_focusStack )
+    {
+        sprintf( fname, sStackedName, m_fileId );
+        fprintf( xml, " stacked=\"%s\"", fname );
+    }
+    if ( m_nightFrames > 0 )
+    {
+        sprintf( fname, sNightName, m_fileId );
+        fprintf( xml, " night=\"%s\" nightframes=\"%i\"", fname, m_nightFrames );
+    }
+    if ( m_luckyFrames > 0 )
+    {
+        fprintf( xml, " captured=\"%i\"", m_capturedFrames );
+    }
+    fprintf( xml, ">\n" );
 
+    int bayerPattern;
     for ( int i = 0; i < m_frames.size(); i++ )
     {
         const FCam::Frame & frame = m_frames[i];
 
-        if ( frame.valid() )
+        // raw frames without Bayer data are neither dumped nor developed
+        if ( frame.valid() && ( m_frameFormat[i].getFormat() != FileFormatDescriptor::EFormatRAW
+                                || GetBayerPattern( frame, bayerPattern ) ) )
         {
             fprintf( xml, "<image " );
             // image name
@@ -194,6 +604,12 @@ void ImageSet::dumpToFileSystem(
             // thumbnail name
             sprintf( fname, sThumbnailName, m_fileId, i );
             fprintf( xml, "thumbnail=\"%s\" ", fname );
+            // raw dump name
+            if ( m_frameFormat[i].getFormat() == FileFormatDescriptor::EFormatRAW )
+            {
+                sprintf( fname, sImageName, m_fileId, i, sRawExt );
+                fprintf( xml, "raw=\"%s\" ", fname );
+            }
             // flash on/off
             FCam::Flash::Tags flashTags( frame );
             fprintf( xml, "flash=\"%i\" ", flashTags.brightness > 0.0f ? 1 : 0 );
@@ -206,6 +622,11 @@ void ImageSet::dumpToFileSystem(
             // focus
             FCam::Lens::Tags lensTags( frame );
             fprintf( xml, "focus=\"%.2f\" ", lensTags.focus );
+            // sharpness score (lucky shot mode)
+            if ( m_frameSharpness[i] >= 0.0f )
+            {
+                fprintf( xml, "sharpness=\"%.1f\" ", m_frameSharpness[i] );
+            }
 
 
             fprintf( xml, "/>\n" );
@@ -231,6 +652,8 @@ void ImageSet::dumpToFileSystem(
         const FCam::Frame & frame = m_frames[i];
         if ( frame.valid() )
         {
+            FCam::Image image = frame.image();
+
             // write image
             switch ( m_frameFormat[i].getFormat() )
             {
@@ -239,13 +662,31 @@ void ImageSet::dumpToFileSystem(
                     sprintf( buf, "%s%s", m_outputDirPrefix, fname );
                     FCam::saveJPEG( frame, buf, m_frameFormat[i].getQuality() );
                     break;
+                case FileFormatDescriptor::EFormatRAW:
+                    // raw dump and the image developed from it
+                    sprintf( fname, sImageName, m_fileId, i, sRawExt );
+                    sprintf( buf, "%s%s", m_outputDirPrefix, fname );
+                    image = developRawFrame( frame, buf, pool );
+                    if ( image.valid() )
+                    {
+                        sprintf( fname, sImageName, m_fileId, i, sJpegExt );
+                        sprintf( buf, "%s%s", m_outputDirPrefix, fname );
+                        FCam::saveJPEG( image, buf, m_frameFormat[i].getQuality() );
+                    }
+                    break;
+            }
+
+            // the frame is not listed in the xml then
+            if ( !image.valid() )
+            {
+                continue;
             }
 
             // write thumbnail
             sprintf( fname, sThumbnailName, m_fileId, i );
             sprintf( buf, "%s%s", m_outputDirPrefix, fname );
             timer.tic();
-            CreateThumbnail( thumbnail, frame.image() );
+            CreateThumbnail( thumbnail, image );
             LOG( "create thumbnail time: %.3f\n", timer.toc() );
             FCam::saveJPEG( thumbnail, buf, THUMBNAIL_QUALITY );
 
@@ -256,6 +697,82 @@ void ImageSet::dumpToFileSystem(
             }
         }
     }
+
+    // align frames for the merges
+    if ( m_alignment && ( !m_responseCurve.empty() || m_exposureFusion || m_focusStack ) )
+    {
+        alignFrames( pool );
+    }
+
+    // write radiance map
+    if ( !m_responseCurve.empty() )
+    {
+        char toneMappedName[128];
+        sprintf( fname, sToneMappedName, m_fileId );
+        sprintf( toneMappedName, "%s%s", m_outputDirPrefix, fname );
+        sprintf( fname, sRadianceName, m_fileId );
+        sprintf( buf, "%s%s", m_outputDirPrefix, fname );
+        if ( writeRadianceMap( buf, toneMappedName, pool ) && onFileSystemChange != 0 )
+        {
+            onFileSystemChange();
+        }
+    }
+
+    // write exposure fusion
+    if ( m_exposureFusion )
+    {
+        sprintf( fname, sFusedName, m_fileId );
+        sprintf( buf, "%s%s", m_outputDirPrefix, fname );
+        if ( writeExposureFusion( buf, pool ) && onFileSystemChange != 0 )
+        {
+            onFileSystemChange();
+        }
+    }
+
+    // write burst merge
+    if ( m_burstMerge )
+    {
+        sprintf( fname, sMergedName, m_fileId );
+        sprintf( buf, "%s%s", m_outputDirPrefix, fname );
+        if ( writeBurstMerge( buf, pool ) && onFileSystemChange != 0 )
+        {
+            onFileSystemChange();
+        }
+    }
+
+    // write flash/no-flash fusion
+    if ( m_flashFusion )
+    {
+        sprintf( fname, sFlashFusedName, m_fileId );
+        sprintf( buf, "%s%s", m_outputDirPrefix, fname );
+        if ( writeFlashFusion( buf, pool ) && onFileSystemChange != 0 )
+        {
+            onFileSystemChange();
+        }
+    }
+
+    // write focus stack
+    if ( m_focusStack )
+    {
+        sprintf( fname, sStackedName, m_fileId );
+        sprintf( buf, "%s%s", m_outputDirPrefix, fname );
+        if ( writeFocusStack( buf, pool ) && onFileSystemChange != 0 )
+        {
+            onFileSystemChange();
+        }
+    }
+
+    // write night mode image
+    if ( m_nightFrames > 0 )
+    {
+        sprintf( fname, sNightName, m_fileId );
+        sprintf( buf, "%s%s", m_outputDirPrefix, fname );
+        FCam::saveJPEG( m_nightImage, buf, NIGHT_QUALITY );
+        if ( onFileSystemChange != 0 )
+        {
+            onFileSystemChange();
+        }
+    }
 }
 
 // ==============================================================================
@@ -287,6 +804,15 @@ AsyncImageWriter::AsyncImageWriter( const char * outputDirPrefix )
     }
 
     m_onChangedCallback = 0;
+
+    // calibration data is kept next to the images
+    char * calibrationFileName = new char[strlen( m_outputDirPrefix ) + sizeof( CALIBRATION_FILE_NAME )];
+    sprintf( calibrationFileName, "%s%s", m_outputDirPrefix, CALIBRATION_FILE_NAME );
+    m_calibration = new CalibrationStore( calibrationFileName );
+    delete[] calibrationFileName;
+
+    m_mergePool = new ThreadPool();
+
     // launch the work thread
     pthread_create( &m_thread, 0, AsyncImageWriter::ThreadProc, this );
 }
@@ -297,6 +823,8 @@ AsyncImageWriter::~AsyncImageWriter( void )
     m_queue.produce( 0 );
     pthread_join( m_thread, 0 );
 
+    delete m_mergePool;
+    delete m_calibration;
     delete[] m_outputDirPrefix;
 }
 
@@ -351,7 +879,7 @@ void * AsyncImageWriter::ThreadProc( void * opaque )
             break;
         }
 
-        imageset->dumpToFileSystem( instance->m_onChangedCallback );
+        imageset->dumpToFileSystem( instance->m_onChangedCallback, instance->m_mergePool );
         delete imageset;
     }
 
@@ -35,6 +35,10 @@
 #include <FCam/Tegra.h>
 #include <vector>
 #include "WorkQueue.h"
+#include "ResponseCurve.h"
+#include "CalibrationStore.h"
+
+class ThreadPool;
 
 
 /**
@@ -107,11 +111,77 @@ public:
 
     /**
      * Adds FCam frame to the image set with specific compression settings.
+     * In lucky shot mode (see enableLuckyShot()) the frame is scored on
+     * arrival and kept only if it ranks among the sharpest frames so far.
      * @param ff defines compression settings (file format, quality, etc.) for the frame
      * @param frame is a reference to FCam frame container
      */
     void add( const FileFormatDescriptor & ff, const FCam::Frame & frame );
 
+    /**
+     * Enables the lucky shot mode: every frame added afterwards is scored
+     * with GetFrameSharpness() and only the sharpest frames are kept, in a
+     * bounded min-heap, and written. The scores are written to the
+     * descriptor. Frames without YUV420p data score lowest.
+     * @param keep number of frames to keep (at least 1)
+     */
+    void enableLuckyShot( int keep );
+
+    /**
+     * Requests the frames of the image set to be merged into a radiance map
+     * (see RadianceMerge) in addition to writing the individual images. The
+     * radiance map is also tone mapped (see ToneMapper) to a JPEG image.
+     * @param responseCurve log inverse response curve of R, G and B,
+     * 3 * RESPONSE_CURVE_SIZE values (the values are copied)
+     * @param localToneMapping use the local tone mapping operator instead of the global one
+     */
+    void enableRadianceMerge( const float * responseCurve, bool localToneMapping );
+
+    /**
+     * Requests the frames of the image set to be blended into a single JPEG
+     * image by exposure fusion (see ExposureFusion) in addition to writing
+     * the individual images.
+     */
+    void enableExposureFusion( void );
+
+    /**
+     * Requests the frames of the image set, a burst of identical shots, to be
+     * aligned and merged into a single low-noise JPEG image (see BurstMerge)
+     * in addition to writing the individual images.
+     */
+    void enableBurstMerge( void );
+
+    /**
+     * Requests the no-flash frame of the image set and the flash frame taken
+     * right after it to be fused into a single JPEG image with the ambient
+     * lighting and the flash detail (see FlashFusion) in addition to writing
+     * the individual images.
+     */
+    void enableFlashFusion( void );
+
+    /**
+     * Requests the frames of the image set, a focus bracket, to be composited
+     * into a single all-in-focus JPEG image (see FocusStack) in addition to
+     * writing the individual images.
+     */
+    void enableFocusStack( void );
+
+    /**
+     * Attaches a night mode image, the average of a stream of aligned short
+     * exposures (see NightAccumulator), written as a JPEG image in addition to
+     * the individual images.
+     * @param image night mode image (YUV420p)
+     * @param frameCount number of averaged frames
+     */
+    void setNightImage( const FCam::Image & image, int frameCount );
+
+    /**
+     * Requests the frames of the image set to be aligned to the median exposure
+     * frame (see MTBAligner) before they are merged into a radiance map, fused
+     * or focus stacked. The individual images are written unaligned.
+     */
+    void enableAlignment( void );
+
 private:
     /**
      * Default constructor.
@@ -128,11 +198,102 @@ private:
      * Writes the content of this ImageSet to the storage and invokes the callback
      * function to notify the output is ready.
      * @param proc pointer to a file system changed notification function
+     * @param pool thread pool used by the raw development, radiance merge, exposure fusion, burst merge, flash fusion and focus stack
+     */
+    void dumpToFileSystem( ASYNC_IMAGE_WRITER_CALLBACK proc, ThreadPool * pool );
+
+    /**
+     * Merges the valid frames of this ImageSet into a radiance map file and
+     * writes its tone mapped version.
+     * @param fileName output file name
+     * @param toneMappedFileName tone mapped image output file name
+     * @param pool thread pool used by the merge and tone mapping
+     * @return true if the radiance map has been written
+     */
+    bool writeRadianceMap( const char * fileName, const char * toneMappedFileName, ThreadPool * pool );
+
+    /**
+     * Blends the valid frames of this ImageSet by exposure fusion and writes
+     * the result as a JPEG image.
+     * @param fileName output file name
+     * @param pool thread pool used by the fusion
+     * @return true if the fused image has been written
+     */
+    bool writeExposureFusion( const char * fileName, ThreadPool * pool );
+
+    /**
+     * Aligns and merges the valid frames of this ImageSet into a denoised
+     * image and writes it as a JPEG image.
+     * @param fileName output file name
+     * @param pool thread pool used by the merge
+     * @return true if the merged image has been written
      */
-    void dumpToFileSystem( ASYNC_IMAGE_WRITER_CALLBACK proc );
+    bool writeBurstMerge( const char * fileName, ThreadPool * pool );
+
+    /**
+     * Fuses the last no-flash frame of this ImageSet with the flash frame
+     * following it and writes the result as a JPEG image.
+     * @param fileName output file name
+     * @param pool thread pool used by the fusion
+     * @return true if the fused image has been written
+     */
+    bool writeFlashFusion( const char * fileName, ThreadPool * pool );
+
+    /**
+     * Composites the valid frames of this ImageSet into an all-in-focus image
+     * and writes it as a JPEG image.
+     * @param fileName output file name
+     * @param pool thread pool used by the composite
+     * @return true if the composite has been written
+     */
+    bool writeFocusStack( const char * fileName, ThreadPool * pool );
+
+    /**
+     * Writes the raw dump of a RAW frame (see RawDevelop::WriteDump()) and
+     * develops it with the gradient-corrected demosaic.
+     * @param frame RAW frame
+     * @param fileName raw dump output file name
+     * @param pool thread pool used by the development
+     * @return developed YUV420p image (invalid if the frame has no Bayer data)
+     */
+    FCam::Image developRawFrame( const FCam::Frame & frame, const char * fileName, ThreadPool * pool );
+
+    /**
+     * Translates the valid frames of this ImageSet in place to align them with
+     * the frame of median exposure.
+     * @param pool thread pool used by the alignment
+     */
+    void alignFrames( ThreadPool * pool );
+
+    /**
+     * Collects the valid YUV420p frames of this ImageSet that share the size
+     * of the first one.
+     * @param frames receives the frame data pointers
+     * @param logExposure receives the log exposure (exposure time * gain) of the frames
+     * @param width receives the frame width
+     * @param height receives the frame height
+     * @return number of collected frames
+     */
+    int collectStackFrames( std::vector<const uchar *> & frames, std::vector<float> & logExposure, int & width,
+                            int & height ) const;
 
     std::vector<FCam::Frame> m_frames; /**< FCam frame vector */
     std::vector<FileFormatDescriptor> m_frameFormat; /**< Per frame output settings vector */
+    std::vector<float> m_frameSharpness; /**< Per frame sharpness score (negative if not scored) */
+    std::vector<int> m_frameIndex; /**< Per frame capture index */
+    std::vector<std::pair<float, int> > m_ranking; /**< Min-heap of (sharpness, capture index) of the kept frames in lucky shot mode */
+    std::vector<uchar> m_sharpnessScratch; /**< Downsampled luma planes of the sharpness scoring */
+    int m_luckyFrames; /**< Number of sharpest frames kept (0 - lucky shot mode off) */
+    int m_capturedFrames; /**< Number of frames added */
+    std::vector<float> m_responseCurve; /**< Response curve for the radiance merge (empty if disabled) */
+    bool m_localToneMapping; /**< Tone map the radiance map with the local operator? */
+    bool m_exposureFusion; /**< Write the exposure fusion of the frames? */
+    bool m_burstMerge; /**< Write the burst merge of the frames? */
+    bool m_flashFusion; /**< Write the flash/no-flash fusion of the frames? */
+    bool m_focusStack; /**< Write the all-in-focus composite of the frames? */
+    bool m_alignment; /**< Align the frames before merging? */
+    FCam::Image m_nightImage; /**< Night mode image (valid if m_nightFrames > 0) */
+    int m_nightFrames; /**< Number of frames averaged into the night mode image */
     const char * m_outputDirPrefix; /**< Output directory location */
     const int m_fileId; /**< ImageSet instance file id */
 };
@@ -181,6 +342,16 @@ public:
      */
     void setOnFileSystemChangedCallback( ASYNC_IMAGE_WRITER_CALLBACK cb );
 
+    /**
+     * Gets the persistent calibration store (response curves per sensor and
+     * gain) kept in the output directory.
+     * @return pointer to the calibration store
+     */
+    CalibrationStore * getCalibrationStore( void )
+    {
+        return m_calibration;
+    }
+
     /**
      * Sets image set descriptor file id. This id will be assigned to next instance
      * of ImageSet produced with newImageSet().
@@ -192,6 +363,8 @@ private:
     char * m_outputDirPrefix; /**< Output directory location */
     WorkQueue<ImageSet *> m_queue; /**< Queue with ImageSet instances to be written */
     ASYNC_IMAGE_WRITER_CALLBACK m_onChangedCallback; /**< Callback function called when file system has been changed */
+    CalibrationStore * m_calibration; /**< Calibration store of the output directory */
+    ThreadPool * m_mergePool; /**< Thread pool for radiance merges */
 
     pthread_t m_thread; /**< Worker thread handler */
 
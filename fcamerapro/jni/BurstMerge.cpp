@@ -0,0 +1,502 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of BurstMerge.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#include <algorithm>
+#include "BurstMerge.h"
+#include "Sharpness.h"
+#include "ThreadPool.h"
+#include "HPT.h"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Computes sum of absolute differences of two BURST_TILE_SIZE x BURST_TILE_SIZE tiles.
+ * @param a first tile
+ * @param b second tile
+ * @param stride row size of both planes
+ * @return sum of absolute differences
+ */
+static inline int TileSAD( const uchar * a, const uchar * b, int stride )
+{
+#if defined(__ARM_NEON__)
+    uint16x8_t sum = vdupq_n_u16( 0 );
+    for ( int y = 0; y < BURST_TILE_SIZE; y++, a += stride, b += stride )
+    {
+        uint8x16_t va = vld1q_u8( a );
+        uint8x16_t vb = vld1q_u8( b );
+        sum = vabal_u8( sum, vget_low_u8( va ), vget_low_u8( vb ) );
+        sum = vabal_u8( sum, vget_high_u8( va ), vget_high_u8( vb ) );
+    }
+    uint32x4_t sum32 = vpaddlq_u16( sum );
+    uint64x2_t sum64 = vpaddlq_u32( sum32 );
+    return (int) ( vgetq_lane_u64( sum64, 0 ) + vgetq_lane_u64( sum64, 1 ) );
+#elif defined(__SSE2__)
+    __m128i sum = _mm_setzero_si128();
+    for ( int y = 0; y < BURST_TILE_SIZE; y++, a += stride, b += stride )
+    {
+        sum = _mm_add_epi32( sum, _mm_sad_epu8( _mm_loadu_si128( (const __m128i *) a ),
+                                                _mm_loadu_si128( (const __m128i *) b ) ) );
+    }
+    return _mm_cvtsi128_si32( sum ) + _mm_cvtsi128_si32( _mm_srli_si128( sum, 8 ) );
+#else
+    int sum = 0;
+    for ( int y = 0; y < BURST_TILE_SIZE; y++, a += stride, b += stride )
+    {
+        for ( int x = 0; x < BURST_TILE_SIZE; x++ )
+        {
+            sum += abs( a[x] - b[x] );
+        }
+    }
+    return sum;
+#endif
+}
+
+/**
+ * Computes mean squared difference of two BURST_TILE_SIZE x BURST_TILE_SIZE tiles.
+ * @param a first tile
+ * @param b second tile
+ * @param stride row size of both planes
+ * @return mean squared difference
+ */
+static float TileMSD( const uchar * a, const uchar * b, int stride )
+{
+    int sum = 0;
+    for ( int y = 0; y < BURST_TILE_SIZE; y++, a += stride, b += stride )
+    {
+        for ( int x = 0; x < BURST_TILE_SIZE; x++ )
+        {
+            int d = a[x] - b[x];
+            sum += d * d;
+        }
+    }
+    return sum * ( 1.0f / ( BURST_TILE_SIZE * BURST_TILE_SIZE ) );
+}
+
+BurstMerge::BurstMerge( void ) : m_frames( 0 ), m_frameCount( 0 ), m_reference( 0 ), m_width( 0 ), m_height( 0 ), m_yuv( 0 ),
+    m_pool( 0 ), m_op( EOperationAlign ), m_alternate( 0 ), m_level( 0 ), m_noiseVariance( 1.0f ), m_levelCount( 0 )
+{
+    // raised cosine windows, half-overlapping copies sum up to one
+    for ( int i = 0; i < BURST_TILE_SIZE; i++ )
+    {
+        m_window[i] = 0.5f - 0.5f * cosf( 2.0f * (float) M_PI * ( i + 0.5f ) / BURST_TILE_SIZE );
+    }
+    for ( int i = 0; i < BURST_TILE_SIZE / 2; i++ )
+    {
+        m_chromaWindow[i] = 0.5f - 0.5f * cosf( 2.0f * (float) M_PI * ( i + 0.5f ) / ( BURST_TILE_SIZE / 2 ) );
+    }
+}
+
+int BurstMerge::merge( const uchar * const * frames, int frameCount, int width, int height, uchar * yuv, ThreadPool * pool )
+{
+    Timer timer;
+
+    m_frames = frames;
+    m_frameCount = frameCount;
+    m_width = width;
+    m_height = height;
+    m_yuv = yuv;
+    m_pool = pool;
+
+    // the sharpest frame (center half) is the reference
+    float bestSharpness = -1.0f;
+    for ( int i = 0; i < frameCount; i++ )
+    {
+        float sharpness = GetGradientEnergy( frames[i], width, height, width / 4, height / 4, width / 2, height / 2 );
+        if ( sharpness > bestSharpness )
+        {
+            bestSharpness = sharpness;
+            m_reference = i;
+        }
+    }
+
+    // pyramid levels and tile grids
+    m_levelWidths[0] = width;
+    m_levelHeights[0] = height;
+    m_levelCount = 1;
+    while ( m_levelCount < BURST_MAX_LEVELS &&
+            std::min( m_levelWidths[m_levelCount - 1], m_levelHeights[m_levelCount - 1] ) >= 4 * BURST_TILE_SIZE )
+    {
+        m_levelWidths[m_levelCount] = m_levelWidths[m_levelCount - 1] >> 1;
+        m_levelHeights[m_levelCount] = m_levelHeights[m_levelCount - 1] >> 1;
+        m_levelCount++;
+    }
+
+    const int step = BURST_TILE_SIZE / 2;
+    m_tilesX[0] = ( width + step - 1 ) / step - 1;
+    m_tilesY[0] = ( height + step - 1 ) / step - 1;
+    for ( int l = 1; l < m_levelCount; l++ )
+    {
+        m_tilesX[l] = ( m_levelWidths[l] + BURST_TILE_SIZE - 1 ) / BURST_TILE_SIZE;
+        m_tilesY[l] = ( m_levelHeights[l] + BURST_TILE_SIZE - 1 ) / BURST_TILE_SIZE;
+        m_levelMotion[l].resize( 2 * m_tilesX[l] * m_tilesY[l] );
+    }
+
+    TileMotion identity = { 0, 0, 0.0f };
+    m_motion.assign( m_tilesX[0] * m_tilesY[0] * frameCount, identity );
+    for ( int i = 0; i < m_tilesX[0] * m_tilesY[0]; i++ )
+    {
+        m_motion[i * frameCount + m_reference].weight = 1.0f;
+    }
+
+    buildPyramid( frames[m_reference], m_referencePyramid );
+    m_noiseVariance = estimateNoiseVariance();
+
+    // align the other frames one at a time
+    for ( int i = 0; i < frameCount; i++ )
+    {
+        if ( i == m_reference )
+        {
+            continue;
+        }
+
+        m_alternate = i;
+        buildPyramid( frames[i], m_alternatePyramid );
+        for ( m_level = m_levelCount - 1; m_level >= 0; m_level-- )
+        {
+            run( EOperationAlign, m_tilesY[m_level] );
+        }
+    }
+
+    run( EOperationMerge, m_tilesY[0] + 1 );
+
+    // release working memory
+    for ( int l = 0; l < BURST_MAX_LEVELS; l++ )
+    {
+        std::vector<uchar>().swap( m_referencePyramid[l] );
+        std::vector<uchar>().swap( m_alternatePyramid[l] );
+        std::vector<short>().swap( m_levelMotion[l] );
+    }
+    std::vector<TileMotion>().swap( m_motion );
+
+    LOG( "BurstMerge: %d frames %dx%d merged in %.1f ms (reference %d, noise variance %.2f)\n", frameCount, width, height,
+         timer.get(), m_reference, m_noiseVariance );
+
+    return m_reference;
+}
+
+void BurstMerge::run( EOperation op, int taskCount )
+{
+    m_op = op;
+    if ( m_pool != 0 )
+    {
+        m_pool->run( BurstMerge::TaskProc, this, taskCount );
+    }
+    else
+    {
+        for ( int i = 0; i < taskCount; i++ )
+        {
+            TaskProc( this, i );
+        }
+    }
+}
+
+void BurstMerge::TaskProc( void * opaque, int index )
+{
+    BurstMerge * instance = (BurstMerge *) opaque;
+    switch ( instance->m_op )
+    {
+        case EOperationAlign:
+            instance->alignTiles( index );
+            break;
+        case EOperationMerge:
+            instance->mergeBand( index );
+            break;
+    }
+}
+
+void BurstMerge::buildPyramid( const uchar * luma, std::vector<uchar> * levels ) const
+{
+    for ( int l = 1; l < m_levelCount; l++ )
+    {
+        int sw = m_levelWidths[l - 1];
+        int w = m_levelWidths[l];
+        int h = m_levelHeights[l];
+        const uchar * src = l == 1 ? luma : &levels[l - 1][0];
+
+        levels[l].resize( w * h );
+        uchar * dst = &levels[l][0];
+        for ( int y = 0; y < h; y++ )
+        {
+            const uchar * r0 = src + 2 * y * sw;
+            const uchar * r1 = r0 + sw;
+            for ( int x = 0; x < w; x++ )
+            {
+                dst[y * w + x] = ( r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2 ) >> 2;
+            }
+        }
+    }
+}
+
+float BurstMerge::estimateNoiseVariance( void ) const
+{
+    const uchar * luma = m_frames[m_reference];
+    const int tilesX = ( m_width - 2 ) / BURST_TILE_SIZE;
+    const int tilesY = ( m_height - 2 ) / BURST_TILE_SIZE;
+    std::vector<float> tileVariance;
+    tileVariance.reserve( tilesX * tilesY );
+
+    // mean square of the Laplacian residual 4 * y - (sum of 4 neighbours) per tile,
+    // its expectation for white noise of variance s^2 is 20 * s^2
+    for ( int ty = 0; ty < tilesY; ty++ )
+    {
+        for ( int tx = 0; tx < tilesX; tx++ )
+        {
+            int sum = 0;
+            for ( int y = 1 + ty * BURST_TILE_SIZE; y < 1 + ( ty + 1 ) * BURST_TILE_SIZE; y++ )
+            {
+                const uchar * row = luma + y * m_width;
+                for ( int x = 1 + tx * BURST_TILE_SIZE; x < 1 + ( tx + 1 ) * BURST_TILE_SIZE; x++ )
+                {
+                    int r = 4 * row[x] - row[x - 1] - row[x + 1] - row[x - m_width] - row[x + m_width];
+                    sum += r * r;
+                }
+            }
+            tileVariance.push_back( sum * ( 1.0f / ( 20 * BURST_TILE_SIZE * BURST_TILE_SIZE ) ) );
+        }
+    }
+
+    if ( tileVariance.empty() )
+    {
+        return 1.0f;
+    }
+
+    // flattest tiles (10th percentile) carry noise only
+    std::vector<float>::iterator p10 = tileVariance.begin() + tileVariance.size() / 10;
+    std::nth_element( tileVariance.begin(), p10, tileVariance.end() );
+    return std::max( *p10, 0.5f );
+}
+
+void BurstMerge::alignTiles( int row )
+{
+    const int l = m_level;
+    const int w = m_levelWidths[l];
+    const int h = m_levelHeights[l];
+    const uchar * ref = l == 0 ? m_frames[m_reference] : &m_referencePyramid[l][0];
+    const uchar * alt = l == 0 ? m_frames[m_alternate] : &m_alternatePyramid[l][0];
+    const int spacing = l == 0 ? BURST_TILE_SIZE / 2 : BURST_TILE_SIZE;
+
+    for ( int i = 0; i < m_tilesX[l]; i++ )
+    {
+        int ox = std::min( i * spacing, w - BURST_TILE_SIZE );
+        int oy = std::min( row * spacing, h - BURST_TILE_SIZE );
+
+        // initial estimate from the parent tile of the coarser level
+        int dx = 0, dy = 0;
+        int radius = BURST_COARSE_RADIUS;
+        if ( l < m_levelCount - 1 )
+        {
+            int px = std::min( ( ( ox + BURST_TILE_SIZE / 2 ) >> 1 ) / BURST_TILE_SIZE, m_tilesX[l + 1] - 1 );
+            int py = std::min( ( ( oy + BURST_TILE_SIZE / 2 ) >> 1 ) / BURST_TILE_SIZE, m_tilesY[l + 1] - 1 );
+            const short * parent = &m_levelMotion[l + 1][2 * ( py * m_tilesX[l + 1] + px )];
+            dx = std::min( std::max( 2 * parent[0], -ox ), w - BURST_TILE_SIZE - ox );
+            dy = std::min( std::max( 2 * parent[1], -oy ), h - BURST_TILE_SIZE - oy );
+            radius = l == 0 ? BURST_FINE_RADIUS : BURST_LEVEL_RADIUS;
+        }
+
+        const uchar * refTile = ref + oy * w + ox;
+        int bestX = dx, bestY = dy;
+        int bestSAD = TileSAD( refTile, alt + ( oy + dy ) * w + ox + dx, w );
+        for ( int cy = dy - radius; cy <= dy + radius; cy++ )
+        {
+            if ( oy + cy < 0 || oy + cy > h - BURST_TILE_SIZE )
+            {
+                continue;
+            }
+
+            for ( int cx = dx - radius; cx <= dx + radius; cx++ )
+            {
+                if ( ox + cx < 0 || ox + cx > w - BURST_TILE_SIZE )
+                {
+                    continue;
+                }
+
+                int sad = TileSAD( refTile, alt + ( oy + cy ) * w + ox + cx, w );
+                if ( sad < bestSAD )
+                {
+                    bestSAD = sad;
+                    bestX = cx;
+                    bestY = cy;
+                }
+            }
+        }
+
+        if ( l > 0 )
+        {
+            short * motion = &m_levelMotion[l][2 * ( row * m_tilesX[l] + i )];
+            motion[0] = bestX;
+            motion[1] = bestY;
+        }
+        else
+        {
+            // robust weight, aligned tiles differ by twice the noise variance
+            float msd = TileMSD( refTile, alt + ( oy + bestY ) * w + ox + bestX, w );
+            float k = BURST_ROBUSTNESS * m_noiseVariance;
+            TileMotion & motion = m_motion[( row * m_tilesX[0] + i ) * m_frameCount + m_alternate];
+            motion.dx = bestX;
+            motion.dy = bestY;
+            motion.weight = k / ( std::max( msd - 2.0f * m_noiseVariance, 0.0f ) + k );
+        }
+    }
+}
+
+void BurstMerge::blendTile( int plane, int tileX, int tileY, int y0, int y1, float * acc, float * norm ) const
+{
+    const int size = plane == 0 ? BURST_TILE_SIZE : BURST_TILE_SIZE / 2;
+    const int pw = plane == 0 ? m_width : m_width >> 1;
+    const int ph = plane == 0 ? m_height : m_height >> 1;
+    const float * window = plane == 0 ? m_window : m_chromaWindow;
+    const int lumaSize = m_width * m_height;
+    const int planeOffset = plane == 0 ? 0 : ( plane == 1 ? lumaSize : lumaSize + ( lumaSize >> 2 ) );
+
+    const int ox = tileX * size / 2;
+    const int oy = tileY * size / 2;
+    const int xs = ox, xe = std::min( ox + size, pw );
+    const int ys = std::max( y0, oy ), ye = std::min( std::min( y1, oy + size ), ph );
+    if ( ys >= ye )
+    {
+        return;
+    }
+
+    const TileMotion * motion = &m_motion[( tileY * m_tilesX[0] + tileX ) * m_frameCount];
+    float tile[BURST_TILE_SIZE * BURST_TILE_SIZE];
+    float weightSum = 0.0f;
+    memset( tile, 0, sizeof( tile ) );
+
+    for ( int f = 0; f < m_frameCount; f++ )
+    {
+        float weight = motion[f].weight;
+        if ( weight <= 0.0f )
+        {
+            continue;
+        }
+        weightSum += weight;
+
+        const uchar * src = m_frames[f] + planeOffset;
+        int dx = plane == 0 ? motion[f].dx : motion[f].dx / 2;
+        int dy = plane == 0 ? motion[f].dy : motion[f].dy / 2;
+        bool inside = xs + dx >= 0 && xe + dx <= pw;
+
+        for ( int y = ys; y < ye; y++ )
+        {
+            const uchar * row = src + std::min( std::max( y + dy, 0 ), ph - 1 ) * pw;
+            float * out = tile + ( y - oy ) * size - ox;
+            if ( inside )
+            {
+                for ( int x = xs; x < xe; x++ )
+                {
+                    out[x] += weight * row[x + dx];
+                }
+            }
+            else
+            {
+                for ( int x = xs; x < xe; x++ )
+                {
+                    out[x] += weight * row[std::min( std::max( x + dx, 0 ), pw - 1 )];
+                }
+            }
+        }
+    }
+
+    const float scale = 1.0f / weightSum;
+    for ( int y = ys; y < ye; y++ )
+    {
+        const float wy = window[y - oy];
+        const float * in = tile + ( y - oy ) * size - ox;
+        float * a = acc + ( y - y0 ) * pw;
+        float * n = norm + ( y - y0 ) * pw;
+        for ( int x = xs; x < xe; x++ )
+        {
+            float wxy = wy * window[x - ox];
+            a[x] += wxy * scale * in[x];
+            n[x] += wxy;
+        }
+    }
+}
+
+void BurstMerge::mergeBand( int band )
+{
+    const int step = BURST_TILE_SIZE / 2;
+    std::vector<float> acc( step * m_width );
+    std::vector<float> norm( step * m_width );
+
+    for ( int plane = 0; plane < 3; plane++ )
+    {
+        const int pstep = plane == 0 ? step : step / 2;
+        const int pw = plane == 0 ? m_width : m_width >> 1;
+        const int ph = plane == 0 ? m_height : m_height >> 1;
+        const int lumaSize = m_width * m_height;
+        uchar * dst = m_yuv + ( plane == 0 ? 0 : ( plane == 1 ? lumaSize : lumaSize + ( lumaSize >> 2 ) ) );
+
+        const int y0 = band * pstep;
+        const int y1 = std::min( y0 + pstep, ph );
+        if ( y0 >= y1 )
+        {
+            continue;
+        }
+
+        std::fill( acc.begin(), acc.end(), 0.0f );
+        std::fill( norm.begin(), norm.end(), 0.0f );
+
+        // the band is covered by two rows of half-overlapping tiles
+        for ( int tileY = band - 1; tileY <= band; tileY++ )
+        {
+            if ( tileY < 0 || tileY >= m_tilesY[0] )
+            {
+                continue;
+            }
+
+            for ( int tileX = 0; tileX < m_tilesX[0]; tileX++ )
+            {
+                blendTile( plane, tileX, tileY, y0, y1, &acc[0], &norm[0] );
+            }
+        }
+
+        for ( int y = y0; y < y1; y++ )
+        {
+            const float * a = &acc[( y - y0 ) * pw];
+            const float * n = &norm[( y - y0 ) * pw];
+            uchar * out = dst + y * pw;
+            for ( int x = 0; x < pw; x++ )
+            {
+                float v = a[x] / n[x] + 0.5f;
+                out[x] = (uchar) ( v <= 0.0f ? 0 : ( v >= 255.0f ? 255 : (int) v ) );
+            }
+        }
+    }
+}
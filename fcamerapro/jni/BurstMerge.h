@@ -0,0 +1,169 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _BURST_MERGE_H
+#define _BURST_MERGE_H
+
+/**
+ * @file
+ * Definition of BurstMerge.
+ */
+
+#include <vector>
+#include "Common.h"
+
+class ThreadPool;
+
+#define BURST_TILE_SIZE        16   /**< Merge tile size in luma pixels (tiles overlap by half) */
+#define BURST_MAX_LEVELS       4    /**< Number of alignment pyramid levels (full resolution included) */
+#define BURST_COARSE_RADIUS    4    /**< Alignment search radius at the coarsest level, in level pixels */
+#define BURST_LEVEL_RADIUS     2    /**< Alignment search radius at the intermediate levels */
+#define BURST_FINE_RADIUS      1    /**< Alignment search radius at full resolution */
+#define BURST_ROBUSTNESS       4.0f /**< Tile mismatch (in units of noise variance) halving the merge weight */
+
+/**
+ * Align-and-merge burst denoising (in the spirit of Hasinoff et al. 2016, HDR+).
+ * Merges a burst of identically exposed YUV420p frames into a single low-noise
+ * frame:
+ * - the sharpest frame (gradient energy, see Sharpness) is the reference;
+ * - every other frame is aligned to it per BURST_TILE_SIZE tile, coarse to fine
+ * on a 2x2 box luma pyramid (sum of absolute differences, non-overlapping tiles
+ * at the coarse levels, the overlapping merge tiles at full resolution);
+ * - each aligned tile gets a robust weight k * s^2 / (max(D - 2 * s^2, 0) + k * s^2),
+ * where D is its mean squared difference from the reference tile, s^2 the noise
+ * variance estimated from flat areas of the reference and k = BURST_ROBUSTNESS,
+ * so misaligned or moving content falls back to the reference;
+ * - the weighted tile averages are blended with a raised cosine window
+ * (half-overlapping tiles), which avoids block artifacts.
+ *
+ * Only the pyramids of the reference and of the frame being aligned exist at
+ * a time. The merge writes the output in bands of BURST_TILE_SIZE / 2 rows.
+ * Both alignment (tile rows) and merge (bands) run on a thread pool.
+ */
+class BurstMerge
+{
+public:
+    /**
+     * Default constructor.
+     */
+    BurstMerge( void );
+
+    /**
+     * Merges a burst of frames.
+     * @param frames YUV420p frame data
+     * @param frameCount number of frames
+     * @param width frame width in pixels (needs to be at least BURST_TILE_SIZE)
+     * @param height frame height in pixels (needs to be at least BURST_TILE_SIZE)
+     * @param yuv receives the merged YUV420p frame
+     * @param pool thread pool used by the merge (0 for the calling thread only)
+     * @return index of the reference frame
+     */
+    int merge( const uchar * const * frames, int frameCount, int width, int height, uchar * yuv, ThreadPool * pool );
+
+private:
+    /**
+     * Alignment of a merge tile in one frame.
+     */
+    struct TileMotion
+    {
+        short dx; /**< Horizontal offset in luma pixels */
+        short dy; /**< Vertical offset in luma pixels */
+        float weight; /**< Merge weight (reference frame: 1) */
+    };
+
+    enum EOperation
+    {
+        EOperationAlign, EOperationMerge
+    };
+
+    void run( EOperation op, int taskCount );
+
+    static void TaskProc( void * opaque, int index );
+
+    /**
+     * Builds levels 1 and up of a luma pyramid.
+     * @param luma full resolution luma plane
+     * @param levels receives the pyramid levels (level 0 is left untouched)
+     */
+    void buildPyramid( const uchar * luma, std::vector<uchar> * levels ) const;
+
+    /**
+     * Estimates the noise variance of the reference luma plane from its flattest tiles.
+     * @return noise variance (luma units squared)
+     */
+    float estimateNoiseVariance( void ) const;
+
+    /**
+     * Aligns a row of tiles of the current alternate frame at the current level.
+     * @param row tile row
+     */
+    void alignTiles( int row );
+
+    /**
+     * Merges an output band of BURST_TILE_SIZE / 2 luma rows (and the matching chroma rows).
+     * @param band band index
+     */
+    void mergeBand( int band );
+
+    /**
+     * Blends the frames over a single merge tile of one plane.
+     * @param plane plane index (0 - Y, 1 - Cb, 2 - Cr)
+     * @param tileX merge tile column
+     * @param tileY merge tile row
+     * @param y0 first plane row of the output band
+     * @param y1 plane row after the last one of the output band
+     * @param acc receives window weighted values of the band
+     * @param norm receives window weights of the band
+     */
+    void blendTile( int plane, int tileX, int tileY, int y0, int y1, float * acc, float * norm ) const;
+
+    const uchar * const * m_frames; /**< Burst frames */
+    int m_frameCount; /**< Number of frames */
+    int m_reference; /**< Reference frame index */
+    int m_width; /**< Frame width */
+    int m_height; /**< Frame height */
+    uchar * m_yuv; /**< Output frame */
+    ThreadPool * m_pool; /**< Thread pool (may be 0) */
+
+    EOperation m_op; /**< Current operation */
+    int m_alternate; /**< Frame being aligned */
+    int m_level; /**< Pyramid level being aligned */
+    float m_noiseVariance; /**< Reference frame noise variance */
+
+    int m_levelCount; /**< Number of pyramid levels */
+    int m_levelWidths[BURST_MAX_LEVELS]; /**< Pyramid level widths */
+    int m_levelHeights[BURST_MAX_LEVELS]; /**< Pyramid level heights */
+    int m_tilesX[BURST_MAX_LEVELS]; /**< Alignment tile columns per level (level 0: merge tiles) */
+    int m_tilesY[BURST_MAX_LEVELS]; /**< Alignment tile rows per level (level 0: merge tiles) */
+    std::vector<uchar> m_referencePyramid[BURST_MAX_LEVELS]; /**< Reference luma pyramid (level 0 unused) */
+    std::vector<uchar> m_alternatePyramid[BURST_MAX_LEVELS]; /**< Alternate luma pyramid (level 0 unused) */
+    std::vector<short> m_levelMotion[BURST_MAX_LEVELS]; /**< Alternate frame tile offsets of the coarse levels */
+    std::vector<TileMotion> m_motion; /**< Merge tile alignment, frameCount entries per tile */
+    float m_window[BURST_TILE_SIZE]; /**< Luma raised cosine window */
+    float m_chromaWindow[BURST_TILE_SIZE / 2]; /**< Chroma raised cosine window */
+};
+
+#endif
@@ -0,0 +1,181 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of CalibrationStore.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "CalibrationStore.h"
+
+CalibrationStore::CalibrationStore( const char * fileName ) : m_data( 0 ), m_mapped( false )
+{
+    m_size = sizeof( Header ) + CALIBRATION_SENSOR_COUNT * CALIBRATION_GAIN_BUCKETS * sizeof( Entry );
+
+    int fd = open( fileName, O_RDWR | O_CREAT, 0644 );
+    if ( fd >= 0 )
+    {
+        struct stat st;
+        bool valid = fstat( fd, &st ) == 0 && st.st_size == (off_t) m_size;
+        if ( valid || ftruncate( fd, m_size ) == 0 )
+        {
+            void * data = mmap( 0, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+            if ( data != MAP_FAILED )
+            {
+                m_data = data;
+                m_mapped = true;
+            }
+        }
+        // the mapping stays valid after the descriptor is closed
+        close( fd );
+    }
+
+    if ( !m_mapped )
+    {
+        ERROR( "CalibrationStore: cannot map %s, calibration will not persist", fileName );
+        m_data = new uchar[m_size];
+        memset( m_data, 0, m_size );
+    }
+
+    // (re)initialize files of a different layout
+    Header * header = (Header *) m_data;
+    if ( header->magic != CALIBRATION_MAGIC || header->version != CALIBRATION_VERSION ||
+         header->sensorCount != CALIBRATION_SENSOR_COUNT || header->gainBuckets != CALIBRATION_GAIN_BUCKETS )
+    {
+        memset( m_data, 0, m_size );
+        header->magic = CALIBRATION_MAGIC;
+        header->version = CALIBRATION_VERSION;
+        header->sensorCount = CALIBRATION_SENSOR_COUNT;
+        header->gainBuckets = CALIBRATION_GAIN_BUCKETS;
+        flush();
+    }
+
+    LOG( "CalibrationStore: %s opened (persistent: %d)\n", fileName, m_mapped ? 1 : 0 );
+}
+
+CalibrationStore::~CalibrationStore( void )
+{
+    if ( m_mapped )
+    {
+        msync( m_data, m_size, MS_SYNC );
+        munmap( m_data, m_size );
+    }
+    else
+    {
+        delete[] (uchar *) m_data;
+    }
+}
+
+int CalibrationStore::GetGainBucket( float gain )
+{
+    int bucket = gain > 0.0f ? (int) floorf( logf( gain ) * (float) M_LOG2E + 0.5f ) : 0;
+    return bucket < 0 ? 0 : ( bucket >= CALIBRATION_GAIN_BUCKETS ? CALIBRATION_GAIN_BUCKETS - 1 : bucket );
+}
+
+CalibrationStore::Entry * CalibrationStore::getEntry( int sensor, float gain ) const
+{
+    if ( sensor < 0 || sensor >= CALIBRATION_SENSOR_COUNT )
+    {
+        return 0;
+    }
+
+    Entry * entries = (Entry *) ( (uchar *) m_data + sizeof( Header ) );
+    return entries + sensor * CALIBRATION_GAIN_BUCKETS + GetGainBucket( gain );
+}
+
+bool CalibrationStore::getResponseCurve( int sensor, float gain, float * curve ) const
+{
+    const Entry * entry = getEntry( sensor, gain );
+    if ( entry == 0 || ( entry->flags & CALIBRATION_FLAG_RESPONSE_CURVE ) == 0 )
+    {
+        return false;
+    }
+
+    memcpy( curve, entry->responseCurve, sizeof( entry->responseCurve ) );
+    return true;
+}
+
+void CalibrationStore::setResponseCurve( int sensor, float gain, const float * curve )
+{
+    Entry * entry = getEntry( sensor, gain );
+    if ( entry == 0 )
+    {
+        ERROR( "CalibrationStore: invalid sensor %d", sensor );
+        return;
+    }
+
+    memcpy( entry->responseCurve, curve, sizeof( entry->responseCurve ) );
+    entry->flags |= CALIBRATION_FLAG_RESPONSE_CURVE;
+    flush();
+
+    LOG( "CalibrationStore: response curve of sensor %d, gain bucket %d stored\n", sensor, GetGainBucket( gain ) );
+}
+
+void CalibrationStore::recalibrate( int sensor )
+{
+    if ( sensor < 0 || sensor >= CALIBRATION_SENSOR_COUNT )
+    {
+        return;
+    }
+
+    Entry * entries = (Entry *) ( (uchar *) m_data + sizeof( Header ) ) + sensor * CALIBRATION_GAIN_BUCKETS;
+    memset( entries, 0, CALIBRATION_GAIN_BUCKETS * sizeof( Entry ) );
+    flush();
+}
+
+int CalibrationStore::getCalibratedGains( int sensor ) const
+{
+    if ( sensor < 0 || sensor >= CALIBRATION_SENSOR_COUNT )
+    {
+        return 0;
+    }
+
+    const Entry * entries = (const Entry *) ( (const uchar *) m_data + sizeof( Header ) ) + sensor * CALIBRATION_GAIN_BUCKETS;
+    int mask = 0;
+    for ( int i = 0; i < CALIBRATION_GAIN_BUCKETS; i++ )
+    {
+        if ( entries[i].flags & CALIBRATION_FLAG_RESPONSE_CURVE )
+        {
+            mask |= 1 << i;
+        }
+    }
+
+    return mask;
+}
+
+void CalibrationStore::flush( void )
+{
+    if ( m_mapped )
+    {
+        msync( m_data, m_size, MS_ASYNC );
+    }
+}
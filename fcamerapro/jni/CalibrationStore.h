@@ -0,0 +1,159 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _CALIBRATION_STORE_H
+#define _CALIBRATION_STORE_H
+
+/**
+ * @file
+ * Definition of CalibrationStore.
+ */
+
+#include <stddef.h>
+#include "Common.h"
+#include "ResponseCurve.h"
+
+#define CALIBRATION_FILE_NAME      "calibration.bin" /**< Calibration store file name (in the output directory) */
+#define CALIBRATION_MAGIC          0x53434346        /**< Calibration file signature ("FCCS") */
+#define CALIBRATION_VERSION        1                 /**< Calibration file layout version */
+#define CALIBRATION_SENSOR_COUNT   3                 /**< Number of sensor modes (Camera::Mode values) */
+#define CALIBRATION_GAIN_BUCKETS   8                 /**< Number of gain buckets, bucket i holds gains around 2^i */
+#define CALIBRATION_NOISE_PROFILE_SIZE 6             /**< Noise profile values per entry (reserved) */
+
+#define CALIBRATION_FLAG_RESPONSE_CURVE 0x1 /**< Entry holds a response curve */
+
+/**
+ * Persistent per-sensor calibration data (camera response curves, with room
+ * for noise profiles) stored in a small fixed-layout file memory-mapped at
+ * startup. Entries are keyed by the sensor mode (front, back, stereo) and a
+ * gain bucket (gain rounded to the nearest power of two). Updates go straight
+ * to the mapping and are flushed asynchronously by the kernel, so a curve
+ * solved once is reused by every later merge, across application restarts.
+ *
+ * If the file cannot be mapped the store keeps its data in memory only.
+ * The class is not thread safe; it is used from the camera thread only.
+ */
+class CalibrationStore
+{
+public:
+    /**
+     * Opens (or creates) the calibration file and maps it to memory.
+     * @param fileName calibration file path
+     */
+    CalibrationStore( const char * fileName );
+
+    /**
+     * Default destructor. Flushes and unmaps the file.
+     */
+    ~CalibrationStore( void );
+
+    /**
+     * Gets the response curve calibrated for a sensor and gain.
+     * @param sensor sensor mode (Camera::Mode value)
+     * @param gain sensor gain
+     * @param curve receives 3 * RESPONSE_CURVE_SIZE values (untouched if not calibrated)
+     * @return true if the curve is calibrated
+     */
+    bool getResponseCurve( int sensor, float gain, float * curve ) const;
+
+    /**
+     * Stores the response curve of a sensor and gain.
+     * @param sensor sensor mode (Camera::Mode value)
+     * @param gain sensor gain
+     * @param curve log inverse response curve of R, G and B, 3 * RESPONSE_CURVE_SIZE values
+     */
+    void setResponseCurve( int sensor, float gain, const float * curve );
+
+    /**
+     * Drops all calibration data of a sensor, forcing it to be recalibrated.
+     * @param sensor sensor mode (Camera::Mode value)
+     */
+    void recalibrate( int sensor );
+
+    /**
+     * Gets the gain buckets with a calibrated response curve.
+     * @param sensor sensor mode (Camera::Mode value)
+     * @return bit mask, bit i set if bucket i is calibrated
+     */
+    int getCalibratedGains( int sensor ) const;
+
+    /**
+     * Maps a sensor gain to its bucket.
+     * @param gain sensor gain
+     * @return bucket index, round( log2( gain ) ) clamped to [0, CALIBRATION_GAIN_BUCKETS)
+     */
+    static int GetGainBucket( float gain );
+
+    /**
+     * Gets the persistence state of the store.
+     * @return true if the store is backed by the calibration file
+     */
+    bool isPersistent( void ) const
+    {
+        return m_mapped;
+    }
+
+private:
+    /**
+     * Calibration file header.
+     */
+    struct Header
+    {
+        uint magic; /**< CALIBRATION_MAGIC */
+        uint version; /**< CALIBRATION_VERSION */
+        uint sensorCount; /**< CALIBRATION_SENSOR_COUNT */
+        uint gainBuckets; /**< CALIBRATION_GAIN_BUCKETS */
+    };
+
+    /**
+     * Calibration data of a sensor and gain bucket.
+     */
+    struct Entry
+    {
+        uint flags; /**< CALIBRATION_FLAG_* bits */
+        float responseCurve[3 * RESPONSE_CURVE_SIZE]; /**< Log inverse response curve of R, G and B */
+        float noiseProfile[CALIBRATION_NOISE_PROFILE_SIZE]; /**< Reserved for noise profiles */
+    };
+
+    /**
+     * Gets the entry of a sensor and gain.
+     * @param sensor sensor mode
+     * @param gain sensor gain
+     * @return entry pointer, 0 if the sensor is out of range
+     */
+    Entry * getEntry( int sensor, float gain ) const;
+
+    /**
+     * Schedules the mapped data to be written back.
+     */
+    void flush( void );
+
+    void * m_data; /**< Mapped file (or heap copy) */
+    size_t m_size; /**< Mapped size in bytes */
+    bool m_mapped; /**< Is m_data a file mapping? */
+};
+
+#endif
@@ -26,26 +26,8 @@
  */
 #include "Camera.h"
 #include "AsyncImageWriter.h"
-
-Camera::ShotParams::ShotParams( void )
-{
-    exposure = 30000; // 30ms
-    gain = 1.0f;
-    wb = 6500.0f;
-    focus = 10.0f;
-    flashOn = 0;
-}
-
-Camera::CaptureState::CaptureState( void )
-{
-    preview.autoExposure = true;
-    preview.autoGain = true;
-    preview.autoWB = true;
-    preview.autoFocus = false;
-
-    memset( preview.histogramData, 0, sizeof( float ) * HISTOGRAM_SIZE );
-    pendingImagesCount = 0;
-}
+#include "RadianceMerge.h"
+#include "NightAccumulator.h"
 
 Camera::Camera( int width, int height, Mode mode ) : m_currentMode( mode ),
     m_imageWidth( width ), m_imageHeight( height )
@@ -67,12 +49,9 @@ Camera::Camera( int width, int height, Mode mode ) : m_currentMode( mode ),
     m_flash = new FCam::Tegra::Flash();
     m_sensor->attach( m_lens );
     m_sensor->attach( m_flash );
-    m_autoFocus = new FCam::Tegra::AutoFocus( m_lens );
+    m_autoFocus = new ContrastAutoFocus( m_lens );
 
     m_previewImage = new FCam::Image( width, height, FCam::YUV420p );
-
-    // init default shot params
-    memset( &m_currentState, 0, sizeof( CaptureState ) );
 }
 
 Camera::~Camera( void )
@@ -85,7 +64,7 @@ Camera::~Camera( void )
     delete m_sensor;
 }
 
-void Camera::capture( AsyncImageWriter * writer )
+void Camera::capture( AsyncImageWriter * writer, ThreadPool * pool, const volatile bool * stop )
 {
     // stop streaming
     m_sensor->stopStreaming();
@@ -96,8 +75,19 @@ void Camera::capture( AsyncImageWriter * writer )
         m_sensor->getFrame();
     }
 
+    if ( m_currentState.outputFormat == OUTPUT_FORMAT_JPEG_NIGHT )
+    {
+        captureNight( writer, pool, stop );
+        return;
+    }
+
     // prepare new image set
     ImageSet * is = writer->newImageSet();
+    bool lucky = m_currentState.outputFormat == OUTPUT_FORMAT_JPEG_LUCKY;
+    if ( lucky )
+    {
+        is->enableLuckyShot( m_currentState.luckyFrames );
+    }
 
     // register capture
 
@@ -106,16 +96,29 @@ void Camera::capture( AsyncImageWriter * writer )
     flashAction.time = 0;
     flashAction.brightness = m_flash->maxBrightness();
 
+    FCam::Lens::FocusAction focusAction( m_lens );
+    // move the lens before the exposure starts
+    focusAction.time = 0;
+    float previewFocus = m_lens->getFocus();
+
     FCam::Size isize = m_sensor->maxImageSize();
 
     for ( int i = 0; i < m_currentState.pendingImagesCount; i++ )
     {
-        // TODO: add support for per-shot focus value
         FCam::Tegra::Shot shot;
         shot.exposure = m_currentState.pendingImages[i].exposure;
         shot.gain = m_currentState.pendingImages[i].gain;
         shot.whiteBalance = m_currentState.pendingImages[i].wb;
-        shot.image = FCam::Image( isize.width, isize.height, FCam::YUV420p );
+        if ( lucky && m_currentState.pendingImages[i].raw == 0 )
+        {
+            // buffers are allocated as frames arrive, evicted frames free theirs
+            shot.image = FCam::Image( isize, FCam::YUV420p, FCam::Image::AutoAllocate );
+        }
+        else
+        {
+            shot.image = FCam::Image( isize.width, isize.height,
+                                      m_currentState.pendingImages[i].raw != 0 ? FCam::RAW : FCam::YUV420p );
+        }
         shot.histogram.enabled = false;
         shot.sharpness.enabled = false;
 
@@ -124,18 +127,131 @@ void Camera::capture( AsyncImageWriter * writer )
             shot.addAction( flashAction );
         }
 
+        // per-shot focus (focus brackets)
+        focusAction.focus = m_currentState.pendingImages[i].focus;
+        shot.addAction( focusAction );
+
         m_sensor->capture( shot );
     }
 
     // capture
     FileFormatDescriptor fmt( FileFormatDescriptor::EFormatJPEG, 95 );
+    FileFormatDescriptor rawFmt( FileFormatDescriptor::EFormatRAW, 95 );
 
     // TODO: much faster would be to consider simultaneous writing and capture (without prebuffering in mem).
     while ( m_sensor->shotsPending() > 0 )
     {
-        is->add( fmt, m_sensor->getFrame() );
+        FCam::Frame frame = m_sensor->getFrame();
+        is->add( frame.image().type() == FCam::RAW ? rawFmt : fmt, frame );
+    }
+
+    // focus brackets leave the lens at the last shot's focus
+    m_lens->setFocus( previewFocus );
+
+    if ( m_currentState.alignFrames )
+    {
+        is->enableAlignment();
+    }
+
+    if ( m_currentState.outputFormat == OUTPUT_FORMAT_JPEG_RADIANCE )
+    {
+        // response curve calibrated for this sensor and the gain of the middle shot, if any
+        float curve[3 * RESPONSE_CURVE_SIZE];
+        float gain = m_currentState.pendingImages[m_currentState.pendingImagesCount / 2].gain;
+        if ( !writer->getCalibrationStore()->getResponseCurve( m_currentMode, gain, curve ) )
+        {
+            RadianceMerge::GetDefaultResponseCurve( curve );
+        }
+        is->enableRadianceMerge( curve, m_currentState.toneMapOperator == TONE_MAP_OPERATOR_LOCAL );
+    }
+    else if ( m_currentState.outputFormat == OUTPUT_FORMAT_JPEG_FUSION )
+    {
+        is->enableExposureFusion();
+    }
+    else if ( m_currentState.outputFormat == OUTPUT_FORMAT_JPEG_BURST_MERGE )
+    {
+        is->enableBurstMerge();
+    }
+    else if ( m_currentState.outputFormat == OUTPUT_FORMAT_JPEG_FLASH_FUSION )
+    {
+        is->enableFlashFusion();
+    }
+    else if ( m_currentState.outputFormat == OUTPUT_FORMAT_JPEG_FOCUS_STACK )
+    {
+        is->enableFocusStack();
     }
 
     // write out images
     writer->push( is );
 }
+
+void Camera::captureNight( AsyncImageWriter * writer, ThreadPool * pool, const volatile bool * stop )
+{
+    const ShotParams & params = m_currentState.pendingImages[0];
+    FCam::Size isize = m_sensor->maxImageSize();
+
+    // short exposures, brightness restored with gain (the averaging removes its noise)
+    FCam::Tegra::Shot shot;
+    shot.exposure = params.exposure < NIGHT_MAX_FRAME_EXPOSURE ? params.exposure : NIGHT_MAX_FRAME_EXPOSURE;
+    shot.gain = params.gain * params.exposure / shot.exposure;
+    if ( shot.gain > m_sensor->maxGain() )
+    {
+        shot.gain = m_sensor->maxGain();
+    }
+    shot.whiteBalance = params.wb;
+    // every streamed frame gets its own buffer, so the sensor never writes into a frame that is
+    // still being accumulated, and the kept frame is not overwritten by the ones that follow
+    shot.image = FCam::Image( isize, FCam::YUV420p, FCam::Image::AutoAllocate );
+    shot.histogram.enabled = false;
+    shot.sharpness.enabled = false;
+
+    FCam::Lens::FocusAction focusAction( m_lens );
+    focusAction.time = 0;
+    focusAction.focus = params.focus;
+    shot.addAction( focusAction );
+    float previewFocus = m_lens->getFocus();
+
+    m_sensor->stream( shot );
+
+    NightAccumulator accumulator;
+    accumulator.reset( isize.width, isize.height );
+    int budget = m_currentState.nightFrames < NIGHT_MAX_FRAMES ? m_currentState.nightFrames : NIGHT_MAX_FRAMES;
+
+    FCam::Frame last;
+    while ( accumulator.getFrameCount() < budget && ( stop == 0 || !*stop ) )
+    {
+        FCam::Frame frame = m_sensor->getFrame();
+        if ( !frame.valid() || frame.image().type() != FCam::YUV420p || frame.image().width() != isize.width
+             || frame.image().height() != isize.height )
+        {
+            continue;
+        }
+
+        accumulator.add( frame.image()( 0, 0 ), pool );
+        // holds a reference to this frame's own buffer, the previous one is released
+        last = frame;
+    }
+
+    m_sensor->stopStreaming();
+    while ( m_sensor->shotsPending() > 0 )
+    {
+        m_sensor->getFrame();
+    }
+    m_lens->setFocus( previewFocus );
+
+    LOG( "captureNight: %d frames accumulated\n", accumulator.getFrameCount() );
+    if ( accumulator.getFrameCount() == 0 )
+    {
+        return;
+    }
+
+    // the last (aligned) frame is written as the individual image
+    ImageSet * is = writer->newImageSet();
+    is->add( FileFormatDescriptor( FileFormatDescriptor::EFormatJPEG, 95 ), last );
+
+    FCam::Image night( isize.width, isize.height, FCam::YUV420p );
+    accumulator.resolve( night( 0, 0 ), pool );
+    is->setNightImage( night, accumulator.getFrameCount() );
+
+    writer->push( is );
+}
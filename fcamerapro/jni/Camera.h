@@ -34,10 +34,11 @@
  */
 
 #include <FCam/Tegra.h>
-#include <FCam/Tegra/AutoFocus.h>
 #include "ParamSetRequest.h"
+#include "ContrastAutoFocus.h"
+#include "CaptureState.h"
 
-#define FCAM_MAX_PICTURES_PER_SHOT 16 /**< Defines maximum number of pictures per burst shot */
+#define NIGHT_MAX_FRAME_EXPOSURE   66666 /**< Longest night mode frame exposure (microseconds, hand-held limit) */
 
 /**
  * Helper class encapsulating FCam sensor, lens, flash and capture functionality.
@@ -45,44 +46,8 @@
 class Camera
 {
 public:
-    /**
-     * Single image capture parameters.
-     */
-    class ShotParams
-    {
-    public:
-        ShotParams( void );
-
-        float exposure; /**< Exposure (microseconds) */
-        float focus; /**< Focus (Dioptres) */
-        float gain; /**< Gain (ISO) */
-        float wb; /**< Color temparature (Kelwins) */
-        int flashOn; /**< Flash state (0 - off, 1 - on) */
-    };
-
-    /**
-     * Capture state for FCam work thread. This structure stores parameters
-     * used for preview and full-resolution image capture.
-     */
-    class CaptureState
-    {
-    public:
-        CaptureState( void );
-
-        struct
-        {
-            ShotParams evaluated; /**< Auto-evaluated capture parameters */
-            ShotParams user; /**< User defined capture parameters */
-            bool autoExposure; /**< Auto-evaluation of exposure enabled? (0 - no, 1 - yes) */
-            bool autoFocus; /**< Auto-evaluation of focus enabled? (0 - no, 1 - yes) */
-            bool autoGain; /**< Auto-evaluation of gain enabled? (0 - no, 1 - yes) */
-            bool autoWB; /**< Auto-evaluation of color temperature enabled? (0 - no, 1 - yes) */
-            float histogramData[HISTOGRAM_SIZE]; /**< Normalized histogram data */
-        } preview; /**< Capture preview settings */
-
-        ShotParams pendingImages[FCAM_MAX_PICTURES_PER_SHOT]; /**< Image parameters for full-resolution capture */
-        int pendingImagesCount; /**< Number of image to capture */
-    };
+    typedef ::ShotParams ShotParams; /**< Single image capture parameters */
+    typedef ::CaptureState CaptureState; /**< Capture state for FCam work thread */
 
     /**
      * Camera used for preview and capture
@@ -117,18 +82,32 @@ public:
      * m_currentState field which is modified in the worker thread body by
      * requests relayed from the Java UI.
      * @param writer pointer to {@link AsyncImageWriter} instance that writes captured images to storage.
+     * @param pool thread pool used by night mode captures (can be 0)
+     * @param stop flag ending night mode captures before the frame budget is reached (can be 0)
      */
-    void capture( class AsyncImageWriter * writer );
+    void capture( class AsyncImageWriter * writer, class ThreadPool * pool = 0, const volatile bool * stop = 0 );
 
     CaptureState m_currentState; /**< Holds configuration of current preview and full-resolution frames */
     const Mode m_currentMode; /**< Current camera used for preview and capture */
     FCam::Tegra::Sensor * m_sensor; /**< pointer to FCam sensor */
     FCam::Tegra::Lens * m_lens; /**< pointer to FCam lens attached to the sensor */
     FCam::Tegra::Flash * m_flash; /**< pointer to FCam flash attached to the sensor */
-    FCam::Tegra::AutoFocus * m_autoFocus; /**< pointer to auto-focuser implementation */
+    ContrastAutoFocus * m_autoFocus; /**< pointer to auto-focuser implementation */
     FCam::Image * m_previewImage; /**< pointer to preview image */
 
 private:
+    /**
+     * Performs a night mode capture: streams full-resolution frames with the
+     * first pending image's parameters (exposure limited to
+     * NIGHT_MAX_FRAME_EXPOSURE, the rest goes to gain) and accumulates them
+     * on the fly (see NightAccumulator) until the frame budget is reached or
+     * the stop flag is raised. Writes the last frame and the average.
+     * @param writer pointer to {@link AsyncImageWriter} instance that writes captured images to storage.
+     * @param pool thread pool used by the accumulation (can be 0)
+     * @param stop flag ending the capture (can be 0)
+     */
+    void captureNight( class AsyncImageWriter * writer, class ThreadPool * pool, const volatile bool * stop );
+
     const int m_imageWidth, m_imageHeight;
 };
 
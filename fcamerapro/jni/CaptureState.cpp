@@ -0,0 +1,64 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Implementation of ShotParams and CaptureState.
+ */
+
+#include "CaptureState.h"
+
+ShotParams::ShotParams( void )
+{
+    exposure = 30000; // 30ms
+    gain = 1.0f;
+    wb = 6500.0f;
+    focus = 10.0f;
+    flashOn = 0;
+    raw = 0;
+}
+
+CaptureState::CaptureState( void )
+{
+    preview.autoExposure = true;
+    preview.autoGain = true;
+    preview.autoWB = true;
+    preview.autoFocus = false;
+    preview.meteringMode = METERING_MODE_MATRIX;
+    preview.hdrFrames = 0;
+
+    memset( preview.histogramData, 0, sizeof( float ) * HISTOGRAM_SIZE );
+    memset( preview.rgbHistogramData, 0, sizeof( float ) * 3 * HISTOGRAM_SIZE );
+    pendingImagesCount = 0;
+    outputFormat = OUTPUT_FORMAT_JPEG;
+    toneMapOperator = TONE_MAP_OPERATOR_LOCAL;
+    alignFrames = true;
+    calibratedGains = 0;
+    stereoDisparity = false;
+    nightFrames = NIGHT_DEFAULT_FRAMES;
+    luckyFrames = LUCKY_DEFAULT_FRAMES;
+}
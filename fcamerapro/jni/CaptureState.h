@@ -0,0 +1,98 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _CAPTURE_STATE_H
+#define _CAPTURE_STATE_H
+
+/**
+ * @file
+ *
+ * Definition of ShotParams and CaptureState
+ */
+
+#include "ParamSetRequest.h"
+
+#define FCAM_MAX_PICTURES_PER_SHOT 16 /**< Defines maximum number of pictures per burst shot */
+#define NIGHT_DEFAULT_FRAMES       32 /**< Default frame budget of night mode captures */
+#define LUCKY_DEFAULT_FRAMES       1  /**< Default number of frames kept in lucky shot mode */
+
+/**
+ * Single image capture parameters.
+ */
+class ShotParams
+{
+public:
+    /**
+     * Default constructor, sets the default shot parameters.
+     */
+    ShotParams( void );
+
+    float exposure; /**< Exposure (microseconds) */
+    float focus; /**< Focus (Dioptres) */
+    float gain; /**< Gain (ISO) */
+    float wb; /**< Color temparature (Kelwins) */
+    int flashOn; /**< Flash state (0 - off, 1 - on) */
+    int raw; /**< Sensor-native Bayer capture, developed by RawDevelop (0 - off, 1 - on) */
+};
+
+/**
+ * Capture state for FCam work thread. This structure stores parameters
+ * used for preview and full-resolution image capture.
+ */
+class CaptureState
+{
+public:
+    /**
+     * Default constructor, sets the default capture settings.
+     */
+    CaptureState( void );
+
+    struct
+    {
+        ShotParams evaluated; /**< Auto-evaluated capture parameters */
+        ShotParams user; /**< User defined capture parameters */
+        bool autoExposure; /**< Auto-evaluation of exposure enabled? (0 - no, 1 - yes) */
+        bool autoFocus; /**< Auto-evaluation of focus enabled? (0 - no, 1 - yes) */
+        bool autoGain; /**< Auto-evaluation of gain enabled? (0 - no, 1 - yes) */
+        bool autoWB; /**< Auto-evaluation of color temperature enabled? (0 - no, 1 - yes) */
+        int meteringMode; /**< Exposure metering mode (METERING_MODE_* value) */
+        int hdrFrames; /**< Exposures per HDR preview cycle (0 - HDR preview off, 2 or 3) */
+        float histogramData[HISTOGRAM_SIZE]; /**< Normalized histogram data */
+        float rgbHistogramData[3 * HISTOGRAM_SIZE]; /**< Normalized R, G and B histogram data */
+    } preview; /**< Capture preview settings */
+
+    ShotParams pendingImages[FCAM_MAX_PICTURES_PER_SHOT]; /**< Image parameters for full-resolution capture */
+    int pendingImagesCount; /**< Number of image to capture */
+    int outputFormat; /**< Image output format (OUTPUT_FORMAT_* value) */
+    int toneMapOperator; /**< Radiance map tone mapping operator (TONE_MAP_OPERATOR_* value) */
+    bool alignFrames; /**< Align frames before multi-frame merges? (0 - no, 1 - yes) */
+    int calibratedGains; /**< Gain buckets of the current sensor with a calibrated response curve (bit mask) */
+    bool stereoDisparity; /**< Compute the disparity map of the stereo preview? (0 - no, 1 - yes) */
+    int nightFrames; /**< Frame budget of night mode captures */
+    int luckyFrames; /**< Number of sharpest burst frames kept in lucky shot mode */
+};
+
+#endif
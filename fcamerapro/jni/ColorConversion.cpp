@@ -0,0 +1,104 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of color conversion kernels.
+ */
+
+#include "ColorConversion.h"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define CSC_SHIFT 6  /**< Fixed-point precision of conversion coefficients */
+#define CSC_CR_R  90 /**< 1.402 * 2^CSC_SHIFT */
+#define CSC_CB_G  22 /**< 0.344 * 2^CSC_SHIFT */
+#define CSC_CR_G  46 /**< 0.714 * 2^CSC_SHIFT */
+#define CSC_CB_B  113 /**< 1.772 * 2^CSC_SHIFT */
+
+static inline uchar ClampToByte( int v )
+{
+    return v < 0 ? 0 : ( v > 255 ? 255 : v );
+}
+
+void ConvertYCbCrToRGB( const uchar * y, const uchar * cb, const uchar * cr, uchar * r, uchar * g, uchar * b, int count )
+{
+    int i = 0;
+
+#if defined(__ARM_NEON__)
+    const uint8x8_t bias = vdup_n_u8( 128 );
+    for ( ; i + 8 <= count; i += 8 )
+    {
+        int16x8_t yy = vreinterpretq_s16_u16( vshll_n_u8( vld1_u8( y + i ), CSC_SHIFT ) );
+        int16x8_t u = vreinterpretq_s16_u16( vsubl_u8( vld1_u8( cb + i ), bias ) );
+        int16x8_t v = vreinterpretq_s16_u16( vsubl_u8( vld1_u8( cr + i ), bias ) );
+
+        int16x8_t rr = vmlaq_n_s16( yy, v, CSC_CR_R );
+        int16x8_t gg = vmlsq_n_s16( vmlsq_n_s16( yy, u, CSC_CB_G ), v, CSC_CR_G );
+        int16x8_t bb = vmlaq_n_s16( yy, u, CSC_CB_B );
+
+        vst1_u8( r + i, vqrshrun_n_s16( rr, CSC_SHIFT ) );
+        vst1_u8( g + i, vqrshrun_n_s16( gg, CSC_SHIFT ) );
+        vst1_u8( b + i, vqrshrun_n_s16( bb, CSC_SHIFT ) );
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16( 128 );
+    const __m128i round = _mm_set1_epi16( 1 << ( CSC_SHIFT - 1 ) );
+    for ( ; i + 8 <= count; i += 8 )
+    {
+        __m128i yy = _mm_slli_epi16( _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( y + i ) ), zero ), CSC_SHIFT );
+        __m128i u = _mm_sub_epi16( _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( cb + i ) ), zero ), bias );
+        __m128i v = _mm_sub_epi16( _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( cr + i ) ), zero ), bias );
+        yy = _mm_add_epi16( yy, round );
+
+        __m128i rr = _mm_add_epi16( yy, _mm_mullo_epi16( v, _mm_set1_epi16( CSC_CR_R ) ) );
+        __m128i gg = _mm_sub_epi16( yy, _mm_add_epi16( _mm_mullo_epi16( u, _mm_set1_epi16( CSC_CB_G ) ),
+                                    _mm_mullo_epi16( v, _mm_set1_epi16( CSC_CR_G ) ) ) );
+        __m128i bb = _mm_add_epi16( yy, _mm_mullo_epi16( u, _mm_set1_epi16( CSC_CB_B ) ) );
+
+        _mm_storel_epi64(( __m128i * )( r + i ), _mm_packus_epi16( _mm_srai_epi16( rr, CSC_SHIFT ), zero ) );
+        _mm_storel_epi64(( __m128i * )( g + i ), _mm_packus_epi16( _mm_srai_epi16( gg, CSC_SHIFT ), zero ) );
+        _mm_storel_epi64(( __m128i * )( b + i ), _mm_packus_epi16( _mm_srai_epi16( bb, CSC_SHIFT ), zero ) );
+    }
+#endif
+
+    // scalar tail
+    for ( ; i < count; i++ )
+    {
+        int yy = ( y[i] << CSC_SHIFT ) + ( 1 << ( CSC_SHIFT - 1 ) );
+        int u = cb[i] - 128;
+        int v = cr[i] - 128;
+
+        r[i] = ClampToByte(( yy + CSC_CR_R * v ) >> CSC_SHIFT );
+        g[i] = ClampToByte(( yy - CSC_CB_G * u - CSC_CR_G * v ) >> CSC_SHIFT );
+        b[i] = ClampToByte(( yy + CSC_CB_B * u ) >> CSC_SHIFT );
+    }
+}
@@ -0,0 +1,51 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _COLORCONVERSION_H
+#define _COLORCONVERSION_H
+
+/**
+ * @file
+ * Definition of color conversion kernels.
+ */
+
+#include "Common.h"
+
+/**
+ * Converts a run of YCbCr (BT.601 full range) pixels to RGB. The conversion uses
+ * 6-bit fixed-point arithmetic, NEON and SSE2 paths produce results identical to
+ * the scalar path.
+ * @param y pointer to luma values
+ * @param cb pointer to blue-difference chroma values (one per pixel)
+ * @param cr pointer to red-difference chroma values (one per pixel)
+ * @param r pointer to output R values
+ * @param g pointer to output G values
+ * @param b pointer to output B values
+ * @param count number of pixels to convert
+ */
+void ConvertYCbCrToRGB( const uchar * y, const uchar * cb, const uchar * cr, uchar * r, uchar * g, uchar * b, int count );
+
+#endif
@@ -72,14 +72,14 @@ public:
     ManagedObject( void ) :
         m_refCount( 0 )
     {
-        LOG( "object@0x%08x: created!\n", ( uint )this );
+        LOG( "object@%p: created!\n", ( const void * ) this );
     }
 
     virtual ~ManagedObject( void )
     {
         if ( m_refCount != 0 )
         {
-            ERROR( "object@0x%08x: non-zero reference count during removal!\n", ( uint )this );
+            ERROR( "object@%p: non-zero reference count during removal!\n", ( const void * ) this );
         }
     }
 
@@ -93,7 +93,7 @@ public:
         ptr->m_refCount--;
         if ( ptr->m_refCount <= 0 )
         {
-            LOG( "object@0x%08x: dereferenced!\n", ( uint )ptr );
+            LOG( "object@%p: dereferenced!\n", ( const void * ) ptr );
             delete ptr;
         }
     }
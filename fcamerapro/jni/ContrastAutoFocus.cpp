@@ -0,0 +1,103 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of ContrastAutoFocus.
+ */
+
+#include <math.h>
+#include "Common.h"
+#include "ContrastAutoFocus.h"
+
+ContrastAutoFocus::ContrastAutoFocus( FCam::Lens * lens )
+{
+    m_lens = lens;
+    m_target = 0.0f;
+    m_settleFrames = 0;
+    m_targetX = m_targetY = -1;
+    m_idle = true;
+}
+
+void ContrastAutoFocus::setTarget( int x, int y )
+{
+    m_targetX = x;
+    m_targetY = y;
+}
+
+void ContrastAutoFocus::clearTarget( void )
+{
+    m_targetX = m_targetY = -1;
+}
+
+void ContrastAutoFocus::startSweep( void )
+{
+    m_search.start( m_lens->nearFocus(), m_lens->farFocus(), m_lens->getFocus() );
+    m_search.next( m_target );
+    m_lens->setFocus( m_target );
+    m_settleFrames = 0;
+    m_idle = false;
+}
+
+void ContrastAutoFocus::update( const FCam::Frame & frame, const FrameStats & stats )
+{
+    if ( m_idle )
+    {
+        return;
+    }
+
+    // measure only frames captured with the lens at the commanded position
+    float focus = frame["lens.focus"];
+    if ( fabsf( focus - m_target ) > AUTOFOCUS_FOCUS_TOLERANCE && ++m_settleFrames < AUTOFOCUS_MAX_SETTLE_FRAMES )
+    {
+        return;
+    }
+
+    const int width = stats.width();
+    const int height = stats.height();
+    const int roiSize = width / AUTOFOCUS_ROI_FRACTION;
+    const int cx = m_targetX < 0 ? width >> 1 : m_targetX;
+    const int cy = m_targetY < 0 ? height >> 1 : m_targetY;
+
+    // shift the ROI inside the frame rather than shrinking it
+    int rx = cx - ( roiSize >> 1 ), ry = cy - ( roiSize >> 1 );
+    rx = rx < 0 ? 0 : ( rx + roiSize > width ? width - roiSize : rx );
+    ry = ry < 0 ? 0 : ( ry + roiSize > height ? height - roiSize : ry );
+
+    m_search.report( stats.getSharpness( rx, ry, roiSize, roiSize ) );
+
+    if ( m_search.next( m_target ) )
+    {
+        m_lens->setFocus( m_target );
+        m_settleFrames = 0;
+    }
+    else
+    {
+        LOG( "ContrastAutoFocus::update(): focus %f after %i probes", m_search.result(), m_search.probeCount() );
+        m_lens->setFocus( m_search.result() );
+        m_idle = true;
+    }
+}
@@ -0,0 +1,99 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _CONTRASTAUTOFOCUS_H
+#define _CONTRASTAUTOFOCUS_H
+
+/**
+ * @file
+ * Definition of ContrastAutoFocus.
+ */
+
+#include <FCam/Tegra.h>
+#include "FrameStats.h"
+#include "FocusSearch.h"
+
+#define AUTOFOCUS_ROI_FRACTION       6   /**< Focus ROI side is 1/AUTOFOCUS_ROI_FRACTION of the frame width */
+#define AUTOFOCUS_FOCUS_TOLERANCE    0.05f /**< Lens position tolerance (dioptres) for a frame to be measured */
+#define AUTOFOCUS_MAX_SETTLE_FRAMES  4   /**< Maximum number of frames to wait for the lens to reach a position */
+
+/**
+ * Contrast-detection auto-focus. Drives a {@link FocusSearch} with the {@link FrameStats}
+ * gradient energy of a region of interest in the streamed preview frames. The interface
+ * follows FCam::Tegra::AutoFocus.
+ */
+class ContrastAutoFocus
+{
+public:
+    /**
+     * Constructs auto-focuser.
+     * @param lens pointer to lens to control
+     */
+    ContrastAutoFocus( FCam::Lens * lens );
+
+    /**
+     * Returns true if no focus search is in progress.
+     */
+    bool idle( void ) const
+    {
+        return m_idle;
+    }
+
+    /**
+     * Centers the focus region of interest on a point. The region is a square of
+     * 1/AUTOFOCUS_ROI_FRACTION of the frame width, clipped to the frame.
+     * @param x point position inside the preview frame (pixels)
+     * @param y point position inside the preview frame (pixels)
+     */
+    void setTarget( int x, int y );
+
+    /**
+     * Centers the region of interest on the frame.
+     */
+    void clearTarget( void );
+
+    /**
+     * Starts a focus search.
+     */
+    void startSweep( void );
+
+    /**
+     * Measures a streamed frame and moves the lens to the next search position.
+     * @param frame last streamed frame
+     * @param stats statistics of the streamed frame
+     */
+    void update( const FCam::Frame & frame, const FrameStats & stats );
+
+private:
+    FCam::Lens * m_lens; /**< Controlled lens */
+    FocusSearch m_search; /**< Search state */
+    float m_target; /**< Commanded lens position */
+    int m_settleFrames; /**< Frames received since the lens has been commanded */
+    int m_targetX, m_targetY; /**< ROI center (-1 for frame center) */
+    bool m_idle;
+};
+
+#endif
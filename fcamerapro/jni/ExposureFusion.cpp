@@ -0,0 +1,741 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of ExposureFusion.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#include <algorithm>
+#include "ExposureFusion.h"
+#include "ColorConversion.h"
+#include "ThreadPool.h"
+#include "HPT.h"
+
+/**
+ * Computes a row of the next (half resolution) Gaussian pyramid level using
+ * separable [1 4 6 4 1] / 16 filter with clamped borders.
+ * @param r source rows 2 * y - 2 to 2 * y + 2 (clamped to the level)
+ * @param sw source width
+ * @param out receives dw values
+ * @param dw destination width
+ * @param temp temporary buffer, sw values
+ */
+template<typename T>
+static void ReduceRow( const T * const * r, int sw, float * out, int dw, float * temp )
+{
+    for ( int x = 0; x < sw; x++ )
+    {
+        temp[x] = ( ( r[0][x] + r[4][x] ) + 4.0f * ( r[1][x] + r[3][x] ) + 6.0f * r[2][x] ) * ( 1.0f / 16 );
+    }
+
+    for ( int x = 0; x < dw; x++ )
+    {
+        int sx = 2 * x;
+        if ( sx >= 2 && sx + 2 < sw )
+        {
+            out[x] = ( ( temp[sx - 2] + temp[sx + 2] ) + 4.0f * ( temp[sx - 1] + temp[sx + 1] ) + 6.0f * temp[sx] ) * ( 1.0f / 16 );
+        }
+        else
+        {
+            float sum = 0.0f;
+            static const float kernel[5] = { 1.0f, 4.0f, 6.0f, 4.0f, 1.0f };
+            for ( int k = 0; k < 5; k++ )
+            {
+                sum += kernel[k] * temp[std::min( std::max( sx + k - 2, 0 ), sw - 1 )];
+            }
+            out[x] = sum * ( 1.0f / 16 );
+        }
+    }
+}
+
+/**
+ * Expands a row of a pyramid level to the resolution of the previous level
+ * (inverse of ReduceRow(): [1 6 1] / 8 at even and [4 4] / 8 at odd positions).
+ * @param above source row y / 2 - 1 (clamped)
+ * @param center source row y / 2
+ * @param below source row y / 2 + 1 (clamped)
+ * @param y destination row
+ * @param sw source width
+ * @param dw destination width
+ * @param temp temporary buffer, sw values
+ * @param out receives dw values
+ */
+static void ExpandRow( const float * above, const float * center, const float * below, int y, int sw, int dw, float * temp, float * out )
+{
+    if ( ( y & 1 ) == 0 )
+    {
+        for ( int x = 0; x < sw; x++ )
+        {
+            temp[x] = ( above[x] + 6.0f * center[x] + below[x] ) * ( 1.0f / 8 );
+        }
+    }
+    else
+    {
+        for ( int x = 0; x < sw; x++ )
+        {
+            temp[x] = ( center[x] + below[x] ) * 0.5f;
+        }
+    }
+
+    for ( int x = 0; x < dw; x++ )
+    {
+        int xc = x >> 1;
+        if ( ( x & 1 ) == 0 )
+        {
+            out[x] = ( temp[std::max( xc - 1, 0 )] + 6.0f * temp[xc] + temp[std::min( xc + 1, sw - 1 )] ) * ( 1.0f / 8 );
+        }
+        else
+        {
+            out[x] = ( temp[xc] + temp[std::min( xc + 1, sw - 1 )] ) * 0.5f;
+        }
+    }
+}
+
+/**
+ * Adds a weighted Laplacian row ( g - expanded ) to the accumulator.
+ * @param g Gaussian level row
+ * @param expanded expanded next Gaussian level row (0 for the top level)
+ * @param weights normalized weights row
+ * @param acc accumulator row
+ * @param w level width
+ */
+template<typename T>
+static void AccumulateRow( const T * g, const float * expanded, const float * weights, float * acc, int w )
+{
+    if ( expanded != 0 )
+    {
+        for ( int x = 0; x < w; x++ )
+        {
+            acc[x] += weights[x] * ( g[x] - expanded[x] );
+        }
+    }
+    else
+    {
+        for ( int x = 0; x < w; x++ )
+        {
+            acc[x] += weights[x] * g[x];
+        }
+    }
+}
+
+/**
+ * Computes fusion weights of a frame row (not normalized).
+ * @param frame YUV420p frame
+ * @param width frame width
+ * @param height frame height
+ * @param y row
+ * @param exposureLut well-exposedness of a channel value
+ * @param buffer temporary buffer, 5 * width bytes
+ * @param weights receives width weights
+ */
+static void ComputeWeightRow( const uchar * frame, int width, int height, int y, const float * exposureLut, uchar * buffer,
+                              float * weights )
+{
+    const uchar * cbPlane = frame + width * height;
+    const uchar * crPlane = cbPlane + ( ( width * height ) >> 2 );
+    uchar * cb = buffer;
+    uchar * cr = cb + width;
+    uchar * r = cr + width;
+    uchar * g = r + width;
+    uchar * b = g + width;
+
+    const uchar * row = frame + y * width;
+    const uchar * above = frame + std::max( y - 1, 0 ) * width;
+    const uchar * below = frame + std::min( y + 1, height - 1 ) * width;
+    const uchar * cbRow = cbPlane + ( y >> 1 ) * ( width >> 1 );
+    const uchar * crRow = crPlane + ( y >> 1 ) * ( width >> 1 );
+
+    for ( int x = 0; x < width; x++ )
+    {
+        cb[x] = cbRow[x >> 1];
+        cr[x] = crRow[x >> 1];
+    }
+    ConvertYCbCrToRGB( row, cb, cr, r, g, b, width );
+
+    for ( int x = 0; x < width; x++ )
+    {
+        // contrast: absolute Laplacian of luma
+        int left = row[std::max( x - 1, 0 )];
+        int right = row[std::min( x + 1, width - 1 )];
+        float contrast = abs( left + right + above[x] + below[x] - 4 * row[x] ) * ( 1.0f / 255 );
+
+        // saturation: standard deviation of R, G and B
+        float mean = ( r[x] + g[x] + b[x] ) * ( 1.0f / 3 );
+        float dr = r[x] - mean, dg = g[x] - mean, db = b[x] - mean;
+        float saturation = sqrtf( ( dr * dr + dg * dg + db * db ) * ( 1.0f / 3 ) ) * ( 1.0f / 255 );
+
+        float exposedness = exposureLut[r[x]] * exposureLut[g[x]] * exposureLut[b[x]];
+        weights[x] = contrast * saturation * exposedness + FUSION_WEIGHT_EPSILON;
+    }
+}
+
+ExposureFusion::ExposureFusion( void ) : m_pool( 0 ), m_plan( false ), m_stage( EStageWeights ), m_level( 0 ), m_frames( 0 ),
+    m_frameCount( 0 ), m_yuv( 0 ), m_levelCount( 0 ), m_coarseLevel( 0 )
+{
+    for ( int i = 0; i < 256; i++ )
+    {
+        float d = i / 255.0f - 0.5f;
+        m_exposureLut[i] = expf( -d * d / ( 2.0f * FUSION_EXPOSURE_SIGMA * FUSION_EXPOSURE_SIGMA ) );
+    }
+}
+
+const uchar * ExposureFusion::getFrameRow( int frame, int plane, int y ) const
+{
+    int lumaSize = m_widths[0] * m_heights[0];
+    switch ( plane )
+    {
+        case EPlaneCb:
+            return m_frames[frame] + lumaSize + y * m_widths[1];
+        case EPlaneCr:
+            return m_frames[frame] + lumaSize + ( lumaSize >> 2 ) + y * m_widths[1];
+        default:
+            return m_frames[frame] + y * m_widths[0];
+    }
+}
+
+void ExposureFusion::fuse( const uchar * const * frames, int frameCount, int width, int height, uchar * yuv, ThreadPool * pool )
+{
+    Timer timer;
+
+    m_pool = pool;
+    m_frames = frames;
+    m_frameCount = frameCount;
+    m_yuv = yuv;
+
+    // level sizes (Cb and Cr need at least two levels)
+    m_widths[0] = width;
+    m_heights[0] = height;
+    m_levelCount = 1;
+    while ( m_levelCount < FUSION_MAX_LEVELS && ( m_levelCount < 2 ||
+            std::min( m_widths[m_levelCount - 1], m_heights[m_levelCount - 1] ) >= 2 * FUSION_MIN_LEVEL_SIZE ) )
+    {
+        m_widths[m_levelCount] = ( m_widths[m_levelCount - 1] + 1 ) >> 1;
+        m_heights[m_levelCount] = ( m_heights[m_levelCount - 1] + 1 ) >> 1;
+        m_levelCount++;
+    }
+    m_coarseLevel = std::min( FUSION_STREAM_LEVELS, m_levelCount );
+
+    // windows in use, the base Gaussian levels of Y, Cb and Cr are the frames
+    m_windows.clear();
+    for ( int p = EPlaneY; p < EPlaneCount; p++ )
+    {
+        for ( int m = 0; m < m_levelCount; m++ )
+        {
+            if ( p == EPlaneWeights || m > getBaseLevel( p ) )
+            {
+                initWindow( m_gauss[p][m], m, frameCount );
+            }
+            if ( p != EPlaneWeights && m >= getBaseLevel( p ) )
+            {
+                initWindow( m_blend[p][m], m, m > getBaseLevel( p ) ? 1 : 0 );
+            }
+        }
+    }
+
+    // plan the window sizes, coarse levels are kept whole
+    sweep( true );
+
+    int memory = 0;
+    for ( int i = 0; i < (int) m_windows.size(); i++ )
+    {
+        Window & window = *m_windows[i];
+        window.capacity = window.level >= m_coarseLevel ? window.height : std::min( std::max( window.span, 1 ), window.height );
+        window.data.resize( window.frames * window.capacity * window.width );
+        memory += window.data.size() * sizeof( float );
+    }
+
+    sweep( false );
+
+    // release working memory
+    for ( int i = 0; i < (int) m_windows.size(); i++ )
+    {
+        std::vector<float>().swap( m_windows[i]->data );
+    }
+
+    LOG( "ExposureFusion: %d frames %dx%d fused in %.1f ms, %.1f MB of row windows\n", frameCount, width, height, timer.get(),
+         memory / ( 1024.0f * 1024.0f ) );
+}
+
+void ExposureFusion::initWindow( Window & window, int level, int frames )
+{
+    window.level = level;
+    window.width = m_widths[level];
+    window.height = m_heights[level];
+    window.frames = frames;
+    window.capacity = 0;
+    window.span = 0;
+    m_windows.push_back( &window );
+}
+
+void ExposureFusion::sweep( bool plan )
+{
+    m_plan = plan;
+    for ( int i = 0; i < (int) m_windows.size(); i++ )
+    {
+        m_windows[i]->front = 0;
+        m_windows[i]->need = 0;
+        m_windows[i]->low = INT_MAX;
+    }
+
+    // first sweep: coarse levels whole, a few of their rows per step
+    int c = m_coarseLevel;
+    if ( c < m_levelCount )
+    {
+        int block = std::max( FUSION_BLOCK_ROWS >> c, 1 );
+        for ( int y = block; y < m_heights[c] + block; y += block )
+        {
+            for ( int p = EPlaneY; p < EPlaneCount; p++ )
+            {
+                require( m_gauss[p][c], y );
+            }
+            step();
+        }
+
+        for ( int p = EPlaneY; p < EPlaneWeights; p++ )
+        {
+            require( m_blend[p][c], m_heights[c] );
+        }
+        step();
+
+        // finer levels are computed again by the second sweep
+        for ( int i = 0; i < (int) m_windows.size(); i++ )
+        {
+            if ( m_windows[i]->level < c )
+            {
+                m_windows[i]->front = 0;
+                m_windows[i]->need = 0;
+            }
+        }
+    }
+
+    // second sweep: finer levels and the output
+    for ( int y = FUSION_BLOCK_ROWS; y < m_heights[0] + FUSION_BLOCK_ROWS; y += FUSION_BLOCK_ROWS )
+    {
+        require( m_blend[EPlaneY][0], y );
+        require( m_blend[EPlaneCb][1], ( y + 1 ) >> 1 );
+        require( m_blend[EPlaneCr][1], ( y + 1 ) >> 1 );
+        step();
+    }
+}
+
+/**
+ * Gets the number of rows of a level needed to expand the given number of rows
+ * of the finer level.
+ */
+static inline int ExpandNeed( int rows )
+{
+    return rows > 0 ? ( ( rows - 1 ) >> 1 ) + 2 : 0;
+}
+
+/**
+ * Gets the number of rows of a level needed to reduce the given number of rows
+ * of the coarser level.
+ */
+static inline int ReduceNeed( int rows )
+{
+    return rows > 0 ? 2 * rows + 1 : 0;
+}
+
+void ExposureFusion::step( void )
+{
+    const int top = m_levelCount - 1;
+
+    // blended levels depend on the coarser blended levels
+    for ( int p = EPlaneY; p < EPlaneWeights; p++ )
+    {
+        for ( int m = getBaseLevel( p ); m < top; m++ )
+        {
+            Window & blend = m_blend[p][m];
+            if ( blend.front < blend.need )
+            {
+                require( m_blend[p][m + 1], ExpandNeed( blend.need ) );
+            }
+        }
+    }
+
+    // Gaussian levels depend on the blended levels and on the coarser Gaussian levels
+    for ( int m = top; m >= 0; m-- )
+    {
+        for ( int p = EPlaneY; p < EPlaneCount; p++ )
+        {
+            if ( p != EPlaneWeights && m <= getBaseLevel( p ) )
+            {
+                continue;
+            }
+
+            Window & gauss = m_gauss[p][m];
+            if ( p == EPlaneWeights )
+            {
+                for ( int q = EPlaneY; q < EPlaneWeights; q++ )
+                {
+                    Window & blend = m_blend[q][m];
+                    if ( m >= getBaseLevel( q ) && blend.front < blend.need )
+                    {
+                        require( gauss, blend.need );
+                    }
+                }
+            }
+            else
+            {
+                Window & blend = m_blend[p][m];
+                if ( blend.front < blend.need )
+                {
+                    require( gauss, blend.need );
+                }
+                Window & finer = m_blend[p][m - 1];
+                if ( m - 1 >= getBaseLevel( p ) && finer.front < finer.need )
+                {
+                    require( gauss, ExpandNeed( finer.need ) );
+                }
+            }
+
+            if ( m < top )
+            {
+                Window & coarser = m_gauss[p][m + 1];
+                if ( coarser.front < coarser.need )
+                {
+                    require( gauss, ReduceNeed( coarser.need ) );
+                }
+            }
+        }
+    }
+
+    for ( int i = 0; i < (int) m_windows.size(); i++ )
+    {
+        m_windows[i]->start = m_windows[i]->front;
+    }
+
+    runStage( EStageWeights, 0 );
+    for ( int m = 1; m <= top; m++ )
+    {
+        runStage( EStageReduce, m );
+    }
+    for ( int m = top; m >= 0; m-- )
+    {
+        runStage( EStageBlend, m );
+    }
+
+    // rows alive during the step: from the lowest row read to the last row computed
+    for ( int i = 0; i < (int) m_windows.size(); i++ )
+    {
+        Window & window = *m_windows[i];
+        if ( window.low != INT_MAX || window.front > window.start )
+        {
+            window.span = std::max( window.span, window.front - std::min( window.low, window.start ) );
+        }
+        window.low = INT_MAX;
+    }
+}
+
+void ExposureFusion::require( Window & window, int rows )
+{
+    window.need = std::max( window.need, std::min( rows, window.height ) );
+}
+
+void ExposureFusion::touch( Window & window, int row )
+{
+    window.low = std::min( window.low, std::min( std::max( row, 0 ), window.height - 1 ) );
+}
+
+void ExposureFusion::runStage( EStage stage, int level )
+{
+    const int top = m_levelCount - 1;
+
+    // windows computed by the stage
+    int planes[EPlaneCount];
+    int planeCount = 0;
+    for ( int p = EPlaneY; p < EPlaneCount; p++ )
+    {
+        bool computed;
+        switch ( stage )
+        {
+            case EStageWeights:
+                computed = p == EPlaneWeights;
+                break;
+            case EStageReduce:
+                computed = p == EPlaneWeights || level > getBaseLevel( p );
+                break;
+            default:
+                computed = p != EPlaneWeights && level >= getBaseLevel( p );
+                break;
+        }
+
+        if ( !computed )
+        {
+            continue;
+        }
+
+        Window & window = stage == EStageBlend ? m_blend[p][level] : m_gauss[p][level];
+        if ( window.front < window.need )
+        {
+            planes[planeCount++] = p;
+        }
+    }
+
+    if ( planeCount == 0 )
+    {
+        return;
+    }
+
+    // record rows read
+    for ( int i = 0; i < planeCount; i++ )
+    {
+        int p = planes[i];
+        if ( stage == EStageReduce )
+        {
+            if ( p == EPlaneWeights || level - 1 > getBaseLevel( p ) )
+            {
+                touch( m_gauss[p][level - 1], 2 * m_gauss[p][level].front - 2 );
+            }
+        }
+        else if ( stage == EStageBlend )
+        {
+            int front = m_blend[p][level].front;
+            if ( level > getBaseLevel( p ) )
+            {
+                touch( m_gauss[p][level], front );
+            }
+            touch( m_gauss[EPlaneWeights][level], front );
+            if ( level < top )
+            {
+                touch( m_gauss[p][level + 1], ( front >> 1 ) - 1 );
+                touch( m_blend[p][level + 1], ( front >> 1 ) - 1 );
+            }
+        }
+    }
+
+    if ( !m_plan )
+    {
+        // split the rows so that there are about two tasks per thread
+        int frames = stage == EStageReduce ? m_frameCount : 1;
+        int units = planeCount * frames;
+        int concurrency = m_pool != 0 ? m_pool->concurrency() : 1;
+        int chunks = std::max( ( 2 * concurrency + units - 1 ) / units, 1 );
+        if ( m_pool == 0 )
+        {
+            chunks = 1;
+        }
+
+        m_stage = stage;
+        m_level = level;
+        m_tasks.clear();
+        for ( int i = 0; i < planeCount; i++ )
+        {
+            int p = planes[i];
+            Window & window = stage == EStageBlend ? m_blend[p][level] : m_gauss[p][level];
+            int rows = window.need - window.front;
+            int count = std::min( chunks, rows );
+            for ( int k = 0; k < frames; k++ )
+            {
+                for ( int j = 0; j < count; j++ )
+                {
+                    Task task;
+                    task.plane = p;
+                    task.frame = k;
+                    task.y0 = window.front + rows * j / count;
+                    task.y1 = window.front + rows * ( j + 1 ) / count;
+                    m_tasks.push_back( task );
+                }
+            }
+        }
+
+        if ( m_pool != 0 )
+        {
+            m_pool->run( ExposureFusion::TaskProc, this, m_tasks.size() );
+        }
+        else
+        {
+            for ( int i = 0; i < (int) m_tasks.size(); i++ )
+            {
+                TaskProc( this, i );
+            }
+        }
+    }
+
+    for ( int i = 0; i < planeCount; i++ )
+    {
+        Window & window = stage == EStageBlend ? m_blend[planes[i]][level] : m_gauss[planes[i]][level];
+        window.front = window.need;
+    }
+}
+
+void ExposureFusion::TaskProc( void * opaque, int index )
+{
+    ExposureFusion * instance = (ExposureFusion *) opaque;
+    const Task & task = instance->m_tasks[index];
+
+    switch ( instance->m_stage )
+    {
+        case EStageWeights:
+            instance->computeWeights( task.y0, task.y1 );
+            break;
+        case EStageReduce:
+            instance->reduce( task );
+            break;
+        case EStageBlend:
+            instance->blend( task );
+            break;
+    }
+}
+
+void ExposureFusion::computeWeights( int y0, int y1 )
+{
+    const int width = m_widths[0];
+    const int height = m_heights[0];
+    Window & weights = m_gauss[EPlaneWeights][0];
+
+    std::vector<uchar> buffer( 5 * width );
+    std::vector<float> sum( width );
+
+    for ( int y = y0; y < y1; y++ )
+    {
+        for ( int x = 0; x < width; x++ )
+        {
+            sum[x] = 0.0f;
+        }
+        for ( int k = 0; k < m_frameCount; k++ )
+        {
+            float * w = weights.row( k, y );
+            ComputeWeightRow( m_frames[k], width, height, y, m_exposureLut, &buffer[0], w );
+            for ( int x = 0; x < width; x++ )
+            {
+                sum[x] += w[x];
+            }
+        }
+        for ( int k = 0; k < m_frameCount; k++ )
+        {
+            float * w = weights.row( k, y );
+            for ( int x = 0; x < width; x++ )
+            {
+                w[x] = w[x] / sum[x];
+            }
+        }
+    }
+}
+
+void ExposureFusion::reduce( const Task & task )
+{
+    Window & dst = m_gauss[task.plane][m_level];
+    int sw = m_widths[m_level - 1], sh = m_heights[m_level - 1];
+    bool frame = task.plane != EPlaneWeights && m_level - 1 == getBaseLevel( task.plane );
+    std::vector<float> temp( sw );
+
+    for ( int y = task.y0; y < task.y1; y++ )
+    {
+        if ( frame )
+        {
+            const uchar * r[5];
+            for ( int k = 0; k < 5; k++ )
+            {
+                r[k] = getFrameRow( task.frame, task.plane, std::min( std::max( 2 * y + k - 2, 0 ), sh - 1 ) );
+            }
+            ReduceRow( r, sw, dst.row( task.frame, y ), dst.width, &temp[0] );
+        }
+        else
+        {
+            Window & src = m_gauss[task.plane][m_level - 1];
+            const float * r[5];
+            for ( int k = 0; k < 5; k++ )
+            {
+                r[k] = src.row( task.frame, std::min( std::max( 2 * y + k - 2, 0 ), sh - 1 ) );
+            }
+            ReduceRow( r, sw, dst.row( task.frame, y ), dst.width, &temp[0] );
+        }
+    }
+}
+
+void ExposureFusion::blend( const Task & task )
+{
+    const int p = task.plane;
+    const int w = m_widths[m_level];
+    const bool base = m_level == getBaseLevel( p );
+    const bool top = m_level == m_levelCount - 1;
+    Window & weights = m_gauss[EPlaneWeights][m_level];
+    std::vector<float> temp( top ? 0 : m_widths[m_level + 1] );
+    std::vector<float> expanded( top ? 0 : w );
+    std::vector<float> output( base ? w : 0 );
+
+    int lumaSize = m_widths[0] * m_heights[0];
+    uchar * dst = m_yuv + ( p == EPlaneY ? 0 : ( p == EPlaneCb ? lumaSize : lumaSize + ( lumaSize >> 2 ) ) );
+
+    for ( int y = task.y0; y < task.y1; y++ )
+    {
+        float * acc = base ? &output[0] : m_blend[p][m_level].row( 0, y );
+        for ( int x = 0; x < w; x++ )
+        {
+            acc[x] = 0.0f;
+        }
+
+        for ( int k = 0; k < m_frameCount; k++ )
+        {
+            if ( !top )
+            {
+                expandRow( m_gauss[p][m_level + 1], k, y, w, &temp[0], &expanded[0] );
+            }
+            const float * next = top ? 0 : &expanded[0];
+            if ( base )
+            {
+                AccumulateRow( getFrameRow( k, p, y ), next, weights.row( k, y ), acc, w );
+            }
+            else
+            {
+                AccumulateRow( m_gauss[p][m_level].row( k, y ), next, weights.row( k, y ), acc, w );
+            }
+        }
+
+        // collapse
+        if ( !top )
+        {
+            expandRow( m_blend[p][m_level + 1], 0, y, w, &temp[0], &expanded[0] );
+            for ( int x = 0; x < w; x++ )
+            {
+                acc[x] += expanded[x];
+            }
+        }
+
+        if ( base )
+        {
+            uchar * out = dst + y * w;
+            for ( int x = 0; x < w; x++ )
+            {
+                float v = acc[x] + 0.5f;
+                out[x] = (uchar) ( v <= 0.0f ? 0 : ( v >= 255.0f ? 255 : (int) v ) );
+            }
+        }
+    }
+}
+
+void ExposureFusion::expandRow( Window & src, int frame, int y, int dw, float * temp, float * out )
+{
+    int yc = y >> 1;
+    ExpandRow( src.row( frame, std::max( yc - 1, 0 ) ), src.row( frame, yc ), src.row( frame, std::min( yc + 1, src.height - 1 ) ), y,
+               src.width, dw, temp, out );
+}
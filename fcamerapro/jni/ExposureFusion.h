@@ -0,0 +1,233 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _EXPOSURE_FUSION_H
+#define _EXPOSURE_FUSION_H
+
+/**
+ * @file
+ * Definition of ExposureFusion.
+ */
+
+#include <vector>
+#include "Common.h"
+
+class ThreadPool;
+
+#define FUSION_MAX_LEVELS      10   /**< Maximum number of pyramid levels */
+#define FUSION_MIN_LEVEL_SIZE  8    /**< Pyramid is built until the smaller dimension drops to this size */
+#define FUSION_STREAM_LEVELS   4    /**< Number of finest levels streamed in row windows, coarser levels are kept whole */
+#define FUSION_BLOCK_ROWS      16   /**< Number of output luma rows produced per streaming step */
+#define FUSION_EXPOSURE_SIGMA  0.2f /**< Well-exposedness gaussian width (normalized intensity) */
+#define FUSION_WEIGHT_EPSILON  1e-12f /**< Weight floor, avoids division by zero in flat or clipped regions */
+
+/**
+ * Exposure fusion (Mertens, Kautz and Van Reeth 2007). Blends a bracket of
+ * YUV420p frames directly, without a response curve, using per-pixel weights
+ * W = contrast * saturation * well-exposedness, where contrast is the absolute
+ * luma Laplacian, saturation is the standard deviation of R, G and B and
+ * well-exposedness favours values close to mid-gray. The blend is done on
+ * Laplacian pyramids; Cb and Cr planes use the weight pyramid from its second
+ * level on (half resolution).
+ *
+ * All frames are swept together from top to bottom. Every step produces
+ * FUSION_BLOCK_ROWS output rows and computes only the rows of the normalized
+ * weight, Gaussian and blended levels these depend on, keeping a sliding
+ * window of rows per level. A coarse level row depends on a tall band of the
+ * frame, so the levels from FUSION_STREAM_LEVELS up (1/256 of the pixels) are
+ * computed whole by a first sweep and only the finer levels are streamed by
+ * the second one. Window sizes are planned by a dry run of the sweeps, the
+ * working memory is about 120 luma rows of floats per frame (3.7 MB for
+ * three 5 MP frames). Every step is split into tasks executed on a thread
+ * pool.
+ */
+class ExposureFusion
+{
+public:
+    /**
+     * Default constructor.
+     */
+    ExposureFusion( void );
+
+    /**
+     * Fuses a bracket of frames.
+     * @param frames pointers to YUV420p frame data, all frames have the same size
+     * @param frameCount number of frames
+     * @param width frame width in pixels (even)
+     * @param height frame height in pixels (even)
+     * @param yuv receives the fused YUV420p image
+     * @param pool thread pool (can be 0)
+     */
+    void fuse( const uchar * const * frames, int frameCount, int width, int height, uchar * yuv, ThreadPool * pool );
+
+private:
+    /**
+     * Sweep step stages.
+     */
+    enum EStage
+    {
+        EStageWeights, EStageReduce, EStageBlend
+    };
+
+    /**
+     * Pyramid planes.
+     */
+    enum EPlane
+    {
+        EPlaneY, EPlaneCb, EPlaneCr, EPlaneWeights, EPlaneCount
+    };
+
+    /**
+     * Sliding window of rows of a pyramid level. Gaussian level windows hold
+     * the same rows of every frame.
+     */
+    struct Window
+    {
+        std::vector<float> data; /**< Rows, capacity rows per frame */
+        int level; /**< Luma level */
+        int width; /**< Level width */
+        int height; /**< Level height */
+        int frames; /**< Number of frames kept (0 for the base blended levels written to the output) */
+        int capacity; /**< Number of rows kept per frame */
+        int front; /**< Number of rows computed */
+        int need; /**< Number of rows needed by the end of the current step */
+        int start; /**< Front at the beginning of the current step */
+        int low; /**< Lowest row read in the current step */
+        int span; /**< Largest number of rows kept alive by a step */
+
+        /**
+         * Gets a row of a frame. Only the last capacity computed rows are kept.
+         */
+        float * row( int frame, int y )
+        {
+            return &data[( frame * capacity + y % capacity ) * width];
+        }
+    };
+
+    /**
+     * Part of a stage executed by a single thread pool task.
+     */
+    struct Task
+    {
+        int plane; /**< Plane */
+        int frame; /**< Frame (reductions only) */
+        int y0; /**< First row */
+        int y1; /**< Row after the last one */
+    };
+
+    /**
+     * Sets up a window of a level and adds it to the windows in use.
+     */
+    void initWindow( Window & window, int level, int frames );
+
+    /**
+     * Sweeps the frames: computes the coarse levels whole, then streams the
+     * finer ones and the output.
+     * @param plan true to only plan window sizes (nothing is computed)
+     */
+    void sweep( bool plan );
+
+    /**
+     * Computes the rows needed by the window needs set by sweep().
+     */
+    void step( void );
+
+    /**
+     * Raises the number of rows needed from a window (clamped to its height).
+     */
+    void require( Window & window, int rows );
+
+    /**
+     * Records a row read from a window (window size planning).
+     */
+    void touch( Window & window, int row );
+
+    /**
+     * Computes the needed rows of all windows of a stage and level.
+     */
+    void runStage( EStage stage, int level );
+
+    /**
+     * Thread pool task executing a task of the current stage.
+     */
+    static void TaskProc( void * opaque, int index );
+
+    /**
+     * Computes normalized weights of all frames at level 0.
+     */
+    void computeWeights( int y0, int y1 );
+    /**
+     * Computes rows of a Gaussian level of a frame from the finer level.
+     */
+    void reduce( const Task & task );
+    /**
+     * Computes rows of a blended level: sum of the weighted Laplacians of
+     * all frames plus the expanded coarser blended level. Rows of the finest
+     * level are converted to bytes.
+     */
+    void blend( const Task & task );
+
+    /**
+     * Expands a row of the coarser level window to a row of the finer level.
+     */
+    void expandRow( Window & src, int frame, int y, int dw, float * temp, float * out );
+
+    /**
+     * Gets the finest luma level of a plane (Cb and Cr start at half resolution).
+     */
+    int getBaseLevel( int plane ) const
+    {
+        return plane == EPlaneCb || plane == EPlaneCr ? 1 : 0;
+    }
+
+    /**
+     * Gets a row of a frame plane (the base level of Y, Cb and Cr pyramids).
+     */
+    const uchar * getFrameRow( int frame, int plane, int y ) const;
+
+    float m_exposureLut[256]; /**< Well-exposedness of a channel value */
+    ThreadPool * m_pool; /**< Thread pool */
+    bool m_plan; /**< Planning sweep */
+
+    // current stage
+    EStage m_stage; /**< Stage */
+    int m_level; /**< Luma level */
+    std::vector<Task> m_tasks; /**< Tasks */
+
+    // fusion state
+    const uchar * const * m_frames; /**< Frames */
+    int m_frameCount; /**< Number of frames */
+    uchar * m_yuv; /**< Output image */
+    int m_levelCount; /**< Number of luma pyramid levels */
+    int m_coarseLevel; /**< First level computed whole */
+    int m_widths[FUSION_MAX_LEVELS]; /**< Luma level widths */
+    int m_heights[FUSION_MAX_LEVELS]; /**< Luma level heights */
+    Window m_gauss[EPlaneCount][FUSION_MAX_LEVELS]; /**< Gaussian level windows of all frames (the base levels of Y, Cb and Cr are the frames) */
+    Window m_blend[EPlaneWeights][FUSION_MAX_LEVELS]; /**< Blended level windows of Y, Cb and Cr (the base levels go straight to the output) */
+    std::vector<Window *> m_windows; /**< Windows in use */
+};
+
+#endif
@@ -44,8 +44,8 @@
 
 #include <jni.h>
 #include <string>
+#include <algorithm>
 #include <FCam/Tegra/hal/SharedBuffer.h>
-#include <fastcv/fastcv.h>
 
 //#define USE_GL_TEXTURE_UPLOAD
 
@@ -64,27 +64,36 @@
 #include "HPT.h"
 #include "Utils.h"
 #include "GLWrapper.h"
+#include "SharedBufferPool.h"
+#include "ThreadPool.h"
+#include "FrameStats.h"
+#include "IntegralImage.h"
+#include "ZoneAutoExposure.h"
+#include "ZoneAutoWhiteBalance.h"
+#include "SceneChangeDetector.h"
+#include "ResponseCurve.h"
+#include "StereoDisparity.h"
+#include "HdrPreview.h"
+#include "NightAccumulator.h"
 
 //#define MEASURE_JITTER
+//#define MEASURE_STATS_TIME
 
 #define BACK_PREVIEW_IMAGE_WIDTH  960 /**< Back camera preview image width in pixels */
 #define BACK_PREVIEW_IMAGE_HEIGHT 720 /**< Back camera preview image height in pixels */
 
-#define FRONT_PREVIEW_IMAGE_WIDTH  960 /**< Front camera preview image width in pixels */
-#define FRONT_PREVIEW_IMAGE_HEIGHT 720 /**< Front camera preview image height in pixels */
+// preview surfaces are recycled through SharedBufferPool (SharedBuffer dealloc bug), so
+// each camera can use its native preview resolution
+#define FRONT_PREVIEW_IMAGE_WIDTH  640 /**< Front camera preview image width in pixels */
+#define FRONT_PREVIEW_IMAGE_HEIGHT 480 /**< Front camera preview image height in pixels */
 
-#define STEREO_PREVIEW_IMAGE_WIDTH  960 /**< Stereo camera preview image width in pixels */
+#define STEREO_PREVIEW_IMAGE_WIDTH  1280 /**< Stereo camera preview image width in pixels */
 #define STEREO_PREVIEW_IMAGE_HEIGHT 720 /**< Stereo camera preview image height in pixels */
 
-// TODO: need to keep preview buffer resolution constant -> SharedBuffer dealloc bug
-//#define FRONT_PREVIEW_IMAGE_WIDTH  640 /**< Front camera preview image width in pixels */
-//#define FRONT_PREVIEW_IMAGE_HEIGHT 480 /**< Front camera preview image height in pixels */
-//
-//#define STEREO_PREVIEW_IMAGE_WIDTH  1280 /**< Stereo camera preview image width in pixels */
-//#define STEREO_PREVIEW_IMAGE_HEIGHT 720 /**< Stereo camera preview image height in pixels */
-
 #define TOUCH_PATCH_SIZE     15 /**< The size of the patch used in local white balancing */
 
+#define STATS_SAMPLING_STEP 2 /**< Preview statistics sampling stride in pixels */
+
 #define FPS_UPDATE_PERIOD 500 /**< FPS estimation interval (in msec) */
 #define FPS_JITTER_CAP    500 /**< FPS estimation outlayer threshold (in msec) */
 
@@ -122,6 +131,7 @@ typedef struct S_FCAM_INTERFACE_DATA
     int frameWidth, frameHeight;
 #else
     class PreviewBuffer * previewBuffer; /**< Encapsulation of preview buffers */
+    SharedBufferPool * previewBufferPool; /**< Pool recycling preview buffer surfaces */
     pthread_mutex_t renderingThreadLock;
 #endif
     int previewBufferTexId; /**< OpenGL texture id that is currently locked in the Java side */
@@ -131,8 +141,12 @@ typedef struct S_FCAM_INTERFACE_DATA
     Camera::CaptureState previousState; /**< Capture state for previous frame */
     pthread_mutex_t previousStateLock; /**< Mutex used in exclusive modification of #previousState */
 
+    StereoDisparity * stereoDisparity; /**< Stereo preview disparity engine (publishes the latest map) */
+
     float captureFps; /**< Capture rate in frames per second */
+    float skipRatio3A; /**< Ratio of preview frames the 3A evaluation has been skipped for */
     bool isCapturing; /**< Is capturing (0 - no, 1 - yes) */
+    volatile bool stopCapture; /**< Has the user asked to end a night mode capture? (0 - no, 1 - yes) */
     bool isViewerActive; /**< Is preview capture active (0 - off, 1 - on) */
     bool isGLInitDone; /**< Has OpenGL initialization been done? (0 - no, 1 - yes) */
 } FCAM_INTERFACE_DATA;
@@ -153,10 +167,11 @@ class PreviewBuffer : public TripleBuffer<FCam::Tegra::Hal::SharedBuffer>
 public:
     /**
      * Constructs hardware accelerated triple-buffered preview container (directly accessible from GPU).
+     * @param pool surface pool the preview buffers are taken from
      * @param width preview image width in pixels
      * @param height preview image height in pixels
      */
-    PreviewBuffer( int width, int height )
+    PreviewBuffer( SharedBufferPool * pool, int width, int height ) : m_pool( pool )
     {
         // init triple buffering
         m_width = width;
@@ -164,7 +179,7 @@ public:
 
         for ( int i = 0; i < 3; i++ )
         {
-            m_viewBuffers[i] = new FCam::Tegra::Hal::SharedBuffer( width, height, FCam::Tegra::Hal::SharedBuffer::YUV420p );
+            m_viewBuffers[i] = m_pool->acquire( width, height, FCam::YUV420p );
         }
 
         m_backBuffer = m_viewBuffers[0];
@@ -174,13 +189,14 @@ public:
 
 
     /**
-     * Default destructor
+     * Default destructor. Returns the surfaces to the pool, they become reusable
+     * after the GL thread unlocks the preview texture.
      */
     ~PreviewBuffer( void )
     {
         for ( int i = 0; i < 3; i++ )
         {
-            delete m_viewBuffers[i];
+            m_pool->release( m_viewBuffers[i] );
         }
     }
 
@@ -194,6 +210,7 @@ public:
     }
 
 private:
+    SharedBufferPool * m_pool; /**< Pool owning the surfaces */
     FCam::Tegra::Hal::SharedBuffer * m_viewBuffers[3]; /**< FCam hardware surfaces (CPU/GPU sharing) */
     int m_width, m_height;
 };
@@ -322,15 +339,15 @@ extern "C" {
 
             if ( sAppData->previewBuffer == 0 )
             {
-                sAppData->previewBuffer = new PreviewBuffer( sAppData->currentCamera->width(), sAppData->currentCamera->height() );
+                sAppData->previewBuffer = new PreviewBuffer( sAppData->previewBufferPool, sAppData->currentCamera->width(), sAppData->currentCamera->height() );
             }
 
-            // reallocate if capture resolution changed
+            // swap surfaces if capture resolution changed (old ones are recycled by the pool)
             if ( sAppData->previewBuffer->width() != sAppData->currentCamera->width() ||
                  sAppData->previewBuffer->height() != sAppData->currentCamera->height() )
             {
                 delete sAppData->previewBuffer;
-                sAppData->previewBuffer = new PreviewBuffer( sAppData->currentCamera->width(), sAppData->currentCamera->height() );
+                sAppData->previewBuffer = new PreviewBuffer( sAppData->previewBufferPool, sAppData->currentCamera->width(), sAppData->currentCamera->height() );
             }
 
             FCam::Tegra::Hal::SharedBuffer * buffer = sAppData->previewBuffer->swapFrontBuffer();
@@ -382,6 +399,11 @@ extern "C" {
             glDeleteTextures( 1, ( GLuint * )&sAppData->previewBufferTexId );
             sAppData->previewBufferTexId = -1;
         }
+
+#ifndef USE_GL_TEXTURE_UPLOAD
+        // surfaces released on resolution change are no longer referenced by GL
+        sAppData->previewBufferPool->collect();
+#endif
     }
 
     /**
@@ -395,6 +417,12 @@ extern "C" {
      */
     JNIEXPORT void JNICALL Java_com_nvidia_fcamerapro_FCamInterface_setParamInt( JNIEnv * env, jobject thiz, jint param, jint value )
     {
+        // the app thread does not resolve requests while it captures, a stop request is signaled directly
+        if ( param == PARAM_TAKE_PICTURE && value == 0 )
+        {
+            sAppData->stopCapture = true;
+        }
+
         sAppData->requestQueue.produce( ParamSetRequest( param, &value, sizeof( int ) ) );
     }
 
@@ -446,9 +474,44 @@ extern "C" {
             case PARAM_PREVIEW_AUTO_FOCUS_ON:
                 rval = previousShot->preview.autoFocus ? 1 : 0;
                 break;
+            case PARAM_PREVIEW_METERING_MODE:
+                rval = previousShot->preview.meteringMode;
+                break;
+            case PARAM_PREVIEW_HDR_FRAMES:
+                rval = previousShot->preview.hdrFrames;
+                break;
+            case PARAM_NIGHT_FRAMES:
+                rval = previousShot->nightFrames;
+                break;
+            case PARAM_LUCKY_FRAMES:
+                rval = previousShot->luckyFrames;
+                break;
             case PARAM_BURST_SIZE:
                 rval = previousShot->pendingImagesCount;
                 break;
+            case PARAM_OUTPUT_FORMAT:
+                rval = previousShot->outputFormat;
+                break;
+            case PARAM_TONE_MAP_OPERATOR:
+                rval = previousShot->toneMapOperator;
+                break;
+            case PARAM_ALIGN_FRAMES:
+                rval = previousShot->alignFrames ? 1 : 0;
+                break;
+            case PARAM_CALIBRATED_GAINS:
+                rval = previousShot->calibratedGains;
+                break;
+            case PARAM_STEREO_DISPARITY_ON:
+                rval = previousShot->stereoDisparity ? 1 : 0;
+                break;
+            case PARAM_DISPARITY_MAP_WIDTH:
+            case PARAM_DISPARITY_MAP_HEIGHT:
+                {
+                    int width, height;
+                    sAppData->stereoDisparity->getSize( width, height );
+                    rval = paramId == PARAM_DISPARITY_MAP_WIDTH ? width : height;
+                }
+                break;
             case PARAM_VIEWER_ACTIVE:
                 rval = sAppData->isViewerActive;
                 break;
@@ -535,7 +598,7 @@ extern "C" {
         {
             case PARAM_SHOT:
                 arraySize = env->GetArrayLength( value );
-                if ( arraySize != 5 )
+                if ( arraySize != SHOT_PARAM_COUNT )
                 {
                     ERROR( "setParamFloatArray(PARAM_SHOT): incorrect array size!" );
                     return;
@@ -560,6 +623,20 @@ extern "C" {
                 env->ReleaseFloatArrayElements( value, arrayData, 0 );
                 break;
 
+            case PARAM_RESPONSE_CURVE:
+                arraySize = env->GetArrayLength( value );
+                // R, G and B curves followed by the gain they were calibrated for
+                if ( arraySize != 3 * RESPONSE_CURVE_SIZE + 1 )
+                {
+                    ERROR( "setParamFloatArray(PARAM_RESPONSE_CURVE): incorrect array size!" );
+                    return;
+                }
+
+                arrayData = env->GetFloatArrayElements( value, 0 );
+                sAppData->requestQueue.produce( ParamSetRequest( param, arrayData, arraySize * sizeof( float ) ) );
+                env->ReleaseFloatArrayElements( value, arrayData, JNI_ABORT );
+                break;
+
             default:
                 ERROR( "setParamFloatArray(%i): received unsupported param id!", paramId );
         }
@@ -590,6 +667,9 @@ extern "C" {
             case PARAM_CAPTURE_FPS:
                 rval = sAppData->captureFps;
                 break;
+            case PARAM_PREVIEW_3A_SKIP_RATIO:
+                rval = sAppData->skipRatio3A;
+                break;
             case PARAM_PREVIEW_EXPOSURE:
                 rval = previousShot->preview.autoExposure ? previousShot->preview.evaluated.exposure : previousShot->preview.user.exposure;
                 break;
@@ -634,7 +714,7 @@ extern "C" {
         {
             case PARAM_SHOT:
                 arraySize = env->GetArrayLength( value );
-                if ( arraySize != 5 )
+                if ( arraySize != SHOT_PARAM_COUNT )
                 {
                     ERROR( "getParamFloatArray(PARAM_SHOT): incorrect shot array size!" );
                     return;
@@ -647,6 +727,7 @@ extern "C" {
                 arrayData[SHOT_PARAM_GAIN] = sAppData->previousState.pendingImages[pictureId].gain;
                 arrayData[SHOT_PARAM_WB] = sAppData->previousState.pendingImages[pictureId].wb;
                 arrayData[SHOT_PARAM_FLASH] = sAppData->previousState.pendingImages[pictureId].flashOn;
+                arrayData[SHOT_PARAM_RAW] = sAppData->previousState.pendingImages[pictureId].raw;
 
                 env->ReleaseFloatArrayElements( value, arrayData, 0 );
                 break;
@@ -669,6 +750,17 @@ extern "C" {
                 env->ReleaseFloatArrayElements( value, arrayData, 0 );
                 break;
 
+            case PARAM_RGB_HISTOGRAM:
+                arraySize = env->GetArrayLength( value );
+                if ( arraySize != 3 * HISTOGRAM_SIZE )
+                {
+                    ERROR( "getParamFloatArray(PARAM_RGB_HISTOGRAM): incorrect array size!" );
+                    break;
+                }
+
+                env->SetFloatArrayRegion( value, 0, arraySize, sAppData->previousState.preview.rgbHistogramData );
+                break;
+
             default:
                 ERROR( "getParamFloatArray(%i): received unsupported param id!", paramId );
         }
@@ -724,30 +816,122 @@ extern "C" {
         pthread_create( &sAppData->appThread, 0, FCamAppThread, sAppData );
     }
 
-	JNIEXPORT void JNICALL Java_com_nvidia_fcamerapro_FCamInterface_gSolve(
-			JNIEnv * env, jobject thiz, jobjectArray zObj, jfloatArray B,
-			jfloat lambda, jfloatArray w)
-	{
-		int len1 = env->GetArrayLength(zObj);
-		jfloatArray dim = (jfloatArray) env->GetObjectArrayElement(zObj, 0);
-		int len2 = env->GetArrayLength(dim);
-		float **z;
-		// allocate localArray using len1
-		z = new float*[len1];
-		for (int i = 0; i < len1; ++i) {
-			jfloatArray oneDim = (jfloatArray) env->GetObjectArrayElement(zObj, i);
-			jfloat *element = env->GetFloatArrayElements(oneDim, 0);
-			//allocate localArray[i] using len2
-			z[i] = new float[len2];
-			for (int j = 0; j < len2; ++j) {
-				z[i][j] = element[j];
-			}
-		}
-
-		free(z);
-
-		// TODO: Do main processing here.
-	}
+    JNIEXPORT jfloatArray JNICALL Java_com_nvidia_fcamerapro_FCamInterface_gSolve( JNIEnv * env, jobject thiz, jobjectArray zObj, jfloatArray bObj,
+                                                                                   jfloat lambda, jfloatArray wObj, jfloatArray lEObj )
+    {
+        int pixelCount = env->GetArrayLength( zObj );
+        int imageCount = env->GetArrayLength( bObj );
+
+        if ( pixelCount == 0 || imageCount == 0 || env->GetArrayLength( wObj ) < RESPONSE_CURVE_SIZE )
+        {
+            ERROR( "gSolve: invalid input dimensions (%d pixels, %d images)", pixelCount, imageCount );
+            return NULL;
+        }
+
+        std::vector<uchar> z( pixelCount * imageCount );
+        std::vector<jint> row( imageCount );
+        for ( int i = 0; i < pixelCount; i++ )
+        {
+            jintArray zRow = (jintArray) env->GetObjectArrayElement( zObj, i );
+            if ( env->GetArrayLength( zRow ) < imageCount )
+            {
+                ERROR( "gSolve: pixel %d has less than %d samples", i, imageCount );
+                env->DeleteLocalRef( zRow );
+                return NULL;
+            }
+
+            env->GetIntArrayRegion( zRow, 0, imageCount, &row[0] );
+            env->DeleteLocalRef( zRow );
+
+            for ( int j = 0; j < imageCount; j++ )
+            {
+                z[i * imageCount + j] = (uchar) ( row[j] < 0 ? 0 : ( row[j] > 255 ? 255 : row[j] ) );
+            }
+        }
+
+        std::vector<float> logExposure( imageCount );
+        float weights[RESPONSE_CURVE_SIZE];
+        float g[RESPONSE_CURVE_SIZE];
+        env->GetFloatArrayRegion( bObj, 0, imageCount, &logExposure[0] );
+        env->GetFloatArrayRegion( wObj, 0, RESPONSE_CURVE_SIZE, weights );
+
+        bool wantIrradiance = lEObj != NULL && env->GetArrayLength( lEObj ) >= pixelCount;
+        std::vector<float> logIrradiance( wantIrradiance ? pixelCount : 0 );
+
+        Timer timer;
+        if ( !SolveResponseCurve( &z[0], pixelCount, imageCount, &logExposure[0], lambda, weights, g,
+                                  wantIrradiance ? &logIrradiance[0] : NULL ) )
+        {
+            ERROR( "gSolve: singular system" );
+            return NULL;
+        }
+        LOG( "gSolve: %d pixels, %d images solved in %.2f ms\n", pixelCount, imageCount, timer.get() );
+
+        if ( wantIrradiance )
+        {
+            env->SetFloatArrayRegion( lEObj, 0, pixelCount, &logIrradiance[0] );
+        }
+
+        jfloatArray result = env->NewFloatArray( RESPONSE_CURVE_SIZE );
+        if ( result != NULL )
+        {
+            env->SetFloatArrayRegion( result, 0, RESPONSE_CURVE_SIZE, g );
+        }
+
+        return result;
+    }
+
+    JNIEXPORT jintArray JNICALL Java_com_nvidia_fcamerapro_FCamInterface_selectResponseSamples( JNIEnv * env, jobject thiz, jobjectArray imagesObj,
+                                                                                                jint width, jint height, jint reference, jint maxSamples )
+    {
+        int imageCount = env->GetArrayLength( imagesObj );
+        int pixelCount = width * height;
+
+        if ( imageCount == 0 || pixelCount <= 0 || maxSamples <= 0 || reference < 0 || reference >= imageCount )
+        {
+            ERROR( "selectResponseSamples: invalid input (%d images, %dx%d)", imageCount, width, height );
+            return NULL;
+        }
+
+        // convert packed ARGB pixels to luma
+        std::vector<uchar> luma( imageCount * pixelCount );
+        std::vector<const uchar *> images( imageCount );
+        for ( int i = 0; i < imageCount; i++ )
+        {
+            jintArray imageObj = (jintArray) env->GetObjectArrayElement( imagesObj, i );
+            if ( env->GetArrayLength( imageObj ) < pixelCount )
+            {
+                ERROR( "selectResponseSamples: image %d is smaller than %dx%d", i, width, height );
+                env->DeleteLocalRef( imageObj );
+                return NULL;
+            }
+
+            jint * argb = env->GetIntArrayElements( imageObj, 0 );
+            uchar * dst = &luma[i * pixelCount];
+            for ( int j = 0; j < pixelCount; j++ )
+            {
+                int pixel = argb[j];
+                dst[j] = (uchar) ( ( 77 * ( ( pixel >> 16 ) & 0xff ) + 150 * ( ( pixel >> 8 ) & 0xff ) + 29 * ( pixel & 0xff ) ) >> 8 );
+            }
+            env->ReleaseIntArrayElements( imageObj, argb, JNI_ABORT );
+            env->DeleteLocalRef( imageObj );
+
+            images[i] = dst;
+        }
+
+        std::vector<int> samples( maxSamples );
+        Timer timer;
+        int count = SelectResponseSamples( &images[0], imageCount, reference, width, height, &samples[0], maxSamples );
+        LOG( "selectResponseSamples: %d samples from %d images selected in %.2f ms\n", count, imageCount, timer.get() );
+
+        jintArray result = env->NewIntArray( count );
+        if ( result != NULL && count > 0 )
+        {
+            env->SetIntArrayRegion( result, 0, count, &samples[0] );
+        }
+
+        return result;
+    }
 
 #include "GLWrapper.h"
 
@@ -795,6 +979,24 @@ extern "C" {
     //  fbo.render(edgeDetectShader);
     //}
 
+    /**
+     * Copies the latest disparity map of the stereo preview (see StereoDisparity).
+     * @param env pointer to Java VM
+     * @param thiz reference to FCamInterface class instance
+     * @param planeObj receives the map, needs to hold exactly #PARAM_DISPARITY_MAP_WIDTH *
+     * #PARAM_DISPARITY_MAP_HEIGHT values
+     * @return true if the map has been copied
+     */
+    JNIEXPORT jboolean JNICALL Java_com_nvidia_fcamerapro_FCamInterface_getDisparityPlane( JNIEnv * env, jobject thiz, jbyteArray planeObj )
+    {
+        int size = env->GetArrayLength( planeObj );
+        jbyte * plane = env->GetByteArrayElements( planeObj, 0 );
+        bool copied = sAppData->stereoDisparity->copyMap(( uchar * ) plane, size );
+        env->ReleaseByteArrayElements( planeObj, plane, copied ? 0 : JNI_ABORT );
+
+        return copied ? JNI_TRUE : JNI_FALSE;
+    }
+
     /**
      * Called when JNI library is loaded. Performs initialization of worker thread data.
      * @param vm pointer to Java VM
@@ -824,11 +1026,13 @@ extern "C" {
         env->DeleteLocalRef( fcamClassRef );
 
         pthread_mutex_init( &sAppData->previousStateLock, 0 );
+        sAppData->stereoDisparity = new StereoDisparity();
 
         // flags
         sAppData->isCapturing = false;
         sAppData->isViewerActive = false;
         sAppData->isGLInitDone = false;
+        sAppData->stopCapture = false;
 
         sAppData->currentCamera = 0;
 #ifdef USE_GL_TEXTURE_UPLOAD
@@ -836,6 +1040,7 @@ extern "C" {
         sAppData->frameDataRGBA = 0;
 #else
         sAppData->previewBuffer = 0;
+        sAppData->previewBufferPool = new SharedBufferPool();
         sAppData->previewBufferTexId = -1;
         pthread_mutex_init( &sAppData->renderingThreadLock, 0 );
 #endif
@@ -880,69 +1085,25 @@ static void OnFileSystemChanged( void )
     sAppData->requestQueue.produce( ParamSetRequest( PARAM_PRIV_FS_CHANGED, &value, sizeof( int ) ) );
 }
 
-/**
- * Gets the average value of a color patch
- * @param idata pointer to color channel patch
- * @param rowStride patch row size in bytes
- * @param patchSize patch size in pixels
- * @return average value inside the patch
- */
-static int GetChannelPatchAverage( unsigned char * idata, const int rowStride, const int patchSize )
-{
-    int average = 0;
-    for ( int y = 0; y < patchSize; y++ )
-    {
-        for ( int x = 0; x < patchSize; x++ )
-        {
-            average += idata[x];
-        }
-        idata += rowStride;
-    }
-
-    return average / ( patchSize * patchSize );
-}
-
 /**
  * Gets the color temperature of a patch at specific location inside YUV420p frame.
- * @param currentTemp current white point temparature (sRGB color space)
- * @param idata pointer to YUV420p image data
+ * @param currentTemp white point temparature the frame was processed with (sRGB color space)
+ * @param sat summed-area tables of the current frame
  * @param tx x position of a patch center inside the image
  * @param ty y position of a patch center inside the image
- * @param width frame width in pixels
- * @param height frame height in pixels
  */
-static int GetLocalColorTemparature( int currentTemp, unsigned char * idata, int tx, int ty, int width, int height )
+static int GetLocalColorTemparature( int currentTemp, const IntegralImage & sat, int tx, int ty )
 {
-    if ( tx < ( TOUCH_PATCH_SIZE >> 1 ) )
-    {
-        tx = TOUCH_PATCH_SIZE >> 1;
-    }
+    // patch is clipped to the frame by the summed-area table queries
+    const int px = tx - ( TOUCH_PATCH_SIZE >> 1 );
+    const int py = ty - ( TOUCH_PATCH_SIZE >> 1 );
 
-    if ( ty < ( TOUCH_PATCH_SIZE >> 1 ) )
-    {
-        ty = TOUCH_PATCH_SIZE >> 1;
-    }
-
-    if ( tx >= ( width - ( TOUCH_PATCH_SIZE >> 1 ) ) )
-    {
-        tx = width - ( TOUCH_PATCH_SIZE >> 1 ) - 1;
-    }
+    int y = ( int ) sat.getMean( IntegralImage::EPlaneY, px, py, TOUCH_PATCH_SIZE, TOUCH_PATCH_SIZE );
+    int cb = ( int ) sat.getMean( IntegralImage::EPlaneCb, px, py, TOUCH_PATCH_SIZE, TOUCH_PATCH_SIZE );
+    int cr = ( int ) sat.getMean( IntegralImage::EPlaneCr, px, py, TOUCH_PATCH_SIZE, TOUCH_PATCH_SIZE );
 
-    if ( ty >= ( height - ( TOUCH_PATCH_SIZE >> 1 ) ) )
-    {
-        ty = height - ( TOUCH_PATCH_SIZE >> 1 ) - 1;
-    }
-
-    int offset = width * ( ty - ( TOUCH_PATCH_SIZE >> 1 ) ) + tx - ( TOUCH_PATCH_SIZE >> 1 );
-    int y = GetChannelPatchAverage( idata + offset, width, TOUCH_PATCH_SIZE );
-
-    offset = ( width >> 1 ) * (( ty >> 1 ) - ( TOUCH_PATCH_SIZE >> 2 ) ) + ( tx >> 1 ) - ( TOUCH_PATCH_SIZE >> 2 );
-    int isize = width * height;
-    int cb = GetChannelPatchAverage( idata + isize + offset, width >> 1, TOUCH_PATCH_SIZE >> 1 );
-    int cr = GetChannelPatchAverage( idata + isize + ( isize >> 2 ) + offset, width >> 1, TOUCH_PATCH_SIZE >> 1 );
-
-    // XXX: bug: need to convert averaged pixel color to d65 srgb space before calling the function below
     int temp = GetColorTemparatureYCbCr( currentTemp, y, cb, cr );
+    temp = temp < AWB_MIN_TEMP ? AWB_MIN_TEMP : ( temp > AWB_MAX_TEMP ? AWB_MAX_TEMP : temp );
     LOG( "GetLocalColorTemparature(): y: %i cb: %i cr: %i temp: %iK", y, cb, cr, temp );
     return temp;
 }
@@ -982,8 +1143,23 @@ static void * FCamAppThread( void * ptr )
 
     FCam::Tegra::Shot shot;
 
+    // preview statistics
+    ThreadPool statsPool;
+    FrameStats frameStats;
+    IntegralImage frameIntegral;
+    ZoneAutoExposure zoneAutoExposure;
+    ZoneAutoWhiteBalance zoneAutoWhiteBalance;
+    SceneChangeDetector sceneChangeDetector;
+
+    // HDR preview (exposure cycle streamed and its base parameters)
+    HdrPreview hdrPreview;
+    std::vector<FCam::Tegra::Shot> hdrBurst;
+    int hdrStreamedFrames = 0, hdrStreamedExposure = 0, hdrStreamedWB = 0;
+    float hdrStreamedGain = 0.0f;
+
     // fps stat init
     tdata->captureFps = 30; // assuming 30hz
+    tdata->skipRatio3A = 0.0f;
     double fpsUpdateTime = timer.get();
     int frameCount = 0;
 
@@ -996,6 +1172,10 @@ static void * FCamAppThread( void * ptr )
     double nextFrameTime = fpsUpdateTime + ( 1000.0f / tdata->captureFps );
 #endif
 
+#ifdef MEASURE_STATS_TIME
+    ParamStat statsTime;
+#endif
+
     for ( ;; )
     {
         // TODO: think about removing the queue, double buffered param struct would be better/faster
@@ -1025,6 +1205,7 @@ static void * FCamAppThread( void * ptr )
                     camera->m_currentState.pendingImages[pictureId].gain = taskDataFloat[SHOT_PARAM_GAIN];
                     camera->m_currentState.pendingImages[pictureId].wb = taskDataFloat[SHOT_PARAM_WB];
                     camera->m_currentState.pendingImages[pictureId].flashOn = taskDataFloat[SHOT_PARAM_FLASH] > 0.0f;
+                    camera->m_currentState.pendingImages[pictureId].raw = taskDataFloat[SHOT_PARAM_RAW] > 0.0f;
                     break;
                 case PARAM_PREVIEW_EXPOSURE:
                     camera->m_currentState.preview.user.exposure = taskDataFloat[0];
@@ -1056,6 +1237,8 @@ static void * FCamAppThread( void * ptr )
                     if ( !prevValue && prevValue ^ camera->m_currentState.preview.autoFocus != 0 )
                     {
                         tdata->previousState.preview.evaluated.focus = camera->m_currentState.preview.user.focus;
+                        // re-enabling auto-focus drops any touch region of interest
+                        camera->m_autoFocus->clearTarget();
                     }
                     else
                     {
@@ -1086,12 +1269,51 @@ static void * FCamAppThread( void * ptr )
                         camera->m_currentState.preview.user.wb = tdata->previousState.preview.evaluated.wb;
                     }
                     break;
+                case PARAM_PREVIEW_METERING_MODE:
+                    camera->m_currentState.preview.meteringMode = taskDataInt[0];
+                    break;
+                case PARAM_PREVIEW_HDR_FRAMES:
+                    camera->m_currentState.preview.hdrFrames = taskDataInt[0] < 2 ? 0 : std::min( taskDataInt[0], HDR_PREVIEW_MAX_FRAMES );
+                    break;
+                case PARAM_NIGHT_FRAMES:
+                    camera->m_currentState.nightFrames = std::min( std::max( taskDataInt[0], 1 ), NIGHT_MAX_FRAMES );
+                    break;
+                case PARAM_LUCKY_FRAMES:
+                    camera->m_currentState.luckyFrames = std::min( std::max( taskDataInt[0], 1 ), FCAM_MAX_PICTURES_PER_SHOT );
+                    break;
                 case PARAM_RESOLUTION:
                     break;
                 case PARAM_BURST_SIZE:
                     camera->m_currentState.pendingImagesCount = taskDataInt[0];
                     break;
                 case PARAM_OUTPUT_FORMAT:
+                    camera->m_currentState.outputFormat = taskDataInt[0];
+                    break;
+                case PARAM_TONE_MAP_OPERATOR:
+                    camera->m_currentState.toneMapOperator = taskDataInt[0];
+                    break;
+                case PARAM_ALIGN_FRAMES:
+                    camera->m_currentState.alignFrames = taskDataInt[0] != 0;
+                    break;
+                case PARAM_STEREO_DISPARITY_ON:
+                    camera->m_currentState.stereoDisparity = taskDataInt[0] != 0;
+                    break;
+                case PARAM_RESPONSE_CURVE:
+                    if ( writer == 0 )
+                    {
+                        ERROR( "PARAM_RESPONSE_CURVE: output directory has not been set!" );
+                    }
+                    else
+                    {
+                        writer->getCalibrationStore()->setResponseCurve( camera->m_currentMode, taskDataFloat[3 * RESPONSE_CURVE_SIZE],
+                                                                         taskDataFloat );
+                    }
+                    break;
+                case PARAM_RECALIBRATE:
+                    if ( writer != 0 )
+                    {
+                        writer->getCalibrationStore()->recalibrate( camera->m_currentMode );
+                    }
                     break;
                 case PARAM_VIEWER_ACTIVE:
                     tdata->isViewerActive = taskDataInt[0] != 0;
@@ -1119,11 +1341,12 @@ static void * FCamAppThread( void * ptr )
                         {
                             // capture begin
                             tdata->isCapturing = true;
+                            tdata->stopCapture = false;
 
                             // notify capture start
                             env->CallVoidMethod( tdata->fcamInstanceRef, tdata->notifyCaptureStart );
 
-                            camera->capture( writer );
+                            camera->capture( writer, &statsPool, &tdata->stopCapture );
 
                             // capture done
                             tdata->isCapturing = false;
@@ -1177,6 +1400,7 @@ static void * FCamAppThread( void * ptr )
                 case PARAM_WB_ON_TOUCH:
                     touchX = taskDataFloat[0] * camera->m_previewImage->width();
                     touchY = taskDataFloat[1] * camera->m_previewImage->height();
+                    zoneAutoExposure.setSpot( taskDataFloat[0], taskDataFloat[1] );
 
                     if ( task.getId() == PARAM_FOCUS_ON_TOUCH )
                     {
@@ -1203,16 +1427,12 @@ static void * FCamAppThread( void * ptr )
         shot.gain = camera->m_currentState.preview.autoGain ? tdata->previousState.preview.evaluated.gain : camera->m_currentState.preview.user.gain;
         shot.whiteBalance = camera->m_currentState.preview.autoWB ? tdata->previousState.preview.evaluated.wb : camera->m_currentState.preview.user.wb;
         shot.image = *( camera->m_previewImage );
-        shot.histogram.enabled = true;
-        shot.histogram.region = FCam::Rect( 0, 0, camera->width(), camera->height() );
+        // histograms are computed from the preview image by FrameStats
+        shot.histogram.enabled = false;
         shot.fastMode = true;
 
-        if ( !camera->m_autoFocus->idle() )
-        {
-            shot.sharpness.enabled = true;
-        }
-
-        if ( !camera->m_currentState.preview.autoFocus && tdata->previousState.preview.user.focus != camera->m_currentState.preview.user.focus )
+        bool focusChanged = !camera->m_currentState.preview.autoFocus && tdata->previousState.preview.user.focus != camera->m_currentState.preview.user.focus;
+        if ( focusChanged )
         {
             shot.clearActions();
             FCam::Lens::FocusAction focusAction( camera->m_lens );
@@ -1221,7 +1441,31 @@ static void * FCamAppThread( void * ptr )
             shot.addAction( focusAction );
         }
 
-        camera->m_sensor->stream( shot );
+        // the HDR preview exposure cycle is streamed again only if its base parameters change
+        // (streaming restarts the cycle)
+        int hdrFrames = camera->m_currentState.preview.hdrFrames;
+        if ( hdrFrames > 1 )
+        {
+            if ( hdrFrames != hdrStreamedFrames || shot.exposure != hdrStreamedExposure || shot.gain != hdrStreamedGain ||
+                 shot.whiteBalance != hdrStreamedWB || focusChanged || !camera->m_sensor->streaming() )
+            {
+                if ( hdrFrames != hdrStreamedFrames )
+                {
+                    hdrPreview.reset( hdrFrames );
+                }
+                HdrPreview::makeBurst( shot, hdrFrames, camera->m_sensor->maxGain(), camera->m_sensor->minExposure(), hdrBurst );
+                camera->m_sensor->stream( hdrBurst );
+                hdrStreamedFrames = hdrFrames;
+                hdrStreamedExposure = shot.exposure;
+                hdrStreamedGain = shot.gain;
+                hdrStreamedWB = shot.whiteBalance;
+            }
+        }
+        else
+        {
+            hdrStreamedFrames = 0;
+            camera->m_sensor->stream( shot );
+        }
 
         // update param estimates
         FCam::Frame frame = camera->m_sensor->getFrame();
@@ -1229,68 +1473,113 @@ static void * FCamAppThread( void * ptr )
         // clear any actions we have previously defined.
         shot.clearActions();
 
-        switch ( touchAction )
+        // HDR preview: statistics, 3A and the framebuffer use the fusion of the frame with the
+        // preceding frames of the exposure cycle
+        const uchar * previewData = ( uchar * ) frame.image()( 0, 0 );
+        if ( hdrFrames > 1 )
         {
-            case TOUCH_ACTION_FOCUS:
-                if ( camera->m_currentState.preview.autoFocus && camera->m_autoFocus->idle() )
-                {
-                    camera->m_autoFocus->startSweep();
-                }
-                break;
-            case TOUCH_ACTION_WHITE_BALANCE:
-                GetLocalColorTemparature( shot.whiteBalance, frame.image()( 0, 0 ), touchX, touchY,
-                                          frame.image().width(), frame.image().height() );
-                break;
+            hdrPreview.addFrame( previewData, frame.image().width(), frame.image().height(), ( float ) frame.exposure(), frame.gain() );
+            previewData = hdrPreview.fuse( &statsPool );
         }
 
-        if ( camera->m_currentState.preview.autoExposure || camera->m_currentState.preview.autoGain )
-        {
-            FCam::autoExpose( &shot, frame, camera->m_sensor->maxGain(), camera->m_sensor->maxExposure(),
-                              camera->m_sensor->minExposure(), 0.3 );
-            camera->m_currentState.preview.evaluated.exposure = shot.exposure;
-            camera->m_currentState.preview.evaluated.gain = shot.gain;
-        }
+        // statistics and 3A evaluation are skipped (cached results are kept) while the scene is stable
+        // and all controllers have settled
+        bool evaluate3A = sceneChangeDetector.update( previewData, frame.image().width(), frame.image().height() ) ||
+                          touchAction != TOUCH_ACTION_NONE || !camera->m_autoFocus->idle() ||
+                          (( camera->m_currentState.preview.autoExposure || camera->m_currentState.preview.autoGain ) && !zoneAutoExposure.converged() ) ||
+                          ( camera->m_currentState.preview.autoWB && !zoneAutoWhiteBalance.converged() );
 
-        if ( camera->m_currentState.preview.autoWB )
+        if ( evaluate3A )
         {
-            FCam::autoWhiteBalance( &shot, frame );
-            camera->m_currentState.preview.evaluated.wb = shot.whiteBalance;
-        }
+            sceneChangeDetector.accept();
 
-        if ( !camera->m_autoFocus->idle() )
-        {
-            camera->m_autoFocus->update( frame, &shot );
-            camera->m_currentState.preview.evaluated.focus = frame["lens.focus"];
-        }
+            // update frame statistics (histograms, zones, sharpness) in a single pass
+#ifdef MEASURE_STATS_TIME
+            timer.tic();
+#endif
+            frameStats.compute( previewData, frame.image().width(), frame.image().height(),
+                                STATS_SAMPLING_STEP, &statsPool );
+            frameStats.normalizeLuma( camera->m_currentState.preview.histogramData );
+            frameStats.normalizeRGB( camera->m_currentState.preview.rgbHistogramData );
+#ifdef MEASURE_STATS_TIME
+            statsTime.update( timer.toc() );
+#endif
 
-        // update histogram data
-        const FCam::Histogram & histogram = frame.histogram();
+            // summed-area tables are built at most once per frame, and only if a patch query needs them
+            if ( touchAction == TOUCH_ACTION_WHITE_BALANCE )
+            {
+                frameIntegral.compute( previewData, frame.image().width(), frame.image().height(), false, &statsPool );
+            }
 
-        int maxBinValue = 1;
-        for ( int i = 0; i < 64; i++ )
-        {
-            int currBinValue = histogram( i );
-            if ( currBinValue > maxBinValue )
+            switch ( touchAction )
             {
-                maxBinValue = currBinValue;
+                case TOUCH_ACTION_FOCUS:
+                    if ( camera->m_currentState.preview.autoFocus && camera->m_autoFocus->idle() )
+                    {
+                        if ( touchX < 0 || touchY < 0 || touchX >= camera->m_previewImage->width() || touchY >= camera->m_previewImage->height() )
+                        {
+                            // a touch outside the preview frame resets the region to the frame center
+                            camera->m_autoFocus->clearTarget();
+                        }
+                        else
+                        {
+                            camera->m_autoFocus->setTarget( touchX, touchY );
+                        }
+                        camera->m_autoFocus->startSweep();
+                    }
+                    break;
+                case TOUCH_ACTION_WHITE_BALANCE:
+                    shot.whiteBalance = GetLocalColorTemparature( frame.whiteBalance(), frameIntegral, touchX, touchY );
+                    camera->m_currentState.preview.user.wb = shot.whiteBalance;
+                    camera->m_currentState.preview.evaluated.wb = shot.whiteBalance;
+                    zoneAutoWhiteBalance.reset( shot.whiteBalance );
+                    break;
+            }
+
+            if ( camera->m_currentState.preview.autoExposure || camera->m_currentState.preview.autoGain )
+            {
+                zoneAutoExposure.setMode(( ZoneAutoExposure::EMeteringMode ) camera->m_currentState.preview.meteringMode );
+                if ( hdrFrames > 1 )
+                {
+                    float exposure, gain;
+                    hdrPreview.getReference( exposure, gain );
+                    zoneAutoExposure.update( &shot, exposure, gain, frameStats, camera->m_sensor->maxGain(),
+                                             camera->m_sensor->maxExposure(), camera->m_sensor->minExposure() );
+                }
+                else
+                {
+                    zoneAutoExposure.update( &shot, frame, frameStats, camera->m_sensor->maxGain(),
+                                             camera->m_sensor->maxExposure(), camera->m_sensor->minExposure() );
+                }
+                camera->m_currentState.preview.evaluated.exposure = shot.exposure;
+                camera->m_currentState.preview.evaluated.gain = shot.gain;
+            }
+
+            if ( camera->m_currentState.preview.autoWB )
+            {
+                zoneAutoWhiteBalance.update( &shot, frame, frameStats );
+                camera->m_currentState.preview.evaluated.wb = shot.whiteBalance;
+            }
+
+            if ( !camera->m_autoFocus->idle() )
+            {
+                camera->m_autoFocus->update( frame, frameStats );
+                camera->m_currentState.preview.evaluated.focus = frame["lens.focus"];
             }
-            camera->m_currentState.preview.histogramData[i * 4] = currBinValue;
         }
 
-        float norm = 1.0f / maxBinValue;
-        for ( int i = 0; i < 64; i++ )
+        // stereo disparity map of every preview frame (not cached like the 3A statistics, depth
+        // changes without the scene change detector noticing)
+        if ( camera->m_currentMode == Camera::Stereo && camera->m_currentState.stereoDisparity )
         {
-            camera->m_currentState.preview.histogramData[i * 4] *= norm;
-            camera->m_currentState.preview.histogramData[i * 4 + 1] = 0.0f;
-            camera->m_currentState.preview.histogramData[i * 4 + 2] = 0.0f;
-            camera->m_currentState.preview.histogramData[i * 4 + 3] = 0.0f;
+            tdata->stereoDisparity->compute( frame.image()( 0, 0 ), frame.image().width(), frame.image().height(), &statsPool );
         }
 
         // update framebuffer
 #ifdef USE_GL_TEXTURE_UPLOAD
         if ( tdata->frameDataYUV != 0 )
         {
-            memcpy( tdata->frameDataYUV, frame.image()( 0, 0 ), camera->width() * camera->height() * 3 / 2 );
+            memcpy( tdata->frameDataYUV, previewData, camera->width() * camera->height() * 3 / 2 );
         }
 #else
         pthread_mutex_lock( &tdata->renderingThreadLock );
@@ -1299,7 +1588,7 @@ static void * FCamAppThread( void * ptr )
             FCam::Image image = frame.image();
             if ( tdata->previewBuffer->width() == image.width() && tdata->previewBuffer->height() == image.height() )
             {
-                uchar * src = ( uchar * )image( 0, 0 );
+                const uchar * src = previewData;
                 FCam::Tegra::Hal::SharedBuffer * captureBuffer = tdata->previewBuffer->getBackBuffer();
                 uchar * dest = ( uchar * )captureBuffer->lock();
 
@@ -1317,6 +1606,7 @@ static void * FCamAppThread( void * ptr )
 #endif
 
         // frame capture complete, copy current shot data to previous one
+        camera->m_currentState.calibratedGains = writer != 0 ? writer->getCalibrationStore()->getCalibratedGains( camera->m_currentMode ) : 0;
         pthread_mutex_lock( &tdata->previousStateLock );
         memcpy( &tdata->previousState, &camera->m_currentState, sizeof( Camera::CaptureState ) );
         pthread_mutex_unlock( &tdata->previousStateLock );
@@ -1334,8 +1624,15 @@ static void * FCamAppThread( void * ptr )
             fpsUpdateTime = time;
             frameCount = 0;
             tdata->captureFps = fps;
+            tdata->skipRatio3A = sceneChangeDetector.getSkipRatio();
+            sceneChangeDetector.resetCounters();
 #ifdef MEASURE_JITTER
             LOG( "fps: %.3f jitter mean: %.3f jitter std: %.3f", fps, stat.getMean(), stat.getStdDev() );
+#endif
+#ifdef MEASURE_STATS_TIME
+            LOG( "fps: %.3f stats time mean: %.3f std: %.3f (ms) ae convergence: %i frames 3a skip ratio: %.2f", fps, statsTime.getMean(),
+                 statsTime.getStdDev(), zoneAutoExposure.getConvergenceFrames(), sceneChangeDetector.getSkipRatio() );
+            statsTime.reset();
 #endif
         }
 
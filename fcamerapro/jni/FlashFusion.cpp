@@ -0,0 +1,351 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "FlashFusion.h"
+#include "HPT.h"
+
+/**
+ * Nearest grid coordinate (without the border) of a sample position.
+ */
+static inline int GridIndex( float position, float invStep )
+{
+    return (int) ( position * invStep + 0.5f );
+}
+
+FlashFusion::FlashFusion( void ) : m_ambient( 0 ), m_flash( 0 ), m_yuv( 0 ), m_width( 0 ), m_height( 0 ), m_pool( 0 ),
+    m_taskCount( 1 ), m_spatialStep( FLASH_MIN_SPATIAL_SIGMA ), m_gridWidth( 0 ), m_gridHeight( 0 ), m_gridDepth( 0 ),
+    m_axis( 0 )
+{
+}
+
+void FlashFusion::fuse( const uchar * ambient, const uchar * flash, int width, int height, uchar * yuv, ThreadPool * pool )
+{
+    Timer timer;
+
+    m_ambient = ambient;
+    m_flash = flash;
+    m_yuv = yuv;
+    m_width = width;
+    m_height = height;
+    m_pool = pool;
+
+    int halfWidth = width >> 1;
+    int halfHeight = height >> 1;
+    m_spatialStep = std::max( FLASH_MIN_SPATIAL_SIGMA, (int) ( FLASH_SPATIAL_SIGMA * std::max( halfWidth, halfHeight ) + 0.5f ) );
+    m_gridWidth = ( halfWidth - 1 ) / m_spatialStep + 2 + 2 * FLASH_GRID_PAD;
+    m_gridHeight = ( halfHeight - 1 ) / m_spatialStep + 2 + 2 * FLASH_GRID_PAD;
+    m_gridDepth = (int) ( 255.0f / FLASH_RANGE_SIGMA ) + 2 + 2 * FLASH_GRID_PAD;
+
+    // splatting splits the grid rows, so there can be no more tasks than rows
+    int gridRows = m_gridHeight - 2 * FLASH_GRID_PAD;
+    m_taskCount = std::min( pool != 0 ? pool->concurrency() : 1, gridRows );
+
+    int gridSize = EChannelCount * m_gridWidth * m_gridHeight * m_gridDepth;
+    m_grid.assign( gridSize, 0.0f );
+    m_temp.resize( gridSize );
+
+    run( FlashFusion::SplatProc );
+
+    // separable [1 4 6 4 1] / 16 blur along x, y and z
+    for ( m_axis = 0; m_axis < 3; m_axis++ )
+    {
+        run( FlashFusion::BlurProc );
+        m_grid.swap( m_temp );
+    }
+
+    m_taskCount = std::min( pool != 0 ? pool->concurrency() : 1, std::max( halfHeight, 1 ) );
+    run( FlashFusion::SliceProc );
+
+    std::vector<float>().swap( m_grid );
+    std::vector<float>().swap( m_temp );
+
+    double elapsed = timer.get();
+    LOG( "FlashFusion: %dx%d, %dx%dx%d grid in %.1f ms (%.1f ms/MPix)\n", width, height, m_gridWidth, m_gridHeight,
+         m_gridDepth, elapsed, elapsed * 1e6 / ( (double) width * height ) );
+}
+
+void FlashFusion::run( THREAD_POOL_TASK task )
+{
+    if ( m_pool != 0 )
+    {
+        m_pool->run( task, this, m_taskCount );
+    }
+    else
+    {
+        for ( int i = 0; i < m_taskCount; i++ )
+        {
+            task( this, i );
+        }
+    }
+}
+
+void FlashFusion::SplatProc( void * opaque, int index )
+{
+    FlashFusion * instance = (FlashFusion *) opaque;
+    const int width = instance->m_width;
+    const int height = instance->m_height;
+    const int halfWidth = width >> 1;
+    const int halfHeight = height >> 1;
+    const int step = instance->m_spatialStep;
+    const int gw = instance->m_gridWidth;
+    const int gh = instance->m_gridHeight;
+    const float invSpatial = 1.0f / step;
+    const float invRange = 1.0f / FLASH_RANGE_SIGMA;
+
+    // grid rows [rowBegin, rowEnd) belong to this task, no other task writes them
+    int gridRows = gh - 2 * FLASH_GRID_PAD;
+    int rowBegin = index * gridRows / instance->m_taskCount;
+    int rowEnd = ( index + 1 ) * gridRows / instance->m_taskCount;
+    int yBegin = std::max( ( rowBegin - 1 ) * step, 0 );
+    int yEnd = std::min( ( rowEnd + 1 ) * step, halfHeight );
+
+    const uchar * ambientCb = instance->m_ambient + width * height;
+    const uchar * ambientCr = ambientCb + halfWidth * halfHeight;
+    float * grid = &instance->m_grid[0];
+
+    for ( int y = yBegin; y < yEnd; y++ )
+    {
+        int gy = GridIndex( (float) y, invSpatial );
+        if ( gy < rowBegin || gy >= rowEnd )
+        {
+            continue;
+        }
+        gy += FLASH_GRID_PAD;
+
+        const uchar * a0 = instance->m_ambient + 2 * y * width;
+        const uchar * a1 = a0 + width;
+        const uchar * f0 = instance->m_flash + 2 * y * width;
+        const uchar * f1 = f0 + width;
+        const uchar * cb = ambientCb + y * halfWidth;
+        const uchar * cr = ambientCr + y * halfWidth;
+
+        for ( int x = 0; x < halfWidth; x++ )
+        {
+            float ay = 0.25f * ( a0[2 * x] + a0[2 * x + 1] + a1[2 * x] + a1[2 * x + 1] );
+            float fy = 0.25f * ( f0[2 * x] + f0[2 * x + 1] + f1[2 * x] + f1[2 * x + 1] );
+
+            int gx = GridIndex( (float) x, invSpatial ) + FLASH_GRID_PAD;
+            int gz = GridIndex( fy, invRange ) + FLASH_GRID_PAD;
+            float * cell = grid + EChannelCount * ( ( gz * gh + gy ) * gw + gx );
+            cell[EChannelAmbientY] += ay;
+            cell[EChannelAmbientCb] += cb[x];
+            cell[EChannelAmbientCr] += cr[x];
+            cell[EChannelFlashY] += fy;
+            cell[EChannelWeight] += 1.0f;
+        }
+    }
+}
+
+void FlashFusion::BlurProc( void * opaque, int index )
+{
+    static const float kernel[5] = { 1.0f / 16, 4.0f / 16, 6.0f / 16, 4.0f / 16, 1.0f / 16 };
+
+    FlashFusion * instance = (FlashFusion *) opaque;
+    const int axis = instance->m_axis;
+    const int gw = instance->m_gridWidth;
+    const int gh = instance->m_gridHeight;
+    const int rowLength = EChannelCount * gw;
+
+    // the grid is processed in contiguous rows of cells, y and z blurs
+    // combine whole rows so the inner loops run over consecutive floats
+    int rowCount = gh * instance->m_gridDepth;
+    int begin = index * rowCount / instance->m_taskCount;
+    int end = ( index + 1 ) * rowCount / instance->m_taskCount;
+
+    for ( int row = begin; row < end; row++ )
+    {
+        const float * src = &instance->m_grid[row * rowLength];
+        float * dst = &instance->m_temp[row * rowLength];
+
+        if ( axis == 0 )
+        {
+            for ( int x = 0; x < gw; x++ )
+            {
+                float sum[EChannelCount] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+                int k0 = std::max( -2, -x );
+                int k1 = std::min( 2, gw - 1 - x );
+
+                for ( int k = k0; k <= k1; k++ )
+                {
+                    const float * cell = src + ( x + k ) * EChannelCount;
+                    for ( int c = 0; c < EChannelCount; c++ )
+                    {
+                        sum[c] += kernel[k + 2] * cell[c];
+                    }
+                }
+
+                for ( int c = 0; c < EChannelCount; c++ )
+                {
+                    dst[x * EChannelCount + c] = sum[c];
+                }
+            }
+            continue;
+        }
+
+        int pos = axis == 1 ? row % gh : row / gh;
+        int size = axis == 1 ? gh : instance->m_gridDepth;
+        int step = axis == 1 ? rowLength : rowLength * gh;
+        int k0 = std::max( -2, -pos );
+        int k1 = std::min( 2, size - 1 - pos );
+
+        for ( int i = 0; i < rowLength; i++ )
+        {
+            dst[i] = 0.0f;
+        }
+        for ( int k = k0; k <= k1; k++ )
+        {
+            const float * neighbor = src + k * step;
+            const float weight = kernel[k + 2];
+            for ( int i = 0; i < rowLength; i++ )
+            {
+                dst[i] += weight * neighbor[i];
+            }
+        }
+    }
+}
+
+template <int CHANNELS> void FlashFusion::sample( float x, float y, float z, float * values ) const
+{
+    const int gw = m_gridWidth;
+    const int gh = m_gridHeight;
+    const float invSpatial = 1.0f / m_spatialStep;
+
+    float fx = x * invSpatial + FLASH_GRID_PAD;
+    float fy = y * invSpatial + FLASH_GRID_PAD;
+    float fz = z * ( 1.0f / FLASH_RANGE_SIGMA ) + FLASH_GRID_PAD;
+    int x0 = (int) fx, y0 = (int) fy, z0 = (int) fz;
+    float tx = fx - x0, ty = fy - y0, tz = fz - z0;
+
+    const float * base = &m_grid[EChannelCount * ( ( z0 * gh + y0 ) * gw + x0 )];
+    const int dx = EChannelCount;
+    const int dy = EChannelCount * gw;
+    const int dz = EChannelCount * gw * gh;
+    const float w[8] =
+    {
+        ( 1 - tx ) * ( 1 - ty ) * ( 1 - tz ), tx * ( 1 - ty ) * ( 1 - tz ),
+        ( 1 - tx ) * ty * ( 1 - tz ), tx * ty * ( 1 - tz ),
+        ( 1 - tx ) * ( 1 - ty ) * tz, tx * ( 1 - ty ) * tz,
+        ( 1 - tx ) * ty * tz, tx * ty * tz
+    };
+    const int offset[8] = { 0, dx, dy, dx + dy, dz, dz + dx, dz + dy, dz + dx + dy };
+
+    for ( int c = 0; c < CHANNELS; c++ )
+    {
+        values[c] = 0.0f;
+    }
+    for ( int k = 0; k < 8; k++ )
+    {
+        const float * cell = base + offset[k];
+        for ( int c = 0; c < CHANNELS; c++ )
+        {
+            values[c] += w[k] * cell[c];
+        }
+    }
+}
+
+void FlashFusion::SliceProc( void * opaque, int index )
+{
+    FlashFusion * instance = (FlashFusion *) opaque;
+    const int width = instance->m_width;
+    const int height = instance->m_height;
+    const int halfWidth = width >> 1;
+    const int halfHeight = height >> 1;
+    const float specularRange = 255.0f - FLASH_SPECULAR_LEVEL;
+
+    int yBegin = index * halfHeight / instance->m_taskCount;
+    int yEnd = ( index + 1 ) * halfHeight / instance->m_taskCount;
+    const uchar * ambientCb = instance->m_ambient + width * height;
+    const uchar * ambientCr = ambientCb + halfWidth * halfHeight;
+    uchar * outCb = instance->m_yuv + width * height;
+    uchar * outCr = outCb + halfWidth * halfHeight;
+    float values[EChannelCount];
+
+    for ( int y = yBegin; y < yEnd; y++ )
+    {
+        // luma: denoised ambient times the flash detail, the half resolution
+        // grid is sampled at the full resolution pixel centers
+        for ( int row = 2 * y; row < 2 * y + 2; row++ )
+        {
+            const uchar * a = instance->m_ambient + row * width;
+            const uchar * f = instance->m_flash + row * width;
+            uchar * out = instance->m_yuv + row * width;
+            float gy = std::min( std::max( ( row - 0.5f ) * 0.5f, 0.0f ), halfHeight - 1.0f );
+
+            for ( int x = 0; x < width; x++ )
+            {
+                float gx = std::min( std::max( ( x - 0.5f ) * 0.5f, 0.0f ), halfWidth - 1.0f );
+                instance->sample<EChannelAmbientCb>( gx, gy, f[x], values );
+
+                float weight = values[EChannelWeight];
+                if ( weight < 1e-3f )
+                {
+                    out[x] = a[x];
+                    continue;
+                }
+
+                float ambientBase = values[EChannelAmbientY] / weight;
+                float flashBase = values[EChannelFlashY] / weight;
+                float detail = ( f[x] + FLASH_DETAIL_EPSILON ) / ( flashBase + FLASH_DETAIL_EPSILON );
+
+                // no detail transfer in flash shadows and specularities
+                float mask = ( flashBase - ambientBase - FLASH_SHADOW_THRESHOLD ) / FLASH_SHADOW_THRESHOLD;
+                mask = std::min( std::max( mask, 0.0f ), 1.0f );
+                mask *= std::min( std::max( ( 255.0f - f[x] ) / specularRange, 0.0f ), 1.0f );
+
+                float v = ambientBase * ( 1.0f + mask * ( detail - 1.0f ) );
+                out[x] = (uchar) std::min( std::max( v + 0.5f, 0.0f ), 255.0f );
+            }
+        }
+
+        // chroma: joint bilateral filtered ambient chroma
+        const uchar * f0 = instance->m_flash + 2 * y * width;
+        const uchar * f1 = f0 + width;
+        const uchar * cb = ambientCb + y * halfWidth;
+        const uchar * cr = ambientCr + y * halfWidth;
+        uchar * ocb = outCb + y * halfWidth;
+        uchar * ocr = outCr + y * halfWidth;
+
+        for ( int x = 0; x < halfWidth; x++ )
+        {
+            float fy = 0.25f * ( f0[2 * x] + f0[2 * x + 1] + f1[2 * x] + f1[2 * x + 1] );
+            instance->sample<EChannelCount>( (float) x, (float) y, fy, values );
+
+            float weight = values[EChannelWeight];
+            if ( weight < 1e-3f )
+            {
+                ocb[x] = cb[x];
+                ocr[x] = cr[x];
+                continue;
+            }
+
+            ocb[x] = (uchar) std::min( std::max( values[EChannelAmbientCb] / weight + 0.5f, 0.0f ), 255.0f );
+            ocr[x] = (uchar) std::min( std::max( values[EChannelAmbientCr] / weight + 0.5f, 0.0f ), 255.0f );
+        }
+    }
+}
@@ -0,0 +1,135 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _FLASH_FUSION_H
+#define _FLASH_FUSION_H
+
+/**
+ * @file
+ * Definition of FlashFusion.
+ */
+
+#include <vector>
+#include "Common.h"
+#include "ThreadPool.h"
+
+#define FLASH_SPATIAL_SIGMA     0.004f /**< Grid spatial sampling (fraction of the larger half resolution dimension) */
+#define FLASH_MIN_SPATIAL_SIGMA 4      /**< Minimum grid spatial sampling in half resolution pixels */
+#define FLASH_RANGE_SIGMA       20.0f  /**< Grid range sampling in flash luma units */
+#define FLASH_GRID_PAD          2      /**< Grid border (blur kernel radius) */
+#define FLASH_DETAIL_EPSILON    4.0f   /**< Detail layer ratio offset (luma units), limits noise amplification in dark areas */
+#define FLASH_SHADOW_THRESHOLD  8.0f   /**< Minimum flash contribution (luma units) for detail transfer, flash shadows get none */
+#define FLASH_SPECULAR_LEVEL    245.0f /**< Flash luma above which detail transfer fades out (specularities, clipping) */
+
+/**
+ * Flash/no-flash fusion (Petschnigg et al. 2004, Eisemann and Durand 2004).
+ * Combines the ambient lighting of a no-flash frame with the low noise detail
+ * of a flash frame taken right after it with the same exposure settings:
+ * - the ambient frame is denoised by a joint (cross) bilateral filter whose
+ *   range weights come from the flash frame luma, so edges of the flash frame
+ *   are kept while the ambient noise is smoothed;
+ * - the flash frame detail is its luma divided by its bilateral filtered
+ *   version and multiplies the denoised ambient luma;
+ * - detail is not transferred in flash shadows (flash adds less than
+ *   FLASH_SHADOW_THRESHOLD over ambient) and specularities.
+ *
+ * Both filters share one bilateral grid (Chen et al. 2007) built from the
+ * half resolution frames (chroma resolution): each cell accumulates the
+ * ambient Y, Cb, Cr, the flash Y and the weight. Splatting runs in bands of
+ * grid rows, so threads write to disjoint cells; blurring and slicing are
+ * split over the thread pool as well.
+ */
+class FlashFusion
+{
+public:
+    /**
+     * Default constructor.
+     */
+    FlashFusion( void );
+
+    /**
+     * Fuses a flash/no-flash pair.
+     * @param ambient YUV420p no-flash frame
+     * @param flash YUV420p flash frame
+     * @param width frame width in pixels (even)
+     * @param height frame height in pixels (even)
+     * @param yuv receives the fused YUV420p frame
+     * @param pool thread pool (can be 0)
+     */
+    void fuse( const uchar * ambient, const uchar * flash, int width, int height, uchar * yuv, ThreadPool * pool );
+
+private:
+    enum EChannel
+    {
+        EChannelAmbientY, EChannelFlashY, EChannelWeight, EChannelAmbientCb, EChannelAmbientCr, EChannelCount
+    };
+
+    /**
+     * Splats the half resolution pixels whose nearest grid row is in the task's range.
+     */
+    static void SplatProc( void * opaque, int index );
+
+    /**
+     * Blurs a range of grid rows along the current axis.
+     */
+    static void BlurProc( void * opaque, int index );
+
+    /**
+     * Slices the grid for a band of rows and writes the fused output.
+     */
+    static void SliceProc( void * opaque, int index );
+
+    /**
+     * Trilinear interpolation of the grid.
+     * @param x half resolution column
+     * @param y half resolution row
+     * @param z flash luma
+     * @param values receives the first CHANNELS channels (luma only needs
+     * the first three)
+     */
+    template <int CHANNELS> void sample( float x, float y, float z, float * values ) const;
+
+    /**
+     * Runs a task on the pool (or the calling thread).
+     */
+    void run( THREAD_POOL_TASK task );
+
+    // state of the fusion in progress
+    const uchar * m_ambient; /**< No-flash frame */
+    const uchar * m_flash; /**< Flash frame */
+    uchar * m_yuv; /**< Output frame */
+    int m_width, m_height; /**< Frame size */
+    ThreadPool * m_pool; /**< Thread pool (can be 0) */
+    int m_taskCount; /**< Number of tasks per operation */
+
+    int m_spatialStep; /**< Grid spatial sampling in half resolution pixels */
+    int m_gridWidth, m_gridHeight, m_gridDepth; /**< Grid size */
+    std::vector<float> m_grid; /**< Bilateral grid, EChannelCount values per cell */
+    std::vector<float> m_temp; /**< Blur destination */
+    int m_axis; /**< Current blur axis */
+};
+
+#endif
@@ -0,0 +1,155 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of FocusSearch.
+ */
+
+#include <math.h>
+#include "FocusSearch.h"
+
+FocusSearch::FocusSearch( void )
+{
+    m_probe = 0.0f;
+    m_level = 0;
+    m_result = 0.0f;
+    m_done = true;
+}
+
+void FocusSearch::start( float nearFocus, float farFocus, float currentFocus )
+{
+    m_samples.clear();
+    m_pending.clear();
+    m_level = 0;
+    m_done = false;
+
+    // coarse sweep, starting from the end closer to the current lens position;
+    // probes are taken from the back, so that end is pushed last
+    bool nearFirst = fabsf( currentFocus - nearFocus ) < fabsf( currentFocus - farFocus );
+    for ( int i = 0; i < FOCUS_SEARCH_COARSE_STEPS; i++ )
+    {
+        float t = ( float ) i / ( FOCUS_SEARCH_COARSE_STEPS - 1 );
+        m_pending.push_back( nearFirst ? farFocus + ( nearFocus - farFocus ) * t : nearFocus + ( farFocus - nearFocus ) * t );
+    }
+
+    m_result = currentFocus;
+}
+
+bool FocusSearch::next( float & position )
+{
+    if ( m_done )
+    {
+        return false;
+    }
+
+    position = m_probe = m_pending.back();
+    return true;
+}
+
+void FocusSearch::report( float sharpness )
+{
+    if ( m_done )
+    {
+        return;
+    }
+
+    m_pending.pop_back();
+
+    // insert sorted by position
+    Sample sample = { m_probe, sharpness };
+    std::vector<Sample>::iterator it = m_samples.begin();
+    while ( it != m_samples.end() && it->position < m_probe )
+    {
+        ++it;
+    }
+    m_samples.insert( it, sample );
+
+    if ( m_pending.empty() )
+    {
+        plan();
+    }
+}
+
+int FocusSearch::getPeakIndex( void ) const
+{
+    int peak = 0;
+    for ( int i = 1; i < ( int ) m_samples.size(); i++ )
+    {
+        if ( m_samples[i].sharpness > m_samples[peak].sharpness )
+        {
+            peak = i;
+        }
+    }
+    return peak;
+}
+
+void FocusSearch::plan( void )
+{
+    const int peak = getPeakIndex();
+    const int count = ( int ) m_samples.size();
+
+    if ( m_level < FOCUS_SEARCH_REFINE_LEVELS )
+    {
+        // probe midpoints between the peak and its neighbours
+        m_level++;
+        if ( peak > 0 )
+        {
+            m_pending.push_back( 0.5f * ( m_samples[peak - 1].position + m_samples[peak].position ) );
+        }
+        if ( peak < count - 1 )
+        {
+            m_pending.push_back( 0.5f * ( m_samples[peak].position + m_samples[peak + 1].position ) );
+        }
+
+        if ( !m_pending.empty() )
+        {
+            return;
+        }
+    }
+
+    // parabolic fit through the peak and its neighbours
+    m_result = m_samples[peak].position;
+    if ( peak > 0 && peak < count - 1 )
+    {
+        float x0 = m_samples[peak - 1].position, f0 = m_samples[peak - 1].sharpness;
+        float x1 = m_samples[peak].position, f1 = m_samples[peak].sharpness;
+        float x2 = m_samples[peak + 1].position, f2 = m_samples[peak + 1].sharpness;
+
+        float d0 = x1 - x0, d2 = x1 - x2;
+        float den = d0 * ( f1 - f2 ) - d2 * ( f1 - f0 );
+        if ( den != 0.0f )
+        {
+            float vertex = x1 - 0.5f * ( d0 * d0 * ( f1 - f2 ) - d2 * d2 * ( f1 - f0 ) ) / den;
+            if ( vertex > x0 && vertex < x2 )
+            {
+                m_result = vertex;
+            }
+        }
+    }
+
+    m_done = true;
+}
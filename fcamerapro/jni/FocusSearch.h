@@ -0,0 +1,126 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _FOCUSSEARCH_H
+#define _FOCUSSEARCH_H
+
+/**
+ * @file
+ * Definition of FocusSearch.
+ */
+
+#include <vector>
+
+#define FOCUS_SEARCH_COARSE_STEPS    7   /**< Number of lens positions probed by the coarse sweep */
+#define FOCUS_SEARCH_REFINE_LEVELS   2   /**< Number of refinement levels around the coarse peak */
+
+/**
+ * Coarse-to-fine search for the lens position that maximizes a sharpness measure.
+ * The search probes a coarse set of positions across the whole focus range, then
+ * repeatedly probes the midpoints between the best position and its neighbours and
+ * finally fits a parabola through the best sample and its neighbours. The class does
+ * not depend on FCam, it only proposes positions and receives sharpness measurements.
+ */
+class FocusSearch
+{
+public:
+    FocusSearch( void );
+
+    /**
+     * Starts a new search.
+     * @param nearFocus nearest focus position (dioptres)
+     * @param farFocus farthest focus position (dioptres)
+     * @param currentFocus current lens position, the coarse sweep starts from the nearer end
+     */
+    void start( float nearFocus, float farFocus, float currentFocus );
+
+    /**
+     * Gets the next lens position to be measured.
+     * @param position next lens position (dioptres)
+     * @return false if the search is finished
+     */
+    bool next( float & position );
+
+    /**
+     * Records the sharpness measured at the position returned by last next() call.
+     * @param sharpness sharpness value (larger is sharper)
+     */
+    void report( float sharpness );
+
+    /**
+     * Returns true if the search is finished.
+     */
+    bool done( void ) const
+    {
+        return m_done;
+    }
+
+    /**
+     * Gets the estimated peak position. Valid when done() returns true.
+     * @return lens position (dioptres)
+     */
+    float result( void ) const
+    {
+        return m_result;
+    }
+
+    /**
+     * Gets the number of positions measured by the current search.
+     */
+    int probeCount( void ) const
+    {
+        return ( int ) m_samples.size();
+    }
+
+private:
+    /**
+     * Lens position and its measured sharpness.
+     */
+    struct Sample
+    {
+        float position;
+        float sharpness;
+    };
+
+    /**
+     * Queues probes for the next search level, or finishes the search.
+     */
+    void plan( void );
+
+    /**
+     * Gets index of the sharpest sample (samples are sorted by position).
+     */
+    int getPeakIndex( void ) const;
+
+    std::vector<Sample> m_samples; /**< Measured samples sorted by position */
+    std::vector<float> m_pending; /**< Positions queued for the current level */
+    float m_probe; /**< Position returned by last next() call */
+    int m_level; /**< Current refinement level (0 - coarse sweep) */
+    float m_result; /**< Estimated peak position */
+    bool m_done;
+};
+
+#endif
@@ -0,0 +1,354 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "FocusStack.h"
+#include "ThreadPool.h"
+#include "HPT.h"
+
+#define FOCUS_STACK_MIN_WEIGHT 1e-4f /**< Selection weight below which a frame is skipped in a tile */
+
+/**
+ * Maps a plane pixel coordinate to a map coordinate (block centers are at
+ * luma 1 + FOCUS_STACK_BLOCK * b + FOCUS_STACK_BLOCK / 2 - 0.5).
+ * @param position plane pixel coordinate
+ * @param scale plane to luma pixel scale
+ * @param size map size in blocks
+ * @param index receives the left (top) map sample
+ * @param next receives the right (bottom) map sample
+ * @return interpolation factor of the next sample
+ */
+static inline float GetMapPosition( int position, int scale, int size, int & index, int & next )
+{
+    float luma = scale * position + 0.5f * ( scale - 1 );
+    float f = ( luma - 0.5f - 0.5f * FOCUS_STACK_BLOCK ) * ( 1.0f / FOCUS_STACK_BLOCK );
+    f = std::min( std::max( f, 0.0f ), size - 1.0f );
+    index = (int) f;
+    next = std::min( index + 1, size - 1 );
+    return f - index;
+}
+
+FocusStack::FocusStack( void ) : m_frames( 0 ), m_frameCount( 0 ), m_width( 0 ), m_height( 0 ), m_yuv( 0 ),
+    m_mapWidth( 0 ), m_mapHeight( 0 ), m_tilesX( 0 ), m_tilesY( 0 )
+{
+}
+
+void FocusStack::stack( const uchar * const * frames, int frameCount, int width, int height, uchar * yuv, ThreadPool * pool )
+{
+    if ( frameCount < 1 )
+    {
+        return;
+    }
+
+    Timer timer;
+
+    m_frames = frames;
+    m_frameCount = frameCount;
+    m_width = width;
+    m_height = height;
+    m_yuv = yuv;
+
+    // blocks keep one pixel away from the frame border (Laplacian support)
+    m_mapWidth = ( width - 2 ) / FOCUS_STACK_BLOCK;
+    m_mapHeight = ( height - 2 ) / FOCUS_STACK_BLOCK;
+    const int mapSize = m_mapWidth * m_mapHeight;
+
+    // sharpness maps
+    m_energy.resize( frameCount * mapSize );
+    if ( pool != 0 )
+    {
+        pool->run( FocusStack::EnergyProc, this, m_mapHeight );
+    }
+    else
+    {
+        for ( int i = 0; i < m_mapHeight; i++ )
+        {
+            EnergyProc( this, i );
+        }
+    }
+
+    for ( int i = 0; i < frameCount; i++ )
+    {
+        boxFilter( &m_energy[i * mapSize], FOCUS_STACK_ENERGY_RADIUS );
+    }
+
+    // depth map: sharpest frame per block
+    std::vector<uchar> depth( mapSize );
+    for ( int i = 0; i < mapSize; i++ )
+    {
+        int best = 0;
+        for ( int j = 1; j < frameCount; j++ )
+        {
+            if ( m_energy[j * mapSize + i] > m_energy[best * mapSize + i] )
+            {
+                best = j;
+            }
+        }
+        depth[i] = (uchar) best;
+    }
+    std::vector<float>().swap( m_energy );
+
+    // 3x3 median removes isolated wrong picks (noise in flat areas)
+    m_depth.resize( mapSize );
+    for ( int y = 0; y < m_mapHeight; y++ )
+    {
+        for ( int x = 0; x < m_mapWidth; x++ )
+        {
+            uchar window[9];
+            int count = 0;
+            for ( int j = std::max( y - 1, 0 ); j <= std::min( y + 1, m_mapHeight - 1 ); j++ )
+            {
+                for ( int i = std::max( x - 1, 0 ); i <= std::min( x + 1, m_mapWidth - 1 ); i++ )
+                {
+                    window[count++] = depth[j * m_mapWidth + i];
+                }
+            }
+            std::nth_element( window, window + count / 2, window + count );
+            m_depth[y * m_mapWidth + x] = window[count / 2];
+        }
+    }
+
+    // selection maps, the box filtered indicators sum up to one in every block
+    m_selection.assign( frameCount * mapSize, 0.0f );
+    for ( int i = 0; i < mapSize; i++ )
+    {
+        m_selection[m_depth[i] * mapSize + i] = 1.0f;
+    }
+    for ( int i = 0; i < frameCount; i++ )
+    {
+        boxFilter( &m_selection[i * mapSize], FOCUS_STACK_SELECTION_RADIUS );
+    }
+
+    // composite
+    m_tilesX = ( width + FOCUS_STACK_TILE - 1 ) / FOCUS_STACK_TILE;
+    m_tilesY = ( height + FOCUS_STACK_TILE - 1 ) / FOCUS_STACK_TILE;
+    if ( pool != 0 )
+    {
+        pool->run( FocusStack::CompositeProc, this, m_tilesX * m_tilesY );
+    }
+    else
+    {
+        for ( int i = 0; i < m_tilesX * m_tilesY; i++ )
+        {
+            CompositeProc( this, i );
+        }
+    }
+
+    std::vector<float>().swap( m_selection );
+
+    double elapsed = timer.get();
+    LOG( "FocusStack: %d frames %dx%d in %.1f ms (%.1f ms/MPix)\n", frameCount, width, height, elapsed,
+         elapsed * 1e6 / ( (double) width * height ) );
+}
+
+void FocusStack::EnergyProc( void * opaque, int index )
+{
+    FocusStack * instance = (FocusStack *) opaque;
+    const int width = instance->m_width;
+    const int mapWidth = instance->m_mapWidth;
+    const int mapSize = mapWidth * instance->m_mapHeight;
+    const float norm = 1.0f / ( FOCUS_STACK_BLOCK * FOCUS_STACK_BLOCK );
+    std::vector<uint> energy( mapWidth );
+
+    for ( int i = 0; i < instance->m_frameCount; i++ )
+    {
+        memset( &energy[0], 0, mapWidth * sizeof( uint ) );
+
+        const uchar * row = instance->m_frames[i] + ( 1 + index * FOCUS_STACK_BLOCK ) * width + 1;
+        for ( int y = 0; y < FOCUS_STACK_BLOCK; y++, row += width )
+        {
+            AddRowLaplacianEnergy( row, width, mapWidth, &energy[0] );
+        }
+
+        float * map = &instance->m_energy[i * mapSize + index * mapWidth];
+        for ( int x = 0; x < mapWidth; x++ )
+        {
+            map[x] = energy[x] * norm;
+        }
+    }
+}
+
+void FocusStack::boxFilter( float * map, int radius )
+{
+    const int w = m_mapWidth;
+    const int h = m_mapHeight;
+    std::vector<float> temp( w * h );
+
+    // horizontal pass, the window is clipped at the borders
+    for ( int y = 0; y < h; y++ )
+    {
+        const float * src = map + y * w;
+        float * dst = &temp[y * w];
+        float sum = 0.0f;
+        for ( int x = 0; x < std::min( radius, w ); x++ )
+        {
+            sum += src[x];
+        }
+        for ( int x = 0; x < w; x++ )
+        {
+            if ( x + radius < w )
+            {
+                sum += src[x + radius];
+            }
+            if ( x - radius - 1 >= 0 )
+            {
+                sum -= src[x - radius - 1];
+            }
+            dst[x] = sum / ( std::min( x + radius, w - 1 ) - std::max( x - radius, 0 ) + 1 );
+        }
+    }
+
+    // vertical pass
+    for ( int x = 0; x < w; x++ )
+    {
+        float sum = 0.0f;
+        for ( int y = 0; y < std::min( radius, h ); y++ )
+        {
+            sum += temp[y * w + x];
+        }
+        for ( int y = 0; y < h; y++ )
+        {
+            if ( y + radius < h )
+            {
+                sum += temp[( y + radius ) * w + x];
+            }
+            if ( y - radius - 1 >= 0 )
+            {
+                sum -= temp[( y - radius - 1 ) * w + x];
+            }
+            map[y * w + x] = sum / ( std::min( y + radius, h - 1 ) - std::max( y - radius, 0 ) + 1 );
+        }
+    }
+}
+
+void FocusStack::CompositeProc( void * opaque, int index )
+{
+    FocusStack * instance = (FocusStack *) opaque;
+    const int width = instance->m_width;
+    const int height = instance->m_height;
+    const int mapWidth = instance->m_mapWidth;
+    const int mapSize = mapWidth * instance->m_mapHeight;
+
+    int x0 = ( index % instance->m_tilesX ) * FOCUS_STACK_TILE;
+    int y0 = ( index / instance->m_tilesX ) * FOCUS_STACK_TILE;
+
+    // frames selected anywhere in the blocks the tile interpolates from
+    int bx0, bx1, by0, by1, unused;
+    GetMapPosition( x0, 1, mapWidth, bx0, unused );
+    GetMapPosition( std::min( x0 + FOCUS_STACK_TILE, width ) - 1, 1, mapWidth, unused, bx1 );
+    GetMapPosition( y0, 1, instance->m_mapHeight, by0, unused );
+    GetMapPosition( std::min( y0 + FOCUS_STACK_TILE, height ) - 1, 1, instance->m_mapHeight, unused, by1 );
+
+    std::vector<int> active;
+    for ( int i = 0; i < instance->m_frameCount; i++ )
+    {
+        const float * selection = &instance->m_selection[i * mapSize];
+        bool selected = false;
+        for ( int y = by0; y <= by1 && !selected; y++ )
+        {
+            for ( int x = bx0; x <= bx1; x++ )
+            {
+                if ( selection[y * mapWidth + x] > FOCUS_STACK_MIN_WEIGHT )
+                {
+                    selected = true;
+                    break;
+                }
+            }
+        }
+        if ( selected )
+        {
+            active.push_back( i );
+        }
+    }
+
+    if ( active.empty() )
+    {
+        return;
+    }
+
+    const int halfWidth = width >> 1;
+    const int halfHeight = height >> 1;
+    instance->compositePlane( 0, width, height, 1, x0, y0, FOCUS_STACK_TILE, &active[0], active.size() );
+    instance->compositePlane( width * height, halfWidth, halfHeight, 2, x0 >> 1, y0 >> 1, FOCUS_STACK_TILE >> 1,
+                              &active[0], active.size() );
+    instance->compositePlane( width * height + halfWidth * halfHeight, halfWidth, halfHeight, 2, x0 >> 1, y0 >> 1,
+                              FOCUS_STACK_TILE >> 1, &active[0], active.size() );
+}
+
+void FocusStack::compositePlane( int plane, int planeWidth, int planeHeight, int scale, int x0, int y0, int size,
+                                 const int * active, int activeCount )
+{
+    const int mapWidth = m_mapWidth;
+    const int mapSize = mapWidth * m_mapHeight;
+    const int x1 = std::min( x0 + size, planeWidth );
+    const int y1 = std::min( y0 + size, planeHeight );
+
+    // horizontal interpolation positions are shared by all rows of the tile
+    int left[FOCUS_STACK_TILE], right[FOCUS_STACK_TILE];
+    float tx[FOCUS_STACK_TILE];
+    for ( int x = x0; x < x1; x++ )
+    {
+        tx[x - x0] = GetMapPosition( x, scale, mapWidth, left[x - x0], right[x - x0] );
+    }
+    const int bx0 = left[0];
+    const int span = right[x1 - x0 - 1] - bx0 + 1;
+
+    // selection map rows interpolated vertically, per active frame
+    std::vector<float> rowWeights( activeCount * span );
+    uchar * out = m_yuv + plane;
+
+    for ( int y = y0; y < y1; y++ )
+    {
+        int top, bottom;
+        float ty = GetMapPosition( y, scale, m_mapHeight, top, bottom );
+        for ( int i = 0; i < activeCount; i++ )
+        {
+            const float * a = &m_selection[active[i] * mapSize + top * mapWidth + bx0];
+            const float * b = &m_selection[active[i] * mapSize + bottom * mapWidth + bx0];
+            float * w = &rowWeights[i * span];
+            for ( int j = 0; j < span; j++ )
+            {
+                w[j] = a[j] + ty * ( b[j] - a[j] );
+            }
+        }
+
+        for ( int x = x0; x < x1; x++ )
+        {
+            int l = left[x - x0] - bx0;
+            int r = right[x - x0] - bx0;
+            float t = tx[x - x0];
+            float v = 0.0f;
+            for ( int i = 0; i < activeCount; i++ )
+            {
+                const float * w = &rowWeights[i * span];
+                v += ( w[l] + t * ( w[r] - w[l] ) ) * m_frames[active[i]][plane + y * planeWidth + x];
+            }
+            out[y * planeWidth + x] = (uchar) std::min( v + 0.5f, 255.0f );
+        }
+    }
+}
@@ -0,0 +1,126 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _FOCUS_STACK_H
+#define _FOCUS_STACK_H
+
+/**
+ * @file
+ * Definition of FocusStack.
+ */
+
+#include <vector>
+#include "Common.h"
+#include "Sharpness.h"
+
+class ThreadPool;
+
+#define FOCUS_STACK_BLOCK            SHARPNESS_BLOCK_SIZE /**< Sharpness and selection map block size in luma pixels */
+#define FOCUS_STACK_ENERGY_RADIUS    2                    /**< Box filter radius (blocks) of the sharpness maps */
+#define FOCUS_STACK_SELECTION_RADIUS 2                    /**< Box filter radius (blocks) of the selection maps */
+#define FOCUS_STACK_TILE             64                   /**< Composite tile size in luma pixels */
+
+/**
+ * Focus stacking. Composites an all-in-focus YUV420p frame from a focus
+ * bracket (aligned frames of the same exposure focused at different
+ * distances):
+ * - per frame sharpness maps hold the Laplacian energy of FOCUS_STACK_BLOCK
+ *   blocks (see Sharpness), smoothed by a box filter;
+ * - the depth map is the index of the sharpest frame per block, cleaned up
+ *   by a 3x3 median filter;
+ * - the selection maps (one per frame) are the box filtered indicator
+ *   functions of the depth map, so frames blend smoothly across depth
+ *   boundaries instead of switching per block;
+ * - the output is composited tile by tile, the selection maps are
+ *   interpolated bilinearly and only the frames selected in a tile are read.
+ *
+ * The sharpness maps and the composite run on a thread pool.
+ */
+class FocusStack
+{
+public:
+    /**
+     * Default constructor.
+     */
+    FocusStack( void );
+
+    /**
+     * Composites an all-in-focus frame.
+     * @param frames YUV420p frame data
+     * @param frameCount number of frames (1 to 255, nothing is written for an empty stack)
+     * @param width frame width in pixels (needs to be at least 2 * FOCUS_STACK_BLOCK)
+     * @param height frame height in pixels (needs to be at least 2 * FOCUS_STACK_BLOCK)
+     * @param yuv receives the composited YUV420p frame
+     * @param pool thread pool (can be 0)
+     */
+    void stack( const uchar * const * frames, int frameCount, int width, int height, uchar * yuv, ThreadPool * pool );
+
+private:
+    /**
+     * Computes the sharpness maps of all frames for a row of blocks.
+     */
+    static void EnergyProc( void * opaque, int index );
+
+    /**
+     * Composites one tile.
+     */
+    static void CompositeProc( void * opaque, int index );
+
+    /**
+     * Box filters a map in place.
+     * @param map map data (m_mapWidth x m_mapHeight)
+     * @param radius filter radius in blocks
+     */
+    void boxFilter( float * map, int radius );
+
+    /**
+     * Composites a plane of a tile.
+     * @param plane offset of the plane in the frames
+     * @param planeWidth plane width in pixels
+     * @param planeHeight plane height in pixels
+     * @param scale plane to luma pixel scale (1 or 2)
+     * @param x0 left edge of the tile in plane pixels
+     * @param y0 top edge of the tile in plane pixels
+     * @param size tile size in plane pixels
+     * @param active indices of the frames selected in the tile
+     * @param activeCount number of active frames
+     */
+    void compositePlane( int plane, int planeWidth, int planeHeight, int scale, int x0, int y0, int size,
+                         const int * active, int activeCount );
+
+    const uchar * const * m_frames; /**< Frames being stacked */
+    int m_frameCount; /**< Number of frames */
+    int m_width, m_height; /**< Frame size */
+    uchar * m_yuv; /**< Output frame */
+
+    int m_mapWidth, m_mapHeight; /**< Map size in blocks */
+    int m_tilesX, m_tilesY; /**< Composite tile grid size */
+    std::vector<float> m_energy; /**< Per frame sharpness maps */
+    std::vector<float> m_selection; /**< Per frame selection maps */
+    std::vector<uchar> m_depth; /**< Depth map (index of the sharpest frame per block) */
+};
+
+#endif
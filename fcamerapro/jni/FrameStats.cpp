@@ -0,0 +1,321 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of FrameStats.
+ */
+
+#include <string.h>
+#include "FrameStats.h"
+#include "ColorConversion.h"
+#include "Sharpness.h"
+#include "ThreadPool.h"
+
+FrameStats::FrameStats( void )
+{
+    m_yuv = 0;
+    m_width = m_height = 0;
+    m_step = 1;
+
+    memset( m_bins, 0, sizeof( m_bins ) );
+    m_clippedShadows = m_clippedHighlights = m_sampleCount = 0;
+
+    for ( int i = 0; i < ZONE_GRID_SIZE; i++ )
+    {
+        m_zoneLuma[i] = 0.0f;
+        m_zoneCb[i] = m_zoneCr[i] = 128.0f;
+        m_zoneSharpness[i] = 0.0f;
+    }
+}
+
+void FrameStats::compute( const uchar * yuv, int width, int height, int step, ThreadPool * pool )
+{
+    m_yuv = yuv;
+    m_width = width;
+    m_height = height;
+    m_step = step < 1 ? 1 : step;
+
+    if ( pool != 0 )
+    {
+        pool->run( FrameStats::TileProc, this, ZONE_GRID_ROWS );
+    }
+    else
+    {
+        for ( int i = 0; i < ZONE_GRID_ROWS; i++ )
+        {
+            TileProc( this, i );
+        }
+    }
+
+    // merge partial histograms
+    memcpy( m_bins, m_tiles[0].bins, sizeof( m_bins ) );
+    m_clippedShadows = m_tiles[0].clippedShadows;
+    m_clippedHighlights = m_tiles[0].clippedHighlights;
+    m_sampleCount = m_tiles[0].sampleCount;
+
+    for ( int i = 1; i < ZONE_GRID_ROWS; i++ )
+    {
+        const Tile & tile = m_tiles[i];
+        for ( int c = 0; c < EChannelCount; c++ )
+        {
+            for ( int j = 0; j < HISTOGRAM_SIZE; j++ )
+            {
+                m_bins[c][j] += tile.bins[c][j];
+            }
+        }
+
+        m_clippedShadows += tile.clippedShadows;
+        m_clippedHighlights += tile.clippedHighlights;
+        m_sampleCount += tile.sampleCount;
+    }
+}
+
+void FrameStats::TileProc( void * opaque, int index )
+{
+    FrameStats * instance = ( FrameStats * ) opaque;
+    Tile * tile = &instance->m_tiles[index];
+
+    const int width = instance->m_width;
+    const int height = instance->m_height;
+    const int step = instance->m_step;
+    const int cwidth = width >> 1;
+
+    const uchar * yplane = instance->m_yuv;
+    const uchar * cbplane = yplane + width * height;
+    const uchar * crplane = cbplane + ( width * height >> 2 );
+
+    // sampled rows and columns of this zone row
+    const int y0 = index * height / ZONE_GRID_ROWS;
+    const int y1 = ( index + 1 ) * height / ZONE_GRID_ROWS;
+    const int yBegin = ( y0 + step - 1 ) / step * step;
+    const int cols = ( width + step - 1 ) / step;
+
+    // zone column boundaries in pixels and in samples
+    int zoneX[ZONE_GRID_COLUMNS + 1], zoneS[ZONE_GRID_COLUMNS + 1];
+    for ( int zx = 0; zx <= ZONE_GRID_COLUMNS; zx++ )
+    {
+        zoneX[zx] = zx * width / ZONE_GRID_COLUMNS;
+        zoneS[zx] = ( zoneX[zx] + step - 1 ) / step;
+    }
+
+    uint sumY[ZONE_GRID_COLUMNS], sumCb[ZONE_GRID_COLUMNS], sumCr[ZONE_GRID_COLUMNS];
+    unsigned long long energy[ZONE_GRID_COLUMNS];
+    uint energyCount[ZONE_GRID_COLUMNS];
+    memset( sumY, 0, sizeof( sumY ) );
+    memset( sumCb, 0, sizeof( sumCb ) );
+    memset( sumCr, 0, sizeof( sumCr ) );
+    memset( energy, 0, sizeof( energy ) );
+    memset( energyCount, 0, sizeof( energyCount ) );
+
+    memset( tile->bins, 0, sizeof( tile->bins ) );
+    tile->scratch.resize( cols * 6 );
+    uchar * sy = &tile->scratch[0];
+    uchar * scb = sy + cols;
+    uchar * scr = scb + cols;
+    uchar * sr = scr + cols;
+    uchar * sg = sr + cols;
+    uchar * sb = sg + cols;
+
+    uint * lbins = tile->bins[EChannelLuma];
+    uint * rbins = tile->bins[EChannelRed];
+    uint * gbins = tile->bins[EChannelGreen];
+    uint * bbins = tile->bins[EChannelBlue];
+    uint clippedShadows = 0, clippedHighlights = 0;
+    int rowCount = 0;
+
+    for ( int y = yBegin; y < y1; y += step, rowCount++ )
+    {
+        const uchar * ysrc = yplane + y * width;
+        const uchar * cbsrc = cbplane + ( y >> 1 ) * cwidth;
+        const uchar * crsrc = crplane + ( y >> 1 ) * cwidth;
+
+        // gather samples into contiguous runs
+        if ( step == 1 )
+        {
+            memcpy( sy, ysrc, cols );
+            for ( int i = 0; i < cols; i++ )
+            {
+                scb[i] = cbsrc[i >> 1];
+                scr[i] = crsrc[i >> 1];
+            }
+        }
+        else
+        {
+            for ( int i = 0, x = 0; i < cols; i++, x += step )
+            {
+                sy[i] = ysrc[x];
+                scb[i] = cbsrc[x >> 1];
+                scr[i] = crsrc[x >> 1];
+            }
+        }
+
+        // vectorised color conversion
+        ConvertYCbCrToRGB( sy, scb, scr, sr, sg, sb, cols );
+
+        // histograms, clipping and zone sums
+        for ( int zx = 0; zx < ZONE_GRID_COLUMNS; zx++ )
+        {
+            uint zy = 0, zcb = 0, zcr = 0;
+            for ( int i = zoneS[zx]; i < zoneS[zx + 1]; i++ )
+            {
+                const uchar l = sy[i], r = sr[i], g = sg[i], b = sb[i];
+                lbins[l]++;
+                rbins[r]++;
+                gbins[g]++;
+                bbins[b]++;
+
+                clippedShadows += l <= FRAME_STATS_CLIP_LOW;
+                clippedHighlights += ( r >= FRAME_STATS_CLIP_HIGH ) | ( g >= FRAME_STATS_CLIP_HIGH ) | ( b >= FRAME_STATS_CLIP_HIGH );
+
+                zy += l;
+                zcb += scb[i];
+                zcr += scr[i];
+            }
+
+            sumY[zx] += zy;
+            sumCb[zx] += zcb;
+            sumCr[zx] += zcr;
+        }
+
+        // gradient energy at full horizontal resolution while the row is in cache
+        if ( y >= 1 && y < height - 1 )
+        {
+            for ( int zx = 0; zx < ZONE_GRID_COLUMNS; zx++ )
+            {
+                const int gx0 = zoneX[zx] < 1 ? 1 : zoneX[zx];
+                const int gx1 = zoneX[zx + 1] > width - 1 ? width - 1 : zoneX[zx + 1];
+                energy[zx] += GetRowGradientEnergy( ysrc + gx0, width, gx1 - gx0 );
+                energyCount[zx] += gx1 - gx0;
+            }
+        }
+    }
+
+    tile->clippedShadows = clippedShadows;
+    tile->clippedHighlights = clippedHighlights;
+    tile->sampleCount = rowCount * cols;
+
+    for ( int zx = 0; zx < ZONE_GRID_COLUMNS; zx++ )
+    {
+        const int zone = index * ZONE_GRID_COLUMNS + zx;
+        const uint count = rowCount * ( zoneS[zx + 1] - zoneS[zx] );
+        if ( count > 0 )
+        {
+            instance->m_zoneLuma[zone] = ( float ) sumY[zx] / count;
+            instance->m_zoneCb[zone] = ( float ) sumCb[zx] / count;
+            instance->m_zoneCr[zone] = ( float ) sumCr[zx] / count;
+        }
+        instance->m_zoneSharpness[zone] = energyCount[zx] > 0 ? ( float )(( double ) energy[zx] / energyCount[zx] ) : 0.0f;
+    }
+}
+
+float FrameStats::getSharpness( int x, int y, int width, int height ) const
+{
+    if ( m_width == 0 || m_height == 0 )
+    {
+        return 0.0f;
+    }
+
+    float sum = 0.0f, weightSum = 0.0f;
+    for ( int zy = 0; zy < ZONE_GRID_ROWS; zy++ )
+    {
+        const int zy0 = zy * m_height / ZONE_GRID_ROWS, zy1 = ( zy + 1 ) * m_height / ZONE_GRID_ROWS;
+        const int oy = ( y + height < zy1 ? y + height : zy1 ) - ( y > zy0 ? y : zy0 );
+        if ( oy <= 0 )
+        {
+            continue;
+        }
+
+        for ( int zx = 0; zx < ZONE_GRID_COLUMNS; zx++ )
+        {
+            const int zx0 = zx * m_width / ZONE_GRID_COLUMNS, zx1 = ( zx + 1 ) * m_width / ZONE_GRID_COLUMNS;
+            const int ox = ( x + width < zx1 ? x + width : zx1 ) - ( x > zx0 ? x : zx0 );
+            if ( ox <= 0 )
+            {
+                continue;
+            }
+
+            float weight = ( float )( ox * oy );
+            sum += weight * m_zoneSharpness[zy * ZONE_GRID_COLUMNS + zx];
+            weightSum += weight;
+        }
+    }
+
+    return weightSum > 0.0f ? sum / weightSum : 0.0f;
+}
+
+void FrameStats::normalizeLuma( float * dest ) const
+{
+    uint maxBinValue = 1;
+    for ( int i = 0; i < HISTOGRAM_SIZE; i++ )
+    {
+        if ( m_bins[EChannelLuma][i] > maxBinValue )
+        {
+            maxBinValue = m_bins[EChannelLuma][i];
+        }
+    }
+
+    float norm = 1.0f / maxBinValue;
+    for ( int i = 0; i < HISTOGRAM_SIZE; i++ )
+    {
+        dest[i] = m_bins[EChannelLuma][i] * norm;
+    }
+}
+
+void FrameStats::normalizeRGB( float * dest ) const
+{
+    uint maxBinValue = 1;
+    for ( int c = EChannelRed; c <= EChannelBlue; c++ )
+    {
+        for ( int i = 0; i < HISTOGRAM_SIZE; i++ )
+        {
+            if ( m_bins[c][i] > maxBinValue )
+            {
+                maxBinValue = m_bins[c][i];
+            }
+        }
+    }
+
+    float norm = 1.0f / maxBinValue;
+    for ( int c = EChannelRed; c <= EChannelBlue; c++ )
+    {
+        for ( int i = 0; i < HISTOGRAM_SIZE; i++ )
+        {
+            *dest++ = m_bins[c][i] * norm;
+        }
+    }
+}
+
+int FrameStats::GetZoneIndex( float x, float y )
+{
+    int zx = ( int )( x * ZONE_GRID_COLUMNS );
+    int zy = ( int )( y * ZONE_GRID_ROWS );
+
+    zx = zx < 0 ? 0 : ( zx >= ZONE_GRID_COLUMNS ? ZONE_GRID_COLUMNS - 1 : zx );
+    zy = zy < 0 ? 0 : ( zy >= ZONE_GRID_ROWS ? ZONE_GRID_ROWS - 1 : zy );
+
+    return zy * ZONE_GRID_COLUMNS + zx;
+}
@@ -0,0 +1,235 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _FRAMESTATS_H
+#define _FRAMESTATS_H
+
+/**
+ * @file
+ * Definition of FrameStats.
+ */
+
+#include <vector>
+#include "Common.h"
+#include "ParamSetRequest.h"
+
+class ThreadPool;
+
+#define FRAME_STATS_CLIP_LOW  2   /**< Luma value at or below which a pixel counts as clipped shadow */
+#define FRAME_STATS_CLIP_HIGH 253 /**< Channel value at or above which a pixel counts as clipped highlight */
+
+#define ZONE_GRID_COLUMNS 16 /**< Number of zone grid columns */
+#define ZONE_GRID_ROWS    12 /**< Number of zone grid rows */
+#define ZONE_GRID_SIZE    ( ZONE_GRID_COLUMNS * ZONE_GRID_ROWS ) /**< Number of zones */
+
+/**
+ * Preview frame statistics shared by auto-exposure, auto white balance, auto-focus
+ * and the UI. All statistics are gathered from a YUV420p frame in one subsampled
+ * pass, tiled by zone rows which are processed in parallel:
+ * - full-resolution (HISTOGRAM_SIZE bins) luma and RGB histograms,
+ * - clipped shadow and highlight counts,
+ * - mean Y, Cb and Cr over a ZONE_GRID_COLUMNS x ZONE_GRID_ROWS zone grid,
+ * - mean gradient energy (see GetRowGradientEnergy()) of each zone.
+ * Zones are stored in row-major order.
+ */
+class FrameStats
+{
+public:
+    /**
+     * Histogram channels.
+     */
+    enum EChannel
+    {
+        EChannelLuma, EChannelRed, EChannelGreen, EChannelBlue, EChannelCount
+    };
+
+    /**
+     * Default constructor.
+     */
+    FrameStats( void );
+
+    /**
+     * Computes statistics of a YUV420p frame.
+     * @param yuv pointer to YUV420p frame data (Y plane followed by Cb and Cr planes)
+     * @param width frame width in pixels
+     * @param height frame height in pixels
+     * @param step sampling stride in pixels (1 - every pixel, 2 - every other pixel
+     * in every other row, ...)
+     * @param pool thread pool used to process the zone rows (can be 0)
+     */
+    void compute( const uchar * yuv, int width, int height, int step, ThreadPool * pool );
+
+    /**
+     * Gets histogram bins of a channel.
+     * @param channel histogram channel
+     * @return pointer to HISTOGRAM_SIZE bin counts
+     */
+    const uint * getBins( EChannel channel ) const
+    {
+        return m_bins[channel];
+    }
+
+    /**
+     * Gets the number of sampled pixels with luma at or below FRAME_STATS_CLIP_LOW.
+     * @return clipped shadow pixel count
+     */
+    uint getClippedShadows( void ) const
+    {
+        return m_clippedShadows;
+    }
+
+    /**
+     * Gets the number of sampled pixels with any RGB channel at or above FRAME_STATS_CLIP_HIGH.
+     * @return clipped highlight pixel count
+     */
+    uint getClippedHighlights( void ) const
+    {
+        return m_clippedHighlights;
+    }
+
+    /**
+     * Gets the number of pixels sampled by last compute() call.
+     * @return sample count
+     */
+    uint getSampleCount( void ) const
+    {
+        return m_sampleCount;
+    }
+
+    /**
+     * Gets mean luma of all zones.
+     * @return pointer to ZONE_GRID_SIZE values
+     */
+    const float * getZoneLuma( void ) const
+    {
+        return m_zoneLuma;
+    }
+
+    /**
+     * Gets mean Cb of all zones.
+     * @return pointer to ZONE_GRID_SIZE values
+     */
+    const float * getZoneCb( void ) const
+    {
+        return m_zoneCb;
+    }
+
+    /**
+     * Gets mean Cr of all zones.
+     * @return pointer to ZONE_GRID_SIZE values
+     */
+    const float * getZoneCr( void ) const
+    {
+        return m_zoneCr;
+    }
+
+    /**
+     * Gets mean gradient energy of all zones.
+     * @return pointer to ZONE_GRID_SIZE values
+     */
+    const float * getZoneSharpness( void ) const
+    {
+        return m_zoneSharpness;
+    }
+
+    /**
+     * Gets mean gradient energy of a rectangle, computed from the zones it overlaps
+     * weighted by the overlap area.
+     * @param x left edge of the rectangle (pixels)
+     * @param y top edge of the rectangle (pixels)
+     * @param width rectangle width in pixels
+     * @param height rectangle height in pixels
+     * @return mean gradient energy
+     */
+    float getSharpness( int x, int y, int width, int height ) const;
+
+    int width( void ) const
+    {
+        return m_width;
+    }
+    int height( void ) const
+    {
+        return m_height;
+    }
+
+    /**
+     * Writes luma histogram normalized by its largest bin.
+     * @param dest pointer to HISTOGRAM_SIZE floats
+     */
+    void normalizeLuma( float * dest ) const;
+
+    /**
+     * Writes R, G and B histograms (in this order, HISTOGRAM_SIZE bins each) normalized
+     * by the largest bin of all three.
+     * @param dest pointer to 3 * HISTOGRAM_SIZE floats
+     */
+    void normalizeRGB( float * dest ) const;
+
+    /**
+     * Gets the zone index containing a frame position.
+     * @param x normalized horizontal position (0 - left, 1 - right)
+     * @param y normalized vertical position (0 - top, 1 - bottom)
+     * @return zone index
+     */
+    static int GetZoneIndex( float x, float y );
+
+private:
+    /**
+     * Per-tile partial histograms and scratch memory.
+     */
+    struct Tile
+    {
+        uint bins[EChannelCount][HISTOGRAM_SIZE]; /**< Partial histograms */
+        uint clippedShadows; /**< Partial clipped shadow count */
+        uint clippedHighlights; /**< Partial clipped highlight count */
+        uint sampleCount; /**< Partial sample count */
+        std::vector<uchar> scratch; /**< Gathered row samples and converted RGB values */
+    };
+
+    /**
+     * Thread pool task processing a single zone row.
+     * @param opaque pointer to FrameStats instance
+     * @param index zone row index
+     */
+    static void TileProc( void * opaque, int index );
+
+    Tile m_tiles[ZONE_GRID_ROWS]; /**< Per zone row partial results */
+
+    const uchar * m_yuv; /**< Current frame data */
+    int m_width, m_height, m_step; /**< Current frame geometry and sampling */
+
+    uint m_bins[EChannelCount][HISTOGRAM_SIZE]; /**< Merged histograms */
+    uint m_clippedShadows; /**< Merged clipped shadow count */
+    uint m_clippedHighlights; /**< Merged clipped highlight count */
+    uint m_sampleCount; /**< Merged sample count */
+
+    float m_zoneLuma[ZONE_GRID_SIZE]; /**< Mean luma per zone */
+    float m_zoneCb[ZONE_GRID_SIZE]; /**< Mean Cb per zone */
+    float m_zoneCr[ZONE_GRID_SIZE]; /**< Mean Cr per zone */
+    float m_zoneSharpness[ZONE_GRID_SIZE]; /**< Mean gradient energy per zone */
+};
+
+#endif
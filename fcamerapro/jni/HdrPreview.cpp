@@ -0,0 +1,281 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "HdrPreview.h"
+#include "ThreadPool.h"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Blends pixels of several frames with well-exposedness weights. The weight
+ * of a pixel with level l is (t * t >> 6) + 1, t = 64 - |l - 128| / 2, the
+ * result is (sum(w * v) + sum(w) / 2) / sum(w). The SSE2 path divides in
+ * single precision, which truncates to the same integer; the NEON path
+ * multiplies by a refined reciprocal estimate and fixes the truncated
+ * quotient up or down by one using the integer remainder.
+ * @param values pixel values of the frames
+ * @param levels luma levels weighting the pixels of the frames
+ * @param frameCount number of frames (1 to HDR_PREVIEW_MAX_FRAMES)
+ * @param count number of pixels
+ * @param dst blended pixels
+ */
+static void BlendPixels( const uchar * const * values, const uchar * const * levels, int frameCount, int count, uchar * dst )
+{
+    int x = 0;
+
+#if defined(__ARM_NEON__)
+    const uint16x8_t mid = vdupq_n_u16( 128 );
+    const uint16x8_t top = vdupq_n_u16( 64 );
+    const uint16x8_t one = vdupq_n_u16( 1 );
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        uint16x8_t num = vdupq_n_u16( 0 ), den = vdupq_n_u16( 0 );
+        for ( int i = 0; i < frameCount; i++ )
+        {
+            uint16x8_t t = vsubq_u16( top, vshrq_n_u16( vabdq_u16( vmovl_u8( vld1_u8( levels[i] + x ) ), mid ), 1 ) );
+            uint16x8_t w = vaddq_u16( vshrq_n_u16( vmulq_u16( t, t ), 6 ), one );
+            num = vmlaq_u16( num, w, vmovl_u8( vld1_u8( values[i] + x ) ) );
+            den = vaddq_u16( den, w );
+        }
+        num = vaddq_u16( num, vshrq_n_u16( den, 1 ) );
+
+        float32x4_t q[2];
+        for ( int h = 0; h < 2; h++ )
+        {
+            float32x4_t n = vcvtq_f32_u32( vmovl_u16( h == 0 ? vget_low_u16( num ) : vget_high_u16( num ) ) );
+            float32x4_t d = vcvtq_f32_u32( vmovl_u16( h == 0 ? vget_low_u16( den ) : vget_high_u16( den ) ) );
+            // reciprocal estimate refined by two Newton-Raphson steps
+            float32x4_t r = vrecpeq_f32( d );
+            r = vmulq_f32( r, vrecpsq_f32( d, r ) );
+            r = vmulq_f32( r, vrecpsq_f32( d, r ) );
+            q[h] = vmulq_f32( n, r );
+        }
+        uint16x8_t v = vcombine_u16( vmovn_u32( vcvtq_u32_f32( q[0] ) ), vmovn_u32( vcvtq_u32_f32( q[1] ) ) );
+
+        // the estimate can be off by one, correct it with the remainder
+        v = vsubq_u16( v, vshrq_n_u16( vcgtq_u16( vmulq_u16( v, den ), num ), 15 ) );
+        v = vaddq_u16( v, vshrq_n_u16( vcgeq_u16( vsubq_u16( num, vmulq_u16( v, den ) ), den ), 15 ) );
+        vst1_u8( dst + x, vqmovn_u16( v ) );
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mid = _mm_set1_epi16( 128 );
+    const __m128i top = _mm_set1_epi16( 64 );
+    const __m128i one = _mm_set1_epi16( 1 );
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        __m128i num = zero, den = zero;
+        for ( int i = 0; i < frameCount; i++ )
+        {
+            __m128i d = _mm_sub_epi16( _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( levels[i] + x ) ), zero ), mid );
+            d = _mm_max_epi16( d, _mm_sub_epi16( zero, d ) );
+            __m128i t = _mm_sub_epi16( top, _mm_srli_epi16( d, 1 ) );
+            __m128i w = _mm_add_epi16( _mm_srli_epi16( _mm_mullo_epi16( t, t ), 6 ), one );
+            __m128i v = _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( values[i] + x ) ), zero );
+            num = _mm_add_epi16( num, _mm_mullo_epi16( w, v ) );
+            den = _mm_add_epi16( den, w );
+        }
+        num = _mm_add_epi16( num, _mm_srli_epi16( den, 1 ) );
+
+        // weighted sums can exceed 0x7fff, widen them as unsigned
+        __m128i lo = _mm_cvttps_epi32( _mm_div_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( num, zero ) ),
+                                                   _mm_cvtepi32_ps( _mm_unpacklo_epi16( den, zero ) ) ) );
+        __m128i hi = _mm_cvttps_epi32( _mm_div_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi16( num, zero ) ),
+                                                   _mm_cvtepi32_ps( _mm_unpackhi_epi16( den, zero ) ) ) );
+        _mm_storel_epi64(( __m128i * )( dst + x ), _mm_packus_epi16( _mm_packs_epi32( lo, hi ), zero ) );
+    }
+#endif
+
+    for ( ; x < count; x++ )
+    {
+        int num = 0, den = 0;
+        for ( int i = 0; i < frameCount; i++ )
+        {
+            int t = 64 - ( abs( levels[i][x] - 128 ) >> 1 );
+            int w = ( ( t * t ) >> 6 ) + 1;
+            num += w * values[i][x];
+            den += w;
+        }
+        dst[x] = ( uchar )(( num + ( den >> 1 ) ) / den );
+    }
+}
+
+HdrPreview::HdrPreview( void ) : m_frameCount( 2 ), m_width( 0 ), m_height( 0 ), m_validFrames( 0 ), m_nextFrame( 0 ), m_bandCount( 1 )
+{
+    for ( int i = 0; i < HDR_PREVIEW_MAX_FRAMES; i++ )
+    {
+        m_exposure[i] = 0.0f;
+        m_gain[i] = 1.0f;
+    }
+}
+
+HdrPreview::~HdrPreview( void )
+{
+}
+
+void HdrPreview::makeBurst( const FCam::Tegra::Shot & base, int frameCount, float maxGain, int minExposure,
+                            std::vector<FCam::Tegra::Shot> & burst )
+{
+    burst.assign( frameCount, base );
+    for ( int i = 0; i < frameCount; i++ )
+    {
+        float stops = HDR_PREVIEW_EV_STEP * ( i - ( frameCount - 1 ) * 0.5f );
+        float exposure = base.exposure * powf( 2.0f, stops );
+        float gain = base.gain;
+        if ( exposure > HDR_PREVIEW_MAX_EXPOSURE )
+        {
+            gain = std::min( gain * exposure / HDR_PREVIEW_MAX_EXPOSURE, std::max( maxGain, base.gain ) );
+            exposure = ( float ) HDR_PREVIEW_MAX_EXPOSURE;
+        }
+        if ( exposure < minExposure )
+        {
+            exposure = ( float ) minExposure;
+        }
+        burst[i].exposure = ( int ) exposure;
+        burst[i].gain = gain;
+    }
+}
+
+void HdrPreview::reset( int frameCount )
+{
+    m_frameCount = std::min( std::max( frameCount, 1 ), HDR_PREVIEW_MAX_FRAMES );
+    m_validFrames = 0;
+    m_nextFrame = 0;
+}
+
+void HdrPreview::addFrame( const uchar * yuv, int width, int height, float exposure, float gain )
+{
+    if ( width != m_width || height != m_height )
+    {
+        reset( m_frameCount );
+        m_width = width;
+        m_height = height;
+    }
+
+    m_frames[m_nextFrame].assign( yuv, yuv + width * height * 3 / 2 );
+    m_exposure[m_nextFrame] = exposure;
+    m_gain[m_nextFrame] = gain;
+    m_nextFrame = ( m_nextFrame + 1 ) % m_frameCount;
+    m_validFrames = std::min( m_validFrames + 1, m_frameCount );
+}
+
+const uchar * HdrPreview::fuse( ThreadPool * pool )
+{
+    if ( m_validFrames == 0 )
+    {
+        return 0;
+    }
+
+    m_fused.resize( m_width * m_height * 3 / 2 );
+    m_bandCount = std::min( pool != 0 ? pool->concurrency() : 1, std::max( m_height / 2, 1 ) );
+    m_levels.resize( m_bandCount * HDR_PREVIEW_MAX_FRAMES * ( m_width / 2 ) );
+
+    if ( pool != 0 )
+    {
+        pool->run( HdrPreview::FuseProc, this, m_bandCount );
+    }
+    else
+    {
+        for ( int i = 0; i < m_bandCount; i++ )
+        {
+            FuseProc( this, i );
+        }
+    }
+
+    return &m_fused[0];
+}
+
+void HdrPreview::getReference( float & exposure, float & gain ) const
+{
+    float logTotal = 0.0f, logGain = 0.0f;
+    for ( int i = 0; i < m_validFrames; i++ )
+    {
+        logTotal += logf( std::max( m_exposure[i], 1.0f ) * std::max( m_gain[i], 1.0f ) );
+        logGain += logf( std::max( m_gain[i], 1.0f ) );
+    }
+    int n = std::max( m_validFrames, 1 );
+    gain = expf( logGain / n );
+    exposure = expf( logTotal / n ) / gain;
+}
+
+void HdrPreview::FuseProc( void * opaque, int index )
+{
+    HdrPreview * self = ( HdrPreview * ) opaque;
+
+    int width = self->m_width, height = self->m_height;
+    int chromaWidth = width / 2;
+    int lumaSize = width * height;
+    int n = self->m_validFrames;
+
+    const uchar * values[HDR_PREVIEW_MAX_FRAMES];
+    const uchar * levels[HDR_PREVIEW_MAX_FRAMES];
+    uchar * subsampled[HDR_PREVIEW_MAX_FRAMES];
+    for ( int i = 0; i < n; i++ )
+    {
+        subsampled[i] = &self->m_levels[( index * HDR_PREVIEW_MAX_FRAMES + i ) * chromaWidth];
+    }
+
+    for ( int y = self->getBandRow( index ); y < self->getBandRow( index + 1 ); y += 2 )
+    {
+        // luma rows weight themselves
+        for ( int r = y; r < std::min( y + 2, height ); r++ )
+        {
+            for ( int i = 0; i < n; i++ )
+            {
+                values[i] = &self->m_frames[i][r * width];
+            }
+            BlendPixels( values, values, n, width, &self->m_fused[r * width] );
+        }
+
+        // chroma rows take the weights of the top-left luma pixel of their blocks
+        for ( int i = 0; i < n; i++ )
+        {
+            const uchar * luma = &self->m_frames[i][y * width];
+            for ( int x = 0; x < chromaWidth; x++ )
+            {
+                subsampled[i][x] = luma[2 * x];
+            }
+            levels[i] = subsampled[i];
+        }
+        for ( int plane = 0; plane < 2; plane++ )
+        {
+            int offset = lumaSize + plane * ( lumaSize / 4 ) + ( y / 2 ) * chromaWidth;
+            for ( int i = 0; i < n; i++ )
+            {
+                values[i] = &self->m_frames[i][offset];
+            }
+            BlendPixels( values, levels, n, chromaWidth, &self->m_fused[offset] );
+        }
+    }
+}
@@ -0,0 +1,144 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _HDR_PREVIEW_H
+#define _HDR_PREVIEW_H
+
+/**
+ * @file
+ * Definition of HdrPreview.
+ */
+
+#include <vector>
+#include <FCam/Tegra.h>
+#include "Common.h"
+
+class ThreadPool;
+
+#define HDR_PREVIEW_MAX_FRAMES    3       /**< Maximum number of exposures per cycle */
+#define HDR_PREVIEW_EV_STEP       2.0f    /**< Exposure difference of consecutive cycle frames (stops) */
+#define HDR_PREVIEW_MAX_EXPOSURE  33333   /**< Longest cycle exposure (microseconds), the rest goes to gain */
+
+/**
+ * Live HDR preview: the preview stream cycles through 2 or 3 exposures
+ * spaced HDR_PREVIEW_EV_STEP stops apart around the auto-exposure base, and
+ * every streamed frame is fused with the preceding frames of the cycle into
+ * a tone-mapped preview frame. The fusion is a per-pixel weighted blend
+ * (single-scale exposure fusion): the weights prefer well-exposed pixels,
+ * chroma is blended with the weights of the top-left luma pixel of each 2x2
+ * block. The blend runs on 8 pixels at once (NEON, SSE2) in bands of rows on
+ * a thread pool.
+ *
+ * Statistics and 3A of the preview run on the fused frame, with the
+ * geometric mean of the cycle exposures as the reference exposure.
+ */
+class HdrPreview
+{
+public:
+    /**
+     * Default constructor.
+     */
+    HdrPreview( void );
+
+    /**
+     * Default destructor.
+     */
+    ~HdrPreview( void );
+
+    /**
+     * Builds the exposure cycle around a base shot. Exposures are limited to
+     * HDR_PREVIEW_MAX_EXPOSURE (the remaining factor goes to gain) and
+     * minExposure.
+     * @param base preview shot with the auto-exposure (or user) exposure and gain
+     * @param frameCount number of exposures (2 or 3)
+     * @param maxGain maximum sensor gain
+     * @param minExposure minimum exposure (microseconds)
+     * @param burst receives the cycle shots
+     */
+    static void makeBurst( const FCam::Tegra::Shot & base, int frameCount, float maxGain, int minExposure,
+                           std::vector<FCam::Tegra::Shot> & burst );
+
+    /**
+     * Drops the frame history and sets the cycle length.
+     * @param frameCount number of exposures per cycle (2 or 3)
+     */
+    void reset( int frameCount );
+
+    /**
+     * Adds a streamed frame to the history, replacing the oldest one.
+     * @param yuv frame data (YUV420p)
+     * @param width frame width in pixels
+     * @param height frame height in pixels
+     * @param exposure frame exposure (microseconds)
+     * @param gain frame gain
+     */
+    void addFrame( const uchar * yuv, int width, int height, float exposure, float gain );
+
+    /**
+     * Fuses the frames in the history.
+     * @param pool thread pool (can be 0)
+     * @return fused frame (YUV420p, size of the added frames), valid until
+     * the next call
+     */
+    const uchar * fuse( ThreadPool * pool );
+
+    /**
+     * Gets the reference exposure of the fused frame (geometric mean of the
+     * exposure * gain products of the frames in the history).
+     * @param exposure receives the reference exposure
+     * @param gain receives the reference gain
+     */
+    void getReference( float & exposure, float & gain ) const;
+
+private:
+    /**
+     * Fuses a band of row pairs.
+     */
+    static void FuseProc( void * opaque, int index );
+
+    /**
+     * Gets the first row of a band (always even).
+     * @param index band index (0 to m_bandCount)
+     */
+    int getBandRow( int index ) const
+    {
+        return 2 * ( index * ( m_height / 2 ) / m_bandCount );
+    }
+
+    int m_frameCount; /**< Exposures per cycle */
+    int m_width, m_height; /**< Frame size */
+    int m_validFrames; /**< Number of frames in the history */
+    int m_nextFrame; /**< History slot receiving the next frame */
+    int m_bandCount; /**< Number of bands */
+
+    std::vector<uchar> m_frames[HDR_PREVIEW_MAX_FRAMES]; /**< Frame history */
+    float m_exposure[HDR_PREVIEW_MAX_FRAMES]; /**< Exposures of the frames in the history */
+    float m_gain[HDR_PREVIEW_MAX_FRAMES]; /**< Gains of the frames in the history */
+    std::vector<uchar> m_levels; /**< Per band subsampled luma rows (chroma weights) */
+    std::vector<uchar> m_fused; /**< Fused frame */
+};
+
+#endif
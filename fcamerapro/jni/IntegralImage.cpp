@@ -0,0 +1,297 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of IntegralImage.
+ */
+
+#include <string.h>
+#include "IntegralImage.h"
+#include "ThreadPool.h"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Computes one row of a summed-area table: dest[x + 1] = prev[x + 1] + sum(src[0..x]).
+ * The in-row prefix sum is computed four pixels at a time with a log-step
+ * in-register scan.
+ * @param dest pointer to current table row (element 0 is the zero column)
+ * @param prev pointer to previous table row
+ * @param src pointer to source pixels
+ * @param width number of source pixels
+ */
+static void IntegrateRow( uint * dest, const uint * prev, const uchar * src, int width )
+{
+    uint carry = 0;
+    int x = 0;
+
+    dest[0] = 0;
+
+#if defined(__ARM_NEON__)
+    const uint32x4_t zero = vdupq_n_u32( 0 );
+    for ( ; x + 4 <= width; x += 4 )
+    {
+        uint32_t pixels;
+        memcpy( &pixels, src + x, sizeof( pixels ) );
+        uint32x4_t v = vmovl_u16( vget_low_u16( vmovl_u8( vreinterpret_u8_u32( vdup_n_u32( pixels ) ) ) ) );
+        v = vaddq_u32( v, vextq_u32( zero, v, 3 ) );
+        v = vaddq_u32( v, vextq_u32( zero, v, 2 ) );
+        v = vaddq_u32( v, vdupq_n_u32( carry ) );
+        carry = vgetq_lane_u32( v, 3 );
+        vst1q_u32( dest + x + 1, vaddq_u32( v, vld1q_u32( prev + x + 1 ) ) );
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for ( ; x + 4 <= width; x += 4 )
+    {
+        int pixels;
+        memcpy( &pixels, src + x, sizeof( int ) );
+        __m128i v = _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( pixels ), zero ), zero );
+        v = _mm_add_epi32( v, _mm_slli_si128( v, 4 ) );
+        v = _mm_add_epi32( v, _mm_slli_si128( v, 8 ) );
+        v = _mm_add_epi32( v, _mm_set1_epi32( carry ) );
+        carry = _mm_cvtsi128_si32( _mm_shuffle_epi32( v, _MM_SHUFFLE( 3, 3, 3, 3 ) ) );
+        _mm_storeu_si128(( __m128i * )( dest + x + 1 ), _mm_add_epi32( v, _mm_loadu_si128(( const __m128i * )( prev + x + 1 ) ) ) );
+    }
+#endif
+
+    for ( ; x < width; x++ )
+    {
+        carry += src[x];
+        dest[x + 1] = prev[x + 1] + carry;
+    }
+}
+
+IntegralImage::IntegralImage( void )
+{
+    for ( int i = 0; i < EPlaneCount; i++ )
+    {
+        m_tables[i] = 0;
+        m_tableStride[i] = 0;
+    }
+
+    m_squares = 0;
+    m_yuv = 0;
+    m_width = m_height = 0;
+    m_allocWidth = m_allocHeight = 0;
+    m_hasSquares = false;
+    m_valid = false;
+}
+
+IntegralImage::~IntegralImage( void )
+{
+    for ( int i = 0; i < EPlaneCount; i++ )
+    {
+        delete[] m_tables[i];
+    }
+
+    delete[] m_squares;
+}
+
+void IntegralImage::compute( const uchar * yuv, int width, int height, bool squares, ThreadPool * pool )
+{
+    // reallocate on resolution change
+    if ( width != m_allocWidth || height != m_allocHeight )
+    {
+        for ( int i = 0; i < EPlaneCount; i++ )
+        {
+            delete[] m_tables[i];
+        }
+        delete[] m_squares;
+
+        m_tableStride[EPlaneY] = width + 1;
+        m_tableStride[EPlaneCb] = m_tableStride[EPlaneCr] = ( width >> 1 ) + 1;
+
+        m_tables[EPlaneY] = new uint[( width + 1 ) * ( height + 1 )];
+        m_tables[EPlaneCb] = new uint[(( width >> 1 ) + 1 ) * (( height >> 1 ) + 1 )];
+        m_tables[EPlaneCr] = new uint[(( width >> 1 ) + 1 ) * (( height >> 1 ) + 1 )];
+        m_squares = 0;
+
+        m_allocWidth = width;
+        m_allocHeight = height;
+    }
+
+    if ( squares && m_squares == 0 )
+    {
+        m_squares = new unsigned long long[( width + 1 ) * ( height + 1 )];
+    }
+
+    m_yuv = yuv;
+    m_width = width;
+    m_height = height;
+    m_hasSquares = squares;
+
+    // tables are independent, build them in parallel
+    int tableCount = squares ? EPlaneCount + 1 : EPlaneCount;
+    if ( pool != 0 )
+    {
+        pool->run( IntegralImage::TableProc, this, tableCount );
+    }
+    else
+    {
+        for ( int i = 0; i < tableCount; i++ )
+        {
+            TableProc( this, i );
+        }
+    }
+
+    m_valid = true;
+}
+
+void IntegralImage::TableProc( void * opaque, int index )
+{
+    IntegralImage * instance = ( IntegralImage * ) opaque;
+    const int width = instance->m_width;
+    const int height = instance->m_height;
+    const int isize = width * height;
+
+    if ( index == EPlaneCount )
+    {
+        // squared luma (64-bit accumulation)
+        unsigned long long * table = instance->m_squares;
+        const int stride = width + 1;
+        const uchar * src = instance->m_yuv;
+
+        memset( table, 0, sizeof( unsigned long long ) * stride );
+        for ( int y = 0; y < height; y++ )
+        {
+            unsigned long long * dest = table + ( y + 1 ) * stride;
+            const unsigned long long * prev = dest - stride;
+            uint carry = 0;
+
+            dest[0] = 0;
+            for ( int x = 0; x < width; x++ )
+            {
+                carry += src[x] * src[x];
+                dest[x + 1] = prev[x + 1] + carry;
+            }
+            src += width;
+        }
+        return;
+    }
+
+    const uchar * src;
+    int pwidth, pheight;
+    switch ( index )
+    {
+        case EPlaneY:
+            src = instance->m_yuv;
+            pwidth = width;
+            pheight = height;
+            break;
+        case EPlaneCb:
+            src = instance->m_yuv + isize;
+            pwidth = width >> 1;
+            pheight = height >> 1;
+            break;
+        default:
+            src = instance->m_yuv + isize + ( isize >> 2 );
+            pwidth = width >> 1;
+            pheight = height >> 1;
+            break;
+    }
+
+    uint * table = instance->m_tables[index];
+    const int stride = instance->m_tableStride[index];
+
+    memset( table, 0, sizeof( uint ) * stride );
+    for ( int y = 0; y < pheight; y++ )
+    {
+        IntegrateRow( table + ( y + 1 ) * stride, table + y * stride, src, pwidth );
+        src += pwidth;
+    }
+}
+
+bool IntegralImage::clip( EPlane plane, int x, int y, int width, int height, int & x0, int & y0, int & x1, int & y1 ) const
+{
+    x0 = x < 0 ? 0 : x;
+    y0 = y < 0 ? 0 : y;
+    x1 = x + width > m_width ? m_width : x + width;
+    y1 = y + height > m_height ? m_height : y + height;
+
+    if ( plane != EPlaneY )
+    {
+        // chroma planes are subsampled, round the rectangle outwards
+        x0 >>= 1;
+        y0 >>= 1;
+        x1 = ( x1 + 1 ) >> 1;
+        y1 = ( y1 + 1 ) >> 1;
+
+        if ( x1 > ( m_width >> 1 ) )
+        {
+            x1 = m_width >> 1;
+        }
+        if ( y1 > ( m_height >> 1 ) )
+        {
+            y1 = m_height >> 1;
+        }
+    }
+
+    return m_valid && x1 > x0 && y1 > y0;
+}
+
+uint IntegralImage::getSum( EPlane plane, int x0, int y0, int x1, int y1 ) const
+{
+    const uint * table = m_tables[plane];
+    const int stride = m_tableStride[plane];
+
+    return table[y1 * stride + x1] - table[y0 * stride + x1] - table[y1 * stride + x0] + table[y0 * stride + x0];
+}
+
+float IntegralImage::getMean( EPlane plane, int x, int y, int width, int height ) const
+{
+    int x0, y0, x1, y1;
+    if ( !clip( plane, x, y, width, height, x0, y0, x1, y1 ) )
+    {
+        return 0.0f;
+    }
+
+    return ( float ) getSum( plane, x0, y0, x1, y1 ) / (( x1 - x0 ) * ( y1 - y0 ) );
+}
+
+float IntegralImage::getVariance( int x, int y, int width, int height ) const
+{
+    int x0, y0, x1, y1;
+    if ( !m_hasSquares || !clip( EPlaneY, x, y, width, height, x0, y0, x1, y1 ) )
+    {
+        return 0.0f;
+    }
+
+    const int stride = m_width + 1;
+    const unsigned long long * table = m_squares;
+    unsigned long long sqsum = table[y1 * stride + x1] - table[y0 * stride + x1] - table[y1 * stride + x0] + table[y0 * stride + x0];
+
+    double count = ( x1 - x0 ) * ( y1 - y0 );
+    double mean = getSum( EPlaneY, x0, y0, x1, y1 ) / count;
+    double variance = sqsum / count - mean * mean;
+
+    return variance > 0.0 ? ( float ) variance : 0.0f;
+}
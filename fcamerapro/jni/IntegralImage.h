@@ -0,0 +1,146 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _INTEGRALIMAGE_H
+#define _INTEGRALIMAGE_H
+
+/**
+ * @file
+ * Definition of IntegralImage.
+ */
+
+#include "Common.h"
+
+class ThreadPool;
+
+/**
+ * Summed-area tables of a YUV420p frame. After compute() has been called, the mean
+ * of any Y, Cb or Cr rectangle (and the variance of a Y rectangle) is available in
+ * constant time, regardless of the rectangle size.
+ */
+class IntegralImage
+{
+public:
+    /**
+     * Frame planes.
+     */
+    enum EPlane
+    {
+        EPlaneY, EPlaneCb, EPlaneCr, EPlaneCount
+    };
+
+    /**
+     * Default constructor.
+     */
+    IntegralImage( void );
+
+    /**
+     * Default destructor.
+     */
+    ~IntegralImage( void );
+
+    /**
+     * Builds summed-area tables of a YUV420p frame. Tables are reallocated only
+     * when frame resolution changes.
+     * @param yuv pointer to YUV420p frame data (Y plane followed by Cb and Cr planes)
+     * @param width frame width in pixels
+     * @param height frame height in pixels
+     * @param squares if true, squared luma table is built as well (needed by getVariance())
+     * @param pool thread pool used to build the tables in parallel (can be 0)
+     */
+    void compute( const uchar * yuv, int width, int height, bool squares, ThreadPool * pool );
+
+    /**
+     * Gets the mean value of a rectangle. The rectangle is given in luma pixel coordinates
+     * for all planes and is clipped to the frame.
+     * @param plane frame plane
+     * @param x left edge of the rectangle
+     * @param y top edge of the rectangle
+     * @param width rectangle width in pixels
+     * @param height rectangle height in pixels
+     * @return mean value inside the rectangle (0 if empty)
+     */
+    float getMean( EPlane plane, int x, int y, int width, int height ) const;
+
+    /**
+     * Gets the luma variance of a rectangle. Valid only if squared luma table has been built.
+     * @param x left edge of the rectangle
+     * @param y top edge of the rectangle
+     * @param width rectangle width in pixels
+     * @param height rectangle height in pixels
+     * @return luma variance inside the rectangle (0 if empty)
+     */
+    float getVariance( int x, int y, int width, int height ) const;
+
+    /**
+     * Returns true if tables have been built for a frame.
+     * @return true if tables are valid
+     */
+    bool valid( void ) const
+    {
+        return m_valid;
+    }
+
+    int width( void ) const
+    {
+        return m_width;
+    }
+    int height( void ) const
+    {
+        return m_height;
+    }
+
+private:
+    /**
+     * Thread pool task building a single table.
+     * @param opaque pointer to IntegralImage instance
+     * @param index table index (EPlane value or EPlaneCount for squared luma)
+     */
+    static void TableProc( void * opaque, int index );
+
+    /**
+     * Gets the sum of a table rectangle given in table (plane) coordinates.
+     */
+    uint getSum( EPlane plane, int x0, int y0, int x1, int y1 ) const;
+
+    /**
+     * Clips a luma rectangle to the frame and converts it to plane coordinates.
+     * @return false if the clipped rectangle is empty
+     */
+    bool clip( EPlane plane, int x, int y, int width, int height, int & x0, int & y0, int & x1, int & y1 ) const;
+
+    uint * m_tables[EPlaneCount]; /**< Summed-area tables, (w+1)x(h+1) with zero first row and column */
+    unsigned long long * m_squares; /**< Summed-area table of squared luma */
+    int m_tableStride[EPlaneCount]; /**< Table row size in elements */
+
+    const uchar * m_yuv; /**< Current frame data */
+    int m_width, m_height; /**< Frame size in pixels */
+    int m_allocWidth, m_allocHeight; /**< Frame size the tables were allocated for */
+    bool m_hasSquares; /**< Squared luma table is valid */
+    bool m_valid; /**< Tables are valid */
+};
+
+#endif
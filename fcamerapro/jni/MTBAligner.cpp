@@ -0,0 +1,405 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of MTBAligner.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "MTBAligner.h"
+#include "ThreadPool.h"
+#include "HPT.h"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Fetches 64 bits of a bitmap row starting at an arbitrary (possibly negative)
+ * bit position. Bits outside the row are zero.
+ * @param row bitmap row
+ * @param stride row length in words
+ * @param bit position of the first bit
+ * @return 64 consecutive bits
+ */
+static inline uint64_t FetchBits( const uint64_t * row, int stride, int bit )
+{
+    int word = bit >> 6;
+    int shift = bit & 63;
+    uint64_t lo = word >= 0 && word < stride ? row[word] : 0;
+    if ( shift == 0 )
+    {
+        return lo;
+    }
+    uint64_t hi = word + 1 >= 0 && word + 1 < stride ? row[word + 1] : 0;
+    return ( lo >> shift ) | ( hi << ( 64 - shift ) );
+}
+
+/**
+ * Computes a row of the next luma pyramid level (2x2 box filter).
+ * @param r0 even source row
+ * @param r1 odd source row
+ * @param dst destination row
+ * @param width destination width
+ */
+static void Downsample( const uchar * r0, const uchar * r1, uchar * dst, int width )
+{
+    int x = 0;
+
+#if defined(__ARM_NEON__)
+    for ( ; x + 8 <= width; x += 8 )
+    {
+        uint16x8_t sum = vaddq_u16( vpaddlq_u8( vld1q_u8( r0 + 2 * x ) ), vpaddlq_u8( vld1q_u8( r1 + 2 * x ) ) );
+        vst1_u8( dst + x, vrshrn_n_u16( sum, 2 ) );
+    }
+#elif defined(__SSE2__)
+    __m128i mask = _mm_set1_epi16( 0xff );
+    __m128i round = _mm_set1_epi16( 2 );
+    for ( ; x + 8 <= width; x += 8 )
+    {
+        __m128i v0 = _mm_loadu_si128( (const __m128i *) ( r0 + 2 * x ) );
+        __m128i v1 = _mm_loadu_si128( (const __m128i *) ( r1 + 2 * x ) );
+        // 16-bit sums of the even and odd pixels of both rows
+        __m128i sum = _mm_add_epi16( _mm_add_epi16( _mm_and_si128( v0, mask ), _mm_srli_epi16( v0, 8 ) ),
+                                     _mm_add_epi16( _mm_and_si128( v1, mask ), _mm_srli_epi16( v1, 8 ) ) );
+        sum = _mm_srli_epi16( _mm_add_epi16( sum, round ), 2 );
+        _mm_storel_epi64( (__m128i *) ( dst + x ), _mm_packus_epi16( sum, sum ) );
+    }
+#endif
+
+    for ( ; x < width; x++ )
+    {
+        dst[x] = ( r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2 ) >> 2;
+    }
+}
+
+/**
+ * Computes threshold and exclusion bits of a row segment.
+ * @param row luma row segment
+ * @param count number of pixels (at most 64)
+ * @param median median threshold
+ * @param threshold receives the threshold bits (pixel > median)
+ * @param exclusion receives the exclusion bits (|pixel - median| > MTB_NOISE_THRESHOLD)
+ */
+static inline void PackBits( const uchar * row, int count, int median, uint64_t & threshold, uint64_t & exclusion )
+{
+    uint64_t t = 0, e = 0;
+    int i = 0;
+
+#if defined(__ARM_NEON__)
+    static const uchar weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t w = vld1q_u8( weights );
+    uint8x16_t m = vdupq_n_u8( median );
+    uint8x16_t noise = vdupq_n_u8( MTB_NOISE_THRESHOLD );
+    for ( ; i + 16 <= count; i += 16 )
+    {
+        uint8x16_t v = vld1q_u8( row + i );
+        uint8x16_t tm = vandq_u8( vcgtq_u8( v, m ), w );
+        uint8x16_t em = vandq_u8( vcgtq_u8( vabdq_u8( v, m ), noise ), w );
+        // horizontal sums of the weighted masks give 8 bits per half
+        uint8x8_t ts = vpadd_u8( vget_low_u8( tm ), vget_high_u8( tm ) );
+        uint8x8_t es = vpadd_u8( vget_low_u8( em ), vget_high_u8( em ) );
+        ts = vpadd_u8( ts, ts );
+        es = vpadd_u8( es, es );
+        ts = vpadd_u8( ts, ts );
+        es = vpadd_u8( es, es );
+        t |= (uint64_t) vget_lane_u16( vreinterpret_u16_u8( ts ), 0 ) << i;
+        e |= (uint64_t) vget_lane_u16( vreinterpret_u16_u8( es ), 0 ) << i;
+    }
+#elif defined(__SSE2__)
+    __m128i m = _mm_set1_epi8( (char) median );
+    __m128i noise = _mm_set1_epi8( MTB_NOISE_THRESHOLD );
+    __m128i zero = _mm_setzero_si128();
+    for ( ; i + 16 <= count; i += 16 )
+    {
+        __m128i v = _mm_loadu_si128( (const __m128i *) ( row + i ) );
+        __m128i diff = _mm_or_si128( _mm_subs_epu8( v, m ), _mm_subs_epu8( m, v ) );
+        // saturated differences are zero where the condition does not hold
+        uint tm = ~_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_subs_epu8( v, m ), zero ) ) & 0xffff;
+        uint em = ~_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_subs_epu8( diff, noise ), zero ) ) & 0xffff;
+        t |= (uint64_t) tm << i;
+        e |= (uint64_t) em << i;
+    }
+#endif
+
+    for ( ; i < count; i++ )
+    {
+        int v = row[i];
+        t |= (uint64_t) ( v > median ) << i;
+        e |= (uint64_t) ( v > median + MTB_NOISE_THRESHOLD || v < median - MTB_NOISE_THRESHOLD ) << i;
+    }
+
+    threshold = t;
+    exclusion = e;
+}
+
+/**
+ * Translates a single image plane in place with border replication.
+ * @param plane image plane
+ * @param width plane width
+ * @param height plane height
+ * @param dx horizontal offset
+ * @param dy vertical offset
+ */
+static void TranslatePlane( uchar * plane, int width, int height, int dx, int dy )
+{
+    dx = std::min( std::max( dx, 1 - width ), width - 1 );
+    int step = dy >= 0 ? 1 : -1;
+    int y = dy >= 0 ? 0 : height - 1;
+
+    // rows are processed in the direction of the shift, so a source row is never overwritten before it is read
+    for ( int i = 0; i < height; i++, y += step )
+    {
+        uchar * dst = plane + y * width;
+        const uchar * src = plane + std::min( std::max( y + dy, 0 ), height - 1 ) * width;
+        if ( dx >= 0 )
+        {
+            uchar edge = src[width - 1];
+            memmove( dst, src + dx, width - dx );
+            memset( dst + width - dx, edge, dx );
+        }
+        else
+        {
+            uchar edge = src[0];
+            memmove( dst - dx, src, width + dx );
+            memset( dst, edge, -dx );
+        }
+    }
+}
+
+MTBAligner::MTBAligner( void ) : m_frames( 0 ), m_referenceIndex( 0 ), m_width( 0 ), m_height( 0 ), m_offsets( 0 )
+{
+}
+
+void MTBAligner::align( const uchar * const * frames, int frameCount, int reference, int width, int height, int * offsets,
+                        ThreadPool * pool )
+{
+    Timer timer;
+
+    m_frames = frames;
+    m_referenceIndex = reference;
+    m_width = width;
+    m_height = height;
+    m_offsets = offsets;
+
+    BuildPyramid( frames[reference], width, height, m_reference );
+
+    if ( pool != 0 )
+    {
+        pool->run( MTBAligner::AlignProc, this, frameCount );
+    }
+    else
+    {
+        for ( int i = 0; i < frameCount; i++ )
+        {
+            AlignProc( this, i );
+        }
+    }
+
+    LOG( "MTBAligner: %d frames aligned in %.1f ms\n", frameCount, timer.get() );
+}
+
+void MTBAligner::AlignProc( void * opaque, int index )
+{
+    MTBAligner * instance = (MTBAligner *) opaque;
+    int * offset = instance->m_offsets + 2 * index;
+
+    offset[0] = offset[1] = 0;
+    if ( index == instance->m_referenceIndex )
+    {
+        return;
+    }
+
+    Pyramid pyramid;
+    BuildPyramid( instance->m_frames[index], instance->m_width, instance->m_height, pyramid );
+    instance->search( pyramid, offset[0], offset[1] );
+}
+
+void MTBAligner::setReference( const uchar * frame, int width, int height )
+{
+    m_width = width;
+    m_height = height;
+    BuildPyramid( frame, width, height, m_reference );
+}
+
+void MTBAligner::alignToReference( const uchar * frame, int & dx, int & dy )
+{
+    Pyramid pyramid;
+    BuildPyramid( frame, m_width, m_height, pyramid );
+    search( pyramid, dx, dy );
+}
+
+void MTBAligner::search( const Pyramid & pyramid, int & dx, int & dy ) const
+{
+    dx = dy = 0;
+    for ( int level = pyramid.levelCount - 1; level >= 0; level-- )
+    {
+        dx *= 2;
+        dy *= 2;
+
+        // center first, so ties keep the current estimate
+        int bestX = dx, bestY = dy;
+        int bestError = getError( pyramid, level, dx, dy );
+        for ( int j = -1; j <= 1; j++ )
+        {
+            for ( int i = -1; i <= 1; i++ )
+            {
+                if ( i == 0 && j == 0 )
+                {
+                    continue;
+                }
+
+                int error = getError( pyramid, level, dx + i, dy + j );
+                if ( error < bestError )
+                {
+                    bestError = error;
+                    bestX = dx + i;
+                    bestY = dy + j;
+                }
+            }
+        }
+
+        dx = bestX;
+        dy = bestY;
+    }
+}
+
+void MTBAligner::BuildPyramid( const uchar * luma, int width, int height, Pyramid & pyramid )
+{
+    // luma pyramid (2x2 box filter), level 0 is the frame itself
+    std::vector<uchar> levels[MTB_MAX_LEVELS];
+    const uchar * data[MTB_MAX_LEVELS];
+
+    data[0] = luma;
+    pyramid.widths[0] = width;
+    pyramid.heights[0] = height;
+    pyramid.levelCount = 1;
+    while ( pyramid.levelCount < MTB_MAX_LEVELS &&
+            std::min( pyramid.widths[pyramid.levelCount - 1], pyramid.heights[pyramid.levelCount - 1] ) >= 2 * MTB_MIN_LEVEL_SIZE )
+    {
+        int l = pyramid.levelCount++;
+        int sw = pyramid.widths[l - 1];
+        int w = pyramid.widths[l] = sw >> 1;
+        int h = pyramid.heights[l] = pyramid.heights[l - 1] >> 1;
+
+        levels[l].resize( w * h );
+        const uchar * src = data[l - 1];
+        uchar * dst = &levels[l][0];
+        for ( int y = 0; y < h; y++ )
+        {
+            Downsample( src + 2 * y * sw, src + ( 2 * y + 1 ) * sw, dst + y * w, w );
+        }
+        data[l] = dst;
+    }
+
+    // threshold and exclusion bitmaps
+    for ( int l = 0; l < pyramid.levelCount; l++ )
+    {
+        int w = pyramid.widths[l];
+        int h = pyramid.heights[l];
+        int stride = pyramid.strides[l] = ( w + 63 ) >> 6;
+        const uchar * src = data[l];
+
+        // the full resolution median is estimated from every other pixel and row
+        int step = l == 0 ? 2 : 1;
+        int histogram[256];
+        int total = 0;
+        memset( histogram, 0, sizeof( histogram ) );
+        for ( int y = 0; y < h; y += step )
+        {
+            const uchar * row = src + y * w;
+            for ( int x = 0; x < w; x += step )
+            {
+                histogram[row[x]]++;
+            }
+            total += ( w + step - 1 ) / step;
+        }
+
+        int median = 0;
+        for ( int count = 0; median < 255; median++ )
+        {
+            count += histogram[median];
+            if ( 2 * count >= total )
+            {
+                break;
+            }
+        }
+
+        pyramid.threshold[l].assign( stride * h, 0 );
+        pyramid.exclusion[l].assign( stride * h, 0 );
+        for ( int y = 0; y < h; y++ )
+        {
+            const uchar * row = src + y * w;
+            uint64_t * tb = &pyramid.threshold[l][y * stride];
+            uint64_t * eb = &pyramid.exclusion[l][y * stride];
+            for ( int x0 = 0; x0 < w; x0 += 64 )
+            {
+                PackBits( row + x0, std::min( 64, w - x0 ), median, tb[x0 >> 6], eb[x0 >> 6] );
+            }
+        }
+    }
+}
+
+int MTBAligner::getError( const Pyramid & pyramid, int level, int dx, int dy ) const
+{
+    int h = pyramid.heights[level];
+    int stride = pyramid.strides[level];
+    int error = 0;
+
+    for ( int y = std::max( 0, -dy ); y < std::min( h, h - dy ); y++ )
+    {
+        const uint64_t * rt = &m_reference.threshold[level][y * stride];
+        const uint64_t * re = &m_reference.exclusion[level][y * stride];
+        const uint64_t * ft = &pyramid.threshold[level][( y + dy ) * stride];
+        const uint64_t * fe = &pyramid.exclusion[level][( y + dy ) * stride];
+
+        for ( int i = 0; i < stride; i++ )
+        {
+            int bit = ( i << 6 ) + dx;
+            uint64_t diff = ( rt[i] ^ FetchBits( ft, stride, bit ) ) & re[i] & FetchBits( fe, stride, bit );
+            error += __builtin_popcountll( diff );
+        }
+    }
+
+    return error;
+}
+
+void MTBAligner::Translate( uchar * yuv, int width, int height, int dx, int dy )
+{
+    if ( dx == 0 && dy == 0 )
+    {
+        return;
+    }
+
+    int lumaSize = width * height;
+    TranslatePlane( yuv, width, height, dx, dy );
+    TranslatePlane( yuv + lumaSize, width >> 1, height >> 1, dx / 2, dy / 2 );
+    TranslatePlane( yuv + lumaSize + ( lumaSize >> 2 ), width >> 1, height >> 1, dx / 2, dy / 2 );
+}
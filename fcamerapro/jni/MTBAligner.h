@@ -0,0 +1,164 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _MTB_ALIGNER_H
+#define _MTB_ALIGNER_H
+
+/**
+ * @file
+ * Definition of MTBAligner.
+ */
+
+#include <vector>
+#include <stdint.h>
+#include "Common.h"
+
+class ThreadPool;
+
+#define MTB_MAX_LEVELS      6  /**< Number of pyramid levels, limits the search range to +/-(2^MTB_MAX_LEVELS - 1) pixels */
+#define MTB_MIN_LEVEL_SIZE  16 /**< Smallest pyramid level dimension in pixels */
+#define MTB_NOISE_THRESHOLD 4  /**< Pixels closer to the median than this are excluded from the comparison */
+
+/**
+ * Median threshold bitmap alignment (Ward 2003). Estimates the translation of
+ * hand-held, differently exposed frames relative to a reference frame. Each
+ * frame's luma is reduced to a pyramid of bitmaps thresholded at the level's
+ * median (exposure invariant), together with exclusion bitmaps masking pixels
+ * close to the median. The bitmaps are packed 64 pixels per word, so comparing
+ * two shifted bitmaps is a word-wide XOR, AND with both exclusion masks and a
+ * population count. The translation is refined coarse-to-fine testing the
+ * 3x3 neighbourhood of the doubled estimate from the previous level.
+ *
+ * Frames are aligned in parallel on a thread pool, each one against the
+ * reference pyramid built once up front.
+ */
+class MTBAligner
+{
+public:
+    /**
+     * Default constructor.
+     */
+    MTBAligner( void );
+
+    /**
+     * Estimates the translation of each frame relative to the reference frame.
+     * @param frames YUV420p (or plain luma) frame data, only the luma plane is used
+     * @param frameCount number of frames
+     * @param reference index of the reference frame
+     * @param width frame width in pixels
+     * @param height frame height in pixels
+     * @param offsets receives 2 * frameCount values, (dx, dy) such that frame
+     * pixel (x + dx, y + dy) matches reference pixel (x, y)
+     * @param pool thread pool used to align frames in parallel (0 for the calling thread only)
+     */
+    void align( const uchar * const * frames, int frameCount, int reference, int width, int height, int * offsets,
+                ThreadPool * pool );
+
+    /**
+     * Builds and keeps the bitmap pyramid of a reference frame for alignToReference(),
+     * for frames that arrive one at a time.
+     * @param frame YUV420p (or plain luma) frame data, only the luma plane is used
+     * @param width frame width in pixels
+     * @param height frame height in pixels
+     */
+    void setReference( const uchar * frame, int width, int height );
+
+    /**
+     * Estimates the translation of a frame relative to the reference frame set
+     * with setReference().
+     * @param frame YUV420p (or plain luma) frame data of the reference size
+     * @param dx receives the horizontal offset (frame pixel (x + dx, y + dy)
+     * matches reference pixel (x, y))
+     * @param dy receives the vertical offset
+     */
+    void alignToReference( const uchar * frame, int & dx, int & dy );
+
+    /**
+     * Translates a YUV420p frame in place so that it matches the reference:
+     * pixel (x, y) takes the value of (x + dx, y + dy), pixels shifted in from
+     * outside replicate the border. Chroma planes move by half the offset.
+     * @param yuv YUV420p frame data
+     * @param width frame width in pixels
+     * @param height frame height in pixels
+     * @param dx horizontal offset (as returned by align())
+     * @param dy vertical offset (as returned by align())
+     */
+    static void Translate( uchar * yuv, int width, int height, int dx, int dy );
+
+private:
+    /**
+     * Median threshold and exclusion bitmap pyramid of a single frame.
+     */
+    struct Pyramid
+    {
+        int levelCount; /**< Number of levels */
+        int widths[MTB_MAX_LEVELS]; /**< Level widths in pixels */
+        int heights[MTB_MAX_LEVELS]; /**< Level heights in pixels */
+        int strides[MTB_MAX_LEVELS]; /**< Level row lengths in 64-bit words */
+        std::vector<uint64_t> threshold[MTB_MAX_LEVELS]; /**< Median threshold bitmaps */
+        std::vector<uint64_t> exclusion[MTB_MAX_LEVELS]; /**< Exclusion bitmaps (1 - pixel used) */
+    };
+
+    static void AlignProc( void * opaque, int index );
+
+    /**
+     * Refines the translation of a frame pyramid relative to the reference
+     * pyramid coarse-to-fine.
+     * @param pyramid frame pyramid
+     * @param dx receives the horizontal offset
+     * @param dy receives the vertical offset
+     */
+    void search( const Pyramid & pyramid, int & dx, int & dy ) const;
+
+    /**
+     * Builds bitmap pyramid of a luma plane.
+     * @param luma luma plane
+     * @param width plane width
+     * @param height plane height
+     * @param pyramid receives the bitmap pyramid
+     */
+    static void BuildPyramid( const uchar * luma, int width, int height, Pyramid & pyramid );
+
+    /**
+     * Counts the differing, non-excluded pixels of a pyramid level and the
+     * reference level when the level is shifted by (dx, dy).
+     * @param pyramid frame pyramid
+     * @param level pyramid level
+     * @param dx horizontal shift in level pixels
+     * @param dy vertical shift in level pixels
+     * @return number of mismatched pixels
+     */
+    int getError( const Pyramid & pyramid, int level, int dx, int dy ) const;
+
+    Pyramid m_reference; /**< Reference frame pyramid */
+    const uchar * const * m_frames; /**< Frames being aligned */
+    int m_referenceIndex; /**< Index of the reference frame */
+    int m_width; /**< Frame width */
+    int m_height; /**< Frame height */
+    int * m_offsets; /**< Output offsets */
+};
+
+#endif
@@ -0,0 +1,252 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdlib.h>
+#include <algorithm>
+#include "NightAccumulator.h"
+#include "ThreadPool.h"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Gets the reciprocal used to average sums of a frame count:
+ * ((sum + count / 2) * reciprocal) >> 16 (0 for a single frame, the sum is
+ * the mean then).
+ * @param frameCount number of frames (1 to NIGHT_MAX_FRAMES)
+ */
+static inline int GetReciprocal( int frameCount )
+{
+    // rounded to nearest: a constant sample averages back to itself, the mean is
+    // within 1 of the exact rounded quotient and never exceeds 255
+    return frameCount > 1 ? ( 65536 + ( frameCount >> 1 ) ) / frameCount : 0;
+}
+
+/**
+ * Adds samples to their sums, replacing outliers by the running mean.
+ * @param sum sample sums
+ * @param src samples to add
+ * @param frameCount number of frames in the sums
+ * @param count number of samples
+ */
+static void AccumulateSamples( ushort * sum, const uchar * src, int frameCount, int count )
+{
+    int reciprocal = GetReciprocal( frameCount );
+    int half = frameCount >> 1;
+    int x = 0;
+
+#if defined(__ARM_NEON__)
+    const uint16x8_t vr = vdupq_n_u16( reciprocal );
+    const uint16x8_t vh = vdupq_n_u16( half );
+    const uint16x8_t vt = vdupq_n_u16( NIGHT_OUTLIER_THRESHOLD );
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        uint16x8_t s = vld1q_u16( sum + x );
+        uint16x8_t mean = s;
+        if ( reciprocal != 0 )
+        {
+            uint16x8_t r = vaddq_u16( s, vh );
+            uint32x4_t lo = vmull_u16( vget_low_u16( r ), vget_low_u16( vr ) );
+            uint32x4_t hi = vmull_u16( vget_high_u16( r ), vget_high_u16( vr ) );
+            mean = vcombine_u16( vshrn_n_u32( lo, 16 ), vshrn_n_u32( hi, 16 ) );
+        }
+        uint16x8_t v = vmovl_u8( vld1_u8( src + x ) );
+        uint16x8_t outlier = vcgtq_u16( vabdq_u16( v, mean ), vt );
+        vst1q_u16( sum + x, vaddq_u16( s, vbslq_u16( outlier, mean, v ) ) );
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vr = _mm_set1_epi16(( short ) reciprocal );
+    const __m128i vh = _mm_set1_epi16(( short ) half );
+    const __m128i vt = _mm_set1_epi16( NIGHT_OUTLIER_THRESHOLD );
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        __m128i s = _mm_loadu_si128(( const __m128i * )( sum + x ) );
+        __m128i mean = reciprocal != 0 ? _mm_mulhi_epu16( _mm_add_epi16( s, vh ), vr ) : s;
+        __m128i v = _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( src + x ) ), zero );
+        // means and samples are below 256, signed comparisons work
+        __m128i d = _mm_sub_epi16( v, mean );
+        d = _mm_max_epi16( d, _mm_sub_epi16( zero, d ) );
+        __m128i outlier = _mm_cmpgt_epi16( d, vt );
+        v = _mm_or_si128( _mm_and_si128( outlier, mean ), _mm_andnot_si128( outlier, v ) );
+        _mm_storeu_si128(( __m128i * )( sum + x ), _mm_add_epi16( s, v ) );
+    }
+#endif
+
+    for ( ; x < count; x++ )
+    {
+        int mean = reciprocal != 0 ? ( int )((( uint )( sum[x] + half ) * reciprocal ) >> 16 ) : sum[x];
+        int v = src[x];
+        sum[x] = ( ushort )( sum[x] + ( abs( v - mean ) > NIGHT_OUTLIER_THRESHOLD ? mean : v ) );
+    }
+}
+
+/**
+ * Averages sample sums.
+ * @param dst averaged samples
+ * @param sum sample sums
+ * @param frameCount number of frames in the sums
+ * @param count number of samples
+ */
+static void AverageSamples( uchar * dst, const ushort * sum, int frameCount, int count )
+{
+    int reciprocal = GetReciprocal( frameCount );
+    int half = frameCount >> 1;
+    int x = 0;
+
+#if defined(__ARM_NEON__)
+    const uint16x8_t vr = vdupq_n_u16( reciprocal );
+    const uint16x8_t vh = vdupq_n_u16( half );
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        uint16x8_t s = vld1q_u16( sum + x );
+        if ( reciprocal != 0 )
+        {
+            uint16x8_t r = vaddq_u16( s, vh );
+            uint32x4_t lo = vmull_u16( vget_low_u16( r ), vget_low_u16( vr ) );
+            uint32x4_t hi = vmull_u16( vget_high_u16( r ), vget_high_u16( vr ) );
+            s = vcombine_u16( vshrn_n_u32( lo, 16 ), vshrn_n_u32( hi, 16 ) );
+        }
+        vst1_u8( dst + x, vqmovn_u16( s ) );
+    }
+#elif defined(__SSE2__)
+    const __m128i vr = _mm_set1_epi16(( short ) reciprocal );
+    const __m128i vh = _mm_set1_epi16(( short ) half );
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        __m128i s = _mm_loadu_si128(( const __m128i * )( sum + x ) );
+        if ( reciprocal != 0 )
+        {
+            s = _mm_mulhi_epu16( _mm_add_epi16( s, vh ), vr );
+        }
+        _mm_storel_epi64(( __m128i * )( dst + x ), _mm_packus_epi16( s, s ) );
+    }
+#endif
+
+    for ( ; x < count; x++ )
+    {
+        int mean = reciprocal != 0 ? ( int )((( uint )( sum[x] + half ) * reciprocal ) >> 16 ) : sum[x];
+        dst[x] = ( uchar ) std::min( mean, 255 );
+    }
+}
+
+NightAccumulator::NightAccumulator( void ) : m_width( 0 ), m_height( 0 ), m_frameCount( 0 ), m_bandCount( 1 ), m_frame( 0 )
+{
+}
+
+NightAccumulator::~NightAccumulator( void )
+{
+}
+
+void NightAccumulator::reset( int width, int height )
+{
+    m_width = width;
+    m_height = height;
+    m_frameCount = 0;
+    m_sum.assign( width * height * 3 / 2, 0 );
+}
+
+bool NightAccumulator::add( uchar * yuv, ThreadPool * pool )
+{
+    if ( m_frameCount >= NIGHT_MAX_FRAMES || m_sum.empty() )
+    {
+        return false;
+    }
+
+    if ( m_frameCount == 0 )
+    {
+        m_aligner.setReference( yuv, m_width, m_height );
+    }
+    else
+    {
+        int dx, dy;
+        m_aligner.alignToReference( yuv, dx, dy );
+        if ( dx != 0 || dy != 0 )
+        {
+            MTBAligner::Translate( yuv, m_width, m_height, dx, dy );
+        }
+    }
+
+    m_frame = yuv;
+    runBands( NightAccumulator::AccumulateProc, pool );
+    m_frameCount++;
+
+    return true;
+}
+
+void NightAccumulator::resolve( uchar * yuv, ThreadPool * pool )
+{
+    m_frame = yuv;
+    runBands( NightAccumulator::ResolveProc, pool );
+}
+
+void NightAccumulator::runBands( void ( *proc )( void *, int ), ThreadPool * pool )
+{
+    m_bandCount = pool != 0 ? pool->concurrency() : 1;
+    if ( pool != 0 )
+    {
+        pool->run( proc, this, m_bandCount );
+    }
+    else
+    {
+        proc( this, 0 );
+    }
+}
+
+void NightAccumulator::AccumulateProc( void * opaque, int index )
+{
+    NightAccumulator * self = ( NightAccumulator * ) opaque;
+
+    int start = self->getBandStart( index );
+    int end = self->getBandStart( index + 1 );
+    if ( self->m_frameCount == 0 )
+    {
+        std::copy( self->m_frame + start, self->m_frame + end, self->m_sum.begin() + start );
+    }
+    else
+    {
+        AccumulateSamples( &self->m_sum[start], self->m_frame + start, self->m_frameCount, end - start );
+    }
+}
+
+void NightAccumulator::ResolveProc( void * opaque, int index )
+{
+    NightAccumulator * self = ( NightAccumulator * ) opaque;
+
+    int start = self->getBandStart( index );
+    int end = self->getBandStart( index + 1 );
+    if ( self->m_frameCount == 0 )
+    {
+        std::fill( self->m_frame + start, self->m_frame + end, 0 );
+    }
+    else
+    {
+        AverageSamples( self->m_frame + start, &self->m_sum[start], self->m_frameCount, end - start );
+    }
+}
@@ -0,0 +1,137 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _NIGHT_ACCUMULATOR_H
+#define _NIGHT_ACCUMULATOR_H
+
+/**
+ * @file
+ * Definition of NightAccumulator.
+ */
+
+#include <vector>
+#include "Common.h"
+#include "MTBAligner.h"
+
+class ThreadPool;
+
+#define NIGHT_MAX_FRAMES         255 /**< Largest frame count the 16-bit accumulator holds */
+#define NIGHT_OUTLIER_THRESHOLD  32  /**< Largest difference of a sample to the running mean that is accumulated */
+
+/**
+ * Night mode accumulator: averages a stream of short, hand-held exposures
+ * into a low-noise image on the fly. The first frame is the alignment
+ * reference (see MTBAligner), every following frame is translated to match
+ * it and added to a 16-bit sum of all YUV420p samples. Samples that differ
+ * from the running mean by more than NIGHT_OUTLIER_THRESHOLD (moving
+ * objects, misalignment) are replaced by the mean, so every sample keeps the
+ * same frame count. The memory use is the sum and the reference bitmaps,
+ * independent of the frame count.
+ *
+ * Means are computed with a 16-bit reciprocal multiply, on 8 samples at once
+ * (NEON, SSE2), in bands of samples on a thread pool.
+ */
+class NightAccumulator
+{
+public:
+    /**
+     * Default constructor.
+     */
+    NightAccumulator( void );
+
+    /**
+     * Default destructor.
+     */
+    ~NightAccumulator( void );
+
+    /**
+     * Drops the accumulated frames and sets the frame size.
+     * @param width frame width in pixels
+     * @param height frame height in pixels
+     */
+    void reset( int width, int height );
+
+    /**
+     * Aligns a frame to the first one and adds it. Frames beyond
+     * NIGHT_MAX_FRAMES are ignored.
+     * @param yuv YUV420p frame data of the accumulator size, translated in place
+     * @param pool thread pool (can be 0)
+     * @return true if the frame has been added
+     */
+    bool add( uchar * yuv, ThreadPool * pool );
+
+    /**
+     * Gets the number of accumulated frames.
+     */
+    int getFrameCount( void ) const
+    {
+        return m_frameCount;
+    }
+
+    /**
+     * Writes the average of the accumulated frames.
+     * @param yuv output YUV420p frame data of the accumulator size
+     * @param pool thread pool (can be 0)
+     */
+    void resolve( uchar * yuv, ThreadPool * pool );
+
+private:
+    /**
+     * Adds a band of samples.
+     */
+    static void AccumulateProc( void * opaque, int index );
+
+    /**
+     * Averages a band of samples.
+     */
+    static void ResolveProc( void * opaque, int index );
+
+    /**
+     * Runs a band function on the pool or the calling thread.
+     * @param proc band function
+     * @param pool thread pool (can be 0)
+     */
+    void runBands( void ( *proc )( void *, int ), ThreadPool * pool );
+
+    /**
+     * Gets the first sample of a band.
+     * @param index band index (0 to m_bandCount)
+     */
+    int getBandStart( int index ) const
+    {
+        return ( int )(( long long ) index * m_sum.size() / m_bandCount );
+    }
+
+    int m_width, m_height; /**< Frame size */
+    int m_frameCount; /**< Number of accumulated frames */
+    int m_bandCount; /**< Number of bands */
+    uchar * m_frame; /**< Frame being added or resolved */
+
+    MTBAligner m_aligner; /**< Aligner holding the reference bitmaps */
+    std::vector<ushort> m_sum; /**< Sum of the accumulated samples */
+};
+
+#endif
@@ -32,6 +32,7 @@
  * Definition of ParamSetRequest.
  */
 
+#include <string.h>
 #include "Common.h"
 
 #define HISTOGRAM_SIZE 256 /**< Histogram bin count (needs to match Java counterpart!) */
@@ -61,6 +62,20 @@
 #define PARAM_FOCUS_ON_TOUCH           18 /**< Touch to focus event (float array, write) */
 #define PARAM_WB_ON_TOUCH              19 /**< Touch to white balance event (float array, write) */
 #define PARAM_SELECT_CAMERA            20 /**< Select capture camera front/back/stereo (int, read/write) */
+#define PARAM_RGB_HISTOGRAM            21 /**< Preview stream R, G and B histogram data (float array, read) */
+#define PARAM_PREVIEW_METERING_MODE    22 /**< Preview stream exposure metering mode (int, read/write) */
+#define PARAM_PREVIEW_3A_SKIP_RATIO    23 /**< Ratio of preview frames 3A evaluation has been skipped for (float, read) */
+#define PARAM_RESPONSE_CURVE           24 /**< Camera response curve of the current sensor and a gain: R, G, B curves and the gain (float array, write) */
+#define PARAM_TONE_MAP_OPERATOR        25 /**< Tone mapping operator for radiance maps (int, read/write) */
+#define PARAM_ALIGN_FRAMES             26 /**< Align frames before multi-frame merges on/off (int, read/write) */
+#define PARAM_RECALIBRATE              27 /**< Drop the calibration data of the current sensor (int, write) */
+#define PARAM_CALIBRATED_GAINS         28 /**< Gain buckets of the current sensor with a calibrated response curve (int, read) */
+#define PARAM_STEREO_DISPARITY_ON      29 /**< Stereo preview disparity map computation on/off (int, read/write) */
+#define PARAM_DISPARITY_MAP_WIDTH      30 /**< Width of the latest stereo preview disparity map (int, read) */
+#define PARAM_DISPARITY_MAP_HEIGHT     31 /**< Height of the latest stereo preview disparity map (int, read) */
+#define PARAM_PREVIEW_HDR_FRAMES       32 /**< Exposures per HDR preview cycle, 0 - HDR preview off (int, read/write) */
+#define PARAM_NIGHT_FRAMES             33 /**< Frame budget of night mode captures (int, read/write) */
+#define PARAM_LUCKY_FRAMES             34 /**< Number of sharpest burst frames kept in lucky shot mode (int, read/write) */
 
 #define PARAM_PRIV_FS_CHANGED     100 /**< File system changed notification */
 
@@ -75,11 +90,29 @@
 #define SHOT_PARAM_GAIN     2 /**< #PARAM_SHOT gain value */
 #define SHOT_PARAM_WB       3 /**< #PARAM_SHOT color temperature value */
 #define SHOT_PARAM_FLASH    4 /**< #PARAM_SHOT flash state value */
+#define SHOT_PARAM_RAW      5 /**< #PARAM_SHOT raw capture state value */
+#define SHOT_PARAM_COUNT    6 /**< #PARAM_SHOT array size */
 
 #define SELECT_FRONT_CAMERA  0 /**< #PARAM_SELECT_CAMERA value */
 #define SELECT_BACK_CAMERA   1 /**< #PARAM_SELECT_CAMERA value */
 #define SELECT_STEREO_CAMERA 2 /**< #PARAM_SELECT_CAMERA value */
 
+#define OUTPUT_FORMAT_JPEG              0 /**< #PARAM_OUTPUT_FORMAT value */
+#define OUTPUT_FORMAT_JPEG_RADIANCE     1 /**< #PARAM_OUTPUT_FORMAT value, JPEG images and a merged radiance map */
+#define OUTPUT_FORMAT_JPEG_FUSION       2 /**< #PARAM_OUTPUT_FORMAT value, JPEG images and their exposure fusion */
+#define OUTPUT_FORMAT_JPEG_BURST_MERGE  3 /**< #PARAM_OUTPUT_FORMAT value, JPEG images and their denoised burst merge */
+#define OUTPUT_FORMAT_JPEG_FLASH_FUSION 4 /**< #PARAM_OUTPUT_FORMAT value, JPEG images and the fusion of a no-flash/flash pair */
+#define OUTPUT_FORMAT_JPEG_FOCUS_STACK  5 /**< #PARAM_OUTPUT_FORMAT value, JPEG images and the all-in-focus composite of a focus bracket */
+#define OUTPUT_FORMAT_JPEG_NIGHT        6 /**< #PARAM_OUTPUT_FORMAT value, JPEG image and the average of a stream of aligned short exposures */
+#define OUTPUT_FORMAT_JPEG_LUCKY        7 /**< #PARAM_OUTPUT_FORMAT value, JPEG images of the sharpest frames of a burst */
+
+#define TONE_MAP_OPERATOR_GLOBAL 0 /**< #PARAM_TONE_MAP_OPERATOR value */
+#define TONE_MAP_OPERATOR_LOCAL  1 /**< #PARAM_TONE_MAP_OPERATOR value */
+
+#define METERING_MODE_MATRIX          0 /**< #PARAM_PREVIEW_METERING_MODE value */
+#define METERING_MODE_CENTER_WEIGHTED 1 /**< #PARAM_PREVIEW_METERING_MODE value */
+#define METERING_MODE_SPOT            2 /**< #PARAM_PREVIEW_METERING_MODE value */
+
 /**< @} */
 
 /**
@@ -0,0 +1,284 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of RadianceMerge.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "RadianceMerge.h"
+#include "ColorConversion.h"
+#include "ThreadPool.h"
+#include "HPT.h"
+
+/**
+ * Orders frame indices by their exposure.
+ */
+class ExposureOrder
+{
+public:
+    ExposureOrder( const float * logExposure ) : m_logExposure( logExposure ) { }
+
+    bool operator()( int a, int b ) const
+    {
+        return m_logExposure[a] < m_logExposure[b];
+    }
+
+private:
+    const float * m_logExposure;
+};
+
+/**
+ * Encodes a linear RGB value to Radiance shared-exponent format.
+ */
+static inline void EncodeRGBE( float r, float g, float b, uchar * rgbe )
+{
+    float v = std::max( r, std::max( g, b ) );
+    if ( v < 1e-32f )
+    {
+        rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+        return;
+    }
+
+    int e;
+    float scale = frexpf( v, &e ) * 256.0f / v;
+    rgbe[0] = (uchar) ( r * scale );
+    rgbe[1] = (uchar) ( g * scale );
+    rgbe[2] = (uchar) ( b * scale );
+    rgbe[3] = (uchar) ( e + 128 );
+}
+
+RadianceMerge::RadianceMerge( void ) : m_frames( 0 ), m_width( 0 ), m_height( 0 ), m_bandY( 0 ), m_bandHeight( 0 )
+{
+    GetDefaultResponseCurve( m_curve );
+
+    for ( int i = 0; i < RESPONSE_CURVE_SIZE; i++ )
+    {
+        m_weights[i] = (float) ( i <= RESPONSE_CURVE_SIZE / 2 - 1 ? i : RESPONSE_CURVE_SIZE - 1 - i );
+    }
+}
+
+void RadianceMerge::GetDefaultResponseCurve( float * curve )
+{
+    float linear[RESPONSE_CURVE_SIZE];
+    for ( int i = 0; i < RESPONSE_CURVE_SIZE; i++ )
+    {
+        // z = 0 would map to -inf, use half a code value instead
+        float c = std::max( i, 1 ) / 255.0f;
+        if ( i == 0 )
+        {
+            c *= 0.5f;
+        }
+        linear[i] = c <= 0.04045f ? c / 12.92f : powf( ( c + 0.055f ) / 1.055f, 2.4f );
+    }
+
+    float offset = logf( linear[RESPONSE_CURVE_MIDPOINT] );
+    for ( int i = 0; i < RESPONSE_CURVE_SIZE; i++ )
+    {
+        curve[i] = curve[i + RESPONSE_CURVE_SIZE] = curve[i + 2 * RESPONSE_CURVE_SIZE] = logf( linear[i] ) - offset;
+    }
+}
+
+void RadianceMerge::setResponseCurve( const float * curve )
+{
+    if ( curve == 0 )
+    {
+        GetDefaultResponseCurve( m_curve );
+    }
+    else
+    {
+        memcpy( m_curve, curve, sizeof( m_curve ) );
+    }
+}
+
+bool RadianceMerge::write( const char * fileName, const uchar * const * frames, const float * logExposure, int frameCount,
+                           int width, int height, ThreadPool * pool, uchar * rgbe )
+{
+    if ( frameCount <= 0 || width <= 0 || height <= 0 )
+    {
+        return false;
+    }
+
+    FILE * file = fopen( fileName, "wb" );
+    if ( file == 0 )
+    {
+        ERROR( "RadianceMerge: cannot open %s", fileName );
+        return false;
+    }
+
+    Timer timer;
+
+    // per-frame tables g(z) - ln(dt)
+    m_tables.resize( frameCount * 3 * RESPONSE_CURVE_SIZE );
+    m_order.resize( frameCount );
+    for ( int i = 0; i < frameCount; i++ )
+    {
+        float * table = &m_tables[i * 3 * RESPONSE_CURVE_SIZE];
+        for ( int j = 0; j < 3 * RESPONSE_CURVE_SIZE; j++ )
+        {
+            table[j] = m_curve[j] - logExposure[i];
+        }
+        m_order[i] = i;
+    }
+    std::sort( m_order.begin(), m_order.end(), ExposureOrder( logExposure ) );
+
+    m_frames = frames;
+    m_width = width;
+    m_height = height;
+    m_band.resize( width * RADIANCE_TILE_HEIGHT * 4 );
+
+    fprintf( file, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %i +X %i\n", height, width );
+
+    int tileCount = ( width + RADIANCE_TILE_WIDTH - 1 ) / RADIANCE_TILE_WIDTH;
+    bool success = true;
+
+    for ( m_bandY = 0; m_bandY < height && success; m_bandY += RADIANCE_TILE_HEIGHT )
+    {
+        m_bandHeight = std::min( RADIANCE_TILE_HEIGHT, height - m_bandY );
+
+        if ( pool != 0 )
+        {
+            pool->run( RadianceMerge::TileProc, this, tileCount );
+        }
+        else
+        {
+            for ( int i = 0; i < tileCount; i++ )
+            {
+                TileProc( this, i );
+            }
+        }
+
+        size_t bandSize = m_bandHeight * width * 4;
+        success = fwrite( &m_band[0], 1, bandSize, file ) == bandSize;
+
+        if ( rgbe != 0 )
+        {
+            memcpy( rgbe + m_bandY * width * 4, &m_band[0], bandSize );
+        }
+    }
+
+    fclose( file );
+
+    LOG( "RadianceMerge: %d frames %dx%d merged in %.2f ms\n", frameCount, width, height, timer.get() );
+
+    // release the band buffer and tables
+    std::vector<uchar>().swap( m_band );
+    std::vector<float>().swap( m_tables );
+
+    return success;
+}
+
+void RadianceMerge::TileProc( void * opaque, int index )
+{
+    RadianceMerge * instance = (RadianceMerge *) opaque;
+    const int width = instance->m_width;
+    const int height = instance->m_height;
+    const int frameCount = (int) instance->m_order.size();
+    const float * weights = instance->m_weights;
+
+    int x0 = index * RADIANCE_TILE_WIDTH;
+    int count = std::min( RADIANCE_TILE_WIDTH, width - x0 );
+
+    uchar cb[RADIANCE_TILE_WIDTH], cr[RADIANCE_TILE_WIDTH];
+    uchar rgb[3][RADIANCE_TILE_WIDTH], shortest[3][RADIANCE_TILE_WIDTH];
+    float num[3][RADIANCE_TILE_WIDTH], den[3][RADIANCE_TILE_WIDTH];
+
+    for ( int y = instance->m_bandY; y < instance->m_bandY + instance->m_bandHeight; y++ )
+    {
+        memset( num, 0, sizeof( num ) );
+        memset( den, 0, sizeof( den ) );
+
+        const float * tables = 0;
+        for ( int k = 0; k < frameCount; k++ )
+        {
+            int frame = instance->m_order[k];
+            const uchar * yuv = instance->m_frames[frame];
+            const uchar * cbRow = yuv + width * height + ( y >> 1 ) * ( width >> 1 ) + ( x0 >> 1 );
+            const uchar * crRow = cbRow + ( width >> 1 ) * ( height >> 1 );
+
+            for ( int i = 0; i < count; i++ )
+            {
+                cb[i] = cbRow[i >> 1];
+                cr[i] = crRow[i >> 1];
+            }
+
+            ConvertYCbCrToRGB( yuv + y * width + x0, cb, cr, rgb[0], rgb[1], rgb[2], count );
+
+            tables = &instance->m_tables[frame * 3 * RESPONSE_CURVE_SIZE];
+            for ( int c = 0; c < 3; c++ )
+            {
+                const float * table = tables + c * RESPONSE_CURVE_SIZE;
+                const uchar * z = rgb[c];
+                float * n = num[c];
+                float * d = den[c];
+                for ( int i = 0; i < count; i++ )
+                {
+                    float w = weights[z[i]];
+                    n[i] += w * table[z[i]];
+                    d[i] += w;
+                }
+            }
+
+            if ( k == 0 )
+            {
+                memcpy( shortest, rgb, sizeof( rgb ) );
+            }
+        }
+
+        // rgb holds the longest exposure now
+        const float * shortTables = &instance->m_tables[instance->m_order[0] * 3 * RESPONSE_CURVE_SIZE];
+        const float * longTables = tables;
+
+        uchar * out = &instance->m_band[( ( y - instance->m_bandY ) * width + x0 ) * 4];
+        for ( int i = 0; i < count; i++ )
+        {
+            float e[3];
+            for ( int c = 0; c < 3; c++ )
+            {
+                float logE;
+                if ( den[c][i] > 0.0f )
+                {
+                    logE = num[c][i] / den[c][i];
+                }
+                else if ( shortest[c][i] >= RESPONSE_CURVE_MIDPOINT )
+                {
+                    logE = shortTables[c * RESPONSE_CURVE_SIZE + shortest[c][i]];
+                }
+                else
+                {
+                    logE = longTables[c * RESPONSE_CURVE_SIZE + rgb[c][i]];
+                }
+                e[c] = expf( logE );
+            }
+
+            EncodeRGBE( e[0], e[1], e[2], out + i * 4 );
+        }
+    }
+}
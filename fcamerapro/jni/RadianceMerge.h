@@ -0,0 +1,125 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _RADIANCE_MERGE_H
+#define _RADIANCE_MERGE_H
+
+/**
+ * @file
+ * Definition of RadianceMerge.
+ */
+
+#include <vector>
+#include "Common.h"
+#include "ResponseCurve.h"
+
+class ThreadPool;
+
+#define RADIANCE_TILE_WIDTH  128 /**< Merge tile width in pixels (needs to be even) */
+#define RADIANCE_TILE_HEIGHT 16  /**< Merge tile height in pixels, i.e. the height of a band written at once */
+
+/**
+ * Merges a stack of differently exposed YUV420p frames into a radiance map and
+ * writes it as a Radiance RGBE (.hdr) file. Each pixel's log radiance is the
+ * weighted average of g(z) - ln(dt) over all frames (hat weighting function,
+ * Debevec & Malik 1997), where g is the per-channel log inverse response curve.
+ * Pixels clipped in every frame take the estimate of the shortest (bright pixels)
+ * or the longest (dark pixels) exposure.
+ *
+ * The frame is processed in bands of RADIANCE_TILE_HEIGHT rows, each split into
+ * RADIANCE_TILE_WIDTH wide tiles processed in parallel; a band is written out
+ * before the next one is started, so the working memory is bounded by the band
+ * size regardless of the frame count.
+ */
+class RadianceMerge
+{
+public:
+    /**
+     * Default constructor. Sets the inverse sRGB response curve.
+     */
+    RadianceMerge( void );
+
+    /**
+     * Sets the response curve used by the merge.
+     * @param curve log exposure g(z) of the R, G and B channel, 3 * RESPONSE_CURVE_SIZE values
+     * (channel-major). NULL restores the default inverse sRGB curve.
+     */
+    void setResponseCurve( const float * curve );
+
+    /**
+     * Gets the response curve used by the merge.
+     * @return pointer to 3 * RESPONSE_CURVE_SIZE values (channel-major)
+     */
+    const float * getResponseCurve( void ) const
+    {
+        return m_curve;
+    }
+
+    /**
+     * Merges the frames and writes the radiance map.
+     * @param fileName output file name
+     * @param frames pointers to YUV420p frame data, all frames have the same size
+     * @param logExposure log exposure ln(dt) of each frame (dt in seconds, including gain)
+     * @param frameCount number of frames
+     * @param width frame width in pixels
+     * @param height frame height in pixels
+     * @param pool thread pool used to process the tiles (can be 0)
+     * @param rgbe if not 0, receives a copy of the whole radiance map (width * height * 4 bytes)
+     * @return false if the output file could not be written
+     */
+    bool write( const char * fileName, const uchar * const * frames, const float * logExposure, int frameCount,
+                int width, int height, ThreadPool * pool, uchar * rgbe = 0 );
+
+    /**
+     * Fills a response curve table with the inverse sRGB transfer function. The
+     * curve is normalized so that g(RESPONSE_CURVE_MIDPOINT) = 0, as the solved curves.
+     * @param curve receives 3 * RESPONSE_CURVE_SIZE values
+     */
+    static void GetDefaultResponseCurve( float * curve );
+
+private:
+    /**
+     * Merges a single tile of the current band.
+     * @param opaque pointer to RadianceMerge instance
+     * @param index tile index within the band
+     */
+    static void TileProc( void * opaque, int index );
+
+    float m_curve[3 * RESPONSE_CURVE_SIZE]; /**< Log inverse response curve of R, G and B */
+    float m_weights[RESPONSE_CURVE_SIZE]; /**< Weighting function */
+
+    // state of the merge in progress
+    std::vector<float> m_tables; /**< Per-frame g(z) - ln(dt) tables (frameCount * 3 * RESPONSE_CURVE_SIZE) */
+    std::vector<int> m_order; /**< Frame indices sorted from the shortest to the longest exposure */
+    std::vector<uchar> m_band; /**< RGBE pixels of the current band */
+    const uchar * const * m_frames; /**< Frames being merged */
+    int m_width; /**< Frame width in pixels */
+    int m_height; /**< Frame height in pixels */
+    int m_bandY; /**< First row of the current band */
+    int m_bandHeight; /**< Number of rows of the current band */
+};
+
+#endif
@@ -0,0 +1,699 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Implementation of RawDevelop.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include "RawDevelop.h"
+#include "ThreadPool.h"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define RAW_DUMP_MAGIC   0x57415246 /**< Raw dump file signature ("FRAW") */
+#define RAW_DUMP_VERSION 1          /**< Raw dump file format version */
+#define RAW_DUMP_MAX_SIZE 16384     /**< Largest raw dump width and height accepted */
+
+/**
+ * Raw dump file header, followed by width * height little-endian 16-bit samples.
+ */
+struct RawDumpHeader
+{
+    int magic; /**< RAW_DUMP_MAGIC */
+    int version; /**< RAW_DUMP_VERSION */
+    int width; /**< Frame width in pixels */
+    int height; /**< Frame height in pixels */
+    int bayerPattern; /**< Color filter layout (RawDevelop::EBayerPattern value) */
+    int blackLevel; /**< Sample value of no light */
+    int whiteLevel; /**< Sample value of saturation */
+    float wbGains[3]; /**< R, G and B white balance gains */
+    float colorMatrix[9]; /**< White balanced camera RGB to linear sRGB matrix */
+};
+
+/**
+ * Channel (0 - R, 1 - G, 2 - B) of the 2x2 color filter positions per
+ * RawDevelop::EBayerPattern value.
+ */
+static const int sBayerChannels[4][2][2] =
+{
+    { { 0, 1 }, { 1, 2 } }, // RGGB
+    { { 2, 1 }, { 1, 0 } }, // BGGR
+    { { 1, 0 }, { 2, 1 } }, // GRBG
+    { { 1, 2 }, { 0, 1 } }  // GBRG
+};
+
+static inline int ClampWorking( int v )
+{
+    return v < 0 ? 0 : ( v > RAW_WORKING_WHITE ? RAW_WORKING_WHITE : v );
+}
+
+static inline uchar ClampToByte( int v )
+{
+    return v < 0 ? 0 : ( v > 255 ? 255 : v );
+}
+
+/**
+ * Applies the fixed-point color matrix to a run of pixels in place.
+ * @param r R values
+ * @param g G values
+ * @param b B values
+ * @param m color matrix (RAW_MATRIX_SHIFT fixed point, row major)
+ * @param count number of pixels
+ */
+static void ApplyColorMatrix( ushort * r, ushort * g, ushort * b, const short * m, int count )
+{
+    int x = 0;
+
+#if defined(__ARM_NEON__)
+    const uint16x8_t white = vdupq_n_u16( RAW_WORKING_WHITE );
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        int16x8_t rr = vreinterpretq_s16_u16( vld1q_u16( r + x ) );
+        int16x8_t gg = vreinterpretq_s16_u16( vld1q_u16( g + x ) );
+        int16x8_t bb = vreinterpretq_s16_u16( vld1q_u16( b + x ) );
+        ushort * out[3] = { r, g, b };
+        for ( int c = 0; c < 3; c++ )
+        {
+            const short * row = m + 3 * c;
+            int32x4_t lo = vmull_n_s16( vget_low_s16( rr ), row[0] );
+            lo = vmlal_n_s16( lo, vget_low_s16( gg ), row[1] );
+            lo = vmlal_n_s16( lo, vget_low_s16( bb ), row[2] );
+            int32x4_t hi = vmull_n_s16( vget_high_s16( rr ), row[0] );
+            hi = vmlal_n_s16( hi, vget_high_s16( gg ), row[1] );
+            hi = vmlal_n_s16( hi, vget_high_s16( bb ), row[2] );
+            uint16x8_t v = vcombine_u16( vqrshrun_n_s32( lo, RAW_MATRIX_SHIFT ), vqrshrun_n_s32( hi, RAW_MATRIX_SHIFT ) );
+            vst1q_u16( out[c] + x, vminq_u16( v, white ) );
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i white = _mm_set1_epi16( RAW_WORKING_WHITE );
+    const __m128i one = _mm_set1_epi16( 1 );
+    __m128i mrg[3], mbr[3];
+    for ( int c = 0; c < 3; c++ )
+    {
+        // (R, G) and (B, 1) pairs are multiplied by (m0, m1) and (m2, rounding) with madd
+        const short * row = m + 3 * c;
+        mrg[c] = _mm_set1_epi32(( ushort ) row[0] | (( uint )( ushort ) row[1] << 16 ) );
+        mbr[c] = _mm_set1_epi32(( ushort ) row[2] | (( uint )( 1 << ( RAW_MATRIX_SHIFT - 1 ) ) << 16 ) );
+    }
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        __m128i rr = _mm_loadu_si128(( const __m128i * )( r + x ) );
+        __m128i gg = _mm_loadu_si128(( const __m128i * )( g + x ) );
+        __m128i bb = _mm_loadu_si128(( const __m128i * )( b + x ) );
+        __m128i rgLo = _mm_unpacklo_epi16( rr, gg );
+        __m128i rgHi = _mm_unpackhi_epi16( rr, gg );
+        __m128i bLo = _mm_unpacklo_epi16( bb, one );
+        __m128i bHi = _mm_unpackhi_epi16( bb, one );
+        ushort * out[3] = { r, g, b };
+        for ( int c = 0; c < 3; c++ )
+        {
+            __m128i lo = _mm_add_epi32( _mm_madd_epi16( rgLo, mrg[c] ), _mm_madd_epi16( bLo, mbr[c] ) );
+            __m128i hi = _mm_add_epi32( _mm_madd_epi16( rgHi, mrg[c] ), _mm_madd_epi16( bHi, mbr[c] ) );
+            __m128i v = _mm_packs_epi32( _mm_srai_epi32( lo, RAW_MATRIX_SHIFT ), _mm_srai_epi32( hi, RAW_MATRIX_SHIFT ) );
+            v = _mm_min_epi16( _mm_max_epi16( v, zero ), white );
+            _mm_storeu_si128(( __m128i * )( out[c] + x ), v );
+        }
+    }
+#endif
+
+    for ( ; x < count; x++ )
+    {
+        int rr = r[x], gg = g[x], bb = b[x];
+        int round = 1 << ( RAW_MATRIX_SHIFT - 1 );
+        r[x] = ( ushort ) ClampWorking(( m[0] * rr + m[1] * gg + m[2] * bb + round ) >> RAW_MATRIX_SHIFT );
+        g[x] = ( ushort ) ClampWorking(( m[3] * rr + m[4] * gg + m[5] * bb + round ) >> RAW_MATRIX_SHIFT );
+        b[x] = ( ushort ) ClampWorking(( m[6] * rr + m[7] * gg + m[8] * bb + round ) >> RAW_MATRIX_SHIFT );
+    }
+}
+
+#if defined(__SSE2__) && !defined(__ARM_NEON__)
+/**
+ * Rounds gradient-corrected estimates (16x scaled, 32-bit) to the working
+ * range and packs them to 16 bits.
+ */
+static inline __m128i PackGradient( __m128i lo, __m128i hi )
+{
+    const __m128i round = _mm_set1_epi32( 8 );
+    __m128i v = _mm_packs_epi32( _mm_srai_epi32( _mm_add_epi32( lo, round ), 4 ),
+                                 _mm_srai_epi32( _mm_add_epi32( hi, round ), 4 ) );
+    return _mm_min_epi16( _mm_max_epi16( v, _mm_setzero_si128() ), _mm_set1_epi16( RAW_WORKING_WHITE ) );
+}
+
+/**
+ * Computes the gradient-corrected estimates (16x scaled) of 4 pixels from the
+ * sample and its neighbour sums.
+ * @param out receives the cross, horizontal, vertical and diagonal estimates
+ */
+static inline void GradientEstimates( __m128i c, __m128i h1, __m128i v1, __m128i h2, __m128i v2, __m128i d1,
+                                      __m128i * out )
+{
+    __m128i c8 = _mm_slli_epi32( c, 3 );
+    __m128i c10 = _mm_add_epi32( c8, _mm_slli_epi32( c, 1 ) );
+    __m128i d2 = _mm_slli_epi32( d1, 1 );
+    __m128i hv2 = _mm_add_epi32( h2, v2 );
+
+    // 8C + 4(H1 + V1) - 2(H2 + V2)
+    out[0] = _mm_sub_epi32( _mm_add_epi32( c8, _mm_slli_epi32( _mm_add_epi32( h1, v1 ), 2 ) ), _mm_slli_epi32( hv2, 1 ) );
+    // 10C + 8H1 - 2H2 - 2D1 + V2
+    out[1] = _mm_add_epi32( _mm_sub_epi32( _mm_add_epi32( c10, _mm_slli_epi32( h1, 3 ) ),
+                                           _mm_add_epi32( _mm_slli_epi32( h2, 1 ), d2 ) ), v2 );
+    // 10C + 8V1 - 2V2 - 2D1 + H2
+    out[2] = _mm_add_epi32( _mm_sub_epi32( _mm_add_epi32( c10, _mm_slli_epi32( v1, 3 ) ),
+                                           _mm_add_epi32( _mm_slli_epi32( v2, 1 ), d2 ) ), h2 );
+    // 12C + 4D1 - 3(H2 + V2)
+    out[3] = _mm_sub_epi32( _mm_add_epi32( _mm_add_epi32( c8, _mm_slli_epi32( c, 2 ) ), _mm_slli_epi32( d1, 2 ) ),
+                            _mm_add_epi32( _mm_slli_epi32( hv2, 1 ), hv2 ) );
+}
+#endif
+
+#if defined(__ARM_NEON__)
+/**
+ * Computes the gradient-corrected estimates of 4 pixels from the sample and
+ * its neighbour sums, rounded to the working range.
+ * @param out receives the cross, horizontal, vertical and diagonal estimates
+ */
+static inline void GradientEstimates( uint16x4_t c16, uint16x4_t h116, uint16x4_t v116, uint16x4_t h216, uint16x4_t v216,
+                                      uint16x4_t d116, int16x4_t * out )
+{
+    int32x4_t c = vreinterpretq_s32_u32( vmovl_u16( c16 ) );
+    int32x4_t h1 = vreinterpretq_s32_u32( vmovl_u16( h116 ) );
+    int32x4_t v1 = vreinterpretq_s32_u32( vmovl_u16( v116 ) );
+    int32x4_t h2 = vreinterpretq_s32_u32( vmovl_u16( h216 ) );
+    int32x4_t v2 = vreinterpretq_s32_u32( vmovl_u16( v216 ) );
+    int32x4_t d1 = vreinterpretq_s32_u32( vmovl_u16( d116 ) );
+    int32x4_t hv2 = vaddq_s32( h2, v2 );
+    int32x4_t c10 = vmulq_n_s32( c, 10 );
+
+    int32x4_t e[4];
+    e[0] = vmlsq_n_s32( vmlaq_n_s32( vshlq_n_s32( c, 3 ), vaddq_s32( h1, v1 ), 4 ), hv2, 2 );
+    e[1] = vaddq_s32( vmlsq_n_s32( vmlsq_n_s32( vmlaq_n_s32( c10, h1, 8 ), h2, 2 ), d1, 2 ), v2 );
+    e[2] = vaddq_s32( vmlsq_n_s32( vmlsq_n_s32( vmlaq_n_s32( c10, v1, 8 ), v2, 2 ), d1, 2 ), h2 );
+    e[3] = vmlsq_n_s32( vmlaq_n_s32( vmulq_n_s32( c, 12 ), d1, 4 ), hv2, 3 );
+
+    for ( int i = 0; i < 4; i++ )
+    {
+        out[i] = vmin_s16( vmax_s16( vqrshrn_n_s32( e[i], 4 ), vdup_n_s16( 0 ) ), vdup_n_s16( RAW_WORKING_WHITE ) );
+    }
+}
+#endif
+
+RawDevelop::RawDevelop( void ) : m_raw( 0 ), m_stride( 0 ), m_demosaic( EDemosaicGradient ), m_yuv( 0 ), m_bandCount( 1 ),
+    m_blackShift( 0 ), m_range( 1 )
+{
+}
+
+RawDevelop::~RawDevelop( void )
+{
+}
+
+void RawDevelop::develop( const ushort * raw, int stride, const Metadata & metadata, EDemosaic demosaic, uchar * yuv,
+                          ThreadPool * pool )
+{
+    if ( metadata.width < 4 || metadata.height < 2 || ( metadata.width & 1 ) != 0 || ( metadata.height & 1 ) != 0
+         || metadata.bayerPattern < EBayerRGGB || metadata.bayerPattern > EBayerGBRG || metadata.whiteLevel <= metadata.blackLevel )
+    {
+        ERROR( "RawDevelop::develop(): unsupported raw frame (%ix%i, pattern %i, levels %i-%i)", metadata.width,
+               metadata.height, metadata.bayerPattern, metadata.blackLevel, metadata.whiteLevel );
+        return;
+    }
+
+    m_raw = raw;
+    m_stride = stride;
+    m_metadata = metadata;
+    m_demosaic = demosaic;
+    m_yuv = yuv;
+
+    // black subtracted samples are shifted to the top of 16 bits, the
+    // multipliers then stay below 2^16 for gains up to RAW_MAX_WB_GAIN
+    m_range = ( ushort ) std::min( metadata.whiteLevel - metadata.blackLevel, 65535 );
+    m_blackShift = 0;
+    while (( m_range << ( m_blackShift + 1 ) ) <= 65535 )
+    {
+        m_blackShift++;
+    }
+
+    const int ( *channels )[2] = sBayerChannels[metadata.bayerPattern];
+    for ( int py = 0; py < 2; py++ )
+    {
+        for ( int px = 0; px < 2; px++ )
+        {
+            int c = channels[py][px];
+            float gain = std::min( std::max( metadata.wbGains[c], 1.0f ), RAW_MAX_WB_GAIN );
+            float scale = gain * RAW_WORKING_WHITE * 65536.0f / ( float )( m_range << m_blackShift );
+            m_scale[py][px] = ( ushort ) std::min( scale + 0.5f, 65535.0f );
+
+            if ( c == 1 )
+            {
+                // green: red or blue on the left and right, the other one above and below
+                int h = channels[py][px ^ 1];
+                m_source[py][1][px] = ECandidateCenter;
+                m_source[py][h][px] = ECandidateHorizontal;
+                m_source[py][2 - h][px] = ECandidateVertical;
+            }
+            else
+            {
+                m_source[py][c][px] = ECandidateCenter;
+                m_source[py][1][px] = ECandidateCross;
+                m_source[py][2 - c][px] = ECandidateDiagonal;
+            }
+        }
+    }
+
+    for ( int i = 0; i < 9; i++ )
+    {
+        float m = metadata.colorMatrix[i] * ( 1 << RAW_MATRIX_SHIFT );
+        m_matrix[i] = ( short ) std::min( std::max( m + ( m < 0.0f ? -0.5f : 0.5f ), -32767.0f ), 32767.0f );
+    }
+
+    // sRGB transfer function
+    for ( int i = 0; i <= RAW_WORKING_WHITE; i++ )
+    {
+        float v = ( float ) i / RAW_WORKING_WHITE;
+        v = v <= 0.0031308f ? 12.92f * v : 1.055f * powf( v, 1.0f / 2.4f ) - 0.055f;
+        m_gamma[i] = ClampToByte(( int )( v * 255.0f + 0.5f ) );
+    }
+
+    m_bandCount = pool != 0 ? pool->concurrency() : 1;
+    if ( pool != 0 )
+    {
+        pool->run( RawDevelop::BandProc, this, m_bandCount );
+    }
+    else
+    {
+        BandProc( this, 0 );
+    }
+}
+
+void RawDevelop::normalizeRow( ushort * dst, int y ) const
+{
+    int width = m_metadata.width;
+    int height = m_metadata.height;
+
+    // mirroring keeps the color filter parity
+    y = y < 0 ? -y : ( y >= height ? 2 * ( height - 1 ) - y : y );
+    const ushort * src = m_raw + y * m_stride;
+    const ushort * scale = m_scale[y & 1];
+    int black = m_metadata.blackLevel;
+    int x = 0;
+
+#if defined(__ARM_NEON__)
+    const uint16x8_t vblack = vdupq_n_u16( black );
+    const uint16x8_t vrange = vdupq_n_u16( m_range );
+    const uint16x8_t white = vdupq_n_u16( RAW_WORKING_WHITE );
+    const int16x8_t shift = vdupq_n_s16( m_blackShift );
+    const uint16x4_t k = vreinterpret_u16_u32( vdup_n_u32( scale[0] | (( uint ) scale[1] << 16 ) ) );
+    for ( ; x + 8 <= width; x += 8 )
+    {
+        uint16x8_t v = vminq_u16( vqsubq_u16( vld1q_u16( src + x ), vblack ), vrange );
+        v = vshlq_u16( v, shift );
+        uint32x4_t lo = vmull_u16( vget_low_u16( v ), k );
+        uint32x4_t hi = vmull_u16( vget_high_u16( v ), k );
+        v = vcombine_u16( vshrn_n_u32( lo, 16 ), vshrn_n_u32( hi, 16 ) );
+        vst1q_u16( dst + x, vminq_u16( v, white ) );
+    }
+#elif defined(__SSE2__)
+    const __m128i vblack = _mm_set1_epi16(( short ) black );
+    const __m128i vrange = _mm_set1_epi16(( short ) m_range );
+    const __m128i white = _mm_set1_epi16( RAW_WORKING_WHITE );
+    const __m128i shift = _mm_cvtsi32_si128( m_blackShift );
+    const __m128i k = _mm_set1_epi32( scale[0] | (( uint ) scale[1] << 16 ) );
+    for ( ; x + 8 <= width; x += 8 )
+    {
+        __m128i v = _mm_subs_epu16( _mm_loadu_si128(( const __m128i * )( src + x ) ), vblack );
+        // unsigned minimum: v - max(v - range, 0)
+        v = _mm_sub_epi16( v, _mm_subs_epu16( v, vrange ) );
+        v = _mm_mulhi_epu16( _mm_sll_epi16( v, shift ), k );
+        v = _mm_sub_epi16( v, _mm_subs_epu16( v, white ) );
+        _mm_storeu_si128(( __m128i * )( dst + x ), v );
+    }
+#endif
+
+    for ( ; x < width; x++ )
+    {
+        int v = std::min( std::max( src[x] - black, 0 ), ( int ) m_range );
+        v = ( int )((( uint )( v << m_blackShift ) * scale[x & 1] ) >> 16 );
+        dst[x] = ( ushort ) std::min( v, RAW_WORKING_WHITE );
+    }
+
+    dst[-1] = dst[1];
+    dst[-2] = dst[2];
+    dst[width] = dst[width - 2];
+    dst[width + 1] = dst[width - 3];
+}
+
+void RawDevelop::demosaicRow( const ushort * const * rows, int y, ushort * const * rgb ) const
+{
+    int width = m_metadata.width;
+    const int ( *source )[2] = m_source[y & 1];
+    const ushort * r0 = rows[0];
+    const ushort * r1 = rows[1];
+    const ushort * r2 = rows[2];
+    const ushort * r3 = rows[3];
+    const ushort * r4 = rows[4];
+    bool gradient = m_demosaic == EDemosaicGradient;
+    int x = 0;
+
+#if defined(__ARM_NEON__)
+    // even columns take the first source, odd columns the second one
+    const uint16x8_t even = vreinterpretq_u16_u32( vdupq_n_u32( 0x0000ffff ) );
+    for ( ; x + 8 <= width; x += 8 )
+    {
+        uint16x8_t cand[ECandidateCount];
+        uint16x8_t c = vld1q_u16( r2 + x );
+        uint16x8_t h1 = vaddq_u16( vld1q_u16( r2 + x - 1 ), vld1q_u16( r2 + x + 1 ) );
+        uint16x8_t v1 = vaddq_u16( vld1q_u16( r1 + x ), vld1q_u16( r3 + x ) );
+        uint16x8_t d1 = vaddq_u16( vaddq_u16( vld1q_u16( r1 + x - 1 ), vld1q_u16( r1 + x + 1 ) ),
+                                   vaddq_u16( vld1q_u16( r3 + x - 1 ), vld1q_u16( r3 + x + 1 ) ) );
+        cand[ECandidateCenter] = c;
+        if ( gradient )
+        {
+            uint16x8_t h2 = vaddq_u16( vld1q_u16( r2 + x - 2 ), vld1q_u16( r2 + x + 2 ) );
+            uint16x8_t v2 = vaddq_u16( vld1q_u16( r0 + x ), vld1q_u16( r4 + x ) );
+            int16x4_t lo[4], hi[4];
+            GradientEstimates( vget_low_u16( c ), vget_low_u16( h1 ), vget_low_u16( v1 ), vget_low_u16( h2 ),
+                               vget_low_u16( v2 ), vget_low_u16( d1 ), lo );
+            GradientEstimates( vget_high_u16( c ), vget_high_u16( h1 ), vget_high_u16( v1 ), vget_high_u16( h2 ),
+                               vget_high_u16( v2 ), vget_high_u16( d1 ), hi );
+            for ( int i = 0; i < 4; i++ )
+            {
+                cand[ECandidateCross + i] = vreinterpretq_u16_s16( vcombine_s16( lo[i], hi[i] ) );
+            }
+        }
+        else
+        {
+            cand[ECandidateCross] = vrshrq_n_u16( vaddq_u16( h1, v1 ), 2 );
+            cand[ECandidateHorizontal] = vrshrq_n_u16( h1, 1 );
+            cand[ECandidateVertical] = vrshrq_n_u16( v1, 1 );
+            cand[ECandidateDiagonal] = vrshrq_n_u16( d1, 2 );
+        }
+        for ( int ch = 0; ch < 3; ch++ )
+        {
+            vst1q_u16( rgb[ch] + x, vbslq_u16( even, cand[source[ch][0]], cand[source[ch][1]] ) );
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    // even columns take the first source, odd columns the second one
+    const __m128i even = _mm_set1_epi32( 0x0000ffff );
+    for ( ; x + 8 <= width; x += 8 )
+    {
+        __m128i cand[ECandidateCount];
+        __m128i c = _mm_loadu_si128(( const __m128i * )( r2 + x ) );
+        __m128i h1 = _mm_add_epi16( _mm_loadu_si128(( const __m128i * )( r2 + x - 1 ) ),
+                                    _mm_loadu_si128(( const __m128i * )( r2 + x + 1 ) ) );
+        __m128i v1 = _mm_add_epi16( _mm_loadu_si128(( const __m128i * )( r1 + x ) ),
+                                    _mm_loadu_si128(( const __m128i * )( r3 + x ) ) );
+        __m128i d1 = _mm_add_epi16( _mm_add_epi16( _mm_loadu_si128(( const __m128i * )( r1 + x - 1 ) ),
+                                    _mm_loadu_si128(( const __m128i * )( r1 + x + 1 ) ) ),
+                                    _mm_add_epi16( _mm_loadu_si128(( const __m128i * )( r3 + x - 1 ) ),
+                                            _mm_loadu_si128(( const __m128i * )( r3 + x + 1 ) ) ) );
+        cand[ECandidateCenter] = c;
+        if ( gradient )
+        {
+            __m128i h2 = _mm_add_epi16( _mm_loadu_si128(( const __m128i * )( r2 + x - 2 ) ),
+                                        _mm_loadu_si128(( const __m128i * )( r2 + x + 2 ) ) );
+            __m128i v2 = _mm_add_epi16( _mm_loadu_si128(( const __m128i * )( r0 + x ) ),
+                                        _mm_loadu_si128(( const __m128i * )( r4 + x ) ) );
+            __m128i lo[4], hi[4];
+            GradientEstimates( _mm_unpacklo_epi16( c, zero ), _mm_unpacklo_epi16( h1, zero ), _mm_unpacklo_epi16( v1, zero ),
+                               _mm_unpacklo_epi16( h2, zero ), _mm_unpacklo_epi16( v2, zero ), _mm_unpacklo_epi16( d1, zero ), lo );
+            GradientEstimates( _mm_unpackhi_epi16( c, zero ), _mm_unpackhi_epi16( h1, zero ), _mm_unpackhi_epi16( v1, zero ),
+                               _mm_unpackhi_epi16( h2, zero ), _mm_unpackhi_epi16( v2, zero ), _mm_unpackhi_epi16( d1, zero ), hi );
+            for ( int i = 0; i < 4; i++ )
+            {
+                cand[ECandidateCross + i] = PackGradient( lo[i], hi[i] );
+            }
+        }
+        else
+        {
+            const __m128i two = _mm_set1_epi16( 2 );
+            cand[ECandidateCross] = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( h1, v1 ), two ), 2 );
+            cand[ECandidateHorizontal] = _mm_avg_epu16( _mm_loadu_si128(( const __m128i * )( r2 + x - 1 ) ),
+                                         _mm_loadu_si128(( const __m128i * )( r2 + x + 1 ) ) );
+            cand[ECandidateVertical] = _mm_avg_epu16( _mm_loadu_si128(( const __m128i * )( r1 + x ) ),
+                                       _mm_loadu_si128(( const __m128i * )( r3 + x ) ) );
+            cand[ECandidateDiagonal] = _mm_srli_epi16( _mm_add_epi16( d1, two ), 2 );
+        }
+        for ( int ch = 0; ch < 3; ch++ )
+        {
+            __m128i v = _mm_or_si128( _mm_and_si128( even, cand[source[ch][0]] ), _mm_andnot_si128( even, cand[source[ch][1]] ) );
+            _mm_storeu_si128(( __m128i * )( rgb[ch] + x ), v );
+        }
+    }
+#endif
+
+    for ( ; x < width; x++ )
+    {
+        int cand[ECandidateCount];
+        int c = r2[x];
+        int h1 = r2[x - 1] + r2[x + 1];
+        int v1 = r1[x] + r3[x];
+        int d1 = r1[x - 1] + r1[x + 1] + r3[x - 1] + r3[x + 1];
+        cand[ECandidateCenter] = c;
+        if ( gradient )
+        {
+            int h2 = r2[x - 2] + r2[x + 2];
+            int v2 = r0[x] + r4[x];
+            cand[ECandidateCross] = ClampWorking(( 8 * c + 4 * ( h1 + v1 ) - 2 * ( h2 + v2 ) + 8 ) >> 4 );
+            cand[ECandidateHorizontal] = ClampWorking(( 10 * c + 8 * h1 - 2 * h2 - 2 * d1 + v2 + 8 ) >> 4 );
+            cand[ECandidateVertical] = ClampWorking(( 10 * c + 8 * v1 - 2 * v2 - 2 * d1 + h2 + 8 ) >> 4 );
+            cand[ECandidateDiagonal] = ClampWorking(( 12 * c + 4 * d1 - 3 * ( h2 + v2 ) + 8 ) >> 4 );
+        }
+        else
+        {
+            cand[ECandidateCross] = ( h1 + v1 + 2 ) >> 2;
+            cand[ECandidateHorizontal] = ( h1 + 1 ) >> 1;
+            cand[ECandidateVertical] = ( v1 + 1 ) >> 1;
+            cand[ECandidateDiagonal] = ( d1 + 2 ) >> 2;
+        }
+        for ( int ch = 0; ch < 3; ch++ )
+        {
+            rgb[ch][x] = ( ushort ) cand[source[ch][x & 1]];
+        }
+    }
+}
+
+void RawDevelop::BandProc( void * opaque, int index )
+{
+    RawDevelop * self = ( RawDevelop * ) opaque;
+
+    int width = self->m_metadata.width;
+    int height = self->m_metadata.height;
+    int pairs = height >> 1;
+    int start = ( int )(( long long ) index * pairs / self->m_bandCount ) * 2;
+    int end = ( int )(( long long )( index + 1 ) * pairs / self->m_bandCount ) * 2;
+    if ( start >= end )
+    {
+        return;
+    }
+
+    // sliding window of normalized rows, 2 samples of padding on each side
+    int padded = width + 4;
+    std::vector<ushort> window( RAW_WINDOW_ROWS * padded );
+    std::vector<ushort> rgbRows( 6 * width );
+
+    uchar * outY = self->m_yuv;
+    uchar * outCb = outY + width * height;
+    uchar * outCr = outCb + ( width >> 1 ) * ( height >> 1 );
+    const uchar * gamma = self->m_gamma;
+
+    int next = start - 2;
+    for ( int y = start; y < end; y += 2 )
+    {
+        // the pair needs the rows y - 2 to y + 3
+        for ( ; next <= y + 3; next++ )
+        {
+            self->normalizeRow( &window[( next & ( RAW_WINDOW_ROWS - 1 ) ) * padded + 2], next );
+        }
+
+        for ( int i = 0; i < 2; i++ )
+        {
+            const ushort * rows[5];
+            for ( int k = 0; k < 5; k++ )
+            {
+                rows[k] = &window[(( y + i - 2 + k ) & ( RAW_WINDOW_ROWS - 1 ) ) * padded + 2];
+            }
+            ushort * rgb[3] = { &rgbRows[( 3 * i ) * width], &rgbRows[( 3 * i + 1 ) * width], &rgbRows[( 3 * i + 2 ) * width] };
+            self->demosaicRow( rows, y + i, rgb );
+            ApplyColorMatrix( rgb[0], rgb[1], rgb[2], self->m_matrix, width );
+        }
+
+        // gamma and BT.601 full range YCbCr, chroma of the 2x2 average
+        const ushort * rgb0 = &rgbRows[0];
+        const ushort * rgb1 = &rgbRows[3 * width];
+        uchar * y0 = outY + y * width;
+        uchar * y1 = y0 + width;
+        uchar * cb = outCb + ( y >> 1 ) * ( width >> 1 );
+        uchar * cr = outCr + ( y >> 1 ) * ( width >> 1 );
+        for ( int x = 0; x < width; x += 2 )
+        {
+            int sr = 0, sg = 0, sb = 0;
+            for ( int k = 0; k < 4; k++ )
+            {
+                const ushort * row = k < 2 ? rgb0 : rgb1;
+                int px = x + ( k & 1 );
+                int r = gamma[row[px]];
+                int g = gamma[row[px + width]];
+                int b = gamma[row[px + 2 * width]];
+                ( k < 2 ? y0 : y1 )[px] = ( uchar )(( 77 * r + 150 * g + 29 * b + 128 ) >> 8 );
+                sr += r;
+                sg += g;
+                sb += b;
+            }
+            cb[x >> 1] = ClampToByte((( 128 << 10 ) + 512 - 43 * sr - 85 * sg + 128 * sb ) >> 10 );
+            cr[x >> 1] = ClampToByte((( 128 << 10 ) + 512 + 128 * sr - 107 * sg - 21 * sb ) >> 10 );
+        }
+    }
+}
+
+void RawDevelop::SplitColorMatrix( const float * rawToRGB, float * wbGains, float * colorMatrix )
+{
+    const float * m = rawToRGB;
+
+    // camera RGB of white: w = M^-1 * (1, 1, 1)
+    float inv[9];
+    inv[0] = m[4] * m[8] - m[5] * m[7];
+    inv[1] = m[2] * m[7] - m[1] * m[8];
+    inv[2] = m[1] * m[5] - m[2] * m[4];
+    inv[3] = m[5] * m[6] - m[3] * m[8];
+    inv[4] = m[0] * m[8] - m[2] * m[6];
+    inv[5] = m[2] * m[3] - m[0] * m[5];
+    inv[6] = m[3] * m[7] - m[4] * m[6];
+    inv[7] = m[1] * m[6] - m[0] * m[7];
+    inv[8] = m[0] * m[4] - m[1] * m[3];
+    float det = m[0] * inv[0] + m[1] * inv[3] + m[2] * inv[6];
+
+    float w[3];
+    bool valid = fabsf( det ) > 1e-6f;
+    for ( int i = 0; i < 3 && valid; i++ )
+    {
+        w[i] = ( inv[3 * i] + inv[3 * i + 1] + inv[3 * i + 2] ) / det;
+        valid = w[i] > 0.0f;
+    }
+
+    if ( !valid )
+    {
+        for ( int i = 0; i < 3; i++ )
+        {
+            wbGains[i] = 1.0f;
+        }
+        std::copy( m, m + 9, colorMatrix );
+        return;
+    }
+
+    // gains bring white to equal channels (smallest gain 1), the matrix columns
+    // take the rest so that white maps to white
+    float wmax = std::max( w[0], std::max( w[1], w[2] ) );
+    for ( int j = 0; j < 3; j++ )
+    {
+        wbGains[j] = std::min( wmax / w[j], RAW_MAX_WB_GAIN );
+        for ( int i = 0; i < 3; i++ )
+        {
+            colorMatrix[3 * i + j] = m[3 * i + j] * w[j];
+        }
+    }
+}
+
+bool RawDevelop::WriteDump( const char * fileName, const ushort * raw, int stride, const Metadata & metadata )
+{
+    FILE * file = fopen( fileName, "wb" );
+    if ( file == 0 )
+    {
+        ERROR( "RawDevelop::WriteDump(): cannot open %s", fileName );
+        return false;
+    }
+
+    RawDumpHeader header;
+    header.magic = RAW_DUMP_MAGIC;
+    header.version = RAW_DUMP_VERSION;
+    header.width = metadata.width;
+    header.height = metadata.height;
+    header.bayerPattern = metadata.bayerPattern;
+    header.blackLevel = metadata.blackLevel;
+    header.whiteLevel = metadata.whiteLevel;
+    std::copy( metadata.wbGains, metadata.wbGains + 3, header.wbGains );
+    std::copy( metadata.colorMatrix, metadata.colorMatrix + 9, header.colorMatrix );
+
+    bool ok = fwrite( &header, sizeof( header ), 1, file ) == 1;
+    for ( int y = 0; y < metadata.height && ok; y++ )
+    {
+        ok = fwrite( raw + y * stride, sizeof( ushort ), metadata.width, file ) == ( size_t ) metadata.width;
+    }
+    fclose( file );
+
+    if ( !ok )
+    {
+        ERROR( "RawDevelop::WriteDump(): cannot write %s", fileName );
+    }
+    return ok;
+}
+
+bool RawDevelop::ReadDump( const char * fileName, Metadata & metadata, std::vector<ushort> & raw )
+{
+    FILE * file = fopen( fileName, "rb" );
+    if ( file == 0 )
+    {
+        ERROR( "RawDevelop::ReadDump(): cannot open %s", fileName );
+        return false;
+    }
+
+    RawDumpHeader header;
+    bool ok = fread( &header, sizeof( header ), 1, file ) == 1 && header.magic == RAW_DUMP_MAGIC
+              && header.version == RAW_DUMP_VERSION && header.width > 0 && header.width <= RAW_DUMP_MAX_SIZE
+              && header.height > 0 && header.height <= RAW_DUMP_MAX_SIZE;
+    if ( ok )
+    {
+        raw.resize( header.width * header.height );
+        ok = fread( &raw[0], sizeof( ushort ), raw.size(), file ) == raw.size();
+    }
+    fclose( file );
+
+    if ( !ok )
+    {
+        ERROR( "RawDevelop::ReadDump(): %s is not a valid raw dump", fileName );
+        return false;
+    }
+
+    metadata.width = header.width;
+    metadata.height = header.height;
+    metadata.bayerPattern = header.bayerPattern;
+    metadata.blackLevel = header.blackLevel;
+    metadata.whiteLevel = header.whiteLevel;
+    std::copy( header.wbGains, header.wbGains + 3, metadata.wbGains );
+    std::copy( header.colorMatrix, header.colorMatrix + 9, metadata.colorMatrix );
+    return true;
+}
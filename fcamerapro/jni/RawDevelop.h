@@ -0,0 +1,201 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _RAW_DEVELOP_H
+#define _RAW_DEVELOP_H
+
+/**
+ * @file
+ * Definition of RawDevelop.
+ */
+
+#include <vector>
+#include "Common.h"
+
+class ThreadPool;
+
+#define RAW_WORKING_WHITE 4095 /**< White level of the 12-bit linear working range */
+#define RAW_MAX_WB_GAIN   8.0f /**< Largest white balance gain of the 16-bit fixed-point scaling */
+#define RAW_MATRIX_SHIFT  12   /**< Fixed-point precision of color matrix coefficients */
+#define RAW_WINDOW_ROWS   8    /**< Normalized rows kept by the sliding window of a band (power of two) */
+
+/**
+ * Develops sensor-native Bayer data into a YUV420p image without the ISP:
+ * black level subtraction, white balance, demosaicing, camera to sRGB color
+ * matrix and sRGB gamma. Two demosaics are available, a fast bilinear one and
+ * the high-quality gradient-corrected linear interpolation of Malvar, He and
+ * Cutler (5x5 kernels, the bilinear estimate corrected by the Laplacian of the
+ * sampled channel).
+ *
+ * The image is developed in bands of rows on a thread pool. Each band walks
+ * its rows in pairs (one chroma row of the output) and keeps a sliding window
+ * of RAW_WINDOW_ROWS normalized (black level, white balance, 12-bit) rows, so
+ * every raw row is read once and the working set stays in the cache. The
+ * normalization, both demosaics and the color matrix process 8 (bilinear,
+ * matrix) or 4 (gradient-corrected) pixels at once with NEON or SSE2; the
+ * scalar path gives identical results.
+ *
+ * Raw frames are saved as dumps (a small header with the metadata followed by
+ * the 16-bit samples) that can be developed later, also off the device.
+ */
+class RawDevelop
+{
+public:
+    /**
+     * Color filter layout of the top-left 2x2 pixels
+     */
+    enum EBayerPattern
+    {
+        EBayerRGGB, EBayerBGGR, EBayerGRBG, EBayerGBRG
+    };
+
+    /**
+     * Demosaicing methods
+     */
+    enum EDemosaic
+    {
+        EDemosaicBilinear, EDemosaicGradient
+    };
+
+    /**
+     * Raw frame description needed to develop it.
+     */
+    struct Metadata
+    {
+        int width; /**< Frame width in pixels (even) */
+        int height; /**< Frame height in pixels (even) */
+        int bayerPattern; /**< Color filter layout (EBayerPattern value) */
+        int blackLevel; /**< Sample value of no light */
+        int whiteLevel; /**< Sample value of saturation */
+        float wbGains[3]; /**< R, G and B white balance gains (1 to RAW_MAX_WB_GAIN) */
+        float colorMatrix[9]; /**< White balanced camera RGB to linear sRGB matrix (row major, rows sum to 1) */
+    };
+
+    /**
+     * Default constructor.
+     */
+    RawDevelop( void );
+
+    /**
+     * Default destructor.
+     */
+    ~RawDevelop( void );
+
+    /**
+     * Develops a raw frame.
+     * @param raw raw samples
+     * @param stride distance of raw rows in samples
+     * @param metadata raw frame description
+     * @param demosaic demosaicing method
+     * @param yuv output YUV420p image data of the frame size
+     * @param pool thread pool (can be 0)
+     */
+    void develop( const ushort * raw, int stride, const Metadata & metadata, EDemosaic demosaic, uchar * yuv,
+                  ThreadPool * pool );
+
+    /**
+     * Splits a camera RGB to sRGB matrix that includes the white balance (as
+     * given by the sensor for a color temperature) into white balance gains and
+     * a color matrix with rows summing to 1. The gains are normalized to a
+     * smallest gain of 1. Falls back to unit gains and the given matrix if the
+     * matrix maps no positive camera RGB to white.
+     * @param rawToRGB camera RGB to sRGB matrix (3x3, row major)
+     * @param wbGains receives R, G and B white balance gains
+     * @param colorMatrix receives the white balanced color matrix (3x3, row major)
+     */
+    static void SplitColorMatrix( const float * rawToRGB, float * wbGains, float * colorMatrix );
+
+    /**
+     * Writes a raw frame dump.
+     * @param fileName output file name
+     * @param raw raw samples
+     * @param stride distance of raw rows in samples
+     * @param metadata raw frame description
+     * @return true if the dump has been written
+     */
+    static bool WriteDump( const char * fileName, const ushort * raw, int stride, const Metadata & metadata );
+
+    /**
+     * Reads a raw frame dump written by WriteDump().
+     * @param fileName dump file name
+     * @param metadata receives the raw frame description
+     * @param raw receives the raw samples (stride equal to the width)
+     * @return true if the dump has been read
+     */
+    static bool ReadDump( const char * fileName, Metadata & metadata, std::vector<ushort> & raw );
+
+private:
+    /**
+     * Demosaic estimates of a channel at a pixel
+     */
+    enum ECandidate
+    {
+        ECandidateCenter, /**< The sample of the pixel */
+        ECandidateCross, /**< Estimate from the 4 nearest neighbours (green at red and blue) */
+        ECandidateHorizontal, /**< Estimate from the left and right neighbours */
+        ECandidateVertical, /**< Estimate from the top and bottom neighbours */
+        ECandidateDiagonal, /**< Estimate from the 4 diagonal neighbours (red at blue and vice versa) */
+        ECandidateCount
+    };
+
+    /**
+     * Develops a band of row pairs.
+     */
+    static void BandProc( void * opaque, int index );
+
+    /**
+     * Normalizes a raw row into a padded working row: subtracts the black
+     * level, applies the white balance, scales to RAW_WORKING_WHITE and
+     * mirrors two samples over each edge.
+     * @param dst working row, dst[-2] to dst[width + 1] are written
+     * @param y row index (mirrored into the frame)
+     */
+    void normalizeRow( ushort * dst, int y ) const;
+
+    /**
+     * Demosaics a row of the sliding window.
+     * @param rows pointers to the working rows y - 2 to y + 2
+     * @param y row index
+     * @param rgb output R, G and B rows
+     */
+    void demosaicRow( const ushort * const * rows, int y, ushort * const * rgb ) const;
+
+    const ushort * m_raw; /**< Raw samples being developed */
+    int m_stride; /**< Distance of raw rows in samples */
+    Metadata m_metadata; /**< Raw frame description */
+    EDemosaic m_demosaic; /**< Demosaicing method */
+    uchar * m_yuv; /**< Output image data */
+    int m_bandCount; /**< Number of bands */
+
+    int m_blackShift; /**< Left shift of black subtracted samples to fill 16 bits */
+    ushort m_range; /**< White level minus black level */
+    ushort m_scale[2][2]; /**< Normalization multipliers (0.16 fixed point) per color filter position */
+    int m_source[2][3][2]; /**< Demosaic estimate (ECandidate value) per row parity, channel and column parity */
+    short m_matrix[9]; /**< Color matrix (RAW_MATRIX_SHIFT fixed point) */
+    uchar m_gamma[RAW_WORKING_WHITE + 1]; /**< Linear working value to sRGB byte table */
+};
+
+#endif
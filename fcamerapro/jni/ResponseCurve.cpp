@@ -0,0 +1,299 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of the camera response curve solver.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include "ResponseCurve.h"
+
+bool SolveResponseCurve( const uchar * z, int pixelCount, int imageCount, const float * logExposure, float lambda,
+                         const float * weights, float * g, float * logIrradiance )
+{
+    const int n = RESPONSE_CURVE_SIZE;
+
+    // Normal equations A^T A x = A^T b with x = [ g | lE ] have the block form
+    //   [ G   C ] [ g  ]   [ bg ]
+    //   [ C^T D ] [ lE ] = [ be ]
+    // where D is diagonal. Eliminating lE gives (G - C D^-1 C^T) g = bg - C D^-1 be.
+    // Each pixel only touches imageCount entries of C, so its Schur update is an
+    // imageCount^2 rank one update of the 256 x 256 system.
+    std::vector<double> s( n * n, 0.0 );
+    std::vector<double> r( n, 0.0 );
+    std::vector<double> wsq( imageCount );
+
+    for ( int i = 0; i < pixelCount; i++ )
+    {
+        const uchar * zi = z + i * imageCount;
+        double d = 0.0, be = 0.0;
+
+        for ( int j = 0; j < imageCount; j++ )
+        {
+            double w = weights[zi[j]];
+            wsq[j] = w * w;
+            d += wsq[j];
+            be -= wsq[j] * logExposure[j];
+
+            s[zi[j] * n + zi[j]] += wsq[j];
+            r[zi[j]] += wsq[j] * logExposure[j];
+        }
+
+        if ( d <= 0.0 )
+        {
+            continue;
+        }
+
+        double invD = 1.0 / d;
+        for ( int j = 0; j < imageCount; j++ )
+        {
+            double cj = wsq[j] * invD;
+            double * srow = &s[zi[j] * n];
+            r[zi[j]] += cj * be;
+            for ( int k = 0; k < imageCount; k++ )
+            {
+                srow[zi[k]] -= cj * wsq[k];
+            }
+        }
+    }
+
+    // fix the curve by setting its middle value to 0
+    s[RESPONSE_CURVE_MIDPOINT * n + RESPONSE_CURVE_MIDPOINT] += 1.0;
+
+    // smoothness equations lambda * w(z) * ( g(z - 1) - 2 g(z) + g(z + 1) ) = 0
+    for ( int i = 1; i < n - 1; i++ )
+    {
+        double a = lambda * weights[i];
+        double c[3] = { a, -2.0 * a, a };
+        for ( int j = 0; j < 3; j++ )
+        {
+            for ( int k = 0; k < 3; k++ )
+            {
+                s[( i - 1 + j ) * n + i - 1 + k] += c[j] * c[k];
+            }
+        }
+    }
+
+    // in-place Cholesky factorisation s = L L^T (lower triangle)
+    for ( int j = 0; j < n; j++ )
+    {
+        double * rowj = &s[j * n];
+        double sum = rowj[j];
+        for ( int k = 0; k < j; k++ )
+        {
+            sum -= rowj[k] * rowj[k];
+        }
+
+        if ( sum <= 0.0 )
+        {
+            return false;
+        }
+
+        double ljj = sqrt( sum );
+        double invLjj = 1.0 / ljj;
+        rowj[j] = ljj;
+
+        for ( int i = j + 1; i < n; i++ )
+        {
+            double * rowi = &s[i * n];
+            double v = rowi[j];
+            for ( int k = 0; k < j; k++ )
+            {
+                v -= rowi[k] * rowj[k];
+            }
+            rowi[j] = v * invLjj;
+        }
+    }
+
+    // forward (L y = r) and backward (L^T g = y) substitution
+    for ( int i = 0; i < n; i++ )
+    {
+        const double * rowi = &s[i * n];
+        double v = r[i];
+        for ( int k = 0; k < i; k++ )
+        {
+            v -= rowi[k] * r[k];
+        }
+        r[i] = v / rowi[i];
+    }
+
+    for ( int i = n - 1; i >= 0; i-- )
+    {
+        double v = r[i];
+        for ( int k = i + 1; k < n; k++ )
+        {
+            v -= s[k * n + i] * r[k];
+        }
+        r[i] = v / s[i * n + i];
+        g[i] = (float) r[i];
+    }
+
+    // back substitute the per-pixel log irradiances: lE = D^-1 ( be - C^T g )
+    if ( logIrradiance != NULL )
+    {
+        for ( int i = 0; i < pixelCount; i++ )
+        {
+            const uchar * zi = z + i * imageCount;
+            double d = 0.0, v = 0.0;
+
+            for ( int j = 0; j < imageCount; j++ )
+            {
+                double w = weights[zi[j]];
+                d += w * w;
+                v += w * w * ( r[zi[j]] - logExposure[j] );
+            }
+
+            logIrradiance[i] = d > 0.0 ? (float) ( v / d ) : 0.0f;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Candidate sample location.
+ */
+struct ResponseSample
+{
+    int index; /**< Pixel index (y * width + x) */
+    int gradient; /**< Local gradient magnitude in the reference image */
+
+    bool operator<( const ResponseSample & other ) const
+    {
+        return gradient < other.gradient || ( gradient == other.gradient && index < other.index );
+    }
+};
+
+static bool CompareSampleIndex( const ResponseSample & a, const ResponseSample & b )
+{
+    return a.index < b.index;
+}
+
+int SelectResponseSamples( const uchar * const * images, int imageCount, int reference, int width, int height,
+                           int * samples, int maxSamples )
+{
+    if ( imageCount <= 0 || reference < 0 || reference >= imageCount || width < 3 || height < 3 || maxSamples <= 0 )
+    {
+        return 0;
+    }
+
+    // examine a regular subset of the interior pixels on large images
+    int step = 1;
+    while ( ( ( width - 2 + step - 1 ) / step ) * ( ( height - 2 + step - 1 ) / step ) > RESPONSE_SAMPLE_CANDIDATES )
+    {
+        step++;
+    }
+
+    std::vector<ResponseSample> strata[RESPONSE_SAMPLE_STRATA];
+    const uchar * ref = images[reference];
+    int maxClipped = imageCount / 2;
+
+    for ( int y = 1; y < height - 1; y += step )
+    {
+        for ( int x = 1; x < width - 1; x += step )
+        {
+            int index = y * width + x;
+            int v = ref[index];
+            if ( v <= RESPONSE_SAMPLE_CLIP_LOW || v >= RESPONSE_SAMPLE_CLIP_HIGH )
+            {
+                continue;
+            }
+
+            int clipped = 0;
+            for ( int i = 0; i < imageCount; i++ )
+            {
+                int z = images[i][index];
+                clipped += ( z <= RESPONSE_SAMPLE_CLIP_LOW || z >= RESPONSE_SAMPLE_CLIP_HIGH ) ? 1 : 0;
+            }
+
+            if ( clipped > maxClipped )
+            {
+                continue;
+            }
+
+            ResponseSample sample;
+            sample.index = index;
+            sample.gradient = abs( ref[index + 1] - ref[index - 1] ) + abs( ref[index + width] - ref[index - width] );
+            strata[v * RESPONSE_SAMPLE_STRATA / RESPONSE_CURVE_SIZE].push_back( sample );
+        }
+    }
+
+    // distribute the sample budget, strata with fewer candidates than their share
+    // pass the rest on to the more populated ones
+    int order[RESPONSE_SAMPLE_STRATA];
+    for ( int i = 0; i < RESPONSE_SAMPLE_STRATA; i++ )
+    {
+        order[i] = i;
+    }
+
+    for ( int i = 1; i < RESPONSE_SAMPLE_STRATA; i++ )
+    {
+        for ( int j = i; j > 0 && strata[order[j]].size() < strata[order[j - 1]].size(); j-- )
+        {
+            std::swap( order[j], order[j - 1] );
+        }
+    }
+
+    int count = 0;
+    for ( int i = 0; i < RESPONSE_SAMPLE_STRATA; i++ )
+    {
+        std::vector<ResponseSample> & candidates = strata[order[i]];
+        int quota = ( maxSamples - count ) / ( RESPONSE_SAMPLE_STRATA - i );
+        int size = (int) candidates.size();
+
+        if ( quota <= 0 )
+        {
+            continue;
+        }
+
+        if ( size <= quota )
+        {
+            for ( int j = 0; j < size; j++ )
+            {
+                samples[count++] = candidates[j].index;
+            }
+            continue;
+        }
+
+        // keep the flattest candidates (up to 4x the quota) and take every n-th of them in scan order
+        int keep = std::min( size, quota * 4 );
+        std::nth_element( candidates.begin(), candidates.begin() + keep - 1, candidates.end() );
+        std::sort( candidates.begin(), candidates.begin() + keep, CompareSampleIndex );
+
+        for ( int j = 0; j < quota; j++ )
+        {
+            samples[count++] = candidates[(int) ( ( j + 0.5f ) * keep / quota )].index;
+        }
+    }
+
+    std::sort( samples, samples + count );
+
+    return count;
+}
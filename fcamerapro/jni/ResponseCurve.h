@@ -0,0 +1,87 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _RESPONSE_CURVE_H
+#define _RESPONSE_CURVE_H
+
+/**
+ * @file
+ * Definition of the camera response curve solver (Debevec & Malik 1997).
+ */
+
+#include "Common.h"
+
+#define RESPONSE_CURVE_SIZE      256 /**< Number of pixel values the response curve is defined for */
+#define RESPONSE_CURVE_MIDPOINT  128 /**< Pixel value whose log exposure is fixed to 0 */
+
+#define RESPONSE_SAMPLE_STRATA    16 /**< Number of reference intensity ranges samples are spread over */
+#define RESPONSE_SAMPLE_CLIP_LOW   4 /**< Values below or equal to this are considered underexposed */
+#define RESPONSE_SAMPLE_CLIP_HIGH 251 /**< Values above or equal to this are considered saturated */
+#define RESPONSE_SAMPLE_CANDIDATES 65536 /**< Upper bound on the number of examined pixel locations */
+
+/**
+ * Recovers the log inverse camera response g(z) = ln(E * dt) from a set of
+ * pixels observed under different exposures. This solves the same least squares
+ * problem as the original gsolve.m (data fitting rows, g(128) = 0 and second
+ * derivative smoothness rows weighted by lambda * w(z)), but instead of
+ * factoring the dense (P * N + 257) x (256 + P) system it forms the normal
+ * equations, eliminates the per-pixel log irradiances (a diagonal block) with
+ * a Schur complement and solves the remaining 256 x 256 system with a Cholesky
+ * factorisation.
+ * @param z pixel values, z[i * imageCount + j] is pixel i in image j
+ * @param pixelCount number of pixel locations (P)
+ * @param imageCount number of images (N)
+ * @param logExposure log exposure (ln dt) of each image, imageCount values
+ * @param lambda smoothness term weight
+ * @param weights weighting function, RESPONSE_CURVE_SIZE values
+ * @param g receives the log exposure for each pixel value, RESPONSE_CURVE_SIZE values
+ * @param logIrradiance receives the log irradiance of each pixel location,
+ * pixelCount values (may be NULL). Locations with zero total weight are set to 0.
+ * @return false if the system is singular (e.g. all weights are zero)
+ */
+bool SolveResponseCurve( const uchar * z, int pixelCount, int imageCount, const float * logExposure, float lambda,
+                         const float * weights, float * g, float * logIrradiance );
+
+/**
+ * Selects pixel locations for response curve recovery. Samples are stratified
+ * across the intensity range of the reference (middle) exposure so that the
+ * solver sees the whole curve; within each intensity stratum the locations with
+ * the lowest local gradient are preferred (misaligned edges produce outliers)
+ * and picked evenly in scan order to keep them spread over the frame. Locations
+ * that are under- or overexposed in more than half of the images are rejected.
+ * @param images luma planes of the bracketed images (width * height bytes each)
+ * @param imageCount number of images
+ * @param reference index of the reference (middle) exposure
+ * @param width image width
+ * @param height image height
+ * @param samples receives selected pixel indices (y * width + x) in ascending order
+ * @param maxSamples capacity of the samples array
+ * @return number of selected samples
+ */
+int SelectResponseSamples( const uchar * const * images, int imageCount, int reference, int width, int height,
+                           int * samples, int maxSamples );
+
+#endif
@@ -0,0 +1,106 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of SceneChangeDetector.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "SceneChangeDetector.h"
+
+SceneChangeDetector::SceneChangeDetector( void )
+{
+    memset( m_histogram, 0, sizeof( m_histogram ) );
+    memset( m_referenceHistogram, 0, sizeof( m_referenceHistogram ) );
+    m_framesSinceReference = 0;
+    m_accepted = true;
+    m_frameCount = m_skipCount = 0;
+}
+
+bool SceneChangeDetector::update( const uchar * luma, int width, int height )
+{
+    // account for the previous frame
+    m_skipCount += m_accepted ? 0 : 1;
+    m_frameCount++;
+    m_accepted = false;
+    m_framesSinceReference++;
+
+    // sparse thumbnail and its histogram
+    const int tw = width / SCENE_SAMPLING_STEP;
+    const int th = height / SCENE_SAMPLING_STEP;
+    const int offset = SCENE_SAMPLING_STEP >> 1;
+
+    m_thumbnail.resize( tw * th );
+    memset( m_histogram, 0, sizeof( m_histogram ) );
+
+    uchar * dest = m_thumbnail.empty() ? 0 : &m_thumbnail[0];
+    for ( int y = 0; y < th; y++ )
+    {
+        const uchar * src = luma + ( y * SCENE_SAMPLING_STEP + offset ) * width + offset;
+        for ( int x = 0; x < tw; x++ )
+        {
+            uchar v = src[x * SCENE_SAMPLING_STEP];
+            *dest++ = v;
+            m_histogram[v * SCENE_HISTOGRAM_SIZE >> 8]++;
+        }
+    }
+
+    if ( m_reference.size() != m_thumbnail.size() || m_framesSinceReference > SCENE_MAX_SKIP_FRAMES )
+    {
+        return true;
+    }
+
+    // mean absolute thumbnail difference
+    const int count = tw * th;
+    uint diff = 0;
+    for ( int i = 0; i < count; i++ )
+    {
+        diff += abs(( int ) m_thumbnail[i] - ( int ) m_reference[i] );
+    }
+    if ( diff > SCENE_THUMBNAIL_THRESHOLD * count )
+    {
+        return true;
+    }
+
+    // histogram distance
+    uint distance = 0;
+    for ( int i = 0; i < SCENE_HISTOGRAM_SIZE; i++ )
+    {
+        distance += abs(( int ) m_histogram[i] - ( int ) m_referenceHistogram[i] );
+    }
+
+    return distance > SCENE_HISTOGRAM_THRESHOLD * count;
+}
+
+void SceneChangeDetector::accept( void )
+{
+    m_reference = m_thumbnail;
+    memcpy( m_referenceHistogram, m_histogram, sizeof( m_histogram ) );
+    m_framesSinceReference = 0;
+    m_accepted = true;
+}
@@ -0,0 +1,102 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SCENECHANGEDETECTOR_H
+#define _SCENECHANGEDETECTOR_H
+
+/**
+ * @file
+ * Definition of SceneChangeDetector.
+ */
+
+#include <vector>
+#include "Common.h"
+
+#define SCENE_SAMPLING_STEP        8     /**< Thumbnail sampling stride in pixels */
+#define SCENE_HISTOGRAM_SIZE       64    /**< Thumbnail histogram bin count */
+#define SCENE_THUMBNAIL_THRESHOLD  4.0f  /**< Mean absolute thumbnail difference (luma levels) treated as a change */
+#define SCENE_HISTOGRAM_THRESHOLD  0.15f /**< L1 distance of normalized histograms (0 - 2) treated as a change */
+#define SCENE_MAX_SKIP_FRAMES      15    /**< Maximum number of consecutive frames reported as unchanged */
+
+/**
+ * Cheap per-frame scene change detector. Compares a sparsely sampled luma
+ * thumbnail and its histogram against a reference frame, which is the last
+ * frame the caller accepted (i.e. ran its expensive processing on). Keeps
+ * track of the ratio of frames reported as unchanged.
+ */
+class SceneChangeDetector
+{
+public:
+    /**
+     * Default constructor.
+     */
+    SceneChangeDetector( void );
+
+    /**
+     * Samples a frame and compares it with the reference.
+     * @param luma pointer to frame luma plane
+     * @param width frame width in pixels
+     * @param height frame height in pixels
+     * @return true if the scene changed, there is no reference yet or the
+     * reference is older than SCENE_MAX_SKIP_FRAMES frames
+     */
+    bool update( const uchar * luma, int width, int height );
+
+    /**
+     * Makes the frame passed to the last update() call the reference frame.
+     * Frames not accepted before the next update() call are counted as skipped.
+     */
+    void accept( void );
+
+    /**
+     * Gets the ratio of skipped frames since the last resetCounters() call.
+     * @return skip ratio (0 - 1)
+     */
+    float getSkipRatio( void ) const
+    {
+        return m_frameCount > 0 ? ( float ) m_skipCount / m_frameCount : 0.0f;
+    }
+
+    /**
+     * Resets the skipped frame counters.
+     */
+    void resetCounters( void )
+    {
+        m_frameCount = m_skipCount = 0;
+    }
+
+private:
+    std::vector<uchar> m_thumbnail; /**< Current thumbnail */
+    std::vector<uchar> m_reference; /**< Reference thumbnail */
+    uint m_histogram[SCENE_HISTOGRAM_SIZE]; /**< Current thumbnail histogram */
+    uint m_referenceHistogram[SCENE_HISTOGRAM_SIZE]; /**< Reference thumbnail histogram */
+    int m_framesSinceReference; /**< Frames since the reference has been accepted */
+    bool m_accepted; /**< Current frame has been accepted */
+    uint m_frameCount; /**< Frames since counters reset */
+    uint m_skipCount; /**< Skipped frames since counters reset */
+};
+
+#endif
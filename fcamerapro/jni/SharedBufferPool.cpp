@@ -0,0 +1,135 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of SharedBufferPool.
+ */
+
+#include "SharedBufferPool.h"
+#include "Common.h"
+
+SharedBufferPool::SharedBufferPool( void )
+{
+    pthread_mutex_init( &m_lock, 0 );
+}
+
+SharedBufferPool::~SharedBufferPool( void )
+{
+    for ( int i = 0; i < m_entries.size(); i++ )
+    {
+        if ( m_entries[i].state == EStateInUse )
+        {
+            ERROR( "SharedBufferPool: deleting surface which is still in use!\n" );
+        }
+
+        delete m_entries[i].buffer;
+    }
+
+    pthread_mutex_destroy( &m_lock );
+}
+
+FCam::Tegra::Hal::SharedBuffer * SharedBufferPool::acquire( int width, int height, FCam::ImageFormat format )
+{
+    if ( format != FCam::YUV420p )
+    {
+        ERROR( "SharedBufferPool::acquire(): unsupported surface format (%i)!\n", format );
+        return 0;
+    }
+
+    FCam::Tegra::Hal::SharedBuffer * buffer = 0;
+
+    pthread_mutex_lock( &m_lock );
+
+    for ( int i = 0; i < m_entries.size(); i++ )
+    {
+        Entry & entry = m_entries[i];
+        if ( entry.state == EStateFree && entry.width == width && entry.height == height && entry.format == format )
+        {
+            entry.state = EStateInUse;
+            buffer = entry.buffer;
+            break;
+        }
+    }
+
+    if ( buffer == 0 )
+    {
+        Entry entry;
+        entry.buffer = new FCam::Tegra::Hal::SharedBuffer( width, height, FCam::Tegra::Hal::SharedBuffer::YUV420p );
+        entry.width = width;
+        entry.height = height;
+        entry.format = format;
+        entry.state = EStateInUse;
+        m_entries.push_back( entry );
+
+        buffer = entry.buffer;
+        LOG( "SharedBufferPool: allocated %ix%i surface (%i total)\n", width, height, ( int ) m_entries.size() );
+    }
+
+    pthread_mutex_unlock( &m_lock );
+
+    return buffer;
+}
+
+void SharedBufferPool::release( FCam::Tegra::Hal::SharedBuffer * buffer )
+{
+    pthread_mutex_lock( &m_lock );
+
+    for ( int i = 0; i < m_entries.size(); i++ )
+    {
+        if ( m_entries[i].buffer == buffer )
+        {
+            m_entries[i].state = EStatePending;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock( &m_lock );
+}
+
+void SharedBufferPool::collect( void )
+{
+    pthread_mutex_lock( &m_lock );
+
+    for ( int i = 0; i < m_entries.size(); i++ )
+    {
+        if ( m_entries[i].state == EStatePending )
+        {
+            m_entries[i].state = EStateFree;
+        }
+    }
+
+    pthread_mutex_unlock( &m_lock );
+}
+
+int SharedBufferPool::size( void )
+{
+    pthread_mutex_lock( &m_lock );
+    int rval = m_entries.size();
+    pthread_mutex_unlock( &m_lock );
+
+    return rval;
+}
@@ -0,0 +1,118 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SHAREDBUFFERPOOL_H
+#define _SHAREDBUFFERPOOL_H
+
+/**
+ * @file
+ * Definition of SharedBufferPool.
+ */
+
+#include <pthread.h>
+#include <vector>
+#include <FCam/FCam.h>
+#include <FCam/Tegra/hal/SharedBuffer.h>
+
+/**
+ * Pool of FCam hardware surfaces (CPU/GPU sharing) keyed by resolution and format.
+ * Surfaces are never deallocated while the application is running, they are
+ * recycled instead. This works around the SharedBuffer deallocation bug and
+ * lets each camera use its native preview resolution without allocation churn
+ * on camera switch.
+ *
+ * Released surfaces are not reused immediately. The GL thread might still
+ * reference them through an EGL image, so they are parked on a pending list and
+ * become available only after the next call to collect(), which should be issued
+ * by the GL thread once it has released the preview texture.
+ */
+class SharedBufferPool
+{
+public:
+    /**
+     * Default constructor.
+     */
+    SharedBufferPool( void );
+
+    /**
+     * Default destructor. Deallocates all surfaces owned by the pool.
+     */
+    ~SharedBufferPool( void );
+
+    /**
+     * Gets a surface with given resolution and format. A recycled surface is returned
+     * if available, otherwise a new one is allocated.
+     * @param width surface width in pixels
+     * @param height surface height in pixels
+     * @param format surface pixel format (only FCam::YUV420p is supported)
+     * @return pointer to the surface or 0 if failed
+     */
+    FCam::Tegra::Hal::SharedBuffer * acquire( int width, int height, FCam::ImageFormat format );
+
+    /**
+     * Returns a surface to the pool. The surface is reusable after next call to collect().
+     * @param buffer pointer to a surface obtained with acquire()
+     */
+    void release( FCam::Tegra::Hal::SharedBuffer * buffer );
+
+    /**
+     * Makes all surfaces released since last call available for reuse. Should be
+     * called from the GL thread after preview texture has been unlocked.
+     */
+    void collect( void );
+
+    /**
+     * Gets the number of surfaces allocated by the pool.
+     * @return number of allocated surfaces
+     */
+    int size( void );
+
+private:
+    /**
+     * Pool entry state.
+     */
+    enum EState
+    {
+        EStateFree, EStateInUse, EStatePending
+    };
+
+    /**
+     * Pool entry describing a single surface.
+     */
+    struct Entry
+    {
+        FCam::Tegra::Hal::SharedBuffer * buffer; /**< Pointer to the surface */
+        int width; /**< Surface width in pixels */
+        int height; /**< Surface height in pixels */
+        FCam::ImageFormat format; /**< Surface pixel format */
+        EState state; /**< Surface state */
+    };
+
+    std::vector<Entry> m_entries; /**< All surfaces owned by the pool */
+    pthread_mutex_t m_lock; /**< Mutex guarding #m_entries */
+};
+
+#endif
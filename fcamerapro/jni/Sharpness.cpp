@@ -0,0 +1,222 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of image sharpness metrics.
+ */
+
+#include <string.h>
+#include "Sharpness.h"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+unsigned long long GetRowGradientEnergy( const uchar * row, int stride, int count )
+{
+    const uchar * up = row - stride;
+    const uchar * down = row + stride;
+    unsigned long long energy = 0;
+    int x = 0;
+
+#if defined(__ARM_NEON__)
+    int32x4_t acc = vdupq_n_s32( 0 );
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        int16x8_t gx = vreinterpretq_s16_u16( vsubl_u8( vld1_u8( row + x + 1 ), vld1_u8( row + x - 1 ) ) );
+        int16x8_t gy = vreinterpretq_s16_u16( vsubl_u8( vld1_u8( down + x ), vld1_u8( up + x ) ) );
+        acc = vmlal_s16( acc, vget_low_s16( gx ), vget_low_s16( gx ) );
+        acc = vmlal_s16( acc, vget_high_s16( gx ), vget_high_s16( gx ) );
+        acc = vmlal_s16( acc, vget_low_s16( gy ), vget_low_s16( gy ) );
+        acc = vmlal_s16( acc, vget_high_s16( gy ), vget_high_s16( gy ) );
+    }
+    uint64x2_t acc64 = vpaddlq_u32( vreinterpretq_u32_s32( acc ) );
+    energy += vgetq_lane_u64( acc64, 0 ) + vgetq_lane_u64( acc64, 1 );
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        __m128i l = _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( row + x - 1 ) ), zero );
+        __m128i r = _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( row + x + 1 ) ), zero );
+        __m128i u = _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( up + x ) ), zero );
+        __m128i d = _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( down + x ) ), zero );
+        __m128i gx = _mm_sub_epi16( r, l );
+        __m128i gy = _mm_sub_epi16( d, u );
+        acc = _mm_add_epi32( acc, _mm_add_epi32( _mm_madd_epi16( gx, gx ), _mm_madd_epi16( gy, gy ) ) );
+    }
+    uint lanes[4];
+    _mm_storeu_si128(( __m128i * ) lanes, acc );
+    energy += ( unsigned long long ) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+    for ( ; x < count; x++ )
+    {
+        int gx = row[x + 1] - row[x - 1];
+        int gy = down[x] - up[x];
+        energy += gx * gx + gy * gy;
+    }
+
+    return energy;
+}
+
+void AddRowLaplacianEnergy( const uchar * row, int stride, int blockCount, uint * energy )
+{
+    const uchar * up = row - stride;
+    const uchar * down = row + stride;
+
+    for ( int b = 0; b < blockCount; b++ )
+    {
+        int x = b * SHARPNESS_BLOCK_SIZE;
+
+#if defined(__ARM_NEON__)
+        uint16x8_t c = vshll_n_u8( vld1_u8( row + x ), 2 );
+        uint16x8_t n = vaddl_u8( vld1_u8( row + x - 1 ), vld1_u8( row + x + 1 ) );
+        n = vaddq_u16( n, vaddl_u8( vld1_u8( up + x ), vld1_u8( down + x ) ) );
+        int16x8_t lap = vreinterpretq_s16_u16( vsubq_u16( c, n ) );
+        int32x4_t acc = vmull_s16( vget_low_s16( lap ), vget_low_s16( lap ) );
+        acc = vmlal_s16( acc, vget_high_s16( lap ), vget_high_s16( lap ) );
+        uint64x2_t acc64 = vpaddlq_u32( vreinterpretq_u32_s32( acc ) );
+        energy[b] += (uint) ( vgetq_lane_u64( acc64, 0 ) + vgetq_lane_u64( acc64, 1 ) );
+#elif defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        __m128i c = _mm_slli_epi16( _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( row + x ) ), zero ), 2 );
+        __m128i l = _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( row + x - 1 ) ), zero );
+        __m128i r = _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( row + x + 1 ) ), zero );
+        __m128i u = _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( up + x ) ), zero );
+        __m128i d = _mm_unpacklo_epi8( _mm_loadl_epi64(( const __m128i * )( down + x ) ), zero );
+        __m128i lap = _mm_sub_epi16( c, _mm_add_epi16( _mm_add_epi16( l, r ), _mm_add_epi16( u, d ) ) );
+        __m128i acc = _mm_madd_epi16( lap, lap );
+        acc = _mm_add_epi32( acc, _mm_shuffle_epi32( acc, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+        acc = _mm_add_epi32( acc, _mm_shuffle_epi32( acc, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+        energy[b] += (uint) _mm_cvtsi128_si32( acc );
+#else
+        uint sum = 0;
+        for ( int i = x; i < x + SHARPNESS_BLOCK_SIZE; i++ )
+        {
+            int lap = 4 * row[i] - row[i - 1] - row[i + 1] - up[i] - down[i];
+            sum += lap * lap;
+        }
+        energy[b] += sum;
+#endif
+    }
+}
+
+/**
+ * Halves a luma plane with a 2x2 box filter (rounded vertical average, then
+ * rounded horizontal average).
+ * @param src source plane
+ * @param srcWidth source row size in bytes
+ * @param dst output plane
+ * @param width output width in pixels
+ * @param height output height in pixels
+ */
+static void DownsampleLuma( const uchar * src, int srcWidth, uchar * dst, int width, int height )
+{
+    for ( int y = 0; y < height; y++ )
+    {
+        const uchar * r0 = src + 2 * y * srcWidth;
+        const uchar * r1 = r0 + srcWidth;
+        uchar * d = dst + y * width;
+        int x = 0;
+
+#if defined(__ARM_NEON__)
+        for ( ; x + 8 <= width; x += 8 )
+        {
+            uint8x16_t v = vrhaddq_u8( vld1q_u8( r0 + 2 * x ), vld1q_u8( r1 + 2 * x ) );
+            vst1_u8( d + x, vrshrn_n_u16( vpaddlq_u8( v ), 1 ) );
+        }
+#elif defined(__SSE2__)
+        const __m128i lowBytes = _mm_set1_epi16( 0x00ff );
+        for ( ; x + 8 <= width; x += 8 )
+        {
+            __m128i v = _mm_avg_epu8( _mm_loadu_si128(( const __m128i * )( r0 + 2 * x ) ),
+                                      _mm_loadu_si128(( const __m128i * )( r1 + 2 * x ) ) );
+            __m128i h = _mm_avg_epu16( _mm_and_si128( v, lowBytes ), _mm_srli_epi16( v, 8 ) );
+            _mm_storel_epi64(( __m128i * )( d + x ), _mm_packus_epi16( h, h ) );
+        }
+#endif
+
+        for ( ; x < width; x++ )
+        {
+            int a = ( r0[2 * x] + r1[2 * x] + 1 ) >> 1;
+            int b = ( r0[2 * x + 1] + r1[2 * x + 1] + 1 ) >> 1;
+            d[x] = ( uchar )(( a + b + 1 ) >> 1 );
+        }
+    }
+}
+
+float GetFrameSharpness( const uchar * luma, int width, int height, std::vector<uchar> & scratch )
+{
+    // the levels follow each other in the scratch buffer
+    int levels = 0;
+    size_t size = 0;
+    for ( int w = width, h = height; levels < SHARPNESS_DOWNSAMPLE_LEVELS && w >= 2 && h >= 2; levels++ )
+    {
+        w >>= 1;
+        h >>= 1;
+        size += w * h;
+    }
+    scratch.resize( size );
+
+    const uchar * src = luma;
+    uchar * dst = scratch.empty() ? 0 : &scratch[0];
+    for ( int level = 0; level < levels; level++ )
+    {
+        DownsampleLuma( src, width, dst, width >> 1, height >> 1 );
+        src = dst;
+        width >>= 1;
+        height >>= 1;
+        dst += width * height;
+    }
+
+    return GetGradientEnergy( src, width, height, 0, 0, width, height );
+}
+
+float GetGradientEnergy( const uchar * luma, int width, int height, int x, int y, int roiWidth, int roiHeight )
+{
+    // keep one pixel away from the frame border (central differences)
+    int x0 = x < 1 ? 1 : x;
+    int y0 = y < 1 ? 1 : y;
+    int x1 = x + roiWidth > width - 1 ? width - 1 : x + roiWidth;
+    int y1 = y + roiHeight > height - 1 ? height - 1 : y + roiHeight;
+
+    if ( x1 <= x0 || y1 <= y0 )
+    {
+        return 0.0f;
+    }
+
+    unsigned long long energy = 0;
+    for ( int j = y0; j < y1; j++ )
+    {
+        energy += GetRowGradientEnergy( luma + j * width + x0, width, x1 - x0 );
+    }
+
+    return ( float )(( double ) energy / (( x1 - x0 ) * ( y1 - y0 ) ) );
+}
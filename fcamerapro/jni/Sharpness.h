@@ -0,0 +1,89 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SHARPNESS_H
+#define _SHARPNESS_H
+
+/**
+ * @file
+ * Definition of image sharpness metrics.
+ */
+
+#include <vector>
+#include "Common.h"
+
+#define SHARPNESS_BLOCK_SIZE        8 /**< Block size (pixels) of AddRowLaplacianEnergy */
+#define SHARPNESS_DOWNSAMPLE_LEVELS 2 /**< 2x2 box filter halvings of the luma plane measured by GetFrameSharpness */
+
+/**
+ * Computes gradient energy (Tenengrad) of a luma rectangle: the mean of squared
+ * central differences gx^2 + gy^2. The rectangle is clipped so that it does not
+ * touch the frame border.
+ * @param luma pointer to luma plane
+ * @param width frame width in pixels (luma plane row size)
+ * @param height frame height in pixels
+ * @param x left edge of the rectangle
+ * @param y top edge of the rectangle
+ * @param roiWidth rectangle width in pixels
+ * @param roiHeight rectangle height in pixels
+ * @return mean gradient energy per pixel (0 if the clipped rectangle is empty)
+ */
+float GetGradientEnergy( const uchar * luma, int width, int height, int x, int y, int roiWidth, int roiHeight );
+
+/**
+ * Computes sum of squared central differences along a part of a luma row.
+ * @param row pointer to the first pixel of the span
+ * @param stride luma plane row size in bytes
+ * @param count number of pixels
+ * @return sum of gx^2 + gy^2 over the span
+ */
+unsigned long long GetRowGradientEnergy( const uchar * row, int stride, int count );
+
+/**
+ * Adds the sums of squared Laplacians 4c - l - r - u - d of consecutive
+ * SHARPNESS_BLOCK_SIZE pixel blocks of a luma row span to per-block accumulators.
+ * @param row pointer to the first pixel of the span (needs one pixel of margin
+ * on each side, and the rows above and below)
+ * @param stride luma plane row size in bytes
+ * @param blockCount number of blocks in the span
+ * @param energy per-block accumulators (blockCount values)
+ */
+void AddRowLaplacianEnergy( const uchar * row, int stride, int blockCount, uint * energy );
+
+/**
+ * Computes a fast whole-frame sharpness score: the gradient energy of the luma
+ * plane downsampled SHARPNESS_DOWNSAMPLE_LEVELS times. Motion and focus blur
+ * remain visible at the lower resolution while sensor noise, which would
+ * otherwise dominate the energy of short exposures, is averaged out.
+ * @param luma pointer to luma plane
+ * @param width frame width in pixels (luma plane row size)
+ * @param height frame height in pixels
+ * @param scratch buffer for the downsampled planes (reused between calls)
+ * @return mean gradient energy per downsampled pixel
+ */
+float GetFrameSharpness( const uchar * luma, int width, int height, std::vector<uchar> & scratch );
+
+#endif
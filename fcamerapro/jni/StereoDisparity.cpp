@@ -0,0 +1,336 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "StereoDisparity.h"
+#include "ThreadPool.h"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define STEREO_COST_PAD 0x7fff /**< Cost of disparities outside the view (above any window SAD) */
+
+/**
+ * Updates running column sums with the absolute differences of an entering
+ * row pair and, optionally, a leaving row pair: sum += |a - b| - |c - d|.
+ * @param sum column sums
+ * @param a entering left view row
+ * @param b entering right view row (shifted by the disparity)
+ * @param c leaving left view row (0 to only add)
+ * @param d leaving right view row
+ * @param count number of columns
+ */
+static void UpdateColumnSums( ushort * sum, const uchar * a, const uchar * b, const uchar * c, const uchar * d, int count )
+{
+    int x = 0;
+
+#if defined(__ARM_NEON__)
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        uint16x8_t s = vaddq_u16( vld1q_u16( sum + x ), vabdl_u8( vld1_u8( a + x ), vld1_u8( b + x ) ) );
+        if ( c != 0 )
+        {
+            s = vsubq_u16( s, vabdl_u8( vld1_u8( c + x ), vld1_u8( d + x ) ) );
+        }
+        vst1q_u16( sum + x, s );
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        __m128i va = _mm_loadl_epi64(( const __m128i * )( a + x ) );
+        __m128i vb = _mm_loadl_epi64(( const __m128i * )( b + x ) );
+        __m128i ad = _mm_unpacklo_epi8( _mm_or_si128( _mm_subs_epu8( va, vb ), _mm_subs_epu8( vb, va ) ), zero );
+        __m128i s = _mm_add_epi16( _mm_loadu_si128(( const __m128i * )( sum + x ) ), ad );
+        if ( c != 0 )
+        {
+            __m128i vc = _mm_loadl_epi64(( const __m128i * )( c + x ) );
+            __m128i vd = _mm_loadl_epi64(( const __m128i * )( d + x ) );
+            s = _mm_sub_epi16( s, _mm_unpacklo_epi8( _mm_or_si128( _mm_subs_epu8( vc, vd ), _mm_subs_epu8( vd, vc ) ), zero ) );
+        }
+        _mm_storeu_si128(( __m128i * )( sum + x ), s );
+    }
+#endif
+
+    for ( ; x < count; x++ )
+    {
+        int s = sum[x] + abs( a[x] - b[x] );
+        if ( c != 0 )
+        {
+            s -= abs( c[x] - d[x] );
+        }
+        sum[x] = (ushort) s;
+    }
+}
+
+/**
+ * Winner-takes-all update: where cost < best, best = cost and index = disparity.
+ * @param best best costs
+ * @param index best disparities
+ * @param cost costs of the disparity
+ * @param disparity disparity
+ * @param count number of pixels
+ */
+static void SelectMinimum( ushort * best, ushort * index, const ushort * cost, int disparity, int count )
+{
+    int x = 0;
+
+#if defined(__ARM_NEON__)
+    uint16x8_t vd = vdupq_n_u16( disparity );
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        uint16x8_t c = vld1q_u16( cost + x );
+        uint16x8_t b = vld1q_u16( best + x );
+        uint16x8_t mask = vcltq_u16( c, b );
+        vst1q_u16( best + x, vminq_u16( c, b ) );
+        vst1q_u16( index + x, vbslq_u16( mask, vd, vld1q_u16( index + x ) ) );
+    }
+#elif defined(__SSE2__)
+    // costs stay below 0x8000, so signed comparisons work
+    __m128i vd = _mm_set1_epi16( disparity );
+    for ( ; x + 8 <= count; x += 8 )
+    {
+        __m128i c = _mm_loadu_si128(( const __m128i * )( cost + x ) );
+        __m128i b = _mm_loadu_si128(( const __m128i * )( best + x ) );
+        __m128i i = _mm_loadu_si128(( const __m128i * )( index + x ) );
+        __m128i mask = _mm_cmplt_epi16( c, b );
+        _mm_storeu_si128(( __m128i * )( best + x ), _mm_min_epi16( c, b ) );
+        _mm_storeu_si128(( __m128i * )( index + x ), _mm_or_si128( _mm_and_si128( mask, vd ), _mm_andnot_si128( mask, i ) ) );
+    }
+#endif
+
+    for ( ; x < count; x++ )
+    {
+        if ( cost[x] < best[x] )
+        {
+            best[x] = cost[x];
+            index[x] = (ushort) disparity;
+        }
+    }
+}
+
+StereoDisparity::StereoDisparity( void ) : m_luma( 0 ), m_frameWidth( 0 ), m_width( 0 ), m_height( 0 ), m_bandCount( 1 ),
+    m_publishedWidth( 0 ), m_publishedHeight( 0 )
+{
+    pthread_mutex_init( &m_lock, 0 );
+}
+
+StereoDisparity::~StereoDisparity( void )
+{
+    pthread_mutex_destroy( &m_lock );
+}
+
+void StereoDisparity::compute( const uchar * luma, int width, int height, ThreadPool * pool )
+{
+    m_luma = luma;
+    m_frameWidth = width;
+    m_width = ( width >> 1 ) / STEREO_DOWNSAMPLE;
+    m_height = height / STEREO_DOWNSAMPLE;
+    m_bandCount = std::min( pool != 0 ? pool->concurrency() : 1, std::max( m_height / ( 4 * STEREO_WINDOW_RADIUS ), 1 ) );
+
+    m_left.resize( m_width * m_height );
+    m_right.resize( ( m_width + STEREO_MAX_DISPARITY ) * m_height );
+    m_map.resize( m_width * m_height );
+
+    // column sums, costs (padded by STEREO_MAX_DISPARITY), right view disparities and costs
+    int bandSize = STEREO_MAX_DISPARITY * m_width + STEREO_MAX_DISPARITY * ( m_width + STEREO_MAX_DISPARITY ) + 4 * m_width;
+    m_bandData.resize( bandSize * m_bandCount );
+
+    if ( pool != 0 )
+    {
+        pool->run( StereoDisparity::DownsampleProc, this, m_bandCount );
+        pool->run( StereoDisparity::MatchProc, this, m_bandCount );
+    }
+    else
+    {
+        for ( int i = 0; i < m_bandCount; i++ )
+        {
+            DownsampleProc( this, i );
+        }
+        for ( int i = 0; i < m_bandCount; i++ )
+        {
+            MatchProc( this, i );
+        }
+    }
+
+    pthread_mutex_lock( &m_lock );
+    m_published.swap( m_map );
+    m_publishedWidth = m_width;
+    m_publishedHeight = m_height;
+    pthread_mutex_unlock( &m_lock );
+}
+
+void StereoDisparity::getSize( int & width, int & height )
+{
+    pthread_mutex_lock( &m_lock );
+    width = m_publishedWidth;
+    height = m_publishedHeight;
+    pthread_mutex_unlock( &m_lock );
+}
+
+bool StereoDisparity::copyMap( uchar * map, int size )
+{
+    bool rval = false;
+
+    pthread_mutex_lock( &m_lock );
+    if ( m_publishedWidth > 0 && size == m_publishedWidth * m_publishedHeight )
+    {
+        memcpy( map, &m_published[0], size );
+        rval = true;
+    }
+    pthread_mutex_unlock( &m_lock );
+
+    return rval;
+}
+
+void StereoDisparity::DownsampleProc( void * opaque, int index )
+{
+    StereoDisparity * instance = (StereoDisparity *) opaque;
+    const int width = instance->m_width;
+    const int paddedWidth = width + STEREO_MAX_DISPARITY;
+    const int stride = instance->m_frameWidth;
+    const int viewOffset = stride >> 1;
+    const int norm = STEREO_DOWNSAMPLE * STEREO_DOWNSAMPLE;
+
+    for ( int y = instance->getBandRow( index ); y < instance->getBandRow( index + 1 ); y++ )
+    {
+        const uchar * src = instance->m_luma + y * STEREO_DOWNSAMPLE * stride;
+        uchar * left = &instance->m_left[y * width];
+        uchar * right = &instance->m_right[y * paddedWidth + STEREO_MAX_DISPARITY];
+
+        for ( int x = 0; x < width; x++ )
+        {
+            int l = 0, r = 0;
+            for ( int j = 0; j < STEREO_DOWNSAMPLE; j++ )
+            {
+                const uchar * p = src + j * stride + x * STEREO_DOWNSAMPLE;
+                for ( int i = 0; i < STEREO_DOWNSAMPLE; i++ )
+                {
+                    l += p[i];
+                    r += p[viewOffset + i];
+                }
+            }
+            left[x] = (uchar) ( l / norm );
+            right[x] = (uchar) ( r / norm );
+        }
+
+        // left padding replicates the first pixel
+        memset( right - STEREO_MAX_DISPARITY, right[0], STEREO_MAX_DISPARITY );
+    }
+}
+
+void StereoDisparity::MatchProc( void * opaque, int index )
+{
+    StereoDisparity * instance = (StereoDisparity *) opaque;
+    const int width = instance->m_width;
+    const int height = instance->m_height;
+    const int paddedWidth = width + STEREO_MAX_DISPARITY;
+    const int r = STEREO_WINDOW_RADIUS;
+
+    int bandSize = STEREO_MAX_DISPARITY * width + STEREO_MAX_DISPARITY * paddedWidth + 4 * width;
+    ushort * columnSums = &instance->m_bandData[index * bandSize];
+    ushort * costs = columnSums + STEREO_MAX_DISPARITY * width;
+    ushort * leftBest = costs + STEREO_MAX_DISPARITY * paddedWidth;
+    ushort * leftIndex = leftBest + width;
+    ushort * rightBest = leftIndex + width;
+    ushort * rightIndex = rightBest + width;
+
+    // cost row tails stand for disparities pointing outside the left view
+    for ( int d = 0; d < STEREO_MAX_DISPARITY; d++ )
+    {
+        std::fill( costs + d * paddedWidth + width, costs + ( d + 1 ) * paddedWidth, (ushort) STEREO_COST_PAD );
+    }
+
+    int y0 = instance->getBandRow( index );
+    int y1 = instance->getBandRow( index + 1 );
+
+    for ( int y = y0; y < y1; y++ )
+    {
+        // vertical aggregation: running column sums over the window rows (clamped at the borders)
+        for ( int d = 0; d < STEREO_MAX_DISPARITY; d++ )
+        {
+            ushort * sum = columnSums + d * width;
+            if ( y == y0 )
+            {
+                memset( sum, 0, width * sizeof( ushort ) );
+                for ( int j = y - r; j <= y + r; j++ )
+                {
+                    int row = std::min( std::max( j, 0 ), height - 1 );
+                    UpdateColumnSums( sum, &instance->m_left[row * width],
+                                      &instance->m_right[row * paddedWidth + STEREO_MAX_DISPARITY - d], 0, 0, width );
+                }
+            }
+            else
+            {
+                int in = std::min( y + r, height - 1 );
+                int out = std::max( y - r - 1, 0 );
+                UpdateColumnSums( sum, &instance->m_left[in * width], &instance->m_right[in * paddedWidth + STEREO_MAX_DISPARITY - d],
+                                  &instance->m_left[out * width], &instance->m_right[out * paddedWidth + STEREO_MAX_DISPARITY - d],
+                                  width );
+            }
+
+            // horizontal aggregation: running row sum (clamped at the borders)
+            ushort * cost = costs + d * paddedWidth;
+            int acc = ( r + 1 ) * sum[0];
+            for ( int x = 1; x <= r; x++ )
+            {
+                acc += sum[std::min( x, width - 1 )];
+            }
+            for ( int x = 0; x < width; x++ )
+            {
+                cost[x] = (ushort) acc;
+                acc += sum[std::min( x + r + 1, width - 1 )] - sum[std::max( x - r, 0 )];
+            }
+        }
+
+        // left view: best d for pixel x, right view: best d for pixel x (left pixel x + d)
+        std::fill( leftBest, leftBest + width, (ushort) STEREO_COST_PAD );
+        std::fill( rightBest, rightBest + width, (ushort) STEREO_COST_PAD );
+        memset( leftIndex, 0, width * sizeof( ushort ) );
+        memset( rightIndex, 0, width * sizeof( ushort ) );
+        for ( int d = 0; d < STEREO_MAX_DISPARITY; d++ )
+        {
+            const ushort * cost = costs + d * paddedWidth;
+            SelectMinimum( leftBest, leftIndex, cost, d, width );
+            SelectMinimum( rightBest, rightIndex, cost + d, d, width );
+        }
+
+        // left-right consistency check
+        uchar * map = &instance->m_map[y * width];
+        for ( int x = 0; x < width; x++ )
+        {
+            int d = leftIndex[x];
+            bool valid = d <= x && abs( rightIndex[x - d] - d ) <= STEREO_LR_TOLERANCE;
+            map[x] = valid ? (uchar) d : STEREO_INVALID_DISPARITY;
+        }
+    }
+}
@@ -0,0 +1,137 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _STEREO_DISPARITY_H
+#define _STEREO_DISPARITY_H
+
+/**
+ * @file
+ * Definition of StereoDisparity.
+ */
+
+#include <pthread.h>
+#include <vector>
+#include "Common.h"
+
+class ThreadPool;
+
+#define STEREO_DOWNSAMPLE         2   /**< Matching resolution divider (per view, both axes) */
+#define STEREO_MAX_DISPARITY      32  /**< Disparity search range in matching pixels */
+#define STEREO_WINDOW_RADIUS      3   /**< SAD window radius in matching pixels */
+#define STEREO_LR_TOLERANCE       1   /**< Maximum left-right disparity difference of consistent matches */
+#define STEREO_INVALID_DISPARITY  255 /**< Disparity map value of occluded and inconsistent pixels */
+
+/**
+ * Stereo disparity engine for the side-by-side REAR_STEREO preview stream
+ * (left view in the left half of the frame, right view in the right half,
+ * rectified by the sensor so that epipolar lines are rows):
+ * - both views are box downsampled by STEREO_DOWNSAMPLE;
+ * - matching costs are sums of absolute luma differences over
+ *   (2 * STEREO_WINDOW_RADIUS + 1)^2 windows for every disparity in
+ *   [0, STEREO_MAX_DISPARITY), aggregated incrementally with running column
+ *   sums (SIMD row kernels) and running row sums;
+ * - winner-takes-all disparities are selected for both the left and the
+ *   right view, pixels whose left and right disparities differ by more than
+ *   STEREO_LR_TOLERANCE (occlusions, mismatches) are marked with
+ *   STEREO_INVALID_DISPARITY.
+ *
+ * The views are matched in bands of rows on a thread pool. The latest map is
+ * published under a lock, so the UI thread can copy it at any time.
+ */
+class StereoDisparity
+{
+public:
+    /**
+     * Default constructor.
+     */
+    StereoDisparity( void );
+
+    /**
+     * Default destructor.
+     */
+    ~StereoDisparity( void );
+
+    /**
+     * Computes the disparity map of a stereo frame and publishes it.
+     * @param luma side-by-side stereo frame luma plane
+     * @param width frame width in pixels (both views)
+     * @param height frame height in pixels
+     * @param pool thread pool (can be 0)
+     */
+    void compute( const uchar * luma, int width, int height, ThreadPool * pool );
+
+    /**
+     * Gets the size of the published disparity map.
+     * @param width receives the map width (0 if no map has been computed yet)
+     * @param height receives the map height
+     */
+    void getSize( int & width, int & height );
+
+    /**
+     * Copies the published disparity map. Values are disparities in matching
+     * pixels (0 to STEREO_MAX_DISPARITY - 1) or STEREO_INVALID_DISPARITY.
+     * @param map destination buffer
+     * @param size destination buffer size (needs to match the map size)
+     * @return true if the map has been copied
+     */
+    bool copyMap( uchar * map, int size );
+
+private:
+    /**
+     * Downsamples a band of rows of both views.
+     */
+    static void DownsampleProc( void * opaque, int index );
+
+    /**
+     * Matches a band of rows.
+     */
+    static void MatchProc( void * opaque, int index );
+
+    /**
+     * Gets the first row of a band.
+     * @param index band index (0 to m_bandCount)
+     */
+    int getBandRow( int index ) const
+    {
+        return index * m_height / m_bandCount;
+    }
+
+    const uchar * m_luma; /**< Frame being matched */
+    int m_frameWidth; /**< Frame row size */
+    int m_width, m_height; /**< Matching resolution (per view) */
+    int m_bandCount; /**< Number of bands */
+
+    std::vector<uchar> m_left; /**< Downsampled left view */
+    std::vector<uchar> m_right; /**< Downsampled right view, STEREO_MAX_DISPARITY pixels of left padding per row */
+    std::vector<ushort> m_bandData; /**< Per band column sums, costs and right view disparities */
+    std::vector<uchar> m_map; /**< Disparity map being computed */
+
+    std::vector<uchar> m_published; /**< Latest complete disparity map */
+    int m_publishedWidth, m_publishedHeight; /**< Published map size */
+    pthread_mutex_t m_lock; /**< Guards the published map */
+};
+
+#endif
@@ -0,0 +1,176 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of ThreadPool.
+ */
+
+#include <unistd.h>
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool( int threadCount )
+{
+    if ( threadCount <= 0 )
+    {
+        threadCount = sysconf( _SC_NPROCESSORS_ONLN ) - 1;
+    }
+
+    pthread_mutex_init( &m_runLock, 0 );
+    pthread_mutex_init( &m_lock, 0 );
+    pthread_cond_init( &m_workCond, 0 );
+    pthread_cond_init( &m_doneCond, 0 );
+
+    m_task = 0;
+    m_opaque = 0;
+    m_taskCount = 0;
+    m_nextTask = 0;
+    m_pendingTasks = 0;
+    m_batchId = 0;
+    m_exit = false;
+
+    m_threadCount = threadCount > 0 ? threadCount : 0;
+    m_threads = m_threadCount > 0 ? new pthread_t[m_threadCount] : 0;
+
+    for ( int i = 0; i < m_threadCount; i++ )
+    {
+        pthread_create( &m_threads[i], 0, ThreadPool::ThreadProc, this );
+    }
+}
+
+ThreadPool::~ThreadPool( void )
+{
+    pthread_mutex_lock( &m_lock );
+    m_exit = true;
+    pthread_cond_broadcast( &m_workCond );
+    pthread_mutex_unlock( &m_lock );
+
+    for ( int i = 0; i < m_threadCount; i++ )
+    {
+        pthread_join( m_threads[i], 0 );
+    }
+
+    delete[] m_threads;
+
+    pthread_cond_destroy( &m_doneCond );
+    pthread_cond_destroy( &m_workCond );
+    pthread_mutex_destroy( &m_lock );
+    pthread_mutex_destroy( &m_runLock );
+}
+
+void ThreadPool::run( THREAD_POOL_TASK task, void * opaque, int taskCount )
+{
+    if ( taskCount <= 0 )
+    {
+        return;
+    }
+
+    // single task or no workers, don't bother waking up the pool
+    if ( taskCount == 1 || m_threadCount == 0 )
+    {
+        for ( int i = 0; i < taskCount; i++ )
+        {
+            task( opaque, i );
+        }
+        return;
+    }
+
+    pthread_mutex_lock( &m_runLock );
+
+    // post new batch
+    pthread_mutex_lock( &m_lock );
+    m_task = task;
+    m_opaque = opaque;
+    m_taskCount = taskCount;
+    m_nextTask = 0;
+    m_pendingTasks = taskCount;
+    m_batchId++;
+    pthread_cond_broadcast( &m_workCond );
+    pthread_mutex_unlock( &m_lock );
+
+    // help the workers
+    processTasks();
+
+    // wait for completion
+    pthread_mutex_lock( &m_lock );
+    while ( m_pendingTasks > 0 )
+    {
+        pthread_cond_wait( &m_doneCond, &m_lock );
+    }
+    m_task = 0;
+    pthread_mutex_unlock( &m_lock );
+
+    pthread_mutex_unlock( &m_runLock );
+}
+
+void ThreadPool::processTasks( void )
+{
+    pthread_mutex_lock( &m_lock );
+    while ( m_nextTask < m_taskCount )
+    {
+        int index = m_nextTask++;
+        THREAD_POOL_TASK task = m_task;
+        void * opaque = m_opaque;
+        pthread_mutex_unlock( &m_lock );
+
+        task( opaque, index );
+
+        pthread_mutex_lock( &m_lock );
+        if ( --m_pendingTasks == 0 )
+        {
+            pthread_cond_signal( &m_doneCond );
+        }
+    }
+    pthread_mutex_unlock( &m_lock );
+}
+
+void * ThreadPool::ThreadProc( void * opaque )
+{
+    ThreadPool * instance = ( ThreadPool * ) opaque;
+    int batchId = 0;
+
+    for ( ;; )
+    {
+        pthread_mutex_lock( &instance->m_lock );
+        while ( !instance->m_exit && instance->m_batchId == batchId )
+        {
+            pthread_cond_wait( &instance->m_workCond, &instance->m_lock );
+        }
+
+        if ( instance->m_exit )
+        {
+            pthread_mutex_unlock( &instance->m_lock );
+            break;
+        }
+
+        batchId = instance->m_batchId;
+        pthread_mutex_unlock( &instance->m_lock );
+
+        instance->processTasks();
+    }
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+/**
+ * @file
+ * Definition of ThreadPool.
+ */
+
+#include <pthread.h>
+
+/**
+ * Task function type for ThreadPool. The function is called once for every task index.
+ * @param opaque user data pointer passed to ThreadPool::run()
+ * @param index task index (0 to task count - 1)
+ */
+typedef void ( *THREAD_POOL_TASK )( void * opaque, int index );
+
+/**
+ * Fixed-size pool of worker threads used to split image processing kernels
+ * into independent tasks (bands, tiles). The calling thread takes part in
+ * the processing, so a pool with N workers keeps N+1 cores busy.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * Default constructor. Creates worker threads.
+     * @param threadCount number of worker threads, if zero the pool creates
+     * one worker less than the number of online cores
+     */
+    ThreadPool( int threadCount = 0 );
+
+    /**
+     * Default destructor. Terminates and joins worker threads.
+     */
+    ~ThreadPool( void );
+
+    /**
+     * Gets the number of threads executing tasks (workers and the calling thread).
+     * @return number of concurrently executed tasks
+     */
+    int concurrency( void )
+    {
+        return m_threadCount + 1;
+    }
+
+    /**
+     * Executes task function for every index in range [0, taskCount) and returns
+     * after all tasks have completed. Calls from different threads are serialized.
+     * @param task pointer to task function
+     * @param opaque user data pointer passed to the task function
+     * @param taskCount number of tasks
+     */
+    void run( THREAD_POOL_TASK task, void * opaque, int taskCount );
+
+private:
+    /**
+     * Worker thread implementation. Sleeps until new batch of tasks is posted
+     * with run() and executes tasks until the batch is exhausted.
+     */
+    static void * ThreadProc( void * );
+
+    /**
+     * Executes tasks from current batch until none is left.
+     */
+    void processTasks( void );
+
+    pthread_t * m_threads; /**< Worker thread handlers */
+    int m_threadCount; /**< Number of worker threads */
+
+    pthread_mutex_t m_runLock; /**< Serializes concurrent run() calls */
+    pthread_mutex_t m_lock; /**< Guards batch state below */
+    pthread_cond_t m_workCond; /**< Signalled when new batch is posted */
+    pthread_cond_t m_doneCond; /**< Signalled when batch is complete */
+
+    THREAD_POOL_TASK m_task; /**< Current batch task function */
+    void * m_opaque; /**< Current batch user data */
+    int m_taskCount; /**< Number of tasks in current batch */
+    int m_nextTask; /**< Index of next task to execute */
+    int m_pendingTasks; /**< Number of unfinished tasks in current batch */
+    int m_batchId; /**< Current batch counter (wakes up workers) */
+    bool m_exit; /**< Worker termination flag */
+};
+
+#endif
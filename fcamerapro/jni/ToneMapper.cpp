@@ -0,0 +1,526 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of ToneMapper.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "ToneMapper.h"
+#include "ThreadPool.h"
+#include "HPT.h"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Finds the log luminance below which a given fraction of pixels lies.
+ * @param histogram log luminance histogram
+ * @param total number of pixels in the histogram
+ * @param fraction percentile (0 - 1)
+ * @return log luminance
+ */
+static float GetPercentile( const uint * histogram, uint total, float fraction )
+{
+    uint threshold = (uint) ( total * fraction );
+    uint sum = 0;
+    int i = 0;
+    for ( ; i < TONE_MAP_HISTOGRAM_BINS - 1; i++ )
+    {
+        sum += histogram[i];
+        if ( sum > threshold )
+        {
+            break;
+        }
+    }
+
+    return ( i + 0.5f ) * ( 2.0f * TONE_MAP_LOG_RANGE / TONE_MAP_HISTOGRAM_BINS ) - TONE_MAP_LOG_RANGE;
+}
+
+/**
+ * Computes global operator scale factors s = k * ( 1 + k * L / Lw^2 ) / ( 1 + k * L ),
+ * where k is the key scale, in place.
+ * @param values luminance on input, scale factors on output
+ * @param count number of values
+ * @param k key scale
+ * @param invWhite2 1 / Lw^2
+ */
+static void ApplyGlobalCurve( float * values, int count, float k, float invWhite2 )
+{
+    int i = 0;
+    float kw = k * invWhite2;
+
+#if defined(__ARM_NEON__)
+    float32x4_t one = vdupq_n_f32( 1.0f );
+    for ( ; i + 4 <= count; i += 4 )
+    {
+        float32x4_t lm = vmulq_n_f32( vld1q_f32( values + i ), k );
+        float32x4_t d = vaddq_f32( one, lm );
+        float32x4_t r = vrecpeq_f32( d );
+        r = vmulq_f32( r, vrecpsq_f32( d, r ) );
+        r = vmulq_f32( r, vrecpsq_f32( d, r ) );
+        float32x4_t n = vmulq_n_f32( vmlaq_n_f32( one, lm, invWhite2 ), k );
+        vst1q_f32( values + i, vmulq_f32( n, r ) );
+    }
+#elif defined(__SSE2__)
+    __m128 one = _mm_set1_ps( 1.0f );
+    __m128 kk = _mm_set1_ps( k );
+    __m128 kkw = _mm_set1_ps( kw );
+    for ( ; i + 4 <= count; i += 4 )
+    {
+        __m128 l = _mm_loadu_ps( values + i );
+        __m128 n = _mm_mul_ps( kk, _mm_add_ps( one, _mm_mul_ps( kkw, l ) ) );
+        __m128 d = _mm_add_ps( one, _mm_mul_ps( kk, l ) );
+        _mm_storeu_ps( values + i, _mm_div_ps( n, d ) );
+    }
+#endif
+
+    for ( ; i < count; i++ )
+    {
+        float l = values[i];
+        values[i] = k * ( 1.0f + kw * l ) / ( 1.0f + k * l );
+    }
+}
+
+/**
+ * Scales linear RGB values and converts them to sRGB encoding table indices.
+ * @param r red values
+ * @param g green values
+ * @param b blue values
+ * @param s per-pixel scale factors
+ * @param count number of pixels
+ * @param ir output red table indices
+ * @param ig output green table indices
+ * @param ib output blue table indices
+ */
+static void ScaleToIndices( const float * r, const float * g, const float * b, const float * s, int count,
+                            int * ir, int * ig, int * ib )
+{
+    const float maxIndex = TONE_MAP_GAMMA_LUT_SIZE - 1;
+    int i = 0;
+
+#if defined(__ARM_NEON__)
+    float32x4_t vmax = vdupq_n_f32( maxIndex );
+    float32x4_t zero = vdupq_n_f32( 0.0f );
+    for ( ; i + 4 <= count; i += 4 )
+    {
+        float32x4_t vs = vmulq_f32( vld1q_f32( s + i ), vmax );
+        vst1q_s32( ir + i, vcvtq_s32_f32( vminq_f32( vmaxq_f32( vmulq_f32( vld1q_f32( r + i ), vs ), zero ), vmax ) ) );
+        vst1q_s32( ig + i, vcvtq_s32_f32( vminq_f32( vmaxq_f32( vmulq_f32( vld1q_f32( g + i ), vs ), zero ), vmax ) ) );
+        vst1q_s32( ib + i, vcvtq_s32_f32( vminq_f32( vmaxq_f32( vmulq_f32( vld1q_f32( b + i ), vs ), zero ), vmax ) ) );
+    }
+#elif defined(__SSE2__)
+    __m128 vmax = _mm_set1_ps( maxIndex );
+    __m128 zero = _mm_setzero_ps();
+    for ( ; i + 4 <= count; i += 4 )
+    {
+        __m128 vs = _mm_mul_ps( _mm_loadu_ps( s + i ), vmax );
+        _mm_storeu_si128( (__m128i *) ( ir + i ), _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_loadu_ps( r + i ), vs ), zero ), vmax ) ) );
+        _mm_storeu_si128( (__m128i *) ( ig + i ), _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_loadu_ps( g + i ), vs ), zero ), vmax ) ) );
+        _mm_storeu_si128( (__m128i *) ( ib + i ), _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_loadu_ps( b + i ), vs ), zero ), vmax ) ) );
+    }
+#endif
+
+    for ( ; i < count; i++ )
+    {
+        float si = s[i] * maxIndex;
+        ir[i] = (int) std::min( std::max( r[i] * si, 0.0f ), maxIndex );
+        ig[i] = (int) std::min( std::max( g[i] * si, 0.0f ), maxIndex );
+        ib[i] = (int) std::min( std::max( b[i] * si, 0.0f ), maxIndex );
+    }
+}
+
+ToneMapper::ToneMapper( void ) : m_rgbe( 0 ), m_yuv( 0 ), m_width( 0 ), m_height( 0 ), m_bandCount( 1 )
+{
+    m_rgbeScale[0] = 0.0f;
+    for ( int i = 1; i < 256; i++ )
+    {
+        m_rgbeScale[i] = ldexpf( 1.0f, i - 136 );
+    }
+
+    for ( int i = 0; i < TONE_MAP_GAMMA_LUT_SIZE; i++ )
+    {
+        float c = (float) i / ( TONE_MAP_GAMMA_LUT_SIZE - 1 );
+        c = c <= 0.0031308f ? 12.92f * c : 1.055f * powf( c, 1.0f / 2.4f ) - 0.055f;
+        m_gammaLut[i] = (uchar) ( c * 255.0f + 0.5f );
+    }
+}
+
+void ToneMapper::map( EOperator op, const uchar * rgbe, int width, int height, uchar * yuv, ThreadPool * pool )
+{
+    Timer timer;
+
+    m_rgbe = rgbe;
+    m_yuv = yuv;
+    m_width = width;
+    m_height = height;
+    m_bandCount = std::min( pool != 0 ? pool->concurrency() : 1, std::max( height >> 1, 1 ) );
+
+    m_scale.resize( width * height );
+    if ( op == EOperatorLocal )
+    {
+        m_logLuminance.resize( width * height );
+    }
+    m_stats.resize( m_bandCount );
+
+    // luminance statistics
+    if ( pool != 0 )
+    {
+        pool->run( ToneMapper::LuminanceProc, this, m_bandCount );
+    }
+    else
+    {
+        LuminanceProc( this, 0 );
+    }
+
+    uint histogram[TONE_MAP_HISTOGRAM_BINS];
+    memcpy( histogram, m_stats[0].histogram, sizeof( histogram ) );
+    double logSum = m_stats[0].logSum;
+    float logMin = m_stats[0].logMin, logMax = m_stats[0].logMax;
+    for ( int i = 1; i < m_bandCount; i++ )
+    {
+        for ( int j = 0; j < TONE_MAP_HISTOGRAM_BINS; j++ )
+        {
+            histogram[j] += m_stats[i].histogram[j];
+        }
+        logSum += m_stats[i].logSum;
+        logMin = std::min( logMin, m_stats[i].logMin );
+        logMax = std::max( logMax, m_stats[i].logMax );
+    }
+
+    uint total = width * height;
+    float lowLog = GetPercentile( histogram, total, TONE_MAP_LOW_PERCENTILE );
+    float highLog = GetPercentile( histogram, total, TONE_MAP_HIGH_PERCENTILE );
+
+    THREAD_POOL_TASK scaleProc;
+    if ( op == EOperatorGlobal )
+    {
+        // automatic key estimation (Reinhard 2002): brighter key for scenes whose
+        // log-average is close to the maximum
+        float logAverage = (float) ( logSum / total );
+        float range = highLog - lowLog;
+        float f = range > 1e-3f ? ( 2.0f * logAverage - lowLog - highLog ) / range : 0.0f;
+        float key = 0.18f * powf( 4.0f, f );
+
+        m_keyScale = key / expf( logAverage );
+        float white = m_keyScale * expf( highLog );
+        m_invWhite2 = 1.0f / ( white * white );
+
+        scaleProc = ToneMapper::GlobalProc;
+    }
+    else
+    {
+        m_logMin = logMin;
+        m_baseMax = highLog;
+        m_compression = std::min( 1.0f, logf( TONE_MAP_BASE_CONTRAST ) / std::max( highLog - lowLog, 1e-3f ) );
+
+        m_spatialStep = std::max( TONE_MAP_MIN_SPATIAL_SIGMA, (int) ( TONE_MAP_SPATIAL_SIGMA * std::max( width, height ) + 0.5f ) );
+        m_gridWidth = ( width - 1 ) / m_spatialStep + 2 + 2 * TONE_MAP_GRID_PAD;
+        m_gridHeight = ( height - 1 ) / m_spatialStep + 2 + 2 * TONE_MAP_GRID_PAD;
+        m_gridDepth = (int) ( ( logMax - logMin ) / TONE_MAP_RANGE_SIGMA ) + 2 + 2 * TONE_MAP_GRID_PAD;
+
+        int gridSize = 2 * m_gridWidth * m_gridHeight * m_gridDepth;
+        m_grids.assign( gridSize * m_bandCount, 0.0f );
+
+        if ( pool != 0 )
+        {
+            pool->run( ToneMapper::SplatProc, this, m_bandCount );
+        }
+        else
+        {
+            SplatProc( this, 0 );
+        }
+
+        // merge per-band grids
+        for ( int i = 1; i < m_bandCount; i++ )
+        {
+            const float * src = &m_grids[i * gridSize];
+            for ( int j = 0; j < gridSize; j++ )
+            {
+                m_grids[j] += src[j];
+            }
+        }
+
+        blurGrid();
+
+        scaleProc = ToneMapper::SliceProc;
+    }
+
+    // per-pixel scale factors and output
+    if ( pool != 0 )
+    {
+        pool->run( scaleProc, this, m_bandCount );
+        pool->run( ToneMapper::EncodeProc, this, m_bandCount );
+    }
+    else
+    {
+        scaleProc( this, 0 );
+        EncodeProc( this, 0 );
+    }
+
+    std::vector<float>().swap( m_scale );
+    std::vector<float>().swap( m_logLuminance );
+    std::vector<float>().swap( m_grids );
+
+    double elapsed = timer.get();
+    LOG( "ToneMapper: %s operator %dx%d in %.1f ms (%.1f ms/MPix)\n", op == EOperatorGlobal ? "global" : "local",
+         width, height, elapsed, elapsed * 1e6 / ( (double) width * height ) );
+}
+
+void ToneMapper::LuminanceProc( void * opaque, int index )
+{
+    ToneMapper * instance = (ToneMapper *) opaque;
+    BandStats & stats = instance->m_stats[index];
+    const float * rgbeScale = instance->m_rgbeScale;
+    const float minLuminance = expf( -TONE_MAP_LOG_RANGE );
+    const float binScale = TONE_MAP_HISTOGRAM_BINS / ( 2.0f * TONE_MAP_LOG_RANGE );
+
+    memset( stats.histogram, 0, sizeof( stats.histogram ) );
+    stats.logSum = 0.0;
+    stats.logMin = TONE_MAP_LOG_RANGE;
+    stats.logMax = -TONE_MAP_LOG_RANGE;
+
+    int begin = instance->getBandRow( index ) * instance->m_width;
+    int end = instance->getBandRow( index + 1 ) * instance->m_width;
+    float * luminance = &instance->m_scale[0];
+    float * logLuminance = instance->m_logLuminance.empty() ? 0 : &instance->m_logLuminance[0];
+
+    for ( int i = begin; i < end; i++ )
+    {
+        const uchar * p = instance->m_rgbe + i * 4;
+        float s = rgbeScale[p[3]];
+        float l = ( 0.2126f * p[0] + 0.7152f * p[1] + 0.0722f * p[2] + 0.5f ) * s;
+        l = std::max( l, minLuminance );
+        float logL = std::min( logf( l ), TONE_MAP_LOG_RANGE );
+
+        luminance[i] = l;
+        if ( logLuminance != 0 )
+        {
+            logLuminance[i] = logL;
+        }
+
+        int bin = std::min( (int) ( ( logL + TONE_MAP_LOG_RANGE ) * binScale ), TONE_MAP_HISTOGRAM_BINS - 1 );
+        stats.histogram[bin]++;
+        stats.logSum += logL;
+        stats.logMin = std::min( stats.logMin, logL );
+        stats.logMax = std::max( stats.logMax, logL );
+    }
+}
+
+void ToneMapper::GlobalProc( void * opaque, int index )
+{
+    ToneMapper * instance = (ToneMapper *) opaque;
+    int begin = instance->getBandRow( index ) * instance->m_width;
+    int end = instance->getBandRow( index + 1 ) * instance->m_width;
+
+    ApplyGlobalCurve( &instance->m_scale[begin], end - begin, instance->m_keyScale, instance->m_invWhite2 );
+}
+
+void ToneMapper::SplatProc( void * opaque, int index )
+{
+    ToneMapper * instance = (ToneMapper *) opaque;
+    const int gw = instance->m_gridWidth;
+    const int gh = instance->m_gridHeight;
+    const float invSpatial = 1.0f / instance->m_spatialStep;
+    const float invRange = 1.0f / TONE_MAP_RANGE_SIGMA;
+    const float logMin = instance->m_logMin;
+    float * grid = &instance->m_grids[index * 2 * gw * gh * instance->m_gridDepth];
+
+    for ( int y = instance->getBandRow( index ); y < instance->getBandRow( index + 1 ); y++ )
+    {
+        const float * logL = &instance->m_logLuminance[y * instance->m_width];
+        int gy = (int) ( y * invSpatial + 0.5f ) + TONE_MAP_GRID_PAD;
+
+        for ( int x = 0; x < instance->m_width; x++ )
+        {
+            int gx = (int) ( x * invSpatial + 0.5f ) + TONE_MAP_GRID_PAD;
+            int gz = (int) ( ( logL[x] - logMin ) * invRange + 0.5f ) + TONE_MAP_GRID_PAD;
+            float * cell = grid + 2 * ( ( gz * gh + gy ) * gw + gx );
+            cell[0] += logL[x];
+            cell[1] += 1.0f;
+        }
+    }
+}
+
+void ToneMapper::blurGrid( void )
+{
+    // separable [1 4 6 4 1] / 16 kernel along x, y and z, the grid border keeps
+    // the data away from the edges
+    static const float kernel[5] = { 1.0f / 16, 4.0f / 16, 6.0f / 16, 4.0f / 16, 1.0f / 16 };
+    const int size[3] = { m_gridWidth, m_gridHeight, m_gridDepth };
+    const int stride[3] = { 2, 2 * m_gridWidth, 2 * m_gridWidth * m_gridHeight };
+    const int total = 2 * m_gridWidth * m_gridHeight * m_gridDepth;
+
+    std::vector<float> temp( total );
+    float * src = &m_grids[0];
+    float * dst = &temp[0];
+
+    for ( int axis = 0; axis < 3; axis++ )
+    {
+        for ( int i = 0; i < total; i += 2 )
+        {
+            int pos = ( i / stride[axis] ) % size[axis];
+            float v = 0.0f, w = 0.0f;
+            for ( int k = -2; k <= 2; k++ )
+            {
+                if ( pos + k >= 0 && pos + k < size[axis] )
+                {
+                    const float * cell = src + i + k * stride[axis];
+                    v += kernel[k + 2] * cell[0];
+                    w += kernel[k + 2] * cell[1];
+                }
+            }
+            dst[i] = v;
+            dst[i + 1] = w;
+        }
+        std::swap( src, dst );
+    }
+
+    // odd number of passes, the result is in the temporary buffer
+    m_grids.swap( temp );
+}
+
+void ToneMapper::SliceProc( void * opaque, int index )
+{
+    ToneMapper * instance = (ToneMapper *) opaque;
+    const int gw = instance->m_gridWidth;
+    const int gh = instance->m_gridHeight;
+    const int planeStride = 2 * gw * gh;
+    const float invSpatial = 1.0f / instance->m_spatialStep;
+    const float invRange = 1.0f / TONE_MAP_RANGE_SIGMA;
+    const float logMin = instance->m_logMin;
+    const float c = instance->m_compression;
+    const float offset = -c * instance->m_baseMax;
+    const float * grid = &instance->m_grids[0];
+
+    for ( int y = instance->getBandRow( index ); y < instance->getBandRow( index + 1 ); y++ )
+    {
+        const float * logL = &instance->m_logLuminance[y * instance->m_width];
+        float * scale = &instance->m_scale[y * instance->m_width];
+
+        float fy = y * invSpatial + TONE_MAP_GRID_PAD;
+        int gy = (int) fy;
+        float ty = fy - gy;
+
+        for ( int x = 0; x < instance->m_width; x++ )
+        {
+            float fx = x * invSpatial + TONE_MAP_GRID_PAD;
+            float fz = ( logL[x] - logMin ) * invRange + TONE_MAP_GRID_PAD;
+            int gx = (int) fx;
+            int gz = (int) fz;
+            float tx = fx - gx;
+            float tz = fz - gz;
+
+            // trilinear interpolation of ( value, weight )
+            const float * c000 = grid + 2 * ( ( gz * gh + gy ) * gw + gx );
+            const float * c010 = c000 + 2 * gw;
+            float v0, w0, v1, w1;
+
+            v0 = ( c000[0] + ( c000[2] - c000[0] ) * tx ) * ( 1.0f - ty ) + ( c010[0] + ( c010[2] - c010[0] ) * tx ) * ty;
+            w0 = ( c000[1] + ( c000[3] - c000[1] ) * tx ) * ( 1.0f - ty ) + ( c010[1] + ( c010[3] - c010[1] ) * tx ) * ty;
+            c000 += planeStride;
+            c010 += planeStride;
+            v1 = ( c000[0] + ( c000[2] - c000[0] ) * tx ) * ( 1.0f - ty ) + ( c010[0] + ( c010[2] - c010[0] ) * tx ) * ty;
+            w1 = ( c000[1] + ( c000[3] - c000[1] ) * tx ) * ( 1.0f - ty ) + ( c010[1] + ( c010[3] - c010[1] ) * tx ) * ty;
+
+            float v = v0 + ( v1 - v0 ) * tz;
+            float w = w0 + ( w1 - w0 ) * tz;
+            float base = w > 1e-6f ? v / w : logL[x];
+
+            // log Ld = c * ( base - baseMax ) + ( logL - base ), scale = Ld / L
+            scale[x] = expf( ( c - 1.0f ) * base + offset );
+        }
+    }
+}
+
+void ToneMapper::EncodeProc( void * opaque, int index )
+{
+    ToneMapper * instance = (ToneMapper *) opaque;
+    const int width = instance->m_width;
+    const float * rgbeScale = instance->m_rgbeScale;
+    const uchar * lut = instance->m_gammaLut;
+
+    std::vector<float> buffer( 3 * width );
+    std::vector<int> indices( 6 * width );
+    uchar * cbPlane = instance->m_yuv + width * instance->m_height;
+    uchar * crPlane = cbPlane + ( width >> 1 ) * ( instance->m_height >> 1 );
+
+    for ( int y = instance->getBandRow( index ); y < instance->getBandRow( index + 1 ); y += 2 )
+    {
+        // decode and scale two rows, indices holds R, G, B of row 0 and then row 1
+        for ( int row = 0; row < 2; row++ )
+        {
+            float * r = &buffer[0];
+            float * g = r + width;
+            float * b = g + width;
+            int * ir = &indices[3 * row * width];
+            int * ig = ir + width;
+            int * ib = ig + width;
+            const uchar * p = instance->m_rgbe + ( y + row ) * width * 4;
+            for ( int x = 0; x < width; x++, p += 4 )
+            {
+                float s = rgbeScale[p[3]];
+                r[x] = ( p[0] + 0.5f ) * s;
+                g[x] = ( p[1] + 0.5f ) * s;
+                b[x] = ( p[2] + 0.5f ) * s;
+            }
+
+            ScaleToIndices( r, g, b, &instance->m_scale[( y + row ) * width], width, ir, ig, ib );
+
+            // luma
+            uchar * luma = instance->m_yuv + ( y + row ) * width;
+            for ( int x = 0; x < width; x++ )
+            {
+                luma[x] = ( 77 * lut[ir[x]] + 150 * lut[ig[x]] + 29 * lut[ib[x]] ) >> 8;
+            }
+        }
+
+        // chroma of 2x2 blocks
+        const int * ir0 = &indices[0];
+        const int * ig0 = ir0 + width;
+        const int * ib0 = ig0 + width;
+        const int * ir1 = ib0 + width;
+        const int * ig1 = ir1 + width;
+        const int * ib1 = ig1 + width;
+        uchar * cb = cbPlane + ( y >> 1 ) * ( width >> 1 );
+        uchar * cr = crPlane + ( y >> 1 ) * ( width >> 1 );
+
+        for ( int x = 0; x < width - 1; x += 2 )
+        {
+            int r = lut[ir0[x]] + lut[ir0[x + 1]] + lut[ir1[x]] + lut[ir1[x + 1]];
+            int g = lut[ig0[x]] + lut[ig0[x + 1]] + lut[ig1[x]] + lut[ig1[x + 1]];
+            int b = lut[ib0[x]] + lut[ib0[x + 1]] + lut[ib1[x]] + lut[ib1[x + 1]];
+            cb[x >> 1] = ( 131072 - 43 * r - 85 * g + 128 * b ) >> 10;
+            cr[x >> 1] = ( 131072 + 128 * r - 107 * g - 21 * b ) >> 10;
+        }
+    }
+}
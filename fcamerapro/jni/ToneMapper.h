@@ -0,0 +1,162 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _TONE_MAPPER_H
+#define _TONE_MAPPER_H
+
+/**
+ * @file
+ * Definition of ToneMapper.
+ */
+
+#include <vector>
+#include "Common.h"
+
+class ThreadPool;
+
+#define TONE_MAP_HISTOGRAM_BINS 1024   /**< Log luminance histogram bin count */
+#define TONE_MAP_LOG_RANGE      16.0f  /**< Histogram covers log luminance in [-TONE_MAP_LOG_RANGE, TONE_MAP_LOG_RANGE] */
+#define TONE_MAP_LOW_PERCENTILE 0.01f  /**< Percentile taken as the minimum scene luminance */
+#define TONE_MAP_HIGH_PERCENTILE 0.99f /**< Percentile taken as the maximum scene luminance */
+#define TONE_MAP_GAMMA_LUT_SIZE 4096   /**< sRGB encoding table size */
+#define TONE_MAP_SPATIAL_SIGMA  0.02f  /**< Bilateral grid spatial sampling (fraction of the image size) */
+#define TONE_MAP_MIN_SPATIAL_SIGMA 4   /**< Minimum bilateral grid spatial sampling in pixels */
+#define TONE_MAP_RANGE_SIGMA    0.92f  /**< Bilateral grid range sampling (0.4 in log10 units) */
+#define TONE_MAP_BASE_CONTRAST  5.0f   /**< Target contrast of the base layer (local operator, Durand & Dorsey) */
+#define TONE_MAP_GRID_PAD       2      /**< Bilateral grid border (blur kernel radius) */
+
+/**
+ * Tone maps radiance maps (RGBE pixels, see RadianceMerge) to YUV420p frames
+ * ready for the JPEG writer. Two operators are available:
+ * - global: photographic operator (Reinhard et al. 2002) with the key value
+ *   estimated automatically from the log luminance distribution,
+ * - local: fast bilateral filtering (Durand & Dorsey 2002) on a downsampled
+ *   bilateral grid (Chen et al. 2007). The log luminance is splatted into the
+ *   grid, blurred, and sliced back to get the base layer, whose contrast is
+ *   compressed to TONE_MAP_BASE_CONTRAST while the detail layer is kept.
+ *
+ * Luminance statistics, grid splatting, slicing and output encoding run in
+ * row bands on a thread pool.
+ */
+class ToneMapper
+{
+public:
+    /**
+     * Tone mapping operators.
+     */
+    enum EOperator
+    {
+        EOperatorGlobal, EOperatorLocal
+    };
+
+    /**
+     * Default constructor.
+     */
+    ToneMapper( void );
+
+    /**
+     * Tone maps a radiance map.
+     * @param op tone mapping operator
+     * @param rgbe radiance map pixels (4 bytes per pixel)
+     * @param width image width in pixels (even)
+     * @param height image height in pixels (even)
+     * @param yuv receives the YUV420p image (width * height * 3 / 2 bytes)
+     * @param pool thread pool (can be 0)
+     */
+    void map( EOperator op, const uchar * rgbe, int width, int height, uchar * yuv, ThreadPool * pool );
+
+private:
+    /**
+     * Computes luminance, log luminance statistics (and log luminance for the
+     * local operator) of a row band.
+     */
+    static void LuminanceProc( void * opaque, int index );
+    /**
+     * Computes per-pixel scale factors of a row band, global operator.
+     */
+    static void GlobalProc( void * opaque, int index );
+    /**
+     * Splats log luminance of a row band into the band's bilateral grid.
+     */
+    static void SplatProc( void * opaque, int index );
+    /**
+     * Slices the blurred grid and computes per-pixel scale factors of a row band,
+     * local operator.
+     */
+    static void SliceProc( void * opaque, int index );
+    /**
+     * Applies the scale factors and encodes a row band to YUV420p.
+     */
+    static void EncodeProc( void * opaque, int index );
+
+    /**
+     * Blurs the bilateral grid along all three axes.
+     */
+    void blurGrid( void );
+
+    /**
+     * Gets first row of a band (always even).
+     */
+    int getBandRow( int index ) const
+    {
+        return ( ( m_height >> 1 ) * index / m_bandCount ) << 1;
+    }
+
+    /**
+     * Per-band luminance statistics.
+     */
+    struct BandStats
+    {
+        uint histogram[TONE_MAP_HISTOGRAM_BINS]; /**< Log luminance histogram */
+        double logSum; /**< Sum of log luminance */
+        float logMin; /**< Minimum log luminance */
+        float logMax; /**< Maximum log luminance */
+    };
+
+    float m_rgbeScale[256]; /**< RGBE exponent to scale factor table */
+    uchar m_gammaLut[TONE_MAP_GAMMA_LUT_SIZE]; /**< Linear to sRGB encoding table */
+
+    // state of the tone mapping in progress
+    const uchar * m_rgbe; /**< Source radiance map */
+    uchar * m_yuv; /**< Destination image */
+    int m_width, m_height; /**< Image size */
+    int m_bandCount; /**< Number of row bands */
+    std::vector<float> m_scale; /**< Luminance, then per-pixel scale factor */
+    std::vector<float> m_logLuminance; /**< Log luminance (local operator only) */
+    std::vector<BandStats> m_stats; /**< Per-band statistics */
+
+    float m_keyScale; /**< Global operator: key / log-average luminance */
+    float m_invWhite2; /**< Global operator: 1 / white point^2 */
+
+    float m_logMin; /**< Local operator: minimum log luminance */
+    float m_baseMax; /**< Local operator: log luminance mapped to white */
+    float m_compression; /**< Local operator: base layer compression factor */
+    int m_spatialStep; /**< Grid spatial sampling in pixels */
+    int m_gridWidth, m_gridHeight, m_gridDepth; /**< Grid size */
+    std::vector<float> m_grids; /**< Per-band grids, (value, weight) pairs */
+};
+
+#endif
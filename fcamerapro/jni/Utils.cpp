@@ -34,79 +34,226 @@
 #include "Common.h"
 #include "Utils.h"
 
-int GetColorTemparatureYCbCr( int temp, int y, int cb, int cr )
+#define CCT_BATCH_CHUNK 64     /**< Number of pixels processed per batch stage */
+#define CCT_TABLE_SIZE  1024   /**< Number of color temperature fit table intervals */
+#define CCT_TABLE_MIN   -1.5f  /**< Chromaticity ratio of the first fit table entry (about 138000K) */
+#define CCT_TABLE_MAX   1.5f   /**< Chromaticity ratio of the last fit table entry (about 280K) */
+
+/**
+ * sRGB to linear conversion table, entry i holds the linear value of i / 255: i / 255 / 12.92
+ * up to 0.04045, ((i / 255 + 0.055) / 1.055)^2.4 above. Generated offline in single precision.
+ */
+static const float sLinearizeTable[256] =
 {
-    // YCbCr to normalized sRGB
-    cb -= 128;
-    cr -= 128;
+    0.0f, 0.000303526991f, 0.000607053982f, 0.000910580973f, 0.00121410796f, 0.00151763496f, 0.00182116195f, 0.00212468882f,
+    0.00242821593f, 0.00273174304f, 0.00303526991f, 0.00334653561f, 0.00367650692f, 0.00402471703f, 0.00439144205f, 0.00477695325f,
+    0.00518151699f, 0.00560539169f, 0.00604883255f, 0.00651209103f, 0.00699541019f, 0.00749903172f, 0.00802319217f, 0.00856812485f,
+    0.00913405698f, 0.00972121768f, 0.010329823f, 0.0109600937f, 0.0116122449f, 0.012286487f, 0.0129830306f, 0.0137020806f,
+    0.0144438436f, 0.0152085144f, 0.0159962922f, 0.0168073755f, 0.0176419523f, 0.0185002182f, 0.0193823613f, 0.0202885624f,
+    0.0212190095f, 0.0221738834f, 0.0231533647f, 0.0241576303f, 0.0251868572f, 0.0262412224f, 0.0273208916f, 0.0284260381f,
+    0.0295568332f, 0.0307134409f, 0.0318960287f, 0.0331047624f, 0.0343398079f, 0.0356013142f, 0.036889445f, 0.0382043645f,
+    0.0395462364f, 0.0409151986f, 0.0423114114f, 0.0437350273f, 0.045186203f, 0.0466650836f, 0.048171822f, 0.0497065634f,
+    0.0512694679f, 0.0528606549f, 0.0544802807f, 0.0561284944f, 0.0578054339f, 0.0595112406f, 0.061246071f, 0.0630100295f,
+    0.0648032799f, 0.0666259527f, 0.068478182f, 0.0703601092f, 0.0722718611f, 0.0742135793f, 0.0761853904f, 0.0781874284f,
+    0.0802198276f, 0.0822827145f, 0.0843762159f, 0.0865004659f, 0.0886556059f, 0.0908417329f, 0.093058981f, 0.0953074843f,
+    0.0975873619f, 0.0998987406f, 0.102241747f, 0.104616493f, 0.107023112f, 0.109461717f, 0.111932434f, 0.114435382f,
+    0.116970673f, 0.119538434f, 0.122138798f, 0.124771841f, 0.127437696f, 0.13013649f, 0.132868335f, 0.135633349f,
+    0.138431624f, 0.141263306f, 0.144128487f, 0.147027284f, 0.149959803f, 0.152926162f, 0.155926466f, 0.158960864f,
+    0.1620294f, 0.165132225f, 0.168269396f, 0.171441093f, 0.174647391f, 0.177888408f, 0.181164235f, 0.18447499f,
+    0.187820762f, 0.191201672f, 0.194617808f, 0.198069304f, 0.201556236f, 0.205078706f, 0.20863685f, 0.212230727f,
+    0.215860531f, 0.219526231f, 0.223227978f, 0.226965889f, 0.23074007f, 0.234550655f, 0.238397658f, 0.242281199f,
+    0.246201396f, 0.25015837f, 0.254152179f, 0.258182913f, 0.262250721f, 0.266355664f, 0.270497859f, 0.274677366f,
+    0.278894335f, 0.283148795f, 0.287440896f, 0.291770697f, 0.296138316f, 0.300543845f, 0.304987371f, 0.309468955f,
+    0.313988745f, 0.318546832f, 0.323143244f, 0.327778131f, 0.332451582f, 0.337163657f, 0.341914445f, 0.346704096f,
+    0.351532698f, 0.356400251f, 0.361306876f, 0.366252691f, 0.371237785f, 0.376262218f, 0.381326109f, 0.386429518f,
+    0.391572565f, 0.396755308f, 0.401977867f, 0.407240301f, 0.412542701f, 0.417885154f, 0.423267752f, 0.428690553f,
+    0.434153706f, 0.439657241f, 0.445201248f, 0.450785846f, 0.456411064f, 0.462077051f, 0.467783839f, 0.473531544f,
+    0.479320228f, 0.48514998f, 0.491020888f, 0.496933043f, 0.502886593f, 0.50888145f, 0.514917791f, 0.520995677f,
+    0.527115226f, 0.533276498f, 0.539479613f, 0.545724571f, 0.55201149f, 0.55834049f, 0.56471163f, 0.571124911f,
+    0.577580512f, 0.584078491f, 0.590618908f, 0.597201884f, 0.603827417f, 0.610495627f, 0.617206633f, 0.623960435f,
+    0.630757213f, 0.637596965f, 0.644479752f, 0.651405692f, 0.658374846f, 0.665387332f, 0.672443211f, 0.679542542f,
+    0.686685443f, 0.693871915f, 0.701102018f, 0.708375931f, 0.715693653f, 0.723055243f, 0.730460882f, 0.737910569f,
+    0.745404363f, 0.752942324f, 0.760524631f, 0.768151283f, 0.775822341f, 0.783537924f, 0.791298032f, 0.799102843f,
+    0.806952357f, 0.814846694f, 0.822785854f, 0.830769956f, 0.838799119f, 0.846873283f, 0.854992688f, 0.863157272f,
+    0.871367216f, 0.87962234f, 0.887923181f, 0.896269381f, 0.904661357f, 0.913098693f, 0.921582043f, 0.930110872f,
+    0.938685894f, 0.947306573f, 0.955973506f, 0.964686275f, 0.973445475f, 0.982250571f, 0.991102219f, 1.0f
+};
 
-    const float iscale = 1.0f / 255.0f;
+/**
+ * Color temperature fit table, entry i holds GetFitTemparature() at
+ * n = CCT_TABLE_MIN + i * (CCT_TABLE_MAX - CCT_TABLE_MIN) / CCT_TABLE_SIZE. Generated offline in single precision.
+ */
+static const float sFitTable[CCT_TABLE_SIZE + 1] =
+{
+    137645.953f, 134562.562f, 131580.5f, 128696.078f, 125905.422f, 123205.188f, 120591.969f, 118062.562f,
+    115613.828f, 113242.82f, 110946.641f, 108722.562f, 106567.977f, 104480.188f, 102456.859f, 100495.633f,
+    98594.2344f, 96750.4844f, 94962.2812f, 93227.6719f, 91544.6719f, 89911.4766f, 88326.2812f, 86787.3438f,
+    85293.0312f, 83841.7656f, 82432.0156f, 81062.2969f, 79731.25f, 78437.4844f, 77179.7031f, 75956.6484f,
+    74767.1328f, 73609.9609f, 72484.0312f, 71388.2812f, 70321.6484f, 69283.1797f, 68271.8906f, 67286.875f,
+    66327.2422f, 65392.1367f, 64480.7344f, 63592.25f, 62725.918f, 61881.0156f, 61056.8242f, 60252.6836f,
+    59467.9297f, 58701.9414f, 57954.0898f, 57223.8398f, 56510.582f, 55813.7891f, 55132.9414f, 54467.5312f,
+    53817.0898f, 53181.1406f, 52559.2383f, 51950.9414f, 51355.832f, 50773.5195f, 50203.6094f, 49645.7227f,
+    49099.5f, 48564.5859f, 48040.6719f, 47527.4102f, 47024.4961f, 46531.6172f, 46048.5078f, 45574.8633f,
+    45110.4297f, 44654.9258f, 44208.1133f, 43769.75f, 43339.5977f, 42917.4297f, 42503.0195f, 42096.1641f,
+    41696.6523f, 41304.293f, 40918.8906f, 40540.2578f, 40168.2266f, 39802.6094f, 39443.2461f, 39089.9805f,
+    38742.6445f, 38401.1016f, 38065.1914f, 37734.7852f, 37409.7344f, 37089.9102f, 36775.1914f, 36465.4492f,
+    36160.5586f, 35860.4023f, 35564.8828f, 35273.875f, 34987.2812f, 34704.9883f, 34426.9062f, 34152.9375f,
+    33882.9844f, 33616.9648f, 33354.7852f, 33096.3516f, 32841.5977f, 32590.4297f, 32342.7754f, 32098.5547f,
+    31857.7012f, 31620.1406f, 31385.8008f, 31154.6172f, 30926.5176f, 30701.4473f, 30479.3438f, 30260.1406f,
+    30043.7832f, 29830.207f, 29619.3691f, 29411.2129f, 29205.6816f, 29002.7188f, 28802.2852f, 28604.3301f,
+    28408.8066f, 28215.6641f, 28024.8613f, 27836.3535f, 27650.0996f, 27466.0586f, 27284.1895f, 27104.4473f,
+    26926.8027f, 26751.2129f, 26577.6445f, 26406.0625f, 26236.4219f, 26068.7031f, 25902.8672f, 25738.8809f,
+    25576.707f, 25416.3281f, 25257.7031f, 25100.8086f, 24945.6113f, 24792.082f, 24640.2031f, 24489.9375f,
+    24341.2617f, 24194.1543f, 24048.582f, 23904.5273f, 23761.9629f, 23620.8672f, 23481.2109f, 23342.9805f,
+    23206.1504f, 23070.6992f, 22936.6055f, 22803.8398f, 22672.3984f, 22542.252f, 22413.3809f, 22285.7656f,
+    22159.3906f, 22034.2363f, 21910.2832f, 21787.5156f, 21665.9141f, 21545.4629f, 21426.1484f, 21307.9492f,
+    21190.8535f, 21074.8398f, 20959.9004f, 20846.0137f, 20733.168f, 20621.3496f, 20510.5391f, 20400.7266f,
+    20291.9004f, 20184.043f, 20077.1406f, 19971.1836f, 19866.1582f, 19762.0488f, 19658.8496f, 19556.5391f,
+    19455.1133f, 19354.5547f, 19254.8574f, 19156.0078f, 19057.9922f, 18960.8027f, 18864.4277f, 18768.8555f,
+    18674.0781f, 18580.0781f, 18486.8555f, 18394.3965f, 18302.6895f, 18211.7246f, 18121.498f, 18031.9922f,
+    17943.207f, 17855.1211f, 17767.7383f, 17681.043f, 17595.0273f, 17509.6855f, 17425.0078f, 17340.9844f,
+    17257.6094f, 17174.8789f, 17092.7754f, 17011.2949f, 16930.4336f, 16850.1816f, 16770.5312f, 16691.4766f,
+    16613.0078f, 16535.123f, 16457.8105f, 16381.0645f, 16304.8779f, 16229.248f, 16154.1631f, 16079.6211f,
+    16005.6123f, 15932.1328f, 15859.1748f, 15786.7344f, 15714.8047f, 15643.3789f, 15572.4521f, 15502.0195f,
+    15432.0742f, 15362.6123f, 15293.624f, 15225.1084f, 15157.0586f, 15089.4717f, 15022.3389f, 14955.6572f,
+    14889.4219f, 14823.627f, 14758.2686f, 14693.3408f, 14628.8408f, 14564.7627f, 14501.1006f, 14437.8525f,
+    14375.0127f, 14312.5771f, 14250.54f, 14188.9004f, 14127.6514f, 14066.79f, 14006.3105f, 13946.2119f,
+    13886.4883f, 13827.1348f, 13768.1494f, 13709.5273f, 13651.2646f, 13593.3604f, 13535.8057f, 13478.6016f,
+    13421.7432f, 13365.2236f, 13309.0449f, 13253.2021f, 13197.6904f, 13142.5049f, 13087.6465f, 13033.1084f,
+    12978.8877f, 12924.9854f, 12871.3945f, 12818.1113f, 12765.1357f, 12712.4629f, 12660.0928f, 12608.0176f,
+    12556.2373f, 12504.749f, 12453.5488f, 12402.6348f, 12352.0068f, 12301.6562f, 12251.5859f, 12201.79f,
+    12152.2686f, 12103.0156f, 12054.0332f, 12005.3135f, 11956.8574f, 11908.6621f, 11860.7236f, 11813.043f,
+    11765.6152f, 11718.4385f, 11671.5098f, 11624.8301f, 11578.3926f, 11532.1982f, 11486.2441f, 11440.5264f,
+    11395.0479f, 11349.8008f, 11304.7852f, 11259.999f, 11215.4434f, 11171.1113f, 11127.0029f, 11083.1182f,
+    11039.4512f, 10996.0039f, 10952.7734f, 10909.7559f, 10866.9512f, 10824.3584f, 10781.9746f, 10739.7969f,
+    10697.8271f, 10656.0586f, 10614.4941f, 10573.1299f, 10531.9639f, 10490.9961f, 10450.2246f, 10409.6455f,
+    10369.2607f, 10329.0674f, 10289.0615f, 10249.2451f, 10209.6152f, 10170.1699f, 10130.9092f, 10091.8301f,
+    10052.9326f, 10014.2129f, 9975.67383f, 9937.30859f, 9899.12012f, 9861.10547f, 9823.2627f, 9785.59375f,
+    9748.09082f, 9710.75977f, 9673.5957f, 9636.59766f, 9599.76465f, 9563.0957f, 9526.58887f, 9490.24512f,
+    9454.05957f, 9418.0332f, 9382.16602f, 9346.45508f, 9310.90039f, 9275.5f, 9240.25293f, 9205.1582f,
+    9170.21387f, 9135.42285f, 9100.77832f, 9066.28223f, 9031.93457f, 8997.73242f, 8963.6748f, 8929.76172f,
+    8895.99316f, 8862.36621f, 8828.87793f, 8795.5332f, 8762.3252f, 8729.25879f, 8696.3291f, 8663.5332f,
+    8630.87598f, 8598.35156f, 8565.96191f, 8533.70605f, 8501.58203f, 8469.58789f, 8437.72559f, 8405.99316f,
+    8374.38965f, 8342.91309f, 8311.56445f, 8280.3418f, 8249.24609f, 8218.27344f, 8187.42627f, 8156.70166f,
+    8126.09961f, 8095.61963f, 8065.26025f, 8035.021f, 8004.90234f, 7974.90234f, 7945.02002f, 7915.25488f,
+    7885.60645f, 7856.0752f, 7826.65771f, 7797.35547f, 7768.16846f, 7739.09326f, 7710.13135f, 7681.28076f,
+    7652.54297f, 7623.91455f, 7595.39648f, 7566.98779f, 7538.68945f, 7510.49707f, 7482.41309f, 7454.43652f,
+    7426.56592f, 7398.80176f, 7371.14258f, 7343.58789f, 7316.13818f, 7288.79053f, 7261.54639f, 7234.40479f,
+    7207.36523f, 7180.42627f, 7153.58838f, 7126.85107f, 7100.21191f, 7073.67285f, 7047.23291f, 7020.89062f,
+    6994.64551f, 6968.49805f, 6942.44629f, 6916.4917f, 6890.63135f, 6864.86719f, 6839.19678f, 6813.62061f,
+    6788.13818f, 6762.74902f, 6737.45215f, 6712.24756f, 6687.13477f, 6662.11328f, 6637.18213f, 6612.34131f,
+    6587.59082f, 6562.92969f, 6538.35742f, 6513.87305f, 6489.47803f, 6465.16992f, 6440.94922f, 6416.81543f,
+    6392.76807f, 6368.80615f, 6344.93066f, 6321.13965f, 6297.43408f, 6273.81201f, 6250.27441f, 6226.8208f,
+    6203.44971f, 6180.16162f, 6156.95605f, 6133.83203f, 6110.79004f, 6087.8291f, 6064.94873f, 6042.15039f,
+    6019.43018f, 5996.79102f, 5974.23145f, 5951.75f, 5929.34717f, 5907.02344f, 5884.77686f, 5862.6084f,
+    5840.5166f, 5818.50293f, 5796.56543f, 5774.7041f, 5752.91797f, 5731.20752f, 5709.57324f, 5688.01318f,
+    5666.52783f, 5645.1167f, 5623.77979f, 5602.51611f, 5581.32568f, 5560.20898f, 5539.16357f, 5518.19141f,
+    5497.2915f, 5476.46289f, 5455.70557f, 5435.01953f, 5414.4043f, 5393.86035f, 5373.38525f, 5352.98047f,
+    5332.646f, 5312.38086f, 5292.18408f, 5272.05615f, 5251.99658f, 5232.00586f, 5212.08252f, 5192.22705f,
+    5172.43848f, 5152.71729f, 5133.06299f, 5113.4751f, 5093.95361f, 5074.49805f, 5055.10791f, 5035.78369f,
+    5016.52441f, 4997.33008f, 4978.20068f, 4959.13477f, 4940.13428f, 4921.19629f, 4902.32275f, 4883.51318f,
+    4864.76562f, 4846.08105f, 4827.45947f, 4808.90039f, 4790.40381f, 4771.96777f, 4753.59473f, 4735.28271f,
+    4717.03125f, 4698.84131f, 4680.71191f, 4662.64307f, 4644.63477f, 4626.68604f, 4608.79736f, 4590.96729f,
+    4573.19727f, 4555.48584f, 4537.83398f, 4520.24023f, 4502.70508f, 4485.22852f, 4467.80957f, 4450.44775f,
+    4433.14404f, 4415.89795f, 4398.70801f, 4381.57568f, 4364.5f, 4347.48047f, 4330.51709f, 4313.60986f,
+    4296.7583f, 4279.96289f, 4263.22217f, 4246.53711f, 4229.90674f, 4213.33154f, 4196.81055f, 4180.34424f,
+    4163.93164f, 4147.57324f, 4131.26904f, 4115.01758f, 4098.81982f, 4082.67554f, 4066.58374f, 4050.54492f,
+    4034.55884f, 4018.62549f, 4002.74438f, 3986.91455f, 3971.13672f, 3955.41138f, 3939.73657f, 3924.11353f,
+    3908.5415f, 3893.02002f, 3877.5498f, 3862.12964f, 3846.76025f, 3831.44092f, 3816.17188f, 3800.95215f,
+    3785.78223f, 3770.66187f, 3755.59082f, 3740.56885f, 3725.59595f, 3710.67163f, 3695.7959f, 3680.96851f,
+    3666.1897f, 3651.45898f, 3636.77563f, 3622.14038f, 3607.55273f, 3593.0127f, 3578.51978f, 3564.07373f,
+    3549.6748f, 3535.32251f, 3521.01685f, 3506.75757f, 3492.54443f, 3478.37793f, 3464.25659f, 3450.18164f,
+    3436.1521f, 3422.16772f, 3408.22949f, 3394.33545f, 3380.48682f, 3366.68286f, 3352.92383f, 3339.20947f,
+    3325.53931f, 3311.91309f, 3298.3313f, 3284.79297f, 3271.29858f, 3257.84839f, 3244.44092f, 3231.07715f,
+    3217.7561f, 3204.47876f, 3191.24365f, 3178.05151f, 3164.9021f, 3151.79541f, 3138.73022f, 3125.70728f,
+    3112.72705f, 3099.78809f, 3086.89111f, 3074.0354f, 3061.22144f, 3048.44849f, 3035.7168f, 3023.02637f,
+    3010.37622f, 2997.76733f, 2985.19873f, 2972.6709f, 2960.18335f, 2947.7356f, 2935.32812f, 2922.96069f,
+    2910.63281f, 2898.34497f, 2886.09644f, 2873.88696f, 2861.7168f, 2849.58594f, 2837.49414f, 2825.44141f,
+    2813.427f, 2801.45142f, 2789.51392f, 2777.61548f, 2765.75415f, 2753.93164f, 2742.14722f, 2730.40015f,
+    2718.69092f, 2707.02002f, 2695.38574f, 2683.78882f, 2672.22925f, 2660.70679f, 2649.22095f, 2637.77222f,
+    2626.36011f, 2614.98511f, 2603.64624f, 2592.34326f, 2581.07764f, 2569.84692f, 2558.65234f, 2547.49414f,
+    2536.37134f, 2525.28442f, 2514.23267f, 2503.2168f, 2492.23584f, 2481.29004f, 2470.37964f, 2459.50366f,
+    2448.6626f, 2437.85669f, 2427.08472f, 2416.34741f, 2405.64478f, 2394.97632f, 2384.3418f, 2373.74097f,
+    2363.1748f, 2352.64185f, 2342.14258f, 2331.67749f, 2321.24561f, 2310.84644f, 2300.48145f, 2290.14893f,
+    2279.84985f, 2269.5835f, 2259.34985f, 2249.14893f, 2238.98096f, 2228.84497f, 2218.74146f, 2208.67041f,
+    2198.63208f, 2188.625f, 2178.65015f, 2168.70703f, 2158.79565f, 2148.91602f, 2139.06812f, 2129.25122f,
+    2119.46558f, 2109.71216f, 2099.98901f, 2090.29688f, 2080.63623f, 2071.00635f, 2061.40674f, 2051.83813f,
+    2042.29968f, 2032.79187f, 2023.31433f, 2013.86719f, 2004.4502f, 1995.06299f, 1985.70618f, 1976.37891f,
+    1967.08154f, 1957.81348f, 1948.57532f, 1939.36621f, 1930.18677f, 1921.03687f, 1911.91589f, 1902.82361f,
+    1893.76086f, 1884.72681f, 1875.72156f, 1866.74512f, 1857.797f, 1848.87769f, 1839.98669f, 1831.12402f,
+    1822.28955f, 1813.48352f, 1804.7052f, 1795.95496f, 1787.23254f, 1778.53796f, 1769.87134f, 1761.23193f,
+    1752.62024f, 1744.03601f, 1735.479f, 1726.94946f, 1718.44702f, 1709.97144f, 1701.52307f, 1693.10144f,
+    1684.70679f, 1676.33887f, 1667.99768f, 1659.68274f, 1651.39453f, 1643.13269f, 1634.89697f, 1626.68762f,
+    1618.50452f, 1610.34717f, 1602.21582f, 1594.11072f, 1586.03113f, 1577.97742f, 1569.94946f, 1561.94653f,
+    1553.96948f, 1546.01782f, 1538.09131f, 1530.19006f, 1522.31396f, 1514.46289f, 1506.63708f, 1498.83582f,
+    1491.05969f, 1483.30811f, 1475.5813f, 1467.87891f, 1460.20129f, 1452.54785f, 1444.91882f, 1437.31384f,
+    1429.73352f, 1422.17688f, 1414.64465f, 1407.13623f, 1399.65186f, 1392.19092f, 1384.75403f, 1377.34058f,
+    1369.95068f, 1362.58447f, 1355.24182f, 1347.92236f, 1340.62622f, 1333.35315f, 1326.10315f, 1318.87634f,
+    1311.67249f, 1304.49158f, 1297.3335f, 1290.19812f, 1283.08569f, 1275.99548f, 1268.9281f, 1261.88306f,
+    1254.86047f, 1247.86023f, 1240.8822f, 1233.92627f, 1226.99255f, 1220.08081f, 1213.19116f, 1206.32349f,
+    1199.47742f, 1192.65356f, 1185.85095f, 1179.07019f, 1172.31079f, 1165.57288f, 1158.85657f, 1152.16138f,
+    1145.48779f, 1138.83508f, 1132.20374f, 1125.59326f, 1119.00391f, 1112.43567f, 1105.88806f, 1099.36133f,
+    1092.85547f, 1086.37f, 1079.9054f, 1073.46118f, 1067.0376f, 1060.6344f, 1054.25146f, 1047.88892f,
+    1041.54675f, 1035.22449f, 1028.92224f, 1022.6402f, 1016.37799f, 1010.13586f, 1003.91327f, 997.710754f,
+    991.527771f, 985.364563f, 979.220703f, 973.096558f, 966.991821f, 960.906616f, 954.840515f, 948.793701f,
+    942.766235f, 936.757935f, 930.768677f, 924.798401f, 918.847046f, 912.914795f, 907.001221f, 901.106812f,
+    895.230774f, 889.373413f, 883.534607f, 877.714417f, 871.912659f, 866.129517f, 860.364685f, 854.618042f,
+    848.889648f, 843.179504f, 837.487549f, 831.813599f, 826.157776f, 820.519897f, 814.899841f, 809.297668f,
+    803.713318f, 798.146729f, 792.597778f, 787.066345f, 781.552734f, 776.056396f, 770.57782f, 765.116394f,
+    759.672546f, 754.245605f, 748.836365f, 743.44397f, 738.068665f, 732.710571f, 727.369507f, 722.04541f,
+    716.738037f, 711.447693f, 706.174133f, 700.917358f, 695.677185f, 690.453613f, 685.246826f, 680.056396f,
+    674.882446f, 669.725098f, 664.583984f, 659.45929f, 654.350769f, 649.258667f, 644.182556f, 639.12262f,
+    634.078857f, 629.050903f, 624.039062f, 619.043091f, 614.062866f, 609.098633f, 604.150085f, 599.217224f,
+    594.299927f, 589.398499f, 584.512451f, 579.641968f, 574.786926f, 569.947449f, 565.12323f, 560.31427f,
+    555.520691f, 550.742249f, 545.978943f, 541.230957f, 536.497864f, 531.779968f, 527.076904f, 522.388855f,
+    517.715759f, 513.057373f, 508.413788f, 503.784973f, 499.170685f, 494.57132f, 489.986359f, 485.416046f,
+    480.86026f, 476.318878f, 471.791931f, 467.279388f, 462.781128f, 458.29718f, 453.827484f, 449.371979f,
+    444.930634f, 440.503357f, 436.090088f, 431.690887f, 427.305847f, 422.934479f, 418.577026f, 414.23349f,
+    409.903656f, 405.587616f, 401.285248f, 396.996552f, 392.721405f, 388.45993f, 384.211914f, 379.977448f,
+    375.756409f, 371.548798f, 367.354492f, 363.173523f, 359.005829f, 354.851349f, 350.710052f, 346.581818f,
+    342.466888f, 338.364899f, 334.275879f, 330.200134f, 326.137115f, 322.087036f, 318.049774f, 314.02533f,
+    310.01358f, 306.014679f, 302.028442f, 298.05481f, 294.093872f, 290.145508f, 286.209595f, 282.286255f,
+    278.375366f
+};
 
-    float r = ( y + 1.402f * cr ) * iscale;
-    if ( r < 0.0f )
-    {
-        r = 0.0f;
-    }
-    if ( r > 1.0f )
-    {
-        r = 1.0f;
-    }
-    float g = ( y - 0.34414f * cb - 0.71414f * cr ) * iscale;
-    if ( g < 0.0f )
-    {
-        g = 0.0f;
-    }
-    if ( g > 1.0f )
-    {
-        g = 1.0f;
-    }
-    float b = ( y + 1.722f * cb ) * iscale;
-    if ( b < 0.0f )
-    {
-        b = 0.0f;
-    }
-    if ( b > 1.0f )
-    {
-        b = 1.0f;
-    }
-    return GetColorTemparature( temp, r, g, b );
-}
+// sRGB primaries matrix (coords in XYZ space)
+static const float sPrim[9] = { 1.939394f, 0.500000f, 2.500000f, 1.000000f, 1.000000f, 1.000000f, 0.090909f, 0.166667f, 13.166667f };
+// inverted primaries matrix
+static const float sInvPrim[9] = { 0.689157f, -0.326908f, -0.106024f, -0.693173f, 1.341633f, 0.029719f, 0.004016f, -0.014726f, 0.076305f };
 
-int GetColorTemparature( float temp, float r, float g, float b )
+/**
+ * Converts normalized sRGB value to linear space (sRGB transfer function) using table interpolation.
+ * @param v normalized sRGB value
+ * @return linear value
+ */
+static inline float Linearize( float v )
 {
-    // sRGB primaries matrix (coords in XYZ space)
-    const float prim[9] = { 1.939394f, 0.500000f, 2.500000f, 1.000000f, 1.000000f, 1.000000f, 0.090909f, 0.166667f, 13.166667f };
-    // inverted primaries matrix
-    const float invprim[9] = { 0.689157f, -0.326908f, -0.106024f, -0.693173f, 1.341633f, 0.029719f, 0.004016f, -0.014726f, 0.076305f };
-
-    // linearize
-    if ( r <= 0.04045f )
+    if ( v <= 0.0f )
     {
-        r = r / 12.92f;
+        return 0.0f;
     }
-    else
+    if ( v >= 1.0f )
     {
-        r = powf(( r + 0.055f ) / 1.055f, 2.4f );
+        return 1.0f;
     }
 
-    if ( g <= 0.04045f )
+    v *= 255.0f;
+    int i = ( int ) v;
+    if ( i >= 255 )
     {
-        g = g / 12.92f;
-    }
-    else
-    {
-        g = powf(( g + 0.055f ) / 1.055f, 2.4f );
+        return sLinearizeTable[255];
     }
 
-    if ( b <= 0.04045f )
-    {
-        b = b / 12.92f;
-    }
-    else
-    {
-        b = powf(( b + 0.055f ) / 1.055f, 2.4f );
-    }
+    return sLinearizeTable[i] + ( sLinearizeTable[i + 1] - sLinearizeTable[i] ) * ( v - i );
+}
 
+/**
+ * Gets linear sRGB to sRGB-with-custom-white-point scale factors.
+ * @param temp source sRGB color space color temparature
+ * @param scale output R, G and B scale factors
+ */
+static void GetWhitePointScale( float temp, float scale[3] )
+{
     // correlated color temperature of a CIE D-illuminant to the chromaticity of that D-illuminant (valid range: 4000-25000K)
     float wxc;
     if ( temp < 7000.0f )
@@ -124,22 +271,148 @@ int GetColorTemparature( float temp, float r, float g, float b )
     float wy = 1.0f;
     float wz = ( 1 - wxc - wyc ) / wyc;
 
+    scale[0] = sInvPrim[0] * wx + sInvPrim[1] * wy + sInvPrim[2] * wz;
+    scale[1] = sInvPrim[3] * wx + sInvPrim[4] * wy + sInvPrim[5] * wz;
+    scale[2] = sInvPrim[6] * wx + sInvPrim[7] * wy + sInvPrim[8] * wz;
+}
+
+/**
+ * Computes correlated color temperature from the chromaticity ratio n of GetChromaticityTemparature()
+ * (McCamy-style fit, approximation range: 3000-50000K).
+ * @param n chromaticity ratio
+ * @return color temparature in Kelwins
+ */
+static float GetFitTemparature( float n )
+{
+    return -949.86315f + 6253.80338f * expf( -n / 0.92159f ) + 28.70599f * expf( -n / 0.20039f ) + 0.00004f * expf( -n / 0.07125f );
+}
+
+/**
+ * Computes correlated color temperature from CIE xy chromaticity coords. The fit is interpolated from
+ * sFitTable (relative error below 1e-5 in 2000-20000K) and evaluated directly outside of the table range.
+ * @param cx x chromaticity coord
+ * @param cy y chromaticity coord
+ * @return color temparature in Kelwins
+ */
+static inline float GetChromaticityTemparature( float cx, float cy )
+{
+    float n = ( cx - 0.3366f ) / ( cy - 0.1735f );
+
+    float v = ( n - CCT_TABLE_MIN ) * ( CCT_TABLE_SIZE / ( CCT_TABLE_MAX - CCT_TABLE_MIN ) );
+    if ( !( v >= 0.0f && v < CCT_TABLE_SIZE ) )
+    {
+        return GetFitTemparature( n );
+    }
+
+    int i = ( int ) v;
+    return sFitTable[i] + ( sFitTable[i + 1] - sFitTable[i] ) * ( v - i );
+}
+
+/**
+ * Clamps a value to [0, 1] range.
+ */
+static inline float Saturate( float v )
+{
+    return v < 0.0f ? 0.0f : ( v > 1.0f ? 1.0f : v );
+}
+
+int GetColorTemparatureYCbCr( int temp, int y, int cb, int cr )
+{
+    // YCbCr to normalized sRGB
+    cb -= 128;
+    cr -= 128;
+
+    const float iscale = 1.0f / 255.0f;
+
+    float r = Saturate(( y + 1.402f * cr ) * iscale );
+    float g = Saturate(( y - 0.34414f * cb - 0.71414f * cr ) * iscale );
+    float b = Saturate(( y + 1.722f * cb ) * iscale );
+
+    return GetColorTemparature( temp, r, g, b );
+}
+
+int GetColorTemparature( float temp, float r, float g, float b )
+{
+    // linearize
+    r = Linearize( r );
+    g = Linearize( g );
+    b = Linearize( b );
+
     // convert linear sRGB (with custom white point) to XYZ
-    r *= invprim[0] * wx + invprim[1] * wy + invprim[2] * wz;
-    g *= invprim[3] * wx + invprim[4] * wy + invprim[5] * wz;
-    b *= invprim[6] * wx + invprim[7] * wy + invprim[8] * wz;
+    float scale[3];
+    GetWhitePointScale( temp, scale );
+    r *= scale[0];
+    g *= scale[1];
+    b *= scale[2];
 
-    float x = prim[0] * r + prim[1] * g + prim[2] * b;
-    float y = prim[3] * r + prim[4] * g + prim[5] * b;
-    float z = prim[6] * r + prim[7] * g + prim[8] * b;
+    float x = sPrim[0] * r + sPrim[1] * g + sPrim[2] * b;
+    float y = sPrim[3] * r + sPrim[4] * g + sPrim[5] * b;
+    float z = sPrim[6] * r + sPrim[7] * g + sPrim[8] * b;
 
     // get chromacity coords
     float cx = x / ( x + y + z );
     float cy = y / ( x + y + z );
 
-    // compute color temp (approximation range: 3000-50000K)
-    float n = ( cx - 0.3366f ) / ( cy - 0.1735f );
-    float cct = -949.86315f + 6253.80338f * expf( -n / 0.92159f ) + 28.70599f * expf( -n / 0.20039f ) + 0.00004f * expf( -n / 0.07125f );
+    return ( int ) GetChromaticityTemparature( cx, cy );
+}
+
+void GetColorTemparatureYCbCrBatch( int temp, const float * y, const float * cb, const float * cr, int * result, int count )
+{
+    // the white point is constant for the whole batch, fold it into the primaries matrix
+    float scale[3];
+    GetWhitePointScale( temp, scale );
+
+    float m[9];
+    for ( int i = 0; i < 9; i++ )
+    {
+        m[i] = sPrim[i] * scale[i % 3];
+    }
+
+    const float iscale = 1.0f / 255.0f;
+
+    // stage buffers (structure of arrays), each stage is a branch-free loop over the chunk
+    float r[CCT_BATCH_CHUNK], g[CCT_BATCH_CHUNK], b[CCT_BATCH_CHUNK];
+    float cx[CCT_BATCH_CHUNK], cy[CCT_BATCH_CHUNK];
+
+    for ( int base = 0; base < count; base += CCT_BATCH_CHUNK )
+    {
+        const int n = count - base < CCT_BATCH_CHUNK ? count - base : CCT_BATCH_CHUNK;
 
-    return ( int ) cct;
+        // YCbCr to normalized sRGB
+        for ( int i = 0; i < n; i++ )
+        {
+            float ly = y[base + i];
+            float lcb = cb[base + i] - 128.0f;
+            float lcr = cr[base + i] - 128.0f;
+
+            r[i] = Saturate(( ly + 1.402f * lcr ) * iscale );
+            g[i] = Saturate(( ly - 0.34414f * lcb - 0.71414f * lcr ) * iscale );
+            b[i] = Saturate(( ly + 1.722f * lcb ) * iscale );
+        }
+
+        // linearize
+        for ( int i = 0; i < n; i++ )
+        {
+            r[i] = Linearize( r[i] );
+            g[i] = Linearize( g[i] );
+            b[i] = Linearize( b[i] );
+        }
+
+        // linear sRGB (with custom white point) to chromaticity coords
+        for ( int i = 0; i < n; i++ )
+        {
+            float x = m[0] * r[i] + m[1] * g[i] + m[2] * b[i];
+            float yy = m[3] * r[i] + m[4] * g[i] + m[5] * b[i];
+            float z = m[6] * r[i] + m[7] * g[i] + m[8] * b[i];
+            float inorm = 1.0f / ( x + yy + z );
+
+            cx[i] = x * inorm;
+            cy[i] = yy * inorm;
+        }
+
+        for ( int i = 0; i < n; i++ )
+        {
+            result[base + i] = ( int ) GetChromaticityTemparature( cx[i], cy[i] );
+        }
+    }
 }
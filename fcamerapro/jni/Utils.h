@@ -55,4 +55,18 @@ int GetColorTemparatureYCbCr( int srcTemp, int y, int cb, int cr );
  */
 int GetColorTemparature( float srcTemp, float r, float g, float b );
 
+/**
+ * Computes correlated color temperatures of an array of YCbCr colors (e.g. zone averages).
+ * Produces the same result as GetColorTemparatureYCbCr() for each element (up to float
+ * rounding), but the white point is evaluated once per call and the conversion runs in
+ * structure-of-arrays stages.
+ * @param srcTemp source sRGB color space color temparature (6500K for a standard sRGB)
+ * @param y array of luma components
+ * @param cb array of chroma components
+ * @param cr array of chroma components
+ * @param temps output array of color temparatures in Kelwins
+ * @param count number of colors
+ */
+void GetColorTemparatureYCbCrBatch( int srcTemp, const float * y, const float * cb, const float * cr, int * temps, int count );
+
 #endif
@@ -0,0 +1,252 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of ZoneAutoExposure.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "Common.h"
+#include "ZoneAutoExposure.h"
+
+/**
+ * sRGB-like display gamma used to bring zone means back to linear scene levels.
+ */
+#define AE_DISPLAY_GAMMA 2.2f
+
+/**
+ * Lowest linear level considered by the controller (avoids log of zero on black frames).
+ */
+#define AE_MIN_LEVEL 1e-4f
+
+ZoneAutoExposure::ZoneAutoExposure( void )
+{
+    m_spotX = m_spotY = 0.5f;
+    m_convergenceFrames = 0;
+    reset();
+
+    m_mode = EMeteringMatrix;
+    updateWeights();
+}
+
+void ZoneAutoExposure::reset( void )
+{
+    m_ceiling = 0.0f;
+    m_ceilingScene = 0.0f;
+    m_pending = 0.0f;
+    m_pendingFrames = 0;
+    m_converged = false;
+    m_framesToConverge = 0;
+}
+
+void ZoneAutoExposure::setMode( EMeteringMode mode )
+{
+    if ( mode != m_mode )
+    {
+        m_mode = mode;
+        updateWeights();
+        reset();
+    }
+}
+
+void ZoneAutoExposure::updateWeights( void )
+{
+    if ( m_mode == EMeteringCenterWeighted )
+    {
+        // gaussian falloff from the frame center
+        const float sigma2 = 2.0f * 0.3f * 0.3f;
+        for ( int zy = 0; zy < ZONE_GRID_ROWS; zy++ )
+        {
+            for ( int zx = 0; zx < ZONE_GRID_COLUMNS; zx++ )
+            {
+                float dx = ( zx + 0.5f ) / ZONE_GRID_COLUMNS - 0.5f;
+                float dy = ( zy + 0.5f ) / ZONE_GRID_ROWS - 0.5f;
+                m_weights[zy * ZONE_GRID_COLUMNS + zx] = expf( -( dx * dx + dy * dy ) / sigma2 );
+            }
+        }
+    }
+    else if ( m_mode == EMeteringSpot )
+    {
+        // square of zones around the spot
+        const int spot = FrameStats::GetZoneIndex( m_spotX, m_spotY );
+        const int sx = spot % ZONE_GRID_COLUMNS, sy = spot / ZONE_GRID_COLUMNS;
+        for ( int zy = 0; zy < ZONE_GRID_ROWS; zy++ )
+        {
+            for ( int zx = 0; zx < ZONE_GRID_COLUMNS; zx++ )
+            {
+                bool inside = abs( zx - sx ) <= AE_SPOT_RADIUS && abs( zy - sy ) <= AE_SPOT_RADIUS;
+                m_weights[zy * ZONE_GRID_COLUMNS + zx] = inside ? 1.0f : 0.0f;
+            }
+        }
+    }
+    else
+    {
+        // matrix: uniform weights, metered as a geometric mean in meter()
+        for ( int i = 0; i < ZONE_GRID_SIZE; i++ )
+        {
+            m_weights[i] = 1.0f;
+        }
+    }
+}
+
+void ZoneAutoExposure::setSpot( float x, float y )
+{
+    m_spotX = x;
+    m_spotY = y;
+
+    if ( m_mode == EMeteringSpot )
+    {
+        updateWeights();
+        reset();
+    }
+}
+
+float ZoneAutoExposure::meter( const FrameStats & stats ) const
+{
+    const float * luma = stats.getZoneLuma();
+    float sum = 0.0f, weightSum = 0.0f;
+
+    for ( int i = 0; i < ZONE_GRID_SIZE; i++ )
+    {
+        if ( m_weights[i] == 0.0f )
+        {
+            continue;
+        }
+
+        float level = powf( luma[i] * ( 1.0f / 255.0f ), AE_DISPLAY_GAMMA );
+        if ( level < AE_MIN_LEVEL )
+        {
+            level = AE_MIN_LEVEL;
+        }
+
+        // matrix metering averages in log domain so that a few very bright or dark zones do not dominate
+        sum += m_weights[i] * ( m_mode == EMeteringMatrix ? logf( level ) : level );
+        weightSum += m_weights[i];
+    }
+
+    if ( weightSum == 0.0f )
+    {
+        return AE_TARGET_LEVEL;
+    }
+
+    return m_mode == EMeteringMatrix ? expf( sum / weightSum ) : sum / weightSum;
+}
+
+void ZoneAutoExposure::update( FCam::Shot * shot, const FCam::Frame & frame, const FrameStats & stats, float maxGain, int maxExposure,
+                               int minExposure )
+{
+    // correct relative to the parameters the measured frame was captured with
+    update( shot, ( float ) frame.exposure(), frame.gain(), stats, maxGain, maxExposure, minExposure );
+}
+
+void ZoneAutoExposure::update( FCam::Shot * shot, float exposure, float gain, const FrameStats & stats, float maxGain, int maxExposure,
+                               int minExposure )
+{
+    if ( exposure < minExposure )
+    {
+        exposure = ( float ) minExposure;
+    }
+    if ( gain < 1.0f )
+    {
+        gain = 1.0f;
+    }
+    const float frameTotal = exposure * gain;
+
+    // frames still in the sensor pipeline were captured before the last correction, skip them
+    if ( m_pending > 0.0f && fabsf( logf( frameTotal / m_pending ) ) > AE_DEADBAND * ( float ) M_LN2 &&
+         ++m_pendingFrames < AE_MAX_LATENCY )
+    {
+        return;
+    }
+    m_pending = 0.0f;
+
+    // exposure error in stops
+    float level = meter( stats );
+    float error = logf( AE_TARGET_LEVEL / level ) / ( float ) M_LN2;
+
+    // the ceiling belongs to the scene it was set in
+    float scene = level / frameTotal;
+    if ( m_ceiling > 0.0f && fabsf( logf( scene / m_ceilingScene ) ) > AE_CEILING_SCENE_STOPS * ( float ) M_LN2 )
+    {
+        m_ceiling = 0.0f;
+    }
+
+    // highlight protection: back off and do not exceed the clipping exposure until the ceiling relaxes
+    float clipped = stats.getSampleCount() > 0 ? ( float ) stats.getClippedHighlights() / stats.getSampleCount() : 0.0f;
+    if ( clipped > AE_HIGHLIGHT_LIMIT )
+    {
+        float limit = -( clipped - AE_HIGHLIGHT_LIMIT ) * AE_HIGHLIGHT_STOPS;
+        error = error < limit ? error : limit;
+        m_ceiling = frameTotal * powf( 2.0f, -AE_DEADBAND );
+        m_ceilingScene = scene;
+    }
+    else if ( m_ceiling > 0.0f )
+    {
+        m_ceiling *= powf( 2.0f, AE_CEILING_RELAX );
+    }
+
+    // large errors are corrected in full: clipping makes the meter underestimate them in both directions,
+    // so the full step can not overshoot; small errors are damped
+    float step = fabsf( error ) < AE_DEADBAND ? 0.0f : ( fabsf( error ) > 1.0f ? error : error * AE_DAMPING );
+    step = step > AE_MAX_STEP ? AE_MAX_STEP : ( step < -AE_MAX_STEP ? -AE_MAX_STEP : step );
+    float total = frameTotal * powf( 2.0f, step );
+    if ( m_ceiling > 0.0f && total > m_ceiling && step > 0.0f )
+    {
+        total = m_ceiling > frameTotal ? m_ceiling : frameTotal;
+    }
+
+    // the sensor can not go past its limits, a correction beyond them would never be reached
+    const float maxTotal = maxExposure * maxGain;
+    total = total > maxTotal ? maxTotal : ( total < minExposure ? ( float ) minExposure : total );
+    if ( total != frameTotal )
+    {
+        m_pending = total;
+        m_pendingFrames = 0;
+    }
+
+    // track convergence (no significant correction left)
+    bool converged = fabsf( logf( total / frameTotal ) ) < AE_DEADBAND * ( float ) M_LN2;
+    if ( converged && !m_converged )
+    {
+        m_convergenceFrames = m_framesToConverge;
+    }
+    m_framesToConverge = converged ? 0 : m_framesToConverge + 1;
+    m_converged = converged;
+
+    // prefer exposure over gain
+    exposure = total;
+    gain = 1.0f;
+    if ( exposure > maxExposure )
+    {
+        gain = exposure / maxExposure;
+        exposure = ( float ) maxExposure;
+    }
+
+    shot->exposure = ( int ) exposure;
+    shot->gain = gain;
+}
@@ -0,0 +1,157 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _ZONEAUTOEXPOSURE_H
+#define _ZONEAUTOEXPOSURE_H
+
+/**
+ * @file
+ * Definition of ZoneAutoExposure.
+ */
+
+#include <FCam/Tegra.h>
+#include "FrameStats.h"
+
+#define AE_TARGET_LEVEL        0.18f /**< Target linear scene level (middle gray) */
+#define AE_DAMPING             0.75f /**< Fraction of the exposure error corrected per frame */
+#define AE_MAX_STEP            2.0f  /**< Maximum exposure change per frame (stops) */
+#define AE_DEADBAND            0.1f  /**< Exposure error tolerance (stops) */
+#define AE_HIGHLIGHT_LIMIT     0.02f /**< Fraction of clipped pixels tolerated before highlight protection kicks in */
+#define AE_HIGHLIGHT_STOPS     2.0f  /**< Exposure reduction (stops) per unit of clipped fraction above the limit */
+#define AE_CEILING_RELAX       0.02f /**< Highlight exposure ceiling relaxation per frame (stops) */
+#define AE_CEILING_SCENE_STOPS 1.0f  /**< Scene level change (stops) dropping the highlight exposure ceiling */
+#define AE_MAX_LATENCY         4     /**< Maximum number of frames to wait for a correction to take effect */
+#define AE_SPOT_RADIUS         1     /**< Spot metering area radius in zones */
+
+/**
+ * Auto-exposure metering the {@link FrameStats} zone grid of the streamed frames. Supports matrix,
+ * center-weighted and spot metering. The controller works in the log domain relative
+ * to the exposure and gain the measured frame was captured with, which keeps it
+ * stable despite the sensor pipeline latency.
+ */
+class ZoneAutoExposure
+{
+public:
+    /**
+     * Metering modes (need to match METERING_MODE_* values).
+     */
+    enum EMeteringMode
+    {
+        EMeteringMatrix, EMeteringCenterWeighted, EMeteringSpot
+    };
+
+    /**
+     * Default constructor.
+     */
+    ZoneAutoExposure( void );
+
+    /**
+     * Sets metering mode.
+     * @param mode metering mode
+     */
+    void setMode( EMeteringMode mode );
+
+    /**
+     * Forgets the adaptive state (highlight ceiling, pending correction and
+     * convergence tracking). Called when the metered region changes.
+     */
+    void reset( void );
+
+    /**
+     * Sets spot metering position.
+     * @param x normalized horizontal position (0 - left, 1 - right)
+     * @param y normalized vertical position (0 - top, 1 - bottom)
+     */
+    void setSpot( float x, float y );
+
+    /**
+     * Computes metered linear scene level of a frame.
+     * @param stats statistics of the measured frame
+     * @return metered level (0 - 1)
+     */
+    float meter( const FrameStats & stats ) const;
+
+    /**
+     * Evaluates exposure and gain of the next shot.
+     * @param shot shot to update
+     * @param frame measured frame
+     * @param stats statistics of the measured frame
+     * @param maxGain maximum sensor gain
+     * @param maxExposure maximum exposure (microseconds)
+     * @param minExposure minimum exposure (microseconds)
+     */
+    void update( FCam::Shot * shot, const FCam::Frame & frame, const FrameStats & stats, float maxGain, int maxExposure,
+                 int minExposure );
+
+    /**
+     * Evaluates exposure and gain of the next shot from statistics that do not
+     * belong to a single frame (fused HDR preview frames).
+     * @param shot shot to update
+     * @param exposure exposure the statistics correspond to (microseconds)
+     * @param gain gain the statistics correspond to
+     * @param stats measured statistics
+     * @param maxGain maximum sensor gain
+     * @param maxExposure maximum exposure (microseconds)
+     * @param minExposure minimum exposure (microseconds)
+     */
+    void update( FCam::Shot * shot, float exposure, float gain, const FrameStats & stats, float maxGain, int maxExposure,
+                 int minExposure );
+
+    /**
+     * Returns true if the last measured frame was within the exposure tolerance.
+     */
+    bool converged( void ) const
+    {
+        return m_converged;
+    }
+
+    /**
+     * Gets the number of frames the controller needed to converge last time.
+     */
+    int getConvergenceFrames( void ) const
+    {
+        return m_convergenceFrames;
+    }
+
+private:
+    /**
+     * Recomputes zone weights for current metering mode and spot position.
+     */
+    void updateWeights( void );
+
+    float m_weights[ZONE_GRID_SIZE]; /**< Zone weights of current metering mode */
+    EMeteringMode m_mode; /**< Current metering mode */
+    float m_spotX, m_spotY; /**< Spot position */
+    float m_ceiling; /**< Highest exposure * gain not clipping highlights (0 - unknown) */
+    float m_ceilingScene; /**< Metered level per unit of exposure * gain when the ceiling was set */
+    float m_pending; /**< Last requested exposure * gain not yet seen in a frame (0 - none) */
+    int m_pendingFrames; /**< Frames received since the last correction */
+    bool m_converged;
+    int m_framesToConverge; /**< Frames since the controller left the tolerance */
+    int m_convergenceFrames; /**< Frames needed by last convergence */
+};
+
+#endif
@@ -0,0 +1,150 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file
+ * Implementation of ZoneAutoWhiteBalance.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "Common.h"
+#include "Utils.h"
+#include "ZoneAutoWhiteBalance.h"
+
+ZoneAutoWhiteBalance::ZoneAutoWhiteBalance( void )
+{
+    m_mired = 0.0f;
+    m_tracking = false;
+}
+
+void ZoneAutoWhiteBalance::reset( int temp )
+{
+    m_mired = 1e6f / temp;
+    m_tracking = false;
+}
+
+int ZoneAutoWhiteBalance::estimate( int srcTemp, const FrameStats & stats )
+{
+    const float * luma = stats.getZoneLuma();
+    const float * cb = stats.getZoneCb();
+    const float * cr = stats.getZoneCr();
+
+    // reject dark, clipped and saturated zones
+    int count = 0;
+    for ( int i = 0; i < ZONE_GRID_SIZE; i++ )
+    {
+        float dcb = cb[i] - 128.0f, dcr = cr[i] - 128.0f;
+        if ( luma[i] < AWB_DARK_LEVEL || luma[i] > AWB_BRIGHT_LEVEL || dcb * dcb + dcr * dcr > AWB_MAX_CHROMA * AWB_MAX_CHROMA )
+        {
+            continue;
+        }
+
+        m_y[count] = luma[i];
+        m_cb[count] = cb[i];
+        m_cr[count] = cr[i];
+        count++;
+    }
+
+    if ( count < AWB_MIN_ZONES )
+    {
+        return 0;
+    }
+
+    GetColorTemparatureYCbCrBatch( srcTemp, m_y, m_cb, m_cr, m_temps, count );
+    for ( int i = 0; i < count; i++ )
+    {
+        // keep the fit inside its valid range
+        m_temps[i] = m_temps[i] < AWB_MIN_TEMP ? AWB_MIN_TEMP : ( m_temps[i] > AWB_MAX_TEMP ? AWB_MAX_TEMP : m_temps[i] );
+    }
+
+    // white patch: mean temperature of the brightest zones
+    int patchCount = ( int )( count * AWB_WHITE_PATCH_RATIO );
+    patchCount = patchCount < 1 ? 1 : patchCount;
+
+    float lumaCopy[ZONE_GRID_SIZE];
+    std::copy( m_y, m_y + count, lumaCopy );
+    std::nth_element( lumaCopy, lumaCopy + count - patchCount, lumaCopy + count );
+    const float threshold = lumaCopy[count - patchCount];
+
+    float whitePatch = 0.0f;
+    int whitePatchCount = 0;
+    for ( int i = 0; i < count; i++ )
+    {
+        if ( m_y[i] >= threshold )
+        {
+            whitePatch += 1e6f / m_temps[i];
+            whitePatchCount++;
+        }
+    }
+    whitePatch /= whitePatchCount;
+
+    // gray world: median temperature of accepted zones (robust to mixed lighting)
+    std::nth_element( m_temps, m_temps + ( count >> 1 ), m_temps + count );
+    float grayWorld = 1e6f / m_temps[count >> 1];
+
+    return ( int )( 1e6f / ( 0.5f * ( grayWorld + whitePatch ) ) );
+}
+
+void ZoneAutoWhiteBalance::update( FCam::Shot * shot, const FCam::Frame & frame, const FrameStats & stats )
+{
+    int srcTemp = frame.whiteBalance();
+    if ( srcTemp <= 0 )
+    {
+        srcTemp = shot->whiteBalance > 0 ? shot->whiteBalance : 6500;
+    }
+
+    int temp = estimate( srcTemp, stats );
+    if ( temp == 0 )
+    {
+        // not enough reliable zones, keep current white balance
+        return;
+    }
+
+    float mired = 1e6f / temp;
+    if ( m_mired == 0.0f )
+    {
+        m_mired = mired;
+    }
+
+    // hysteresis: small estimate changes (mixed lighting, noise) do not move the output
+    float delta = mired - m_mired;
+    if ( !m_tracking && fabsf( delta ) > AWB_HYSTERESIS_OUTER )
+    {
+        m_tracking = true;
+    }
+
+    if ( m_tracking )
+    {
+        m_mired += delta * AWB_SMOOTHING;
+        if ( fabsf( delta ) < AWB_HYSTERESIS_INNER )
+        {
+            m_tracking = false;
+        }
+    }
+
+    shot->whiteBalance = ( int )( 1e6f / m_mired );
+}
@@ -0,0 +1,103 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _ZONEAUTOWHITEBALANCE_H
+#define _ZONEAUTOWHITEBALANCE_H
+
+/**
+ * @file
+ * Definition of ZoneAutoWhiteBalance.
+ */
+
+#include <FCam/Tegra.h>
+#include "FrameStats.h"
+
+#define AWB_MIN_TEMP          3000  /**< Lowest estimated color temperature (Kelwins) */
+#define AWB_MAX_TEMP          8000  /**< Highest estimated color temperature (Kelwins) */
+#define AWB_DARK_LEVEL        24.0f /**< Zones with lower mean luma are rejected */
+#define AWB_BRIGHT_LEVEL      235.0f /**< Zones with higher mean luma are rejected (likely clipped) */
+#define AWB_MAX_CHROMA        48.0f /**< Zones with larger chroma distance from gray are rejected */
+#define AWB_MIN_ZONES         8     /**< Minimum number of accepted zones to update the estimate */
+#define AWB_WHITE_PATCH_RATIO 0.1f  /**< Fraction of brightest accepted zones used by the white-patch estimate */
+#define AWB_HYSTERESIS_OUTER  12.0f /**< Estimate change (mireds) that starts tracking */
+#define AWB_HYSTERESIS_INNER  2.0f  /**< Estimate change (mireds) that stops tracking */
+#define AWB_SMOOTHING         0.25f /**< Fraction of the remaining change applied per frame while tracking */
+
+/**
+ * Auto white balance working on the {@link FrameStats} zone grid of the streamed frames.
+ * Dark, clipped and strongly colored zones are rejected, the color temperature
+ * of the remaining zones is estimated with a single batch call and combined
+ * from a gray-world (median of zones) and a white-patch (brightest zones)
+ * estimate. The output follows the estimate with hysteresis in mired space.
+ */
+class ZoneAutoWhiteBalance
+{
+public:
+    /**
+     * Default constructor.
+     */
+    ZoneAutoWhiteBalance( void );
+
+    /**
+     * Resets the filter to a specific color temperature.
+     * @param temp color temperature (Kelwins)
+     */
+    void reset( int temp );
+
+    /**
+     * Estimates the illuminant color temperature of a frame.
+     * @param srcTemp white point the measured frame was processed with (Kelwins)
+     * @param stats statistics of the measured frame
+     * @return estimated color temperature (Kelwins) or 0 if too few zones were accepted
+     */
+    int estimate( int srcTemp, const FrameStats & stats );
+
+    /**
+     * Evaluates white balance of the next shot.
+     * @param shot shot to update
+     * @param frame measured frame
+     * @param stats statistics of the measured frame
+     */
+    void update( FCam::Shot * shot, const FCam::Frame & frame, const FrameStats & stats );
+
+    /**
+     * Returns true if the output is not tracking an estimate change.
+     */
+    bool converged( void ) const
+    {
+        return !m_tracking;
+    }
+
+private:
+    float m_mired; /**< Current output (mireds, 0 - not initialized) */
+    bool m_tracking; /**< Output follows a changed estimate */
+
+    // per-frame scratch
+    float m_y[ZONE_GRID_SIZE], m_cb[ZONE_GRID_SIZE], m_cr[ZONE_GRID_SIZE];
+    int m_temps[ZONE_GRID_SIZE];
+};
+
+#endif
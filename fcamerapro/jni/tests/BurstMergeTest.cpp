@@ -0,0 +1,204 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Host test of BurstMerge.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "TestCommon.h"
+#include "BurstMerge.h"
+#include "ThreadPool.h"
+
+#define TEST_WIDTH  640 /**< Test frame width */
+#define TEST_HEIGHT 480 /**< Test frame height */
+#define TEST_FRAMES 8   /**< Number of burst frames */
+#define TEST_NOISE  8.0f /**< Noise standard deviation */
+#define TEST_SIZE   ( TEST_WIDTH * TEST_HEIGHT * 3 / 2 ) /**< Test frame data size */
+
+/**
+ * Gets the luma of the static scene at a point.
+ */
+static float GetSceneLuma( float x, float y )
+{
+    int checker = (( int )( x / 40.0f ) ^ ( int )( y / 40.0f ) ) & 1;
+    return 110.0f + 50.0f * sinf( x * 0.013f ) * cosf( y * 0.011f ) + 30.0f * sinf( x * 0.051f + y * 0.03f )
+           + 20.0f * checker + 10.0f * sinf( x * 0.2f ) * sinf( y * 0.17f );
+}
+
+/**
+ * Hand shake of a burst frame.
+ */
+static void GetShake( int frame, int & dx, int & dy )
+{
+    dx = frame * 7 % 11 - 5;
+    dy = frame * 5 % 9 - 4;
+}
+
+/**
+ * Is a pixel covered by the object moving through the burst in a frame?
+ */
+static bool IsObject( int frame, int x, int y )
+{
+    return abs( x - ( 200 + 30 * frame ) ) < 40 && abs( y - 240 ) < 40;
+}
+
+/**
+ * Gets the noiseless luma of a burst frame at a pixel.
+ */
+static float GetCleanLuma( int frame, int x, int y )
+{
+    int dx, dy;
+    GetShake( frame, dx, dy );
+    return IsObject( frame, x, y ) ? 230.0f : GetSceneLuma( x + dx, y + dy );
+}
+
+/**
+ * Gets a reproducible standard normal random number.
+ */
+static float GetGaussian( uint & seed )
+{
+    seed = seed * 1103515245 + 12345;
+    float u = (( seed >> 8 ) + 1.0f ) / 16777218.0f;
+    seed = seed * 1103515245 + 12345;
+    float v = ( seed >> 8 ) / 16777216.0f;
+    return sqrtf( -2.0f * logf( u ) ) * cosf( 6.2831853f * v );
+}
+
+/**
+ * Checks that a shaken, noisy burst with a moving object merges into a
+ * frame with less noise than the reference frame and without ghosts of the
+ * object, and that the merge on a thread pool gives the same result.
+ */
+static void TestMerge( void )
+{
+    std::vector<std::vector<uchar> > frames( TEST_FRAMES, std::vector<uchar>( TEST_SIZE ) );
+    std::vector<const uchar *> data( TEST_FRAMES );
+    uint seed = 3;
+    for ( int k = 0; k < TEST_FRAMES; k++ )
+    {
+        for ( int y = 0; y < TEST_HEIGHT; y++ )
+        {
+            for ( int x = 0; x < TEST_WIDTH; x++ )
+            {
+                float v = GetCleanLuma( k, x, y ) + TEST_NOISE * GetGaussian( seed );
+                frames[k][y * TEST_WIDTH + x] = ( uchar ) std::min( std::max( v + 0.5f, 0.0f ), 255.0f );
+            }
+        }
+        for ( int i = TEST_WIDTH * TEST_HEIGHT; i < TEST_SIZE; i++ )
+        {
+            frames[k][i] = ( uchar ) std::min( std::max( 128.5f + TEST_NOISE * GetGaussian( seed ), 0.0f ), 255.0f );
+        }
+        data[k] = &frames[k][0];
+    }
+
+    BurstMerge merge;
+    ThreadPool pool( 3 );
+    std::vector<uchar> merged( TEST_SIZE ), pooledMerged( TEST_SIZE );
+    int reference = merge.merge( &data[0], TEST_FRAMES, TEST_WIDTH, TEST_HEIGHT, &merged[0], 0 );
+    int pooledReference = merge.merge( &data[0], TEST_FRAMES, TEST_WIDTH, TEST_HEIGHT, &pooledMerged[0], &pool );
+    CHECK( reference >= 0 && reference < TEST_FRAMES );
+    CHECK( reference == pooledReference );
+    CHECK( merged == pooledMerged );
+
+    // luma errors against the noiseless reference frame, away from the borders
+    double referenceError = 0.0, mergedError = 0.0, objectError = 0.0;
+    int count = 0, objectCount = 0;
+    for ( int y = 16; y < TEST_HEIGHT - 16; y++ )
+    {
+        for ( int x = 16; x < TEST_WIDTH - 16; x++ )
+        {
+            float clean = GetCleanLuma( reference, x, y );
+            double e = merged[y * TEST_WIDTH + x] - clean;
+            if ( IsObject( reference, x, y ) )
+            {
+                objectError += e * e;
+                objectCount++;
+            }
+            else
+            {
+                double r = frames[reference][y * TEST_WIDTH + x] - clean;
+                referenceError += r * r;
+                mergedError += e * e;
+                count++;
+            }
+        }
+    }
+
+    // 8 frames could at best lower the noise by 9 dB
+    double gain = 10.0 * log10( referenceError / mergedError );
+    CHECK( gain > 4.0 );
+    // a ghost of the object elsewhere in the burst would be far off the reference
+    CHECK( sqrt( objectError / objectCount ) < TEST_NOISE * 1.5 );
+
+    double chromaReference = 0.0, chromaMerged = 0.0;
+    for ( int i = TEST_WIDTH * TEST_HEIGHT; i < TEST_SIZE; i++ )
+    {
+        chromaReference += ( frames[reference][i] - 128 ) * ( frames[reference][i] - 128 );
+        chromaMerged += ( merged[i] - 128 ) * ( merged[i] - 128 );
+    }
+    CHECK( chromaMerged * 2.0 < chromaReference );
+}
+
+/**
+ * Checks that a burst of identical frames merges into the same frame.
+ */
+static void TestIdenticalFrames( void )
+{
+    std::vector<uchar> frame( TEST_SIZE );
+    for ( int y = 0; y < TEST_HEIGHT; y++ )
+    {
+        for ( int x = 0; x < TEST_WIDTH; x++ )
+        {
+            frame[y * TEST_WIDTH + x] = ( uchar ) GetSceneLuma( x, y );
+        }
+    }
+    FillRandom( &frame[TEST_WIDTH * TEST_HEIGHT], TEST_WIDTH * TEST_HEIGHT / 2, 9 );
+
+    std::vector<const uchar *> data( 4, &frame[0] );
+    std::vector<uchar> merged( TEST_SIZE );
+    BurstMerge merge;
+    merge.merge( &data[0], 4, TEST_WIDTH, TEST_HEIGHT, &merged[0], 0 );
+
+    int worst = 0;
+    for ( int i = 0; i < TEST_SIZE; i++ )
+    {
+        worst = std::max( worst, abs( merged[i] - frame[i] ) );
+    }
+    CHECK( worst == 0 );
+}
+
+int main( void )
+{
+    TestMerge();
+    TestIdenticalFrames();
+
+    return TestResult( "BurstMergeTest" );
+}
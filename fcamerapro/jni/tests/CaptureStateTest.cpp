@@ -0,0 +1,61 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Host test of CaptureState.
+ */
+
+#include "TestCommon.h"
+#include "CaptureState.h"
+
+/**
+ * Checks the default capture settings. Camera used to zero its state after
+ * construction, which turned night mode captures and frame alignment off and
+ * selected the global tone mapping operator instead of the local one.
+ */
+static void TestDefaults( void )
+{
+    CaptureState state;
+    CHECK( state.nightFrames == NIGHT_DEFAULT_FRAMES && state.nightFrames > 0 );
+    CHECK( state.luckyFrames == LUCKY_DEFAULT_FRAMES && state.luckyFrames > 0 );
+    CHECK( state.alignFrames );
+    CHECK( state.toneMapOperator == TONE_MAP_OPERATOR_LOCAL );
+    CHECK( state.outputFormat == OUTPUT_FORMAT_JPEG );
+    CHECK( state.preview.meteringMode == METERING_MODE_MATRIX );
+    CHECK( state.preview.autoExposure && state.preview.autoGain && state.preview.autoWB );
+    CHECK( state.pendingImagesCount == 0 );
+    CHECK( state.calibratedGains == 0 );
+    CHECK( state.preview.user.exposure > 0.0f && state.preview.user.gain >= 1.0f );
+}
+
+int main( void )
+{
+    TestDefaults();
+
+    return TestResult( "CaptureStateTest" );
+}
@@ -0,0 +1,174 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Host test of ExposureFusion.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "TestCommon.h"
+#include "ExposureFusion.h"
+#include "ThreadPool.h"
+
+#define TEST_WIDTH  648 /**< Test frame width (deep enough for levels computed whole) */
+#define TEST_HEIGHT 486 /**< Test frame height */
+#define TEST_SIZE   ( TEST_WIDTH * TEST_HEIGHT * 3 / 2 ) /**< Test frame data size */
+
+/**
+ * Gets the linear radiance of the test scene at a pixel: a horizontal ramp
+ * over three decades with fine texture.
+ */
+static float GetRadiance( int x, int y )
+{
+    float ramp = powf( 1000.0f, (float) x / ( TEST_WIDTH - 1 ) ) / 1000.0f;
+    return ramp * ( 1.0f + 0.3f * sinf( x * 0.7f ) * sinf( y * 0.5f ) );
+}
+
+/**
+ * Renders a frame of the test scene with the given exposure.
+ */
+static void RenderFrame( float exposure, uchar * frame )
+{
+    for ( int y = 0; y < TEST_HEIGHT; y++ )
+    {
+        for ( int x = 0; x < TEST_WIDTH; x++ )
+        {
+            float v = 255.0f * powf( std::min( GetRadiance( x, y ) * exposure, 1.0f ), 1.0f / 2.2f );
+            frame[y * TEST_WIDTH + x] = ( uchar ) ( v + 0.5f );
+        }
+    }
+
+    // bluish scene, chroma gets weaker towards black and white
+    uchar * cb = frame + TEST_WIDTH * TEST_HEIGHT;
+    uchar * cr = cb + TEST_WIDTH * TEST_HEIGHT / 4;
+    for ( int y = 0; y < TEST_HEIGHT / 2; y++ )
+    {
+        for ( int x = 0; x < TEST_WIDTH / 2; x++ )
+        {
+            int luma = frame[2 * y * TEST_WIDTH + 2 * x];
+            int chroma = std::min( luma, 255 - luma ) / 4;
+            cb[y * TEST_WIDTH / 2 + x] = ( uchar ) ( 128 + chroma );
+            cr[y * TEST_WIDTH / 2 + x] = ( uchar ) ( 128 - chroma / 2 );
+        }
+    }
+}
+
+/**
+ * Gets the mean and the standard deviation of luma in a column range.
+ */
+static void GetLumaStatistics( const uchar * frame, int x0, int x1, float & mean, float & deviation )
+{
+    double sum = 0.0, sum2 = 0.0;
+    int count = 0;
+    for ( int y = 0; y < TEST_HEIGHT; y++ )
+    {
+        for ( int x = x0; x < x1; x++ )
+        {
+            int v = frame[y * TEST_WIDTH + x];
+            sum += v;
+            sum2 += v * v;
+            count++;
+        }
+    }
+    mean = ( float ) ( sum / count );
+    deviation = ( float ) sqrt( std::max( sum2 / count - mean * mean, 0.0 ) );
+}
+
+/**
+ * Checks that fusing a single frame or copies of the same frame gives the
+ * frame back (up to rounding).
+ */
+static void TestIdentity( void )
+{
+    std::vector<uchar> frame( TEST_SIZE ), fused( TEST_SIZE );
+    FillRandom( &frame[0], TEST_SIZE, 5 );
+
+    ExposureFusion fusion;
+    for ( int n = 1; n <= 3; n += 2 )
+    {
+        std::vector<const uchar *> data( n, &frame[0] );
+        fusion.fuse( &data[0], n, TEST_WIDTH, TEST_HEIGHT, &fused[0], 0 );
+
+        int worst = 0;
+        for ( int i = 0; i < TEST_SIZE; i++ )
+        {
+            worst = std::max( worst, abs( fused[i] - frame[i] ) );
+        }
+        CHECK( worst <= 1 );
+    }
+}
+
+/**
+ * Checks that a bracket fuses into an image with detail both in the shadows
+ * of the long exposure and in the highlights of the short one, and that the
+ * fusion on a thread pool gives the same result.
+ */
+static void TestBracket( void )
+{
+    static const float exposures[3] = { 1.0f, 16.0f, 256.0f };
+    std::vector<std::vector<uchar> > frames( 3, std::vector<uchar>( TEST_SIZE ) );
+    std::vector<const uchar *> data( 3 );
+    for ( int k = 0; k < 3; k++ )
+    {
+        RenderFrame( exposures[k], &frames[k][0] );
+        data[k] = &frames[k][0];
+    }
+
+    ExposureFusion fusion;
+    ThreadPool pool( 3 );
+    std::vector<uchar> fused( TEST_SIZE ), pooledFused( TEST_SIZE );
+    fusion.fuse( &data[0], 3, TEST_WIDTH, TEST_HEIGHT, &fused[0], 0 );
+    fusion.fuse( &data[0], 3, TEST_WIDTH, TEST_HEIGHT, &pooledFused[0], &pool );
+    CHECK( fused == pooledFused );
+
+    // shadows: the short exposure is nearly black, the fused image is lifted
+    float mean, deviation, shortMean, shortDeviation;
+    GetLumaStatistics( &fused[0], 16, TEST_WIDTH / 6, mean, deviation );
+    GetLumaStatistics( &frames[0][0], 16, TEST_WIDTH / 6, shortMean, shortDeviation );
+    printf( "shadows: short %.1f +- %.1f, fused %.1f +- %.1f\n", shortMean, shortDeviation, mean, deviation );
+    CHECK( mean > shortMean + 20.0f );
+    CHECK( deviation > 2.0f * shortDeviation );
+
+    // highlights: the long exposure is clipped, the fused image keeps detail
+    float longMean, longDeviation;
+    GetLumaStatistics( &fused[0], TEST_WIDTH * 5 / 6, TEST_WIDTH - 16, mean, deviation );
+    GetLumaStatistics( &frames[2][0], TEST_WIDTH * 5 / 6, TEST_WIDTH - 16, longMean, longDeviation );
+    printf( "highlights: long %.1f +- %.1f, fused %.1f +- %.1f\n", longMean, longDeviation, mean, deviation );
+    CHECK( mean < longMean - 20.0f );
+    CHECK( longDeviation < 1.0f && deviation > 10.0f );
+}
+
+int main( void )
+{
+    TestIdentity();
+    TestBracket();
+
+    return TestResult( "ExposureFusionTest" );
+}
@@ -0,0 +1,149 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Host test of FlashFusion.
+ */
+
+#include <string.h>
+#include <vector>
+#include "TestCommon.h"
+#include "FlashFusion.h"
+
+#define TEST_WIDTH  320 /**< Test frame width */
+#define TEST_HEIGHT 240 /**< Test frame height */
+#define TEST_LUMA   ( TEST_WIDTH * TEST_HEIGHT ) /**< Test frame luma size */
+#define TEST_SIZE   ( TEST_LUMA * 3 / 2 ) /**< Test frame data size */
+
+/**
+ * Fills a frame with constant planes.
+ */
+static void FillFlat( std::vector<uchar> & frame, uchar y, uchar cb, uchar cr )
+{
+    frame.resize( TEST_SIZE );
+    memset( &frame[0], y, TEST_LUMA );
+    memset( &frame[TEST_LUMA], cb, TEST_LUMA / 4 );
+    memset( &frame[TEST_LUMA * 5 / 4], cr, TEST_LUMA / 4 );
+}
+
+/**
+ * Counts the luma pixels of the output that differ from the no-flash frame,
+ * among the pixels where the flash luma satisfies a condition.
+ * @param inside if true, pixels with flash luma in [low, high] are checked,
+ * otherwise the pixels outside
+ */
+static int CountChanged( const std::vector<uchar> & out, const std::vector<uchar> & ambient, const std::vector<uchar> & flash,
+                         int low, int high, bool inside )
+{
+    int changed = 0;
+    for ( int i = 0; i < TEST_LUMA; i++ )
+    {
+        if ( ( flash[i] >= low && flash[i] <= high ) == inside && out[i] != ambient[i] )
+        {
+            changed++;
+        }
+    }
+    return changed;
+}
+
+/**
+ * Checks that flat no-flash/flash pairs pass the no-flash frame through
+ * unchanged: no detail to transfer and nothing for the filter to smooth.
+ * The pairs cover a dark flash-lit scene, equal frames (flash shadow) and a
+ * clipping flash.
+ */
+static void TestFlat( void )
+{
+    const uchar pairs[][4] = { { 40, 180, 110, 150 }, { 90, 90, 128, 128 }, { 200, 255, 100, 140 }, { 0, 0, 128, 128 } };
+    ThreadPool pool( 3 );
+    FlashFusion fusion;
+
+    for ( int i = 0; i < ( int ) ( sizeof( pairs ) / sizeof( pairs[0] ) ); i++ )
+    {
+        std::vector<uchar> ambient, flash, out( TEST_SIZE ), pooled( TEST_SIZE );
+        FillFlat( ambient, pairs[i][0], pairs[i][2], pairs[i][3] );
+        FillFlat( flash, pairs[i][1], 128, 128 );
+
+        fusion.fuse( &ambient[0], &flash[0], TEST_WIDTH, TEST_HEIGHT, &out[0], 0 );
+        CHECK( memcmp( &out[0], &ambient[0], TEST_SIZE ) == 0 );
+
+        fusion.fuse( &ambient[0], &flash[0], TEST_WIDTH, TEST_HEIGHT, &pooled[0], &pool );
+        CHECK( memcmp( &out[0], &pooled[0], TEST_SIZE ) == 0 );
+    }
+}
+
+/**
+ * Checks that textured flash frames over a flat no-flash frame transfer
+ * their detail only where the flash lights the scene: in flash shadows (the
+ * flash adds less than FLASH_SHADOW_THRESHOLD) and on clipped specular
+ * pixels the output keeps the no-flash pixel.
+ */
+static void TestMask( void )
+{
+    std::vector<uchar> ambient, flash( TEST_SIZE ), out( TEST_SIZE );
+    FillFlat( ambient, 100, 120, 136 );
+    FillRandom( &flash[0], TEST_LUMA, 5 );
+    memset( &flash[TEST_LUMA], 128, TEST_LUMA / 2 );
+
+    FlashFusion fusion;
+
+    // flash shadow: the flash adds 0 to 4 luma units
+    for ( int i = 0; i < TEST_LUMA; i++ )
+    {
+        flash[i] = 100 + ( flash[i] & 3 );
+    }
+    fusion.fuse( &ambient[0], &flash[0], TEST_WIDTH, TEST_HEIGHT, &out[0], 0 );
+    CHECK( memcmp( &out[0], &ambient[0], TEST_SIZE ) == 0 );
+
+    // lit by the flash: detail is transferred
+    FillRandom( &flash[0], TEST_LUMA, 5 );
+    for ( int i = 0; i < TEST_LUMA; i++ )
+    {
+        flash[i] = 160 + ( flash[i] & 31 );
+    }
+    fusion.fuse( &ambient[0], &flash[0], TEST_WIDTH, TEST_HEIGHT, &out[0], 0 );
+    CHECK( CountChanged( out, ambient, flash, 0, 255, true ) > TEST_LUMA / 2 );
+
+    // specular: clipped flash pixels keep the no-flash value, the rest get detail
+    FillRandom( &flash[0], TEST_LUMA, 5 );
+    for ( int i = 0; i < TEST_LUMA; i++ )
+    {
+        flash[i] = flash[i] & 1 ? 255 : 215 + ( flash[i] & 15 );
+    }
+    fusion.fuse( &ambient[0], &flash[0], TEST_WIDTH, TEST_HEIGHT, &out[0], 0 );
+    CHECK( CountChanged( out, ambient, flash, 255, 255, true ) == 0 );
+    CHECK( CountChanged( out, ambient, flash, 255, 255, false ) > TEST_LUMA / 4 );
+}
+
+int main( void )
+{
+    TestFlat();
+    TestMask();
+
+    return TestResult( "FlashFusionTest" );
+}
@@ -0,0 +1,113 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Host test of FocusSearch.
+ */
+
+#include <math.h>
+#include "TestCommon.h"
+#include "FocusSearch.h"
+
+#define TEST_NEAR_FOCUS 10.0f /**< Nearest lens position of the test lens (dioptres) */
+#define TEST_FAR_FOCUS  0.0f  /**< Farthest lens position of the test lens (dioptres) */
+#define TEST_CURVE_WIDTH 1.5f /**< Half width of the test focus curves (dioptres) */
+
+/**
+ * Runs a search on a synthetic focus curve: a peak at the given position on
+ * a constant background, with deterministic multiplicative noise.
+ * @param peak lens position of the peak (dioptres)
+ * @param noise relative noise amplitude
+ * @param current lens position at the start of the search
+ * @param probes receives the number of measured positions
+ * @return estimated peak position
+ */
+static float Search( float peak, float noise, float current, int & probes )
+{
+    FocusSearch search;
+    search.start( TEST_NEAR_FOCUS, TEST_FAR_FOCUS, current );
+
+    uint seed = 12345;
+    float position;
+    while ( search.next( position ) )
+    {
+        CHECK( position >= TEST_FAR_FOCUS && position <= TEST_NEAR_FOCUS );
+        float d = ( position - peak ) / TEST_CURVE_WIDTH;
+        seed = seed * 1103515245 + 12345;
+        float n = ( ( seed >> 16 ) & 0x7fff ) / 16383.5f - 1.0f;
+        search.report( ( 0.1f + 1.0f / ( 1.0f + d * d ) ) * ( 1.0f + noise * n ) );
+    }
+
+    CHECK( search.done() );
+    probes = search.probeCount();
+    return search.result();
+}
+
+/**
+ * Checks that the search converges to the peak of noise-free curves focused
+ * near, far and in the middle of the lens range, from either end of the range.
+ */
+static void TestPeaks( void )
+{
+    const float peaks[] = { 9.6f, 0.3f, 4.2f, 6.9f };
+    for ( int i = 0; i < ( int ) ( sizeof( peaks ) / sizeof( peaks[0] ) ); i++ )
+    {
+        for ( int start = 0; start < 2; start++ )
+        {
+            int probes;
+            float result = Search( peaks[i], 0.0f, start == 0 ? TEST_NEAR_FOCUS : TEST_FAR_FOCUS, probes );
+            printf( "peak %.2f from %s: %.3f after %d probes\n", peaks[i], start == 0 ? "near" : "far", result, probes );
+            CHECK( fabsf( result - peaks[i] ) < 0.1f );
+            CHECK( probes <= FOCUS_SEARCH_COARSE_STEPS + 2 * FOCUS_SEARCH_REFINE_LEVELS );
+        }
+    }
+}
+
+/**
+ * Checks that the search still lands close to the peak when the sharpness
+ * measurements carry 5% noise.
+ */
+static void TestNoise( void )
+{
+    const float peaks[] = { 9.6f, 0.3f, 4.2f };
+    for ( int i = 0; i < ( int ) ( sizeof( peaks ) / sizeof( peaks[0] ) ); i++ )
+    {
+        int probes;
+        float result = Search( peaks[i], 0.05f, TEST_FAR_FOCUS, probes );
+        printf( "noisy peak %.2f: %.3f after %d probes\n", peaks[i], result, probes );
+        CHECK( fabsf( result - peaks[i] ) < 0.5f );
+    }
+}
+
+int main( void )
+{
+    TestPeaks();
+    TestNoise();
+
+    return TestResult( "FocusSearchTest" );
+}
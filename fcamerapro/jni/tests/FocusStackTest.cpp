@@ -0,0 +1,178 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Host test of FocusStack.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "TestCommon.h"
+#include "FocusStack.h"
+#include "ThreadPool.h"
+
+#define TEST_WIDTH  320 /**< Test frame width */
+#define TEST_HEIGHT 240 /**< Test frame height */
+#define TEST_SIZE   ( TEST_WIDTH * TEST_HEIGHT * 3 / 2 ) /**< Test frame data size */
+#define TEST_MARGIN 64  /**< Distance from the focus boundary (luma pixels) where the blend has to be settled */
+
+/**
+ * Blurs a plane with a 5x5 box filter (clamped at the borders).
+ */
+static void BoxBlur( const uchar * src, uchar * dst, int width, int height )
+{
+    for ( int y = 0; y < height; y++ )
+    {
+        for ( int x = 0; x < width; x++ )
+        {
+            int sum = 0;
+            for ( int j = -2; j <= 2; j++ )
+            {
+                for ( int i = -2; i <= 2; i++ )
+                {
+                    int sx = std::min( std::max( x + i, 0 ), width - 1 );
+                    int sy = std::min( std::max( y + j, 0 ), height - 1 );
+                    sum += src[sy * width + sx];
+                }
+            }
+            dst[y * width + x] = ( uchar ) ( ( sum + 12 ) / 25 );
+        }
+    }
+}
+
+/**
+ * Renders a frame of a textured scene that is sharp in one half (left or
+ * right) and blurred in the other.
+ */
+static void RenderFrame( const uchar * sharp, const uchar * blurred, bool sharpLeft, uchar * frame )
+{
+    const int half[3] = { TEST_WIDTH / 2, TEST_WIDTH / 4, TEST_WIDTH / 4 };
+    const int widths[3] = { TEST_WIDTH, TEST_WIDTH / 2, TEST_WIDTH / 2 };
+    const int heights[3] = { TEST_HEIGHT, TEST_HEIGHT / 2, TEST_HEIGHT / 2 };
+    const int offsets[3] = { 0, TEST_WIDTH * TEST_HEIGHT, TEST_WIDTH * TEST_HEIGHT * 5 / 4 };
+
+    for ( int p = 0; p < 3; p++ )
+    {
+        for ( int y = 0; y < heights[p]; y++ )
+        {
+            for ( int x = 0; x < widths[p]; x++ )
+            {
+                int i = offsets[p] + y * widths[p] + x;
+                frame[i] = ( x < half[p] ) == sharpLeft ? sharp[i] : blurred[i];
+            }
+        }
+    }
+}
+
+/**
+ * Checks that the composite of two frames, each sharp in a different half,
+ * takes every plane of each half from the frame that is sharp there, away
+ * from the focus boundary; and that a thread pool gives the same result.
+ */
+static void TestHalves( void )
+{
+    std::vector<uchar> sharp( TEST_SIZE ), blurred( TEST_SIZE );
+    FillRandom( &sharp[0], TEST_SIZE, 7 );
+    BoxBlur( &sharp[0], &blurred[0], TEST_WIDTH, TEST_HEIGHT );
+    for ( int p = 0; p < 2; p++ )
+    {
+        int offset = TEST_WIDTH * TEST_HEIGHT * ( 4 + p ) / 4;
+        BoxBlur( &sharp[offset], &blurred[offset], TEST_WIDTH / 2, TEST_HEIGHT / 2 );
+    }
+
+    std::vector<uchar> left( TEST_SIZE ), right( TEST_SIZE );
+    RenderFrame( &sharp[0], &blurred[0], true, &left[0] );
+    RenderFrame( &sharp[0], &blurred[0], false, &right[0] );
+
+    // the frame that is sharp on the left comes second, so the order does not decide
+    const uchar * frames[2] = { &right[0], &left[0] };
+    std::vector<uchar> stacked( TEST_SIZE ), pooled( TEST_SIZE );
+    FocusStack stack;
+    stack.stack( frames, 2, TEST_WIDTH, TEST_HEIGHT, &stacked[0], 0 );
+
+    bool sharpLeft = true, sharpRight = true;
+    for ( int y = 0; y < TEST_HEIGHT; y++ )
+    {
+        for ( int x = 0; x < TEST_WIDTH / 2 - TEST_MARGIN; x++ )
+        {
+            int i = y * TEST_WIDTH + x, j = y * TEST_WIDTH + TEST_WIDTH - 1 - x;
+            sharpLeft = sharpLeft && stacked[i] == sharp[i];
+            sharpRight = sharpRight && stacked[j] == sharp[j];
+        }
+    }
+    CHECK( sharpLeft );
+    CHECK( sharpRight );
+
+    bool chromaLeft = true, chromaRight = true;
+    for ( int p = 0; p < 2; p++ )
+    {
+        const int offset = TEST_WIDTH * TEST_HEIGHT * ( 4 + p ) / 4;
+        const int width = TEST_WIDTH / 2;
+        for ( int y = 0; y < TEST_HEIGHT / 2; y++ )
+        {
+            for ( int x = 0; x < ( TEST_WIDTH / 2 - TEST_MARGIN ) / 2; x++ )
+            {
+                int i = offset + y * width + x, j = offset + y * width + width - 1 - x;
+                chromaLeft = chromaLeft && stacked[i] == sharp[i];
+                chromaRight = chromaRight && stacked[j] == sharp[j];
+            }
+        }
+    }
+    CHECK( chromaLeft );
+    CHECK( chromaRight );
+
+    ThreadPool pool( 3 );
+    stack.stack( frames, 2, TEST_WIDTH, TEST_HEIGHT, &pooled[0], &pool );
+    CHECK( memcmp( &stacked[0], &pooled[0], TEST_SIZE ) == 0 );
+}
+
+/**
+ * Checks that an empty stack leaves the output alone.
+ */
+static void TestEmpty( void )
+{
+    std::vector<uchar> output( TEST_SIZE, 77 );
+    FocusStack stack;
+    stack.stack( 0, 0, TEST_WIDTH, TEST_HEIGHT, &output[0], 0 );
+
+    bool untouched = true;
+    for ( int i = 0; i < TEST_SIZE; i++ )
+    {
+        untouched = untouched && output[i] == 77;
+    }
+    CHECK( untouched );
+}
+
+int main( void )
+{
+    TestHalves();
+    TestEmpty();
+
+    return TestResult( "FocusStackTest" );
+}
@@ -0,0 +1,137 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Host test of IntegralImage.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "TestCommon.h"
+#include "IntegralImage.h"
+#include "ThreadPool.h"
+
+#define TEST_RECTANGLES 3000 /**< Random rectangles checked per frame size */
+
+/**
+ * Sums a rectangle of a plane directly.
+ */
+static unsigned long long NaiveSum( const uchar * plane, int stride, int x0, int y0, int x1, int y1, bool squares )
+{
+    unsigned long long sum = 0;
+    for ( int y = y0; y < y1; y++ )
+    {
+        for ( int x = x0; x < x1; x++ )
+        {
+            uint v = plane[y * stride + x];
+            sum += squares ? v * v : v;
+        }
+    }
+    return sum;
+}
+
+/**
+ * Checks means and variances of random rectangles (partly outside the frame)
+ * against direct sums, on a frame of the given size. Odd sizes leave pixels
+ * for the scalar tail after the four pixel SIMD steps.
+ */
+static void TestFrame( int width, int height, ThreadPool * pool )
+{
+    const int isize = width * height;
+    const int cwidth = width >> 1, cheight = height >> 1;
+    std::vector<uchar> yuv( isize + 2 * ( isize >> 2 ) + 4 );
+    FillRandom( &yuv[0], ( int ) yuv.size(), width * 1000 + height );
+
+    IntegralImage integral;
+    integral.compute( &yuv[0], width, height, true, pool );
+    CHECK( integral.valid() );
+
+    const uchar * planes[IntegralImage::EPlaneCount] = { &yuv[0], &yuv[isize], &yuv[isize + ( isize >> 2 )] };
+    uint seed = width * 31 + height;
+    bool meansExact = true, variancesClose = true;
+
+    for ( int i = 0; i < TEST_RECTANGLES; i++ )
+    {
+        seed = seed * 1103515245 + 12345;
+        int x = ( int ) ( ( seed >> 8 ) % ( width + 4 ) ) - 2;
+        seed = seed * 1103515245 + 12345;
+        int y = ( int ) ( ( seed >> 8 ) % ( height + 4 ) ) - 2;
+        seed = seed * 1103515245 + 12345;
+        int w = ( int ) ( ( seed >> 8 ) % ( width + 2 ) ) + 1;
+        seed = seed * 1103515245 + 12345;
+        int h = ( int ) ( ( seed >> 8 ) % ( height + 2 ) ) + 1;
+
+        for ( int p = 0; p < IntegralImage::EPlaneCount; p++ )
+        {
+            // same clipping rules as IntegralImage, chroma rounded outwards
+            int x0 = std::max( x, 0 ), y0 = std::max( y, 0 );
+            int x1 = std::min( x + w, width ), y1 = std::min( y + h, height );
+            int stride = width;
+            if ( p != IntegralImage::EPlaneY )
+            {
+                x0 >>= 1;
+                y0 >>= 1;
+                x1 = std::min( ( x1 + 1 ) >> 1, cwidth );
+                y1 = std::min( ( y1 + 1 ) >> 1, cheight );
+                stride = cwidth;
+            }
+
+            float expected = 0.0f;
+            if ( x1 > x0 && y1 > y0 )
+            {
+                expected = ( float ) NaiveSum( planes[p], stride, x0, y0, x1, y1, false ) / ( ( x1 - x0 ) * ( y1 - y0 ) );
+            }
+            meansExact = meansExact && integral.getMean( ( IntegralImage::EPlane ) p, x, y, w, h ) == expected;
+
+            if ( p == IntegralImage::EPlaneY && x1 > x0 && y1 > y0 )
+            {
+                double count = ( x1 - x0 ) * ( y1 - y0 );
+                double mean = NaiveSum( planes[p], stride, x0, y0, x1, y1, false ) / count;
+                double variance = NaiveSum( planes[p], stride, x0, y0, x1, y1, true ) / count - mean * mean;
+                variancesClose = variancesClose && fabs( integral.getVariance( x, y, w, h ) - variance ) <= 1e-3 * ( 1.0 + variance );
+            }
+        }
+    }
+
+    CHECK( meansExact );
+    CHECK( variancesClose );
+}
+
+int main( void )
+{
+    ThreadPool pool( 3 );
+    const int sizes[][2] = { { 1, 1 }, { 3, 5 }, { 7, 3 }, { 37, 23 }, { 22, 14 }, { 641, 479 } };
+    for ( int i = 0; i < ( int ) ( sizeof( sizes ) / sizeof( sizes[0] ) ); i++ )
+    {
+        TestFrame( sizes[i][0], sizes[i][1], 0 );
+        TestFrame( sizes[i][0], sizes[i][1], &pool );
+    }
+
+    return TestResult( "IntegralImageTest" );
+}
@@ -0,0 +1,167 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Host test of MTBAligner.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "TestCommon.h"
+#include "MTBAligner.h"
+#include "ThreadPool.h"
+
+#define TEST_WIDTH  1024 /**< Test frame width */
+#define TEST_HEIGHT 768  /**< Test frame height */
+#define TEST_FRAMES 5    /**< Number of test frames */
+
+/**
+ * Frame offsets and exposure scales (the first frame is the reference)
+ */
+static const int sOffsetX[TEST_FRAMES] = { 0, 7, -13, 22, -40 };
+static const int sOffsetY[TEST_FRAMES] = { 0, -5, 9, -17, 31 };
+static const float sExposure[TEST_FRAMES] = { 1.0f, 0.25f, 1.5f, 0.5f, 0.75f };
+
+/**
+ * Gets the linear radiance of the test scene at a point.
+ */
+static float GetRadiance( float x, float y )
+{
+    int checker = (( int )( x / 64.0f ) ^ ( int )( y / 64.0f ) ) & 1;
+    return 0.5f + 0.2f * sinf( x * 0.013f ) * cosf( y * 0.011f ) + 0.15f * sinf( x * 0.051f + y * 0.03f )
+           + 0.1f * checker + 0.05f * sinf( x * 0.2f ) * sinf( y * 0.17f );
+}
+
+/**
+ * Renders a YUV420p frame of the scene: frame pixel (x, y) shows scene point
+ * (x - offsetX, y - offsetY), gamma encoded after the exposure scale.
+ */
+static void RenderFrame( std::vector<uchar> & frame, int offsetX, int offsetY, float exposure )
+{
+    frame.assign( TEST_WIDTH * TEST_HEIGHT * 3 / 2, 128 );
+    for ( int y = 0; y < TEST_HEIGHT; y++ )
+    {
+        for ( int x = 0; x < TEST_WIDTH; x++ )
+        {
+            float radiance = std::min( GetRadiance( x - offsetX, y - offsetY ) * exposure, 1.0f );
+            frame[y * TEST_WIDTH + x] = ( uchar )( 255.0f * powf( radiance, 1.0f / 2.2f ) + 0.5f );
+        }
+    }
+}
+
+/**
+ * Checks that differently exposed, translated frames are aligned to the
+ * reference, on the calling thread and on a thread pool, and that
+ * translating a frame by its offset restores the reference view.
+ */
+static void TestAlign( void )
+{
+    std::vector<std::vector<uchar> > frames( TEST_FRAMES );
+    std::vector<const uchar *> data( TEST_FRAMES );
+    for ( int i = 0; i < TEST_FRAMES; i++ )
+    {
+        RenderFrame( frames[i], sOffsetX[i], sOffsetY[i], sExposure[i] );
+        data[i] = &frames[i][0];
+    }
+
+    MTBAligner aligner;
+    ThreadPool pool( 3 );
+    int offsets[2 * TEST_FRAMES], pooledOffsets[2 * TEST_FRAMES];
+    aligner.align( &data[0], TEST_FRAMES, 0, TEST_WIDTH, TEST_HEIGHT, offsets, 0 );
+    aligner.align( &data[0], TEST_FRAMES, 0, TEST_WIDTH, TEST_HEIGHT, pooledOffsets, &pool );
+    for ( int i = 0; i < TEST_FRAMES; i++ )
+    {
+        CHECK( offsets[2 * i] == sOffsetX[i] && offsets[2 * i + 1] == sOffsetY[i] );
+        CHECK( pooledOffsets[2 * i] == offsets[2 * i] && pooledOffsets[2 * i + 1] == offsets[2 * i + 1] );
+    }
+
+    // the streaming interface gives the same offsets
+    aligner.setReference( data[0], TEST_WIDTH, TEST_HEIGHT );
+    for ( int i = 1; i < TEST_FRAMES; i++ )
+    {
+        int dx, dy;
+        aligner.alignToReference( data[i], dx, dy );
+        CHECK( dx == offsets[2 * i] && dy == offsets[2 * i + 1] );
+    }
+
+    // away from the replicated border the translated frame matches a frame rendered without offset
+    std::vector<uchar> expected;
+    RenderFrame( expected, 0, 0, sExposure[3] );
+    MTBAligner::Translate( &frames[3][0], TEST_WIDTH, TEST_HEIGHT, offsets[6], offsets[7] );
+    bool same = true;
+    for ( int y = 64; y < TEST_HEIGHT - 64; y++ )
+    {
+        for ( int x = 64; x < TEST_WIDTH - 64; x++ )
+        {
+            same = same && frames[3][y * TEST_WIDTH + x] == expected[y * TEST_WIDTH + x];
+        }
+    }
+    CHECK( same );
+}
+
+/**
+ * Checks the border replication and chroma offsets of a translation.
+ */
+static void TestTranslate( void )
+{
+    const int width = 64, height = 32;
+    std::vector<uchar> frame( width * height * 3 / 2 );
+    FillRandom( &frame[0], ( int ) frame.size(), 5 );
+    std::vector<uchar> original( frame );
+
+    MTBAligner::Translate( &frame[0], width, height, 4, -2 );
+    bool valid = true;
+    for ( int y = 0; y < height; y++ )
+    {
+        for ( int x = 0; x < width; x++ )
+        {
+            int sx = std::min( x + 4, width - 1 ), sy = std::max( y - 2, 0 );
+            valid = valid && frame[y * width + x] == original[sy * width + sx];
+        }
+    }
+    const uchar * cb = &frame[width * height];
+    const uchar * originalCb = &original[width * height];
+    for ( int y = 0; y < height / 2; y++ )
+    {
+        for ( int x = 0; x < width / 2; x++ )
+        {
+            int sx = std::min( x + 2, width / 2 - 1 ), sy = std::max( y - 1, 0 );
+            valid = valid && cb[y * width / 2 + x] == originalCb[sy * width / 2 + sx];
+        }
+    }
+    CHECK( valid );
+}
+
+int main( void )
+{
+    TestAlign();
+    TestTranslate();
+
+    return TestResult( "MTBAlignerTest" );
+}
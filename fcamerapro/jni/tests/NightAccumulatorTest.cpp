@@ -0,0 +1,176 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Host test of NightAccumulator.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "TestCommon.h"
+#include "NightAccumulator.h"
+#include "ThreadPool.h"
+
+#define TEST_WIDTH  128 /**< Test frame width */
+#define TEST_HEIGHT 96  /**< Test frame height */
+#define TEST_SIZE   ( TEST_WIDTH * TEST_HEIGHT * 3 / 2 ) /**< Test frame data size */
+
+/**
+ * Creates a YUV420p test scene: smooth shading with random texture.
+ */
+static std::vector<uchar> CreateScene( void )
+{
+    std::vector<uchar> scene( TEST_SIZE );
+    FillRandom( &scene[0], TEST_SIZE, 1 );
+    for ( int y = 0; y < TEST_HEIGHT; y++ )
+    {
+        for ( int x = 0; x < TEST_WIDTH; x++ )
+        {
+            uchar & v = scene[y * TEST_WIDTH + x];
+            v = ( uchar )( 40 + x + ( v & 63 ) );
+        }
+    }
+
+    return scene;
+}
+
+/**
+ * Checks that frames of constant value average back to that value, for the
+ * largest frame count too, and that frames beyond it are ignored.
+ */
+static void TestConstantFrames( void )
+{
+    std::vector<uchar> scene = CreateScene();
+    const int counts[] = { 2, 3, 7, 128, NIGHT_MAX_FRAMES };
+    for ( int i = 0; i < ( int )( sizeof( counts ) / sizeof( counts[0] ) ); i++ )
+    {
+        NightAccumulator accumulator;
+        accumulator.reset( TEST_WIDTH, TEST_HEIGHT );
+        std::vector<uchar> frame;
+        for ( int n = 0; n < counts[i]; n++ )
+        {
+            frame = scene;
+            accumulator.add( &frame[0], 0 );
+        }
+        CHECK( accumulator.getFrameCount() == counts[i] );
+
+        std::vector<uchar> result( TEST_SIZE );
+        accumulator.resolve( &result[0], 0 );
+        CHECK( result == scene );
+    }
+
+    // saturated samples stay at 255
+    NightAccumulator accumulator;
+    accumulator.reset( TEST_WIDTH, TEST_HEIGHT );
+    std::vector<uchar> white( TEST_SIZE, 255 ), frame;
+    for ( int n = 0; n < NIGHT_MAX_FRAMES; n++ )
+    {
+        frame = white;
+        accumulator.add( &frame[0], 0 );
+    }
+    frame = white;
+    CHECK( !accumulator.add( &frame[0], 0 ) );
+    std::vector<uchar> result( TEST_SIZE );
+    accumulator.resolve( &result[0], 0 );
+    CHECK( result == white );
+}
+
+/**
+ * Checks that averaging noisy frames reduces the noise, that samples far
+ * from the running mean are rejected and that the banded accumulation on a
+ * thread pool gives the same result.
+ */
+static void TestNoiseAndOutliers( void )
+{
+    std::vector<uchar> scene = CreateScene();
+    std::vector<uchar> noise( TEST_SIZE );
+    NightAccumulator single, banded;
+    single.reset( TEST_WIDTH, TEST_HEIGHT );
+    banded.reset( TEST_WIDTH, TEST_HEIGHT );
+    ThreadPool pool( 3 );
+
+    const int frameCount = 16;
+    long long frameError = 0;
+    for ( int n = 0; n < frameCount; n++ )
+    {
+        FillRandom( &noise[0], TEST_SIZE, 100 + n );
+        std::vector<uchar> frame( scene );
+        for ( int i = 0; i < TEST_SIZE; i++ )
+        {
+            int v = frame[i] + ( noise[i] & 15 ) - 8;
+            frame[i] = ( uchar ) std::min( std::max( v, 0 ), 255 );
+            frameError += abs( frame[i] - scene[i] );
+        }
+
+        // a bright object passing through the top-left corner of one frame
+        if ( n == frameCount / 2 )
+        {
+            for ( int y = 0; y < 16; y++ )
+            {
+                memset( &frame[y * TEST_WIDTH], 255, 16 );
+            }
+        }
+
+        std::vector<uchar> copy( frame );
+        single.add( &frame[0], 0 );
+        banded.add( &copy[0], &pool );
+    }
+
+    std::vector<uchar> result( TEST_SIZE ), bandedResult( TEST_SIZE );
+    single.resolve( &result[0], 0 );
+    banded.resolve( &bandedResult[0], &pool );
+    CHECK( result == bandedResult );
+
+    long long resultError = 0;
+    for ( int i = 0; i < TEST_SIZE; i++ )
+    {
+        resultError += abs( result[i] - scene[i] );
+    }
+    // the mean absolute error of a single frame is about 4
+    CHECK( resultError * 2 * frameCount < frameError );
+
+    // accepted, the object would raise the corner by 8 or more on average
+    int cornerError = 0;
+    for ( int y = 0; y < 16; y++ )
+    {
+        for ( int x = 0; x < 16; x++ )
+        {
+            cornerError += abs( result[y * TEST_WIDTH + x] - scene[y * TEST_WIDTH + x] );
+        }
+    }
+    CHECK( cornerError < 2 * 16 * 16 );
+}
+
+int main( void )
+{
+    TestConstantFrames();
+    TestNoiseAndOutliers();
+
+    return TestResult( "NightAccumulatorTest" );
+}
@@ -0,0 +1,262 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Host test of RawDevelop.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "TestCommon.h"
+#include "RawDevelop.h"
+#include "ThreadPool.h"
+
+#define TEST_WIDTH  64 /**< Test frame width */
+#define TEST_HEIGHT 48 /**< Test frame height */
+
+/**
+ * Color filter (0 - red, 1 - green, 2 - blue) per Bayer pattern, row and column parity
+ */
+static const int sFilter[4][2][2] = { { { 0, 1 }, { 1, 2 } }, { { 2, 1 }, { 1, 0 } }, { { 1, 0 }, { 2, 1 } },
+                                      { { 1, 2 }, { 0, 1 } } };
+
+/**
+ * Malvar-He-Cutler kernels (scaled by 8): green at red or blue, red or blue at
+ * green in a row of that color, red at blue and vice versa.
+ */
+static const float sGreenKernel[5][5] = { { 0, 0, -1, 0, 0 }, { 0, 0, 2, 0, 0 }, { -1, 2, 4, 2, -1 }, { 0, 0, 2, 0, 0 },
+                                          { 0, 0, -1, 0, 0 } };
+static const float sRowKernel[5][5] = { { 0, 0, 0.5f, 0, 0 }, { 0, -1, 0, -1, 0 }, { -1, 4, 5, 4, -1 }, { 0, -1, 0, -1, 0 },
+                                        { 0, 0, 0.5f, 0, 0 } };
+static const float sDiagonalKernel[5][5] = { { 0, 0, -1.5f, 0, 0 }, { 0, 2, 0, 2, 0 }, { -1.5f, 0, 6, 0, -1.5f },
+                                             { 0, 2, 0, 2, 0 }, { 0, 0, -1.5f, 0, 0 } };
+
+/**
+ * Gets a normalized sample with the edges mirrored.
+ */
+static int GetSample( const std::vector<int> & samples, int x, int y )
+{
+    y = y < 0 ? -y : ( y >= TEST_HEIGHT ? 2 * ( TEST_HEIGHT - 1 ) - y : y );
+    x = x < 0 ? -x : ( x >= TEST_WIDTH ? 2 * ( TEST_WIDTH - 1 ) - x : x );
+    return samples[y * TEST_WIDTH + x];
+}
+
+/**
+ * Applies a (transposed) kernel at a pixel.
+ */
+static float Convolve( const std::vector<int> & samples, const float kernel[5][5], int x, int y, bool transpose )
+{
+    float sum = 0.0f;
+    for ( int i = 0; i < 5; i++ )
+    {
+        for ( int j = 0; j < 5; j++ )
+        {
+            sum += ( transpose ? kernel[j][i] : kernel[i][j] ) * GetSample( samples, x + j - 2, y + i - 2 );
+        }
+    }
+
+    return sum / 8.0f;
+}
+
+/**
+ * Maps a 12-bit linear value to an sRGB byte.
+ */
+static int EncodeSRGB( float value )
+{
+    float v = std::min( std::max( floorf( value + 0.5f ), 0.0f ), ( float ) RAW_WORKING_WHITE ) / RAW_WORKING_WHITE;
+    v = v <= 0.0031308f ? 12.92f * v : 1.055f * powf( v, 1.0f / 2.4f ) - 0.055f;
+    return ( int )( v * 255.0f + 0.5f );
+}
+
+/**
+ * Gets the metadata of an identity development (no black level, unit gains and matrix).
+ */
+static RawDevelop::Metadata GetIdentityMetadata( int bayerPattern )
+{
+    RawDevelop::Metadata metadata;
+    metadata.width = TEST_WIDTH;
+    metadata.height = TEST_HEIGHT;
+    metadata.bayerPattern = bayerPattern;
+    metadata.blackLevel = 0;
+    metadata.whiteLevel = RAW_WORKING_WHITE;
+    for ( int i = 0; i < 3; i++ )
+    {
+        metadata.wbGains[i] = 1.0f;
+    }
+    for ( int i = 0; i < 9; i++ )
+    {
+        metadata.colorMatrix[i] = i % 4 == 0 ? 1.0f : 0.0f;
+    }
+
+    return metadata;
+}
+
+/**
+ * Compares the gradient-corrected demosaic with a floating point evaluation
+ * of the Malvar-He-Cutler kernels on random data.
+ */
+static void TestGradientReference( void )
+{
+    std::vector<ushort> raw( TEST_WIDTH * TEST_HEIGHT );
+    srand( 3 );
+    for ( int i = 0; i < TEST_WIDTH * TEST_HEIGHT; i++ )
+    {
+        raw[i] = rand() % ( RAW_WORKING_WHITE + 1 );
+    }
+
+    // normalization of black 0 and white 4095: samples shifted to 16 bits and scaled back
+    uint scale = ( uint )( RAW_WORKING_WHITE * 65536.0f / ( RAW_WORKING_WHITE << 4 ) + 0.5f );
+    std::vector<int> samples( TEST_WIDTH * TEST_HEIGHT );
+    for ( int i = 0; i < TEST_WIDTH * TEST_HEIGHT; i++ )
+    {
+        samples[i] = std::min(( int )((( uint ) raw[i] << 4 ) * scale >> 16 ), RAW_WORKING_WHITE );
+    }
+
+    int worst = 0;
+    for ( int pattern = 0; pattern < 4; pattern++ )
+    {
+        RawDevelop::Metadata metadata = GetIdentityMetadata( pattern );
+        std::vector<uchar> yuv( TEST_WIDTH * TEST_HEIGHT * 3 / 2 );
+        RawDevelop develop;
+        develop.develop( &raw[0], TEST_WIDTH, metadata, RawDevelop::EDemosaicGradient, &yuv[0], 0 );
+
+        for ( int y = 0; y < TEST_HEIGHT; y++ )
+        {
+            for ( int x = 0; x < TEST_WIDTH; x++ )
+            {
+                int filter = sFilter[pattern][y & 1][x & 1];
+                float rgb[3];
+                if ( filter == 1 )
+                {
+                    int rowFilter = sFilter[pattern][y & 1][( x & 1 ) ^ 1];
+                    rgb[1] = GetSample( samples, x, y );
+                    rgb[rowFilter] = Convolve( samples, sRowKernel, x, y, false );
+                    rgb[2 - rowFilter] = Convolve( samples, sRowKernel, x, y, true );
+                }
+                else
+                {
+                    rgb[filter] = GetSample( samples, x, y );
+                    rgb[1] = Convolve( samples, sGreenKernel, x, y, false );
+                    rgb[2 - filter] = Convolve( samples, sDiagonalKernel, x, y, false );
+                }
+
+                int luma = ( 77 * EncodeSRGB( rgb[0] ) + 150 * EncodeSRGB( rgb[1] ) + 29 * EncodeSRGB( rgb[2] ) + 128 ) >> 8;
+                worst = std::max( worst, abs( luma - yuv[y * TEST_WIDTH + x] ) );
+            }
+        }
+    }
+
+    CHECK( worst == 0 );
+}
+
+/**
+ * Checks that a uniform gray frame develops into a uniform neutral image.
+ */
+static void TestFlatField( void )
+{
+    std::vector<ushort> raw( TEST_WIDTH * TEST_HEIGHT, 2048 );
+    for ( int pattern = 0; pattern < 4; pattern++ )
+    {
+        for ( int demosaic = RawDevelop::EDemosaicBilinear; demosaic <= RawDevelop::EDemosaicGradient; demosaic++ )
+        {
+            RawDevelop::Metadata metadata = GetIdentityMetadata( pattern );
+            std::vector<uchar> yuv( TEST_WIDTH * TEST_HEIGHT * 3 / 2 );
+            RawDevelop develop;
+            develop.develop( &raw[0], TEST_WIDTH, metadata, ( RawDevelop::EDemosaic ) demosaic, &yuv[0], 0 );
+
+            int gray = EncodeSRGB( 2048.0f );
+            int luma = ( 77 * gray + 150 * gray + 29 * gray + 128 ) >> 8;
+            bool flat = true;
+            for ( int i = 0; i < TEST_WIDTH * TEST_HEIGHT; i++ )
+            {
+                flat = flat && yuv[i] == luma;
+            }
+            for ( int i = TEST_WIDTH * TEST_HEIGHT; i < TEST_WIDTH * TEST_HEIGHT * 3 / 2; i++ )
+            {
+                flat = flat && abs( yuv[i] - 128 ) <= 1;
+            }
+            CHECK( flat );
+        }
+    }
+}
+
+/**
+ * Checks that a development in bands on a thread pool, from a padded raw
+ * frame and from a dump round trip gives the same image.
+ */
+static void TestBandsAndDump( void )
+{
+    const int stride = TEST_WIDTH + 16;
+    std::vector<ushort> raw( stride * TEST_HEIGHT );
+    srand( 7 );
+    for ( int i = 0; i < stride * TEST_HEIGHT; i++ )
+    {
+        raw[i] = 64 + rand() % 960;
+    }
+
+    float rawToRGB[9] = { 3.2f, -0.8f, -0.4f, -0.3f, 1.5f, -0.2f, 0.0f, -0.5f, 2.1f };
+    RawDevelop::Metadata metadata = GetIdentityMetadata( RawDevelop::EBayerGRBG );
+    metadata.blackLevel = 64;
+    metadata.whiteLevel = 1023;
+    RawDevelop::SplitColorMatrix( rawToRGB, metadata.wbGains, metadata.colorMatrix );
+
+    ThreadPool pool( 3 );
+    const char * dumpName = "RawDevelopTest.raw";
+    CHECK( RawDevelop::WriteDump( dumpName, &raw[0], stride, metadata ) );
+    RawDevelop::Metadata dumped;
+    std::vector<ushort> dumpedRaw;
+    CHECK( RawDevelop::ReadDump( dumpName, dumped, dumpedRaw ) );
+    remove( dumpName );
+    CHECK( dumpedRaw.size() == TEST_WIDTH * TEST_HEIGHT );
+    if ( dumpedRaw.size() != TEST_WIDTH * TEST_HEIGHT )
+    {
+        return;
+    }
+
+    for ( int demosaic = RawDevelop::EDemosaicBilinear; demosaic <= RawDevelop::EDemosaicGradient; demosaic++ )
+    {
+        std::vector<uchar> single( TEST_WIDTH * TEST_HEIGHT * 3 / 2 ), banded( single.size() ), fromDump( single.size() );
+        RawDevelop develop;
+        develop.develop( &raw[0], stride, metadata, ( RawDevelop::EDemosaic ) demosaic, &single[0], 0 );
+        develop.develop( &raw[0], stride, metadata, ( RawDevelop::EDemosaic ) demosaic, &banded[0], &pool );
+        develop.develop( &dumpedRaw[0], TEST_WIDTH, dumped, ( RawDevelop::EDemosaic ) demosaic, &fromDump[0], 0 );
+        CHECK( single == banded );
+        CHECK( single == fromDump );
+    }
+}
+
+int main( void )
+{
+    TestGradientReference();
+    TestFlatField();
+    TestBandsAndDump();
+
+    return TestResult( "RawDevelopTest" );
+}
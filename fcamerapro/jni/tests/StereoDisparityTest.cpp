@@ -0,0 +1,201 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Host test of StereoDisparity.
+ */
+
+#include <algorithm>
+#include <vector>
+#include "TestCommon.h"
+#include "StereoDisparity.h"
+#include "ThreadPool.h"
+
+#define TEST_WIDTH  640 /**< Test frame width (both views) */
+#define TEST_HEIGHT 240 /**< Test frame height */
+#define TEST_MARGIN ( 2 * STEREO_DOWNSAMPLE * STEREO_MAX_DISPARITY ) /**< Texture margin in pixels */
+
+#define TEST_BACKGROUND_DISPARITY 6  /**< Background disparity in matching pixels */
+#define TEST_OBJECT_DISPARITY     20 /**< Object disparity in matching pixels */
+
+/**
+ * Is a left view pixel covered by the near object?
+ */
+static bool IsObject( int x, int y )
+{
+    return x >= 120 && x < 200 && y >= 60 && y < 180;
+}
+
+/**
+ * Renders a side-by-side stereo frame of a textured background plane with a
+ * textured object in front of it. The right view sees the scene point of
+ * left view pixel x at x - disparity.
+ * @param frame destination frame luma
+ * @param object true to place the object in front of the background
+ */
+static void RenderFrame( std::vector<uchar> & frame, bool object )
+{
+    const int viewWidth = TEST_WIDTH / 2;
+    const int textureWidth = viewWidth + TEST_MARGIN;
+    std::vector<uchar> background( textureWidth * TEST_HEIGHT ), foreground( textureWidth * TEST_HEIGHT );
+    FillRandom( &background[0], background.size(), 5 );
+    FillRandom( &foreground[0], foreground.size(), 6 );
+
+    const int backgroundShift = STEREO_DOWNSAMPLE * TEST_BACKGROUND_DISPARITY;
+    const int objectShift = STEREO_DOWNSAMPLE * TEST_OBJECT_DISPARITY;
+    frame.resize( TEST_WIDTH * TEST_HEIGHT );
+    for ( int y = 0; y < TEST_HEIGHT; y++ )
+    {
+        for ( int x = 0; x < viewWidth; x++ )
+        {
+            // texture coordinates of the left view pixel
+            const uchar * t = &background[y * textureWidth + TEST_MARGIN / 2];
+            frame[y * TEST_WIDTH + x] = object && IsObject( x, y ) ? foreground[y * textureWidth + x] : t[x];
+
+            // the right view pixel shows the left view pixel x + disparity
+            int xl = x + objectShift;
+            bool onObject = object && IsObject( xl, y );
+            frame[y * TEST_WIDTH + viewWidth + x] = onObject ? foreground[y * textureWidth + xl] : t[x + backgroundShift];
+        }
+    }
+}
+
+/**
+ * Gets a pixel of a disparity map.
+ */
+static int GetDisparity( const std::vector<uchar> & map, int x, int y )
+{
+    return map[y * ( TEST_WIDTH / 2 / STEREO_DOWNSAMPLE ) + x];
+}
+
+/**
+ * Checks the map size and that a fronto-parallel plane gives its disparity
+ * almost everywhere.
+ */
+static void TestPlane( void )
+{
+    std::vector<uchar> frame;
+    RenderFrame( frame, false );
+
+    StereoDisparity stereo;
+    int width, height;
+    stereo.getSize( width, height );
+    CHECK( width == 0 );
+
+    stereo.compute( &frame[0], TEST_WIDTH, TEST_HEIGHT, 0 );
+    stereo.getSize( width, height );
+    CHECK( width == TEST_WIDTH / 2 / STEREO_DOWNSAMPLE );
+    CHECK( height == TEST_HEIGHT / STEREO_DOWNSAMPLE );
+
+    std::vector<uchar> map( width * height );
+    CHECK( !stereo.copyMap( &map[0], width * height - 1 ) );
+    CHECK( stereo.copyMap( &map[0], width * height ) );
+
+    // the right view has no match for the leftmost pixels of the left view
+    int correct = 0, count = 0;
+    for ( int y = 0; y < height; y++ )
+    {
+        for ( int x = TEST_BACKGROUND_DISPARITY; x < width; x++ )
+        {
+            correct += GetDisparity( map, x, y ) == TEST_BACKGROUND_DISPARITY;
+            count++;
+        }
+    }
+    CHECK( correct * 100 > count * 98 );
+}
+
+/**
+ * Checks that an object in front of the background is found at its
+ * disparity, that the background it hides from the right view is marked
+ * invalid, that the rest of the background keeps its disparity, and that the
+ * map computed on a thread pool is the same.
+ */
+static void TestObject( void )
+{
+    std::vector<uchar> frame;
+    RenderFrame( frame, true );
+
+    StereoDisparity stereo;
+    ThreadPool pool( 3 );
+    int width, height;
+    stereo.compute( &frame[0], TEST_WIDTH, TEST_HEIGHT, 0 );
+    stereo.getSize( width, height );
+    std::vector<uchar> map( width * height ), pooledMap( width * height );
+    CHECK( stereo.copyMap( &map[0], width * height ) );
+    stereo.compute( &frame[0], TEST_WIDTH, TEST_HEIGHT, &pool );
+    CHECK( stereo.copyMap( &pooledMap[0], width * height ) );
+    CHECK( map == pooledMap );
+
+    // object interior, away from the window sized borders
+    const int s = STEREO_DOWNSAMPLE, r = STEREO_WINDOW_RADIUS;
+    int correct = 0, count = 0;
+    for ( int y = 60 / s + r; y < 180 / s - r; y++ )
+    {
+        for ( int x = 120 / s + r; x < 200 / s - r; x++ )
+        {
+            correct += GetDisparity( map, x, y ) == TEST_OBJECT_DISPARITY;
+            count++;
+        }
+    }
+    CHECK( correct * 100 > count * 98 );
+
+    // background hidden behind the object in the right view fails the left-right check
+    const int occludedBegin = 120 - STEREO_DOWNSAMPLE * ( TEST_OBJECT_DISPARITY - TEST_BACKGROUND_DISPARITY );
+    int invalid = 0;
+    count = 0;
+    for ( int y = 60 / s + r; y < 180 / s - r; y++ )
+    {
+        for ( int x = occludedBegin / s + r; x < 120 / s - r; x++ )
+        {
+            invalid += GetDisparity( map, x, y ) == STEREO_INVALID_DISPARITY;
+            count++;
+        }
+    }
+    CHECK( invalid * 10 > count * 9 );
+
+    // background visible in both views never takes the object disparity
+    int wrong = 0;
+    for ( int y = 0; y < height; y++ )
+    {
+        for ( int x = TEST_BACKGROUND_DISPARITY; x < width; x++ )
+        {
+            int d = GetDisparity( map, x, y );
+            bool near = x >= 120 / s - TEST_OBJECT_DISPARITY - r && x < 200 / s + r && y >= 60 / s - r && y < 180 / s + r;
+            wrong += !near && d != TEST_BACKGROUND_DISPARITY && d != STEREO_INVALID_DISPARITY;
+        }
+    }
+    CHECK( wrong * 100 < width * height );
+}
+
+int main( void )
+{
+    TestPlane();
+    TestObject();
+
+    return TestResult( "StereoDisparityTest" );
+}
@@ -0,0 +1,84 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _TEST_COMMON_H
+#define _TEST_COMMON_H
+
+/**
+ * @file
+ * Minimal check and timing helpers of the host tests.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "Common.h"
+
+/**
+ * Number of failed checks of the test program
+ */
+static int sFailedChecks = 0;
+
+/**
+ * Checks a condition, reports it with its location if it does not hold.
+ */
+#define CHECK(cond) \
+    do \
+    { \
+        if ( !( cond ) ) \
+        { \
+            fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond ); \
+            sFailedChecks++; \
+        } \
+    } while ( 0 )
+
+/**
+ * Reports the result of the test program.
+ * @param name test program name
+ * @return process exit code (0 if all checks passed)
+ */
+static inline int TestResult( const char * name )
+{
+    printf( "%s: %s\n", name, sFailedChecks == 0 ? "passed" : "FAILED" );
+    return sFailedChecks == 0 ? 0 : 1;
+}
+
+/**
+ * Fills a buffer with reproducible pseudo-random bytes.
+ * @param data buffer
+ * @param count number of bytes
+ * @param seed generator seed
+ */
+static inline void FillRandom( uchar * data, int count, uint seed )
+{
+    for ( int i = 0; i < count; i++ )
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = ( uchar )( seed >> 16 );
+    }
+}
+
+#endif
@@ -0,0 +1,143 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Host test of ToneMapper.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "TestCommon.h"
+#include "ToneMapper.h"
+#include "ThreadPool.h"
+
+#define TEST_WIDTH  320 /**< Test image width */
+#define TEST_HEIGHT 240 /**< Test image height */
+#define TEST_SIZE   ( TEST_WIDTH * TEST_HEIGHT * 3 / 2 ) /**< Test output data size */
+
+/**
+ * Encodes a linear RGB value as an RGBE pixel (same encoding as RadianceMerge).
+ */
+static void EncodeRGBE( float r, float g, float b, uchar * rgbe )
+{
+    float v = std::max( r, std::max( g, b ) );
+    int e;
+    float scale = frexpf( v, &e ) * 256.0f / v;
+    rgbe[0] = (uchar) ( r * scale );
+    rgbe[1] = (uchar) ( g * scale );
+    rgbe[2] = (uchar) ( b * scale );
+    rgbe[3] = (uchar) ( e + 128 );
+}
+
+/**
+ * Checks that a uniform gray radiance map maps to a uniform gray frame with
+ * both operators (both map the scene maximum to display white, so the level
+ * itself is not checked).
+ */
+static void TestConstant( void )
+{
+    std::vector<uchar> rgbe( TEST_WIDTH * TEST_HEIGHT * 4 );
+    for ( int i = 0; i < TEST_WIDTH * TEST_HEIGHT; i++ )
+    {
+        EncodeRGBE( 0.25f, 0.25f, 0.25f, &rgbe[i * 4] );
+    }
+
+    ToneMapper mapper;
+    std::vector<uchar> yuv( TEST_SIZE );
+    for ( int op = ToneMapper::EOperatorGlobal; op <= ToneMapper::EOperatorLocal; op++ )
+    {
+        mapper.map( (ToneMapper::EOperator) op, &rgbe[0], TEST_WIDTH, TEST_HEIGHT, &yuv[0], 0 );
+
+        bool uniform = true;
+        for ( int i = 1; i < TEST_WIDTH * TEST_HEIGHT; i++ )
+        {
+            uniform = uniform && yuv[i] == yuv[0];
+        }
+        CHECK( uniform );
+
+        bool neutral = true;
+        for ( int i = TEST_WIDTH * TEST_HEIGHT; i < TEST_SIZE; i++ )
+        {
+            neutral = neutral && abs( yuv[i] - 128 ) <= 1;
+        }
+        CHECK( neutral );
+    }
+}
+
+/**
+ * Checks that a horizontal radiance ramp over four decades maps to luma that
+ * does not decrease along the rows, with both operators, and that running on
+ * a thread pool gives the same frame as the calling thread. The local operator
+ * slices its base layer from a coarse grid and may step back by one code value.
+ */
+static void TestMonotonic( void )
+{
+    std::vector<uchar> rgbe( TEST_WIDTH * TEST_HEIGHT * 4 );
+    for ( int y = 0; y < TEST_HEIGHT; y++ )
+    {
+        for ( int x = 0; x < TEST_WIDTH; x++ )
+        {
+            float v = powf( 10000.0f, (float) x / ( TEST_WIDTH - 1 ) ) / 1000.0f;
+            EncodeRGBE( v, v, v, &rgbe[( y * TEST_WIDTH + x ) * 4] );
+        }
+    }
+
+    ToneMapper mapper;
+    ThreadPool pool( 3 );
+    std::vector<uchar> yuv( TEST_SIZE ), pooled( TEST_SIZE );
+    for ( int op = ToneMapper::EOperatorGlobal; op <= ToneMapper::EOperatorLocal; op++ )
+    {
+        mapper.map( (ToneMapper::EOperator) op, &rgbe[0], TEST_WIDTH, TEST_HEIGHT, &yuv[0], 0 );
+
+        int tolerance = op == ToneMapper::EOperatorLocal ? 1 : 0;
+        bool monotonic = true;
+        for ( int y = 0; y < TEST_HEIGHT; y++ )
+        {
+            const uchar * row = &yuv[y * TEST_WIDTH];
+            for ( int x = 1; x < TEST_WIDTH; x++ )
+            {
+                monotonic = monotonic && row[x] + tolerance >= row[x - 1];
+            }
+        }
+        CHECK( monotonic );
+        CHECK( yuv[0] + 64 < yuv[TEST_WIDTH - 1] );
+
+        mapper.map( (ToneMapper::EOperator) op, &rgbe[0], TEST_WIDTH, TEST_HEIGHT, &pooled[0], &pool );
+        CHECK( memcmp( &yuv[0], &pooled[0], TEST_SIZE ) == 0 );
+    }
+}
+
+int main( void )
+{
+    TestConstant();
+    TestMonotonic();
+
+    return TestResult( "ToneMapperTest" );
+}
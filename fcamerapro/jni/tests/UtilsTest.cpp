@@ -0,0 +1,199 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Host accuracy test and benchmark of the color temperature estimation in
+ * Utils.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "TestCommon.h"
+#include "HPT.h"
+#include "Utils.h"
+
+#define TEST_BENCHMARK_COLORS 4096 /**< Number of colors of the benchmark */
+#define TEST_BENCHMARK_RUNS   20   /**< Number of benchmark runs */
+
+/**
+ * Reference color temperature estimation: the sRGB transfer function,
+ * D-illuminant white point and McCamy-style fit evaluated with libm in
+ * double precision, without tables.
+ */
+static double GetReferenceTemparature( double temp, int y, int cb, int cr )
+{
+    static const double prim[9] = { 1.939394, 0.500000, 2.500000, 1.000000, 1.000000, 1.000000, 0.090909, 0.166667, 13.166667 };
+    static const double invprim[9] = { 0.689157, -0.326908, -0.106024, -0.693173, 1.341633, 0.029719, 0.004016, -0.014726, 0.076305 };
+
+    cb -= 128;
+    cr -= 128;
+    double rgb[3] = { ( y + 1.402 * cr ) / 255.0, ( y - 0.34414 * cb - 0.71414 * cr ) / 255.0, ( y + 1.722 * cb ) / 255.0 };
+    for ( int i = 0; i < 3; i++ )
+    {
+        double v = std::min( std::max( rgb[i], 0.0 ), 1.0 );
+        rgb[i] = v <= 0.04045 ? v / 12.92 : pow(( v + 0.055 ) / 1.055, 2.4 );
+    }
+
+    double wxc;
+    if ( temp < 7000.0 )
+    {
+        wxc = -4.6070e9 / ( temp * temp * temp ) + 2.9678e6 / ( temp * temp ) + 0.09911e3 / temp + 0.244063;
+    }
+    else
+    {
+        wxc = -2.0064e9 / ( temp * temp * temp ) + 1.9018e6 / ( temp * temp ) + 0.24748e3 / temp + 0.237040;
+    }
+    double wyc = -3.0 * ( wxc * wxc ) + 2.870 * wxc - 0.275;
+    double w[3] = { wxc / wyc, 1.0, ( 1 - wxc - wyc ) / wyc };
+
+    double xyz[3];
+    for ( int j = 0; j < 3; j++ )
+    {
+        xyz[j] = 0.0;
+        for ( int i = 0; i < 3; i++ )
+        {
+            double scale = invprim[i * 3] * w[0] + invprim[i * 3 + 1] * w[1] + invprim[i * 3 + 2] * w[2];
+            xyz[j] += prim[j * 3 + i] * rgb[i] * scale;
+        }
+    }
+
+    double cx = xyz[0] / ( xyz[0] + xyz[1] + xyz[2] );
+    double cy = xyz[1] / ( xyz[0] + xyz[1] + xyz[2] );
+    double n = ( cx - 0.3366 ) / ( cy - 0.1735 );
+    return -949.86315 + 6253.80338 * exp( -n / 0.92159 ) + 28.70599 * exp( -n / 0.20039 ) + 0.00004 * exp( -n / 0.07125 );
+}
+
+/**
+ * Checks single and batch estimates against the reference over a YCbCr grid
+ * for several source temperatures, issued in alternating order.
+ */
+static void TestAccuracy( void )
+{
+    static const int srcTemps[] = { 4000, 5000, 6500, 8000, 10000 };
+    const int srcTempCount = sizeof( srcTemps ) / sizeof( srcTemps[0] );
+
+    std::vector<float> y, cb, cr;
+    for ( int ly = 24; ly <= 232; ly += 16 )
+    {
+        for ( int lcb = 64; lcb <= 192; lcb += 4 )
+        {
+            for ( int lcr = 64; lcr <= 192; lcr += 4 )
+            {
+                y.push_back( ly );
+                cb.push_back( lcb );
+                cr.push_back( lcr );
+            }
+        }
+    }
+    const int count = y.size();
+
+    std::vector<std::vector<int> > batch( srcTempCount, std::vector<int>( count ) );
+    for ( int t = 0; t < srcTempCount; t++ )
+    {
+        GetColorTemparatureYCbCrBatch( srcTemps[t], &y[0], &cb[0], &cr[0], &batch[t][0], count );
+    }
+
+    double maxError = 0.0, sumError = 0.0;
+    int inRange = 0, batchMismatches = 0;
+    for ( int i = 0; i < count; i++ )
+    {
+        // alternate the source temperature from call to call
+        for ( int t = 0; t < srcTempCount; t++ )
+        {
+            int single = GetColorTemparatureYCbCr( srcTemps[t], ( int ) y[i], ( int ) cb[i], ( int ) cr[i] );
+            // far outside the fit range the estimates grow exponentially, compare them only inside
+            double reference = GetReferenceTemparature( srcTemps[t], ( int ) y[i], ( int ) cb[i], ( int ) cr[i] );
+            if ( reference >= 2000.0 && reference <= 20000.0 )
+            {
+                batchMismatches += abs( single - batch[t][i] ) > 1;
+
+                double e = fabs( single - reference ) / reference;
+                maxError = std::max( maxError, e );
+                sumError += e;
+                inRange++;
+            }
+        }
+    }
+
+    printf( "Utils: %d estimates in 2000-20000K, relative error mean %.2e max %.2e\n", inRange, sumError / inRange, maxError );
+    CHECK( inRange > count );
+    CHECK( batchMismatches == 0 );
+    CHECK( sumError / inRange < 1e-3 );
+    CHECK( maxError < 1e-2 );
+}
+
+/**
+ * Times the single and batch estimates of a zone grid sized array.
+ */
+static void Benchmark( void )
+{
+    std::vector<uchar> data( 3 * TEST_BENCHMARK_COLORS );
+    FillRandom( &data[0], data.size(), 11 );
+
+    std::vector<float> y( TEST_BENCHMARK_COLORS ), cb( TEST_BENCHMARK_COLORS ), cr( TEST_BENCHMARK_COLORS );
+    for ( int i = 0; i < TEST_BENCHMARK_COLORS; i++ )
+    {
+        y[i] = data[3 * i];
+        cb[i] = 96 + data[3 * i + 1] / 4;
+        cr[i] = 96 + data[3 * i + 2] / 4;
+    }
+
+    std::vector<int> temps( TEST_BENCHMARK_COLORS );
+    int checksum = 0;
+    Timer timer;
+
+    timer.tic();
+    for ( int k = 0; k < TEST_BENCHMARK_RUNS; k++ )
+    {
+        for ( int i = 0; i < TEST_BENCHMARK_COLORS; i++ )
+        {
+            checksum += GetColorTemparatureYCbCr( 6500, ( int ) y[i], ( int ) cb[i], ( int ) cr[i] );
+        }
+    }
+    double singleTime = timer.toc();
+
+    timer.tic();
+    for ( int k = 0; k < TEST_BENCHMARK_RUNS; k++ )
+    {
+        GetColorTemparatureYCbCrBatch( 6500, &y[0], &cb[0], &cr[0], &temps[0], TEST_BENCHMARK_COLORS );
+        checksum += temps[k];
+    }
+    double batchTime = timer.toc();
+
+    printf( "Utils: %d colors x %d, single %.2f ms, batch %.2f ms (checksum %d)\n", TEST_BENCHMARK_COLORS, TEST_BENCHMARK_RUNS,
+            singleTime, batchTime, checksum );
+}
+
+int main( void )
+{
+    TestAccuracy();
+    Benchmark();
+
+    return TestResult( "UtilsTest" );
+}
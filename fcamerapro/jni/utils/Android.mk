@@ -31,22 +31,21 @@ LOCAL_CFLAGS := -Wno-write-strings $(OPENGLES_DEF)
 # with the "-l" prefix.
 
 LOCAL_LDLIBS := \
-     -llog $(OPENGLES_LIB) -lfastcv
+     -llog $(OPENGLES_LIB)
 
-LOCAL_MODULE    := libfastcvUtils
-LOCAL_CFLAGS    := -Werror
+LOCAL_MODULE    := libsampleUtils
+LOCAL_CFLAGS    += -Werror
 LOCAL_SRC_FILES := \
 	FPSCounter.cpp \
 	CameraRendererRGB565GL2.cpp \
 	CameraUtil.cpp \
 	FastCVSampleRenderer.cpp \
-	FastCVUtil.cpp
+	FastCVUtil.cpp \
+	../ColorConversion.cpp
 
-LOCAL_STATIC_LIBRARIES := libfastcv
 LOCAL_SHARED_LIBRARIES := liblog libGLESv2
-LOCAL_C_INCLUDES += $(JNI_DIR)/fastcv
 LOCAL_C_INCLUDES += $(UTILS_DIR)
-#LOCAL_C_INCLUDES += $(JNI_DIR)						
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..						
                     
 include $(BUILD_STATIC_LIBRARY)
 
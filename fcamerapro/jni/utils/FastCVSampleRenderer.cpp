@@ -14,12 +14,13 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <stdlib.h>
+#include <malloc.h>
 #include <android/log.h>
 #include <time.h>
 #include <pthread.h>
-#include <fastcv/fastcv.h>
 
 #include "FastCVSampleRenderer.h"
+#include "ColorConversion.h"
 #include "CameraRendererRGB565GL2.h"
 #include "FPSCounter.h"
 
@@ -99,7 +100,7 @@ uint8_t* getRenderBuffer( uint32_t w, uint32_t h )
    {
       if( state.renderBufRGB565 != NULL )
       {
-         fcvMemFree( state.renderBufRGB565 );
+         free( state.renderBufRGB565 );
          state.renderBufRGB565 = NULL;
          state.renderBufSize = 0;
          state.renderBufWidth = 0;
@@ -111,7 +112,7 @@ uint8_t* getRenderBuffer( uint32_t w, uint32_t h )
    if( state.renderBufRGB565 == NULL )
    {
       state.renderBufSize = w * h * 2;
-      state.renderBufRGB565 = (uint8_t*) fcvMemAlloc(state.renderBufSize, 16);
+      state.renderBufRGB565 = (uint8_t*) memalign(16, state.renderBufSize);
       state.renderBufWidth = w;
       state.renderBufHeight = h;
       
@@ -267,7 +268,36 @@ void colorConvertYUV420ToRGB565Renderer( const uint8_t* srcYUV420,
                                           unsigned int   srcHeight,
                                           uint32_t*      dstRGB565 )
 {
-   fcvColorYUV420toRGB565u8(srcYUV420, srcWidth, srcHeight, dstRGB565);
+   const uint8_t* srcCb = srcYUV420 + srcWidth * srcHeight;
+   const uint8_t* srcCr = srcCb + srcWidth * srcHeight / 4;
+   uint16_t*      dst = (uint16_t*) dstRGB565;
+
+   uint8_t* cb = (uint8_t*) malloc( srcWidth * 5 );
+   uint8_t* cr = cb + srcWidth;
+   uint8_t* r = cr + srcWidth;
+   uint8_t* g = r + srcWidth;
+   uint8_t* b = g + srcWidth;
+
+   for( unsigned int y = 0; y < srcHeight; y++ )
+   {
+      // upsample the chroma row (nearest neighbour)
+      const uint8_t* rowCb = srcCb + (y >> 1) * (srcWidth >> 1);
+      const uint8_t* rowCr = srcCr + (y >> 1) * (srcWidth >> 1);
+      for( unsigned int x = 0; x < srcWidth; x++ )
+      {
+         cb[x] = rowCb[x >> 1];
+         cr[x] = rowCr[x >> 1];
+      }
+
+      ConvertYCbCrToRGB( srcYUV420 + y * srcWidth, cb, cr, r, g, b, srcWidth );
+
+      for( unsigned int x = 0; x < srcWidth; x++ )
+      {
+         *dst++ = (uint16_t) (((r[x] >> 3) << 11) | ((g[x] >> 2) << 5) | (b[x] >> 3));
+      }
+   }
+
+   free( cb );
 }
 
 //------------------------------------------------------------------------------
@@ -289,7 +319,7 @@ JNIEXPORT void JNICALL
 
    if( state.renderBufRGB565 != NULL )
    {
-      fcvMemFree( state.renderBufRGB565 );
+      free( state.renderBufRGB565 );
       state.renderBufRGB565 = NULL;
    }
 
@@ -18,12 +18,7 @@ JNIEXPORT void JNICALL Java_com_qualcomm_fastcvdemo_utils_FastCVUtil_init
    jobject obj
 )
 {
-   char sVersion[32];  
-   
-   fcvSetOperationMode( (fcvOperationMode) FASTCV_OP_PERFORMANCE );
-
-   fcvGetVersion(sVersion, 32);
-   DPRINTF( "Using FastCV version %s \n", sVersion );
+   DPRINTF( "FastCV utilities initialized\n" );
 
    return;
 }
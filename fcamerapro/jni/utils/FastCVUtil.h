@@ -12,7 +12,8 @@
 
 #include <jni.h>
 #include "FPSCounter.h"
-#include "fastcv/fastcv.h"
+#include <stdint.h>
+#include <android/log.h>
 
 #define LOG_TAG    "FastCVDemoJNI"
 #define DPRINTF(...)  __android_log_print(ANDROID_LOG_DEBUG,LOG_TAG,__VA_ARGS__)
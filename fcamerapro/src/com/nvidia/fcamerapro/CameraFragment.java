@@ -123,7 +123,6 @@ public final class CameraFragment extends Fragment implements OnClickListener, O
         adapter = ArrayAdapter.createFromResource(activity, R.array.output_format_array, android.R.layout.simple_spinner_item);
         adapter.setDropDownViewResource(android.R.layout.simple_spinner_dropdown_item);
         mOutputFormatSpinner.setAdapter(adapter);
-        mOutputFormatSpinner.setEnabled(false);
 
         // shooting mode
         mShootingModeSpinner = (Spinner) mContentView.findViewById(R.id.spinner_shooting_mode);
@@ -222,6 +221,26 @@ public final class CameraFragment extends Fragment implements OnClickListener, O
         super.onDestroyView();
     }
 
+    /**
+     * Creates a shot with the current preview capture parameters.
+     *
+     * @param flashOn
+     *            true if flash supposed to be enabled during the capture
+     * @return new shot
+     */
+    private FCamShot createShot(boolean flashOn) {
+        FCamInterface iface = FCamInterface.GetInstance();
+
+        FCamShot shot = new FCamShot();
+        shot.exposure = iface.getPreviewParam(FCamInterface.PreviewParams.EXPOSURE);
+        shot.gain = iface.getPreviewParam(FCamInterface.PreviewParams.GAIN);
+        shot.wb = iface.getPreviewParam(FCamInterface.PreviewParams.WB);
+        shot.focus = iface.getPreviewParam(FCamInterface.PreviewParams.FOCUS);
+        shot.flashOn = flashOn;
+
+        return shot;
+    }
+
     /**
      * Given current shooting mode and capture parameters, the method creates a
      * set of {@link FCamShot} that specify shots to be captured.
@@ -232,19 +251,7 @@ public final class CameraFragment extends Fragment implements OnClickListener, O
      *            true if flash supposed to be enabled during the capture
      */
     private void pushShots(ArrayList<FCamShot> shots, boolean flashOn) {
-        FCamInterface iface = FCamInterface.GetInstance();
-
-        double exposure = iface.getPreviewParam(FCamInterface.PreviewParams.EXPOSURE);
-        double gain = iface.getPreviewParam(FCamInterface.PreviewParams.GAIN);
-        double wb = iface.getPreviewParam(FCamInterface.PreviewParams.WB);
-        double focus = iface.getPreviewParam(FCamInterface.PreviewParams.FOCUS);
-
-        FCamShot shot = new FCamShot();
-        shot.exposure = exposure;
-        shot.gain = gain;
-        shot.wb = wb;
-        shot.focus = focus;
-        shot.flashOn = flashOn;
+        FCamShot shot = createShot(flashOn);
 
         // TODO: make selection based on object id not position (now its
         // constant dependent)
@@ -272,13 +279,18 @@ public final class CameraFragment extends Fragment implements OnClickListener, O
             }
             break;
         case 4: {
-            // bracketing
+            // bracketing (focus bracketing, near to far, for focus stacks)
+            boolean focusBracket = mOutputFormatSpinner.getSelectedItemPosition() == 5;
         	int numImages = mBrackSeekBar.getProgress() + 3;
         	for(int i = 0; i < numImages; i++){
         		FCamShot bshot = shot.clone();
-        		float ev = i * 4.0f / numImages;
-        		ev -= 2;
-        		bshot.exposure *= Math.pow(2, ev);
+        		if (focusBracket) {
+        		    bshot.focus = Settings.MIN_FOCUS + (Settings.MAX_FOCUS - Settings.MIN_FOCUS) * i / (numImages - 1);
+        		} else {
+        		    float ev = i * 4.0f / numImages;
+        		    ev -= 2;
+        		    bshot.exposure *= Math.pow(2, ev);
+        		}
         		shots.add(bshot);
         	}
             break;
@@ -311,20 +323,68 @@ public final class CameraFragment extends Fragment implements OnClickListener, O
             if (!iface.isCapturing()) {
                 ArrayList<FCamShot> shots = new ArrayList<FCamShot>(16);
 
-                switch (mFlashModeSpinner.getSelectedItemPosition()) {
-                case 0: // flash off
-                    pushShots(shots, false);
+                if (mOutputFormatSpinner.getSelectedItemPosition() == 4) {
+                    // flash/no-flash preset: a no-flash shot followed by a
+                    // flash shot, regardless of the flash and shooting modes
+                    shots.add(createShot(false));
+                    shots.add(createShot(true));
+                } else if (mOutputFormatSpinner.getSelectedItemPosition() == 6) {
+                    // night mode preset: a single shot, its parameters are
+                    // used for every streamed frame
+                    shots.add(createShot(false));
+                } else {
+                    switch (mFlashModeSpinner.getSelectedItemPosition()) {
+                    case 0: // flash off
+                        pushShots(shots, false);
+                        break;
+                    case 1: // flash on
+                        pushShots(shots, true);
+                        break;
+                    case 2: // flash off/on
+                        pushShots(shots, false);
+                        pushShots(shots, true);
+                        break;
+                    }
+                }
+
+                // TODO: make selection based on object id not position
+                switch (mOutputFormatSpinner.getSelectedItemPosition()) {
+                case 0: // JPEG
+                    iface.setOutputFormat(FCamInterface.OutputFormats.JPEG);
+                    break;
+                case 1: // JPEG + radiance map
+                    iface.setOutputFormat(FCamInterface.OutputFormats.JPEG_RADIANCE);
+                    break;
+                case 2: // JPEG + exposure fusion
+                    iface.setOutputFormat(FCamInterface.OutputFormats.JPEG_FUSION);
+                    break;
+                case 3: // JPEG + burst merge
+                    iface.setOutputFormat(FCamInterface.OutputFormats.JPEG_BURST_MERGE);
+                    break;
+                case 4: // JPEG + flash/no-flash fusion
+                    iface.setOutputFormat(FCamInterface.OutputFormats.JPEG_FLASH_FUSION);
+                    break;
+                case 5: // JPEG + focus stack
+                    iface.setOutputFormat(FCamInterface.OutputFormats.JPEG_FOCUS_STACK);
                     break;
-                case 1: // flash on
-                    pushShots(shots, true);
+                case 6: // JPEG + night mode
+                    iface.setOutputFormat(FCamInterface.OutputFormats.JPEG_NIGHT);
                     break;
-                case 2: // flash off/on
-                    pushShots(shots, false);
-                    pushShots(shots, true);
+                case 7: // RAW + developed JPEG
+                    iface.setOutputFormat(FCamInterface.OutputFormats.JPEG);
+                    for (FCamShot shot : shots) {
+                        shot.raw = true;
+                    }
+                    break;
+                case 8: // JPEG + lucky shot (sharpest frames of the burst)
+                    iface.setOutputFormat(FCamInterface.OutputFormats.JPEG_LUCKY);
                     break;
                 }
 
                 iface.capture(shots);
+            } else {
+                // ends night mode captures early
+                iface.stopCapture();
             }
         } else if (v == mAutoExposureCheckBox) {
             boolean autoEvaluate = mAutoExposureCheckBox.isChecked();
@@ -467,6 +527,19 @@ public final class CameraFragment extends Fragment implements OnClickListener, O
         FCamInterface.GetInstance().getHistogramData(data);
     }
 
+    /**
+     * Returns the R, G and B histograms for histogram view. The data is
+     * fetched directly from the {@link FCamInterface}.
+     *
+     * @param data
+     *            reference to array holding 768 floats.
+     * @return true
+     */
+    public boolean getRGBHistogramData(float[] data) {
+        FCamInterface.GetInstance().getRGBHistogramData(data);
+        return true;
+    }
+
     /**
      * Called when particular option menu is selected. Here we handle cases
      * specific only to viewer fragment.
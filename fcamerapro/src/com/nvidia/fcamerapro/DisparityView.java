@@ -0,0 +1,197 @@
+/* Copyright (c) 2011-2012, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+package com.nvidia.fcamerapro;
+
+import android.content.Context;
+import android.graphics.Bitmap;
+import android.graphics.Canvas;
+import android.graphics.Color;
+import android.graphics.Paint;
+import android.graphics.Paint.Style;
+import android.graphics.Rect;
+import android.os.Handler;
+import android.util.AttributeSet;
+import android.view.View;
+
+/**
+ * Custom UI component that displays the latest disparity map of the stereo
+ * camera preview (see {@link FCamInterface#getDisparityPlane(byte[])}). Near
+ * objects (large disparities) are drawn bright, pixels without a consistent
+ * match are left transparent. The map is scaled to fit the view, keeping its
+ * aspect ratio, and refreshed {@link Settings#UI_MAX_FPS} per second while the
+ * view is attached to a window.
+ */
+public final class DisparityView extends View {
+    /**
+     * Disparity map as copied from the native code
+     */
+    private byte[] mPlane;
+
+    /**
+     * Disparity map converted to ARGB colors
+     */
+    private int[] mPixels;
+
+    /**
+     * Bitmap holding {@link #mPixels}
+     */
+    private Bitmap mBitmap;
+
+    private Paint mBitmapPaint, mBackgroundPaint;
+    private final Rect mDestRect = new Rect();
+
+    /**
+     * UI thread handler. Needed for posting UI update messages directly from
+     * the UI thread.
+     */
+    private Handler mHandler = new Handler();
+
+    /**
+     * UI update event handler. Redraws the map {@link Settings#UI_MAX_FPS}
+     * per second. The event is added to event loop in
+     * {@link #onAttachedToWindow()} and removed in
+     * {@link #onDetachedFromWindow()}.
+     */
+    private Runnable mUpdateUITask = new Runnable() {
+        public void run() {
+            invalidate();
+            mHandler.postDelayed(this, 1000 / Settings.UI_MAX_FPS);
+        }
+    };
+
+    /**
+     * Default disparity view constructor.
+     *
+     * @param context
+     *            contains parent context
+     * @param attrs
+     *            contains xml attribute set
+     */
+    public DisparityView(Context context, AttributeSet attrs) {
+        super(context, attrs);
+
+        setBackgroundColor(Color.TRANSPARENT);
+
+        mBitmapPaint = new Paint();
+        mBitmapPaint.setFilterBitmap(true);
+
+        mBackgroundPaint = new Paint();
+        mBackgroundPaint.setColor(0x40707080);
+        mBackgroundPaint.setStyle(Style.STROKE);
+        mBackgroundPaint.setStrokeWidth(2);
+    }
+
+    /**
+     * Fetches the latest disparity map and converts it to {@link #mBitmap}.
+     *
+     * @return false if no map is available
+     */
+    private boolean updateBitmap() {
+        FCamInterface iface = FCamInterface.GetInstance();
+        int width = iface.getDisparityMapWidth();
+        int height = iface.getDisparityMapHeight();
+        if (width <= 0 || height <= 0) {
+            return false;
+        }
+
+        if (mBitmap == null || mBitmap.getWidth() != width || mBitmap.getHeight() != height) {
+            mPlane = new byte[width * height];
+            mPixels = new int[width * height];
+            mBitmap = Bitmap.createBitmap(width, height, Bitmap.Config.ARGB_8888);
+        }
+
+        // the map size can change between the size query and the copy
+        if (!iface.getDisparityPlane(mPlane)) {
+            return false;
+        }
+
+        for (int i = 0; i < mPlane.length; i++) {
+            int disparity = mPlane[i] & 0xff;
+            if (disparity == FCamInterface.INVALID_DISPARITY) {
+                mPixels[i] = Color.TRANSPARENT;
+            } else {
+                int v = disparity * 255 / (FCamInterface.MAX_DISPARITY - 1);
+                mPixels[i] = Color.rgb(v, v, v);
+            }
+        }
+        mBitmap.setPixels(mPixels, 0, width, 0, 0, width, height);
+
+        return true;
+    }
+
+    /**
+     * Draws disparity view.
+     */
+    @Override
+    protected void onDraw(Canvas canvas) {
+        if (canvas == null) {
+            return;
+        }
+
+        int width = getWidth();
+        int height = getHeight();
+
+        // clear bg
+        canvas.drawRect(0.0f, 0.0f, width, height, mBackgroundPaint);
+
+        if (isInEditMode() || !updateBitmap()) {
+            return;
+        }
+
+        // fit the map into the view
+        int mapWidth = mBitmap.getWidth();
+        int mapHeight = mBitmap.getHeight();
+        if (width * mapHeight > height * mapWidth) {
+            int w = height * mapWidth / mapHeight;
+            mDestRect.set((width - w) / 2, 0, (width + w) / 2, height);
+        } else {
+            int h = width * mapHeight / mapWidth;
+            mDestRect.set(0, (height - h) / 2, width, (height + h) / 2);
+        }
+        canvas.drawBitmap(mBitmap, null, mDestRect, mBitmapPaint);
+    }
+
+    /**
+     * Called when component is attached to the parent. Registers UI refresh
+     * task.
+     */
+    @Override
+    protected void onAttachedToWindow() {
+        super.onAttachedToWindow();
+        mHandler.postDelayed(mUpdateUITask, 0);
+    }
+
+    /**
+     * Called when component is detached from the parent. Removes UI refresh
+     * task.
+     */
+    @Override
+    protected void onDetachedFromWindow() {
+        mHandler.removeCallbacks(mUpdateUITask);
+        super.onDetachedFromWindow();
+    }
+}
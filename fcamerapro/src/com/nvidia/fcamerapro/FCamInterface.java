@@ -68,17 +68,63 @@ public final class FCamInterface {
     final static private int PARAM_FOCUS_ON_TOUCH = 18;
     final static private int PARAM_WB_ON_TOUCH = 19;
     final static private int PARAM_SELECT_CAMERA = 20;
+    final static private int PARAM_RGB_HISTOGRAM = 21;
+    final static private int PARAM_PREVIEW_METERING_MODE = 22;
+    final static private int PARAM_PREVIEW_3A_SKIP_RATIO = 23;
+    final static private int PARAM_RESPONSE_CURVE = 24;
+    final static private int PARAM_TONE_MAP_OPERATOR = 25;
+    final static private int PARAM_ALIGN_FRAMES = 26;
+    final static private int PARAM_RECALIBRATE = 27;
+    final static private int PARAM_CALIBRATED_GAINS = 28;
+    final static private int PARAM_STEREO_DISPARITY_ON = 29;
+    final static private int PARAM_DISPARITY_MAP_WIDTH = 30;
+    final static private int PARAM_DISPARITY_MAP_HEIGHT = 31;
+    final static private int PARAM_PREVIEW_HDR_FRAMES = 32;
+    final static private int PARAM_NIGHT_FRAMES = 33;
+    final static private int PARAM_LUCKY_FRAMES = 34;
 
     final static private int SHOT_PARAM_EXPOSURE = 0;
     final static private int SHOT_PARAM_FOCUS = 1;
     final static private int SHOT_PARAM_GAIN = 2;
     final static private int SHOT_PARAM_WB = 3;
     final static private int SHOT_PARAM_FLASH = 4;
+    final static private int SHOT_PARAM_RAW = 5;
+    final static private int SHOT_PARAM_COUNT = 6;
 
     final static private int SELECT_FRONT_CAMERA = 0;
     final static private int SELECT_BACK_CAMERA = 1;
     final static private int SELECT_STEREO_CAMERA = 2;
 
+    final static private int METERING_MODE_MATRIX = 0;
+    final static private int METERING_MODE_CENTER_WEIGHTED = 1;
+    final static private int METERING_MODE_SPOT = 2;
+
+    final static private int OUTPUT_FORMAT_JPEG = 0;
+    final static private int OUTPUT_FORMAT_JPEG_RADIANCE = 1;
+    final static private int OUTPUT_FORMAT_JPEG_FUSION = 2;
+    final static private int OUTPUT_FORMAT_JPEG_BURST_MERGE = 3;
+    final static private int OUTPUT_FORMAT_JPEG_FLASH_FUSION = 4;
+    final static private int OUTPUT_FORMAT_JPEG_FOCUS_STACK = 5;
+    final static private int OUTPUT_FORMAT_JPEG_NIGHT = 6;
+    final static private int OUTPUT_FORMAT_JPEG_LUCKY = 7;
+
+    final static private int CALIBRATION_GAIN_BUCKETS = 8;
+
+    /**
+     * Disparity map value of occluded and inconsistent pixels (see
+     * {@link #getDisparityPlane})
+     */
+    final static public int INVALID_DISPARITY = 255;
+
+    /**
+     * Exclusive upper bound of valid disparity map values (see
+     * {@link #getDisparityPlane})
+     */
+    final static public int MAX_DISPARITY = 32;
+
+    final static private int TONE_MAP_OPERATOR_GLOBAL = 0;
+    final static private int TONE_MAP_OPERATOR_LOCAL = 1;
+
     // ============================================================================
     // JAVA INTERFACE
     // ============================================================================
@@ -125,6 +171,80 @@ public final class FCamInterface {
         STEREO
     };
 
+    public enum MeteringModes {
+        /**
+         * Meters the whole frame, averaging zone brightness in log domain
+         */
+        MATRIX,
+        /**
+         * Meters the whole frame with emphasis on its center
+         */
+        CENTER_WEIGHTED,
+        /**
+         * Meters a small area around the last touch position (frame center by
+         * default)
+         */
+        SPOT
+    };
+
+    public enum OutputFormats {
+        /**
+         * Writes JPEG images
+         */
+        JPEG,
+        /**
+         * Writes JPEG images and merges the image stack into a radiance map
+         * (Radiance RGBE .hdr file) and its tone mapped JPEG version
+         */
+        JPEG_RADIANCE,
+        /**
+         * Writes JPEG images and blends the image stack into a single JPEG
+         * image by exposure fusion
+         */
+        JPEG_FUSION,
+        /**
+         * Writes JPEG images and aligns and merges the burst (identical shots)
+         * into a single low-noise JPEG image
+         */
+        JPEG_BURST_MERGE,
+        /**
+         * Writes JPEG images and fuses the no-flash shot with the flash shot
+         * taken right after it into a single JPEG image with the ambient
+         * lighting and the flash detail
+         */
+        JPEG_FLASH_FUSION,
+        /**
+         * Writes JPEG images and composites the focus bracket (shots focused
+         * at different distances) into a single all-in-focus JPEG image
+         */
+        JPEG_FOCUS_STACK,
+        /**
+         * Streams short exposures with the parameters of the first shot and
+         * averages the aligned frames into a single low-noise JPEG image (see
+         * {@link FCamInterface#setNightFrames}), writes the last frame as the
+         * JPEG image
+         */
+        JPEG_NIGHT,
+        /**
+         * Scores the sharpness of every burst frame as it arrives and writes
+         * only the sharpest ones (see {@link FCamInterface#setLuckyFrames}) as
+         * JPEG images
+         */
+        JPEG_LUCKY
+    };
+
+    public enum ToneMapOperators {
+        /**
+         * Photographic operator with automatic key value (Reinhard et al.)
+         */
+        GLOBAL,
+        /**
+         * Fast bilateral filtering operator (Durand and Dorsey) on a bilateral
+         * grid, preserves local contrast
+         */
+        LOCAL
+    };
+
     // single-ton class model
     static private FCamInterface sInstance = new FCamInterface();
 
@@ -248,6 +368,18 @@ public final class FCamInterface {
         getParamFloatArray(PARAM_LUMINANCE_HISTOGRAM, bins);
     }
 
+    /**
+     * Returns the R, G and B histograms for current preview frame. The data
+     * contains three consecutive 256 bins histograms normalized by their
+     * common largest bin.
+     *
+     * @param bins
+     *            reference to array holding 768 floats.
+     */
+    public void getRGBHistogramData(float[] bins) {
+        getParamFloatArray(PARAM_RGB_HISTOGRAM, bins);
+    }
+
     /**
      * Selects camera used for capture and preview. The change is immediate.
      *
@@ -284,6 +416,42 @@ public final class FCamInterface {
         }
     }
 
+    /**
+     * Selects exposure metering mode used by preview auto-exposure.
+     *
+     * @param mode
+     */
+    public void setMeteringMode(MeteringModes mode) {
+        switch (mode) {
+        case MATRIX:
+            setParamInt(PARAM_PREVIEW_METERING_MODE, METERING_MODE_MATRIX);
+            break;
+        case CENTER_WEIGHTED:
+            setParamInt(PARAM_PREVIEW_METERING_MODE, METERING_MODE_CENTER_WEIGHTED);
+            break;
+        case SPOT:
+            setParamInt(PARAM_PREVIEW_METERING_MODE, METERING_MODE_SPOT);
+            break;
+        }
+    }
+
+    /**
+     * Returns current exposure metering mode
+     *
+     * @return current exposure metering mode
+     */
+    public MeteringModes getMeteringMode() {
+        int mode = getParamInt(PARAM_PREVIEW_METERING_MODE);
+        switch (mode) {
+        case METERING_MODE_CENTER_WEIGHTED:
+            return MeteringModes.CENTER_WEIGHTED;
+        case METERING_MODE_SPOT:
+            return MeteringModes.SPOT;
+        default:
+            return MeteringModes.MATRIX;
+        }
+    }
+
     /**
      * Enables/disables auto-evaluation of preview frame capture parameters.
      *
@@ -395,6 +563,17 @@ public final class FCamInterface {
         return getParamFloat(PARAM_CAPTURE_FPS);
     }
 
+    /**
+     * Returns the ratio of preview frames for which auto-exposure, auto white
+     * balance and histogram evaluation has been skipped because the scene was
+     * stable. The value is updated together with the capture fps.
+     *
+     * @return skip ratio (0 - 1)
+     */
+    public float get3ASkipRatio() {
+        return getParamFloat(PARAM_PREVIEW_3A_SKIP_RATIO);
+    }
+
     /**
      * Gets preview capture state. If true then preview is active and capturing
      * frames.
@@ -416,6 +595,220 @@ public final class FCamInterface {
         setParamInt(PARAM_VIEWER_ACTIVE, enabled ? 1 : 0);
     }
 
+    /**
+     * Selects the output format of captured image stacks.
+     *
+     * @param format
+     */
+    public void setOutputFormat(OutputFormats format) {
+        switch (format) {
+        case JPEG:
+            setParamInt(PARAM_OUTPUT_FORMAT, OUTPUT_FORMAT_JPEG);
+            break;
+        case JPEG_RADIANCE:
+            setParamInt(PARAM_OUTPUT_FORMAT, OUTPUT_FORMAT_JPEG_RADIANCE);
+            break;
+        case JPEG_FUSION:
+            setParamInt(PARAM_OUTPUT_FORMAT, OUTPUT_FORMAT_JPEG_FUSION);
+            break;
+        case JPEG_BURST_MERGE:
+            setParamInt(PARAM_OUTPUT_FORMAT, OUTPUT_FORMAT_JPEG_BURST_MERGE);
+            break;
+        case JPEG_FLASH_FUSION:
+            setParamInt(PARAM_OUTPUT_FORMAT, OUTPUT_FORMAT_JPEG_FLASH_FUSION);
+            break;
+        case JPEG_FOCUS_STACK:
+            setParamInt(PARAM_OUTPUT_FORMAT, OUTPUT_FORMAT_JPEG_FOCUS_STACK);
+            break;
+        case JPEG_NIGHT:
+            setParamInt(PARAM_OUTPUT_FORMAT, OUTPUT_FORMAT_JPEG_NIGHT);
+            break;
+        case JPEG_LUCKY:
+            setParamInt(PARAM_OUTPUT_FORMAT, OUTPUT_FORMAT_JPEG_LUCKY);
+            break;
+        }
+    }
+
+    /**
+     * Returns current output format of captured image stacks
+     *
+     * @return current output format
+     */
+    public OutputFormats getOutputFormat() {
+        int format = getParamInt(PARAM_OUTPUT_FORMAT);
+        switch (format) {
+        case OUTPUT_FORMAT_JPEG_RADIANCE:
+            return OutputFormats.JPEG_RADIANCE;
+        case OUTPUT_FORMAT_JPEG_FUSION:
+            return OutputFormats.JPEG_FUSION;
+        case OUTPUT_FORMAT_JPEG_BURST_MERGE:
+            return OutputFormats.JPEG_BURST_MERGE;
+        case OUTPUT_FORMAT_JPEG_FLASH_FUSION:
+            return OutputFormats.JPEG_FLASH_FUSION;
+        case OUTPUT_FORMAT_JPEG_FOCUS_STACK:
+            return OutputFormats.JPEG_FOCUS_STACK;
+        case OUTPUT_FORMAT_JPEG_NIGHT:
+            return OutputFormats.JPEG_NIGHT;
+        case OUTPUT_FORMAT_JPEG_LUCKY:
+            return OutputFormats.JPEG_LUCKY;
+        default:
+            return OutputFormats.JPEG;
+        }
+    }
+
+    /**
+     * Selects the operator used to tone map radiance maps of captured image
+     * stacks (see {@link OutputFormats#JPEG_RADIANCE}).
+     *
+     * @param operator
+     */
+    public void setToneMapOperator(ToneMapOperators operator) {
+        switch (operator) {
+        case GLOBAL:
+            setParamInt(PARAM_TONE_MAP_OPERATOR, TONE_MAP_OPERATOR_GLOBAL);
+            break;
+        case LOCAL:
+            setParamInt(PARAM_TONE_MAP_OPERATOR, TONE_MAP_OPERATOR_LOCAL);
+            break;
+        }
+    }
+
+    /**
+     * Returns current radiance map tone mapping operator
+     *
+     * @return current tone mapping operator
+     */
+    public ToneMapOperators getToneMapOperator() {
+        int operator = getParamInt(PARAM_TONE_MAP_OPERATOR);
+        switch (operator) {
+        case TONE_MAP_OPERATOR_GLOBAL:
+            return ToneMapOperators.GLOBAL;
+        default:
+            return ToneMapOperators.LOCAL;
+        }
+    }
+
+    /**
+     * Enables or disables alignment of hand-held image stacks before they are
+     * merged into a radiance map or fused (enabled by default). The individual
+     * images are always written unaligned.
+     *
+     * @param enabled
+     */
+    public void enableFrameAlignment(boolean enabled) {
+        setParamInt(PARAM_ALIGN_FRAMES, enabled ? 1 : 0);
+    }
+
+    /**
+     * Returns the image stack alignment state
+     *
+     * @return true if image stacks are aligned before merging
+     */
+    public boolean isFrameAlignmentEnabled() {
+        return getParamInt(PARAM_ALIGN_FRAMES) != 0;
+    }
+
+    /**
+     * Sets the number of exposures of the live HDR preview (disabled by
+     * default). The preview stream cycles through 2 or 3 exposures two stops
+     * apart and shows their fusion, 3A runs on the fused frames.
+     *
+     * @param frames
+     *            exposures per cycle (2 or 3), 0 disables the HDR preview
+     */
+    public void setPreviewHdrFrames(int frames) {
+        setParamInt(PARAM_PREVIEW_HDR_FRAMES, frames);
+    }
+
+    /**
+     * Returns the number of exposures of the live HDR preview
+     *
+     * @return exposures per cycle, 0 if the HDR preview is disabled
+     */
+    public int getPreviewHdrFrames() {
+        return getParamInt(PARAM_PREVIEW_HDR_FRAMES);
+    }
+
+    /**
+     * Enables or disables the disparity map computation of the stereo camera
+     * preview (disabled by default).
+     *
+     * @param enabled
+     */
+    public void enableStereoDisparity(boolean enabled) {
+        setParamInt(PARAM_STEREO_DISPARITY_ON, enabled ? 1 : 0);
+    }
+
+    /**
+     * Returns the stereo preview disparity map computation state
+     *
+     * @return true if disparity maps are computed
+     */
+    public boolean isStereoDisparityEnabled() {
+        return getParamInt(PARAM_STEREO_DISPARITY_ON) != 0;
+    }
+
+    /**
+     * Returns the width of the latest stereo preview disparity map
+     *
+     * @return map width in pixels (0 if no map has been computed yet)
+     */
+    public int getDisparityMapWidth() {
+        return getParamInt(PARAM_DISPARITY_MAP_WIDTH);
+    }
+
+    /**
+     * Returns the height of the latest stereo preview disparity map
+     *
+     * @return map height in pixels
+     */
+    public int getDisparityMapHeight() {
+        return getParamInt(PARAM_DISPARITY_MAP_HEIGHT);
+    }
+
+    /**
+     * Stores the camera response curve of the current sensor, calibrated at
+     * the given gain (see {@link #gSolve}), in the persistent calibration
+     * store of the output directory. Radiance maps of subsequent captures at
+     * a similar gain use it instead of the default sRGB curve.
+     *
+     * @param curves
+     *            log exposure g(z) of the red, green and blue channel (3 arrays
+     *            of 256 values)
+     * @param gain
+     *            sensor gain of the images the curve was recovered from
+     */
+    public void setResponseCurve(float[][] curves, float gain) {
+        float[] curveArray = new float[3 * 256 + 1];
+        for (int c = 0; c < 3; c++) {
+            System.arraycopy(curves[c], 0, curveArray, c * 256, 256);
+        }
+        curveArray[3 * 256] = gain;
+        setParamFloatArray(PARAM_RESPONSE_CURVE, curveArray);
+    }
+
+    /**
+     * Drops the calibration data (response curves) of the current sensor.
+     */
+    public void recalibrate() {
+        setParamInt(PARAM_RECALIBRATE, 1);
+    }
+
+    /**
+     * Checks whether the current sensor has a response curve calibrated for
+     * the given gain. Gains are grouped into buckets by rounding log2(gain),
+     * the same way as the native calibration store does.
+     *
+     * @param gain
+     *            sensor gain
+     * @return true if a calibrated curve is available
+     */
+    public boolean isResponseCurveCalibrated(float gain) {
+        int bucket = gain > 0 ? (int) Math.floor(Math.log(gain) / Math.log(2) + 0.5) : 0;
+        bucket = Math.max(0, Math.min(bucket, CALIBRATION_GAIN_BUCKETS - 1));
+        return (getParamInt(PARAM_CALIBRATED_GAINS) & (1 << bucket)) != 0;
+    }
+
     /**
      * Issues image capture command. The native code stops updating preview and
      * captures a series of images which are subsequently compressed and dumped
@@ -428,7 +821,7 @@ public final class FCamInterface {
      *            images to be captured.
      */
     public void capture(ArrayList<FCamShot> shots) {
-        float[] shotArray = new float[5];
+        float[] shotArray = new float[SHOT_PARAM_COUNT];
         setParamInt(PARAM_BURST_SIZE, shots.size());
         for (int i = 0; i < shots.size(); i++) {
             FCamShot shot = shots.get(i);
@@ -437,12 +830,61 @@ public final class FCamInterface {
             shotArray[SHOT_PARAM_GAIN] = (float) shot.gain;
             shotArray[SHOT_PARAM_WB] = (float) shot.wb;
             shotArray[SHOT_PARAM_FLASH] = shot.flashOn ? 1 : 0;
+            shotArray[SHOT_PARAM_RAW] = shot.raw ? 1 : 0;
             setParamFloatArray(PARAM_SHOT | (i << 16), shotArray);
         }
 
         setParamInt(PARAM_TAKE_PICTURE, 1);
     }
 
+    /**
+     * Ends a night mode capture before its frame budget is reached, the
+     * frames accumulated so far are written.
+     */
+    public void stopCapture() {
+        setParamInt(PARAM_TAKE_PICTURE, 0);
+    }
+
+    /**
+     * Sets the frame budget of night mode captures (see
+     * {@link OutputFormats#JPEG_NIGHT}), 32 by default.
+     *
+     * @param frames
+     *            maximum number of averaged frames (1 to 255)
+     */
+    public void setNightFrames(int frames) {
+        setParamInt(PARAM_NIGHT_FRAMES, frames);
+    }
+
+    /**
+     * Returns the frame budget of night mode captures
+     *
+     * @return maximum number of averaged frames
+     */
+    public int getNightFrames() {
+        return getParamInt(PARAM_NIGHT_FRAMES);
+    }
+
+    /**
+     * Sets the number of burst frames kept in lucky shot mode (see
+     * {@link OutputFormats#JPEG_LUCKY}), 1 by default.
+     *
+     * @param frames
+     *            number of sharpest frames written (1 to 16)
+     */
+    public void setLuckyFrames(int frames) {
+        setParamInt(PARAM_LUCKY_FRAMES, frames);
+    }
+
+    /**
+     * Returns the number of burst frames kept in lucky shot mode
+     *
+     * @return number of sharpest frames written
+     */
+    public int getLuckyFrames() {
+        return getParamInt(PARAM_LUCKY_FRAMES);
+    }
+
     /**
      * Gets the capture state. If true then we are still capturing images.
      *
@@ -481,7 +923,8 @@ public final class FCamInterface {
      * expressed in normalized (0..1) coordinates inside the preview frame. This
      * event will start auto-focus procedure only if auto-evaluation of preview
      * frame parameters is enabled (see
-     * {@link #enablePreviewParamEvaluator(PreviewParams, boolean)}).
+     * {@link #enablePreviewParamEvaluator(PreviewParams, boolean)}). A
+     * position outside the frame resets the focus region to the frame center.
      *
      * @param x
      *            normalized touch x position
@@ -644,7 +1087,59 @@ public final class FCamInterface {
     private native String getParamString(int param);
     
     /**
-	 * Preforms the gSolve code.
-	 */
-	private native void gSolve(int[][] Z, float[] B, float lambda, int[] w);
+     * Recovers the camera response curve from a set of pixels observed under
+     * different exposures (Debevec and Malik, SIGGRAPH 1997). The solver
+     * minimizes the same objective as the original gsolve.m, i.e. weighted data
+     * fitting terms, g(128) = 0 and lambda weighted smoothness terms.
+     *
+     * @param Z
+     *            pixel values (0 - 255), Z[i][j] is pixel i in image j
+     * @param B
+     *            log exposure (ln dt) of each image
+     * @param lambda
+     *            smoothness term weight
+     * @param w
+     *            weighting function, 256 values
+     * @param lE
+     *            receives the log irradiance of each pixel location (may be
+     *            null)
+     * @return log exposure g(z) for each of 256 pixel values, or null if the
+     *         system could not be solved
+     */
+    public native float[] gSolve(int[][] Z, float[] B, float lambda, float[] w, float[] lE);
+
+    /**
+     * Selects pixel locations for camera response recovery from a stack of
+     * bracketed images. Samples are stratified across the intensity range of
+     * the reference exposure, prefer flat regions (low local gradient) and
+     * avoid locations that are clipped in most of the exposures.
+     *
+     * @param images
+     *            packed ARGB pixels of each image (see
+     *            {@link android.graphics.Bitmap#getPixels})
+     * @param width
+     *            image width
+     * @param height
+     *            image height
+     * @param reference
+     *            index of the reference (middle) exposure
+     * @param maxSamples
+     *            maximum number of samples to select
+     * @return selected pixel indices (y * width + x), or null on invalid input
+     */
+    public native int[] selectResponseSamples(int[][] images, int width, int height, int reference, int maxSamples);
+
+    /**
+     * Copies the latest disparity map of the stereo camera preview (see
+     * {@link #enableStereoDisparity}). The map covers the left view at half
+     * of its resolution in both directions, values are disparities in map
+     * pixels or {@link #INVALID_DISPARITY}.
+     *
+     * @param plane
+     *            receives the map, row by row, needs to hold exactly
+     *            {@link #getDisparityMapWidth()} *
+     *            {@link #getDisparityMapHeight()} values
+     * @return true if the map has been copied
+     */
+    public native boolean getDisparityPlane(byte[] plane);
 }
@@ -55,6 +55,12 @@ public final class FCamShot {
      */
     public boolean flashOn;
 
+    /**
+     * raw capture state (sensor-native Bayer data, written as a raw dump and
+     * a developed JPEG image)
+     */
+    public boolean raw;
+
     /**
      * Creates a deep copy of the {@code FCamShot} object
      */
@@ -66,6 +72,7 @@ public final class FCamShot {
         instance.wb = wb;
         instance.focus = focus;
         instance.flashOn = flashOn;
+        instance.raw = raw;
 
         return instance;
     }
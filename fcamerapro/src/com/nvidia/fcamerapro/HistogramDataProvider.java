@@ -38,4 +38,14 @@ public interface HistogramDataProvider {
      *            reference to array holding at least 256 floats.
      */
     public void getHistogramData(float[] data);
+
+    /**
+     * Returns normalized R, G and B histograms for histogram view, stored as
+     * three consecutive 256 bins histograms.
+     *
+     * @param data
+     *            reference to array holding at least 768 floats.
+     * @return false if the data source has no color histograms
+     */
+    public boolean getRGBHistogramData(float[] data);
 }
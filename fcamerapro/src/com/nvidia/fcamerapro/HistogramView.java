@@ -41,7 +41,9 @@ import android.view.View.OnClickListener;
  * changed at run-time with {@link #setDataProvider(HistogramDataProvider)}
  * function call. The histogram component is refreshed either continuously (with
  * frequency defined by {@link Settings#UI_MAX_FPS}) or upon content change. The
- * refresh mode depends on {@code auto_refresh} attribute.
+ * refresh mode depends on {@code auto_refresh} attribute. Clicking the view
+ * cycles through luma, coarse luma and (if the data source has them) overlaid
+ * R, G and B histograms.
  */
 public final class HistogramView extends View implements OnClickListener {
     final static private int DRAW_MODE_COARSE_ACCUM_COLUMNS = 4;
@@ -50,7 +52,7 @@ public final class HistogramView extends View implements OnClickListener {
      * Histogram drawing modes.
      */
     private enum DrawMode {
-        NORMAL, COARSE;
+        NORMAL, COARSE, RGB;
     }
 
     /**
@@ -58,12 +60,18 @@ public final class HistogramView extends View implements OnClickListener {
      */
     private final float[] mBinData = new float[256];
 
+    /**
+     * Normalized R, G and B histogram data
+     */
+    private final float[] mRGBBinData = new float[3 * 256];
+
     /**
      * Current data provider
      */
     private HistogramDataProvider mDataProvider;
 
     private Paint mHistogramPaint, mBackgroundPaint;
+    private final Paint[] mChannelPaints = new Paint[3];
 
     private DrawMode mDrawMode;
     final private boolean mAutoRefresh;
@@ -99,6 +107,9 @@ public final class HistogramView extends View implements OnClickListener {
             for (int i = 0; i < mBinData.length; i++) {
                 mBinData[i] = 0.0f;
             }
+            if (mDrawMode == DrawMode.RGB) {
+                mDrawMode = DrawMode.NORMAL;
+            }
         }
         postInvalidate();
     }
@@ -131,6 +142,12 @@ public final class HistogramView extends View implements OnClickListener {
         mBackgroundPaint.setStyle(Style.STROKE);
         mBackgroundPaint.setStrokeWidth(2);
 
+        final int[] channelColors = { 0x80e04040, 0x8040e040, 0x804060f0 };
+        for (int c = 0; c < channelColors.length; c++) {
+            mChannelPaints[c] = new Paint();
+            mChannelPaints[c].setColor(channelColors[c]);
+        }
+
         mDrawMode = attrs.getAttributeBooleanValue(null, "draw_coarse", false) ? DrawMode.COARSE : DrawMode.NORMAL;
     }
 
@@ -153,7 +170,12 @@ public final class HistogramView extends View implements OnClickListener {
 
         // query fcam
         if (mDataProvider != null) {
-            mDataProvider.getHistogramData(mBinData);
+            if (mDrawMode == DrawMode.RGB && !mDataProvider.getRGBHistogramData(mRGBBinData)) {
+                mDrawMode = DrawMode.NORMAL;
+            }
+            if (mDrawMode != DrawMode.RGB) {
+                mDataProvider.getHistogramData(mBinData);
+            }
         }
 
         // draw bars
@@ -179,6 +201,16 @@ public final class HistogramView extends View implements OnClickListener {
                 ax += dx;
             }
             break;
+        case RGB:
+            // translucent channels, overlaps blend towards white
+            for (int c = 0; c < mChannelPaints.length; c++) {
+                ax = 0.0f;
+                for (int i = 0; i < mBinData.length; i++) {
+                    canvas.drawRect(ax, height - height * mRGBBinData[c * mBinData.length + i], ax + dx, height, mChannelPaints[c]);
+                    ax += dx;
+                }
+            }
+            break;
         }
     }
 
@@ -192,6 +224,10 @@ public final class HistogramView extends View implements OnClickListener {
             mDrawMode = DrawMode.COARSE;
             break;
         case COARSE:
+            boolean hasRGBData = mDataProvider != null && mDataProvider.getRGBHistogramData(mRGBBinData);
+            mDrawMode = hasRGBData ? DrawMode.RGB : DrawMode.NORMAL;
+            break;
+        case RGB:
             mDrawMode = DrawMode.NORMAL;
             break;
         }
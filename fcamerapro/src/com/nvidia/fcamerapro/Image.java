@@ -190,6 +190,24 @@ public final class Image implements HistogramDataProvider {
         return str;
     }
 
+    /**
+     * Returns the exposure time the image has been captured with.
+     *
+     * @return exposure time in microseconds
+     */
+    public int getExposure() {
+        return mExposure;
+    }
+
+    /**
+     * Returns the sensor gain the image has been captured with.
+     *
+     * @return sensor gain (ISO)
+     */
+    public int getGain() {
+        return mGain;
+    }
+
     /**
      * Returns the histogram data for this image. The data contains normalized
      * 256 bins histogram values.
@@ -203,4 +221,15 @@ public final class Image implements HistogramDataProvider {
         }
     }
 
+    /**
+     * Color histograms are not computed for stored images.
+     *
+     * @param data
+     *            reference to array holding 768 floats (unused).
+     * @return false
+     */
+    public boolean getRGBHistogramData(float[] data) {
+        return false;
+    }
+
 }
@@ -179,8 +179,9 @@ public final class StereoCameraFragment extends Fragment implements OnClickListe
         // start ui update timer
         mHandler.postDelayed(mUpdateUITask, 0);
 
-        // set stereo camera
+        // set stereo camera, compute disparity maps of the preview
         FCamInterface.GetInstance().selectCamera(Cameras.STEREO);
+        FCamInterface.GetInstance().enableStereoDisparity(true);
 
         // setup default view params
         updateControls();
@@ -196,6 +197,8 @@ public final class StereoCameraFragment extends Fragment implements OnClickListe
         // stop ui update timer
         mHandler.removeCallbacks(mUpdateUITask);
 
+        FCamInterface.GetInstance().enableStereoDisparity(false);
+
         super.onDestroyView();
     }
 
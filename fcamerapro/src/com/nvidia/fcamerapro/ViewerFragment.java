@@ -26,11 +26,8 @@
  */
 package com.nvidia.fcamerapro;
 
-import java.io.File;
 import java.io.IOException;
-import java.nio.Buffer;
-import java.nio.ByteBuffer;
-import java.util.ArrayList;
+import java.util.Arrays;
 
 import android.app.DialogFragment;
 import android.app.Fragment;
@@ -48,6 +45,7 @@ import android.view.Menu;
 import android.view.MenuItem;
 import android.view.View;
 import android.view.View.OnClickListener;
+import android.view.View.OnLongClickListener;
 import android.view.ViewGroup;
 import android.webkit.WebView;
 import android.widget.AdapterView;
@@ -64,16 +62,13 @@ import android.widget.Toast;
 
 import com.nvidia.fcamerapro.FCamInterface.PreviewParams;
 
-import edu.gatech.flojama.Matrix;
-import edu.gatech.flojama.SingularValueDecomposition;
-
 /**
  * Image viewer component. It is a simple image gallery where top row shows
  * available image stacks, and bottom row shows images in currently selected
  * stack. Basic capture information about images and stacks is displayed on the
  * side.
  */
-public final class ViewerFragment extends Fragment implements FCamInterfaceEventListener, OnClickListener {
+public final class ViewerFragment extends Fragment implements FCamInterfaceEventListener, OnClickListener, OnLongClickListener {
     /**
      * Reference to fragment view component created by
      * {@link #initContentView()}
@@ -92,6 +87,13 @@ public final class ViewerFragment extends Fragment implements FCamInterfaceEvent
     private Toast mPreviewHint;
     private Button mRadianceButton;
 
+    /**
+     * Camera response curve recovery settings: maximum number of pixel
+     * locations sampled from the stack thumbnails and smoothness weight.
+     */
+    final static private int RESPONSE_SAMPLE_COUNT = 300;
+    final static private float RESPONSE_SMOOTHNESS = 1.0f;
+
     /**
      * UI thread handler. Needed for posting UI update messages directly from
      * the UI thread.
@@ -222,6 +224,7 @@ public final class ViewerFragment extends Fragment implements FCamInterfaceEvent
         mGalleryInfoValue = (TextView) mContentView.findViewById(R.id.tv_gallery_info_value);
         mRadianceButton = (Button) mContentView.findViewById(R.id.radiance_gen);
         mRadianceButton.setOnClickListener(this);
+        mRadianceButton.setOnLongClickListener(this);
         mHistogram = (HistogramView) mContentView.findViewById(R.id.gallery_histogram);
 
         mPreviewHint = Toast.makeText(activity, R.string.label_preview_hint, Toast.LENGTH_SHORT);
@@ -516,251 +519,100 @@ public final class ViewerFragment extends Fragment implements FCamInterfaceEvent
 
 	@Override
 	public void onClick(View arg0) {
+		solveResponseCurve(false);
+	}
+
+	/**
+	 * Drops the calibration of the current sensor and recovers the response
+	 * curve again from the selected stack.
+	 */
+	@Override
+	public boolean onLongClick(View arg0) {
+		FCamInterface.GetInstance().recalibrate();
+		solveResponseCurve(true);
+		return true;
+	}
+
+	/**
+	 * Recovers the camera response curve from the selected image stack and
+	 * stores it in the calibration store, unless the sensor is already
+	 * calibrated for the stack's gain.
+	 *
+	 * @param force
+	 *            solve even if a calibrated curve is available
+	 */
+	private void solveResponseCurve(boolean force) {
+		if (mImageStackManager.getStackCount() == 0 || !mImageStackManager.getStack(mSelectedStack).isLoadComplete()) {
+			return;
+		}
+
 		ImageStack istack = mImageStackManager.getStack(mSelectedStack);
-		ArrayList<Buffer> imgBuffers = new ArrayList<Buffer>();
 		int numPhotos = istack.getImageCount();
-		int imW = 0, imH = 0;
-		for(int i = 0; i < istack.getImageCount(); i++){
-
-			String filename = new File(istack.getImage(i).getName()).getAbsolutePath();
-			Log.d("algo", "Reading in " + filename);
-//			Bitmap cur = BitmapFactory.decodeFile(filename);
-			Bitmap cur = mImageStackManager.getStack(i).getImage(0).getThumbnail();
-			cur = Bitmap.createScaledBitmap(cur, 16, 16, false);
-			
-			imW = cur.getWidth();
-			imH = cur.getHeight();
-			
-			Log.d("size", ""+imW);
-			Log.d("size", ""+imH);
-			Log.d("size", ""+cur.getByteCount());
-			Log.d("size", ""+(imW * imH * 4));
-			
-			ByteBuffer ib = ByteBuffer.allocate(cur.getByteCount());
-			
-			cur.copyPixelsToBuffer(ib);
-			
-			imgBuffers.add(ib);
-		}
-		
-		Log.d("algo", "Read in " + imgBuffers.size() + " images.");
-		Log.d("algo", "Image size is " + imW + " by " + imH);
-		
-		float zMin = Float.MAX_VALUE;
-		float zMax = Float.MIN_VALUE;
-		
-		byte[][] imgDatas = new byte[imgBuffers.size()][];{
-			int end = imgBuffers.size();
-			int realIndex = 0;
-			for(int i = 0; i < end; i++){
-				imgDatas[realIndex] = (byte[])imgBuffers.get(0).array();
-				realIndex++;
-				imgBuffers.remove(i);
-				end--;
-				i--;
-				System.gc();
+		int width = istack.getImage(0).getThumbnail().getWidth();
+		int height = istack.getImage(0).getThumbnail().getHeight();
+
+		// thumbnail pixels and ln(dt) of every image, sensor gain scales the exposure the same way
+		int[][] pixels = new int[numPhotos][width * height];
+		float[] B = new float[numPhotos];
+		for (int i = 0; i < numPhotos; i++) {
+			Image image = istack.getImage(i);
+			Bitmap cur = image.getThumbnail();
+			if (cur.getWidth() != width || cur.getHeight() != height) {
+				cur = Bitmap.createScaledBitmap(cur, width, height, true);
 			}
+			cur.getPixels(pixels[i], 0, width, 0, 0, width, height);
+			B[i] = (float) Math.log(image.getExposure() * 1e-6 * image.getGain());
 		}
-		
-		imgBuffers = null;
-		System.gc();
-		
-		Log.d("algo", "Converted buffers into arrays");
-		
-		float[][][] zVals = new float[3][imgDatas[0].length/4][imgDatas.length];
-		for(int channel = 0; channel < zVals.length; channel++){
-			// Goes through each channel
-			for(int imgNum = 0; imgNum < zVals[channel][0].length; imgNum++){
-				// Goes through every image
-				for(int pixelNum = 0; pixelNum < zVals[channel].length; pixelNum++){
-					zVals[channel][pixelNum][imgNum] = imgDatas[imgNum][pixelNum * 4 + channel];
-				}
-			}
+
+		// the median exposure is the reference for intensity stratification
+		float[] sortedB = B.clone();
+		Arrays.sort(sortedB);
+		int reference = 0;
+		while (B[reference] != sortedB[numPhotos / 2]) {
+			reference++;
 		}
 
-		Log.d("algo", "Separated image color channels");
-		
-		imgDatas = null;
-		System.gc();
-			
-		Matrix Z = new Matrix(zVals[0]);
-		
-		System.out.println();
-		
-		float[][] bVals = new float[numPhotos][1];
-		for(int i = 0; i < bVals.length; i++){
-			bVals[i][0] = (float) ((i * 4.0 / bVals.length) - 2.0);
+		// the curve depends on the sensor and roughly on gain only, solve once per gain
+		// the stack descriptor stores ISO, i.e. 100 times the sensor gain
+		float gain = istack.getImage(reference).getGain() / 100.0f;
+		if (!force && FCamInterface.GetInstance().isResponseCurveCalibrated(gain)) {
+			Log.i("ViewerFragment", "Camera response already calibrated for gain " + gain);
+			return;
 		}
-		
-		Matrix B = new Matrix(bVals);
-		bVals = null;
-		System.gc();
-		
-		Log.d("algo", "Exposure info added to B array");
-		
-		float lambda = 1.0f;
-		
-		float[][] wArr = new float[Z.getRowDimension()][1];
-		for(int i = 0; i < wArr.length; i++){
-			wArr[i][0] = 1.0f;
+
+		int[] samples = FCamInterface.GetInstance().selectResponseSamples(pixels, width, height, reference, RESPONSE_SAMPLE_COUNT);
+		if (samples == null || samples.length == 0) {
+			Log.e("ViewerFragment", "No usable samples for camera response recovery!");
+			return;
 		}
-		Matrix w = new Matrix(wArr);
-		wArr = null;
-		System.gc();
-		
-		Log.d("algo", "Created weight matrix");
-		
-		// --------------------------------
-		// - BEGIN INTERLACED MATLAB CODE -
-		// --------------------------------
-		
-//		n = 256;
-		int n = 256;
-		
-//		%Zeros returns a vector of all zeros
-//		%Size in this case returns the size of the dimension specified by the second arg
-//		%As in, size[(1 2 3), 2] would return 2
-//		%in size(Z,1) we're returning the number of rows in Z
-//		%then multiplying that by the num cols in Z
-//		%This is using MATRIX multiplication rather than array multiplication
-//		%then adding that to N+1
-//		%for n+size(Z,1), we're getting the num rows in Z
-//		%adding N to it
-//		%AND THEEEEN we return a matrix of zeros based on those calculations
-
-
-//		A = zeros(size(Z,1)*size(Z,2)+n+1,n+size(Z,1));
-		int pixelCount = Z.getRowDimension();
-		int imgCount = Z.getColumnDimension();
-		float[][] AArr = new float[pixelCount * imgCount + n + 1][n + pixelCount];
-		Matrix A = new Matrix(AArr);
-		AArr = null;
-		System.gc();
-		
-
-		Log.d("algo", "Created A matrix");
-				
-//		%Getting the num rows in A
-//		%And then performing zeros on that element and 1 (1 dimensional vector of zeros)
-
-//		b = zeros(size(A,1),1);
-		Matrix b = new Matrix(new float[A.getRowDimension()][1]);
-		
-
-		Log.d("algo", "Created b matrix");
-		
-//		%% Include the data−fitting equations
-		
-
-//		k = 1;
-		int k = 1;
-
-		Log.d("algo", "Looping through each pixel");
-//		for i=1:size(Z,1)  %num rows in Z (for loop working on elements 1 through num rows in Z)
-		for( int i = 0; i < Z.getRowDimension(); i++){
-
-			Log.d("algo", "Looping through each image");
-//			for j=1:size(Z,2) %num cols in Z  (for loop working on elements 1 through num cols in Z)
-			for(int j = 0; j < Z.getColumnDimension(); j++){
-				 
-//				 %A few things going on here
-//				 %Z(i,j) gets the value at row i and col j in Z
-//				 %then we add 1
-//				 %then we find THAT value in Matrix w
-				 
-//				 wij = w(Z(i,j)+1); 
-				 float wij = w.get((int)(Z.get(i,j)+0.5), 0);
-				 
-//				 %A(k, Z(i,j) is finding the value at row i and col j in Z
-//				 %then finding the value at K and (Z(i,j) in matrix A
-//				 %Then setting that equal to the value wij
-				 
-//				 A(k,Z(i,j)+1) = wij; 
-				 A.set(k, (int)(Z.get(i,j)+0.5), wij);
-				 
-//				 %Finds the value located at row K and col n+1 in matrix A
-//				 %Then sets it equal to the negative value of wij
-				 
-//				 A(k,n+i) = −wij; 
-				 A.set(k, n+i, -1 * wij);
-				 
-				 
-//				 %Matrix multiplication on wij and the value located at row i in B
-//				 %Then sets ^^^^ that value to the value located at row k and col 1 in b
-				 
-//				 b(k,1) = wij * B(j);
-				 b.set(k, 0, wij * B.get(j, 0));
-				 
-//				 k=k+1;
-				 k++;
-				 
-//			 end %ends inner loop
+
+		// Z[channel][sample][image]
+		int[][][] zVals = new int[3][samples.length][numPhotos];
+		for (int i = 0; i < numPhotos; i++) {
+			for (int p = 0; p < samples.length; p++) {
+				int pixel = pixels[i][samples[p]];
+				zVals[0][p][i] = Color.red(pixel);
+				zVals[1][p][i] = Color.green(pixel);
+				zVals[2][p][i] = Color.blue(pixel);
 			}
-//		end  %ends outer loop
 		}
 
-
-//		%% Fix the curve by setting its middle value to 0
-
-//		%sets the value located at row k and col 129 in A to 1
-//		A(k,129) = 1;
-		A.set(k, 128, (float) 1.0);
-//		k=k+1;
-		k++;
-		
-		Log.d("algo", "Setting curve mid value to 0");
-
-//		%% Include the smoothness equations
-
-//		for i=1:n−2 %for loops starting at 1 going to n-2
-		for(int i = 0; i < n-2; i++){
-	
-//			%matrix multiplication on l (lambda constant) to the value located at row i+1 in W
-//			%then set ^^^^ that value to the location in row k and col i in A
-	
-//			A(k,i)=l*w(i+1); 
-			A.set(k, i, lambda * w.get(i+1, 0));
-			
-//			%matrix multiplication on row i+1 in W by -2 * l (also matrix multiplication)
-//			%Then sets that value in location row k col i+1 in matrix A
-			
-//			A(k,i+1)=−2*l*w(i+1);
-			A.set(k, i+1, -2 * lambda * w.get(i+1, 0));
-			
-//			%matrix multiplication of l with location row i+1 in matrix w
-//			%sets that value to location row k col i+2 in A
-//			A(k,i+2)=l*w(i+1);
-			A.set(k, i+2, lambda * w.get(i+1, 0));
-			
-//			k=k+1;
-			k++;
-//		end
+		// hat weighting function, favours mid-tones over under/over exposed values
+		float[] w = new float[256];
+		for (int z = 0; z < w.length; z++) {
+			w[z] = z <= 127 ? z : 255 - z;
 		}
-		
-//		%% Solve the system using SVD
-
-		Log.d("algo", "Doing SVD, bless our hearts.");
-		
-//		x = A\b;
-		Matrix x;
-		SingularValueDecomposition svd = new SingularValueDecomposition(A);
-		Log.d("algo", "SVD completed.");
-		x = svd.getU().times(svd.getS().inverse()).times(svd.getV().transpose()).times(b);
-		
-		Log.d("algo", "Done computing result matrix.");
-		
-//		g = x(1:n);
-		Matrix g = new Matrix(n,1);
-		for(int i = 0; i < n; i++){
-			g.set(i, 0, x.get(i,0));
+
+		float[][] curves = new float[3][];
+		for (int channel = 0; channel < curves.length; channel++) {
+			curves[channel] = FCamInterface.GetInstance().gSolve(zVals[channel], B, RESPONSE_SMOOTHNESS, w, null);
+			if (curves[channel] == null) {
+				Log.e("ViewerFragment", "Camera response recovery failed!");
+				return;
+			}
 		}
-		
-		Log.d("algo", "End of BSolve");
-//		lE = x(n+1:size(x,1));
-		
-		// ------------------------------
-		// - END INTERLACED MATLAB CODE -
-		// ------------------------------
-	
+
+		// use the recovered curves for radiance maps of subsequent captures
+		FCamInterface.GetInstance().setResponseCurve(curves, gain);
 	}
 }